@@ -88,5 +88,14 @@ for x in split-index clipped-index; do
 done
 }
 
+# The latency runs above, in one process that loads each index once.
+latency_sweep() {
+    $PISA/bin/queries \
+        -s quantized \
+        --threads 16 \
+        --sweep improvement-sequence.sweep \
+        --sweep-results latency.json
+}
+
 effectiveness
-latency
+latency_sweep
@@ -0,0 +1,176 @@
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "boost/preprocessor/cat.hpp"
+#include "boost/preprocessor/seq/for_each.hpp"
+#include "boost/preprocessor/stringize.hpp"
+#include "fmt/format.h"
+#include "spdlog/spdlog.h"
+
+#include "index_types.hpp"
+#include "memory_source.hpp"
+#include "query/cursor_trace.hpp"
+#include "util/do_not_optimize_away.hpp"
+#include "util/util.hpp"
+#include "wand_data.hpp"
+#include "wand_data_compressed.hpp"
+#include "wand_data_raw.hpp"
+
+using pisa::CursorCall;
+using pisa::CursorOp;
+using pisa::do_not_optimize_away;
+using pisa::get_time_usecs;
+using pisa::ListTrace;
+
+/// Replays the calls of `traces` of every list class `repetitions` times, after a warm-up, and
+/// prints the minimum and mean time per call as a line of
+///
+///     <type> TAB <list class> TAB <min ns per call> TAB <mean ns per call>
+///
+/// to the standard output. `replay` replays the calls of one trace.
+template <typename Replay>
+void replay_traces(
+    std::vector<ListTrace> const& traces,
+    std::string const& name,
+    std::size_t repetitions,
+    Replay replay)
+{
+    std::map<std::string, std::vector<ListTrace const*>> classes;
+    for (auto const& trace: traces) {
+        classes[trace.list_class].push_back(&trace);
+    }
+    for (auto const& [list_class, class_traces]: classes) {
+        std::size_t calls = 0;
+        for (auto const* trace: class_traces) {
+            calls += replay(*trace);
+        }
+        if (calls == 0) {
+            continue;
+        }
+        double min_ns = std::numeric_limits<double>::max();
+        double total_ns = 0;
+        for (std::size_t rep = 0; rep < repetitions; ++rep) {
+            auto tick = get_time_usecs();
+            for (auto const* trace: class_traces) {
+                replay(*trace);
+            }
+            double ns = (get_time_usecs() - tick) * 1000 / calls;
+            min_ns = std::min(min_ns, ns);
+            total_ns += ns;
+        }
+        spdlog::info(
+            "Replayed {} calls on {} {} lists: {:.1f} ns per call (min), {:.1f} (mean)",
+            calls,
+            class_traces.size(),
+            list_class,
+            min_ns,
+            total_ns / repetitions);
+        std::cout << fmt::format(
+            "{}\t{}\t{:.1f}\t{:.1f}\n", name, list_class, min_ns, total_ns / repetitions);
+    }
+}
+
+/// Replays the `next()` and `next_geq()` calls of the traces on the lists of an index.
+template <typename IndexType>
+void replay_postings(
+    std::vector<ListTrace> const& traces,
+    std::string const& type,
+    std::string const& index_filename,
+    std::size_t repetitions)
+{
+    spdlog::info("Loading index from {}", index_filename);
+    IndexType index(pisa::MemorySource::mapped_file(index_filename));
+    replay_traces(traces, type, repetitions, [&](ListTrace const& trace) {
+        auto cursor = index[trace.term];
+        std::size_t calls = 0;
+        for (auto const& call: trace.calls) {
+            switch (call.op) {
+            case CursorOp::Next: cursor.next(); break;
+            case CursorOp::NextGeq: cursor.next_geq(call.docid); break;
+            case CursorOp::BlockMaxNextGeq: continue;
+            }
+            do_not_optimize_away(cursor.docid());
+            do_not_optimize_away(cursor.freq());
+            calls += 1;
+        }
+        return calls;
+    });
+}
+
+/// Replays the `block_max_next_geq()` calls of the traces on the block max scores of wand data.
+template <typename WandType>
+void replay_block_max(
+    std::vector<ListTrace> const& traces,
+    std::string const& layout,
+    std::string const& wand_filename,
+    std::size_t repetitions)
+{
+    spdlog::info("Loading wand data from {}", wand_filename);
+    WandType wdata(pisa::MemorySource::mapped_file(wand_filename));
+    replay_traces(traces, layout, repetitions, [&](ListTrace const& trace) {
+        auto cursor = wdata.getenum(trace.term);
+        std::size_t calls = 0;
+        for (auto const& call: trace.calls) {
+            if (call.op == CursorOp::BlockMaxNextGeq) {
+                cursor.next_geq(call.docid);
+                do_not_optimize_away(cursor.score());
+                calls += 1;
+            }
+        }
+        return calls;
+    });
+}
+
+int main(int argc, const char** argv)
+{
+    using namespace pisa;
+
+    if (argc < 4) {
+        std::cerr << "Usage: " << argv[0]
+                  << " <traces> <repetitions> <type>:<filename>...\n\n"
+                     "Replays the cursor calls traced by `queries --trace-cursors` on the lists\n"
+                     "of the given indexes, where <type> is a block index type, and on the block\n"
+                     "max scores of the given wand data, where <type> is raw or compressed."
+                  << std::endl;
+        return 1;
+    }
+
+    std::ifstream is(argv[1]);
+    auto traces = read_cursor_traces(is);
+    std::size_t repetitions = std::stoul(argv[2]);
+    spdlog::info("Read {} traces from {}", traces.size(), argv[1]);
+
+    for (int arg = 3; arg < argc; ++arg) {
+        std::string target = argv[arg];
+        auto colon = target.find(':');
+        if (colon == std::string::npos) {
+            spdlog::error("Expected <type>:<filename>, got {}", target);
+            return 1;
+        }
+        auto type = target.substr(0, colon);
+        auto filename = target.substr(colon + 1);
+        if (type == "raw") {
+            replay_block_max<wand_data<wand_data_raw>>(traces, type, filename, repetitions);
+        } else if (type == "compressed") {
+            replay_block_max<wand_data<wand_data_compressed<>>>(
+                traces, type, filename, repetitions);
+        }
+#define LOOP_BODY(R, DATA, T)                                                                  \
+    else if (type == BOOST_PP_STRINGIZE(T))                                                    \
+    {                                                                                          \
+        replay_postings<BOOST_PP_CAT(T, _index)>(traces, type, filename, repetitions);         \
+    }                                                                                          \
+    /**/
+        BOOST_PP_SEQ_FOR_EACH(LOOP_BODY, _, PISA_BLOCK_INDEX_TYPES)
+#undef LOOP_BODY
+        else {
+            spdlog::error("Unknown type {}", type);
+            return 1;
+        }
+    }
+}
@@ -3,14 +3,16 @@
 #include "spdlog/spdlog.h"
 
 #include "index_types.hpp"
+#include "perf_counters.hpp"
 #include "util/do_not_optimize_away.hpp"
 #include "util/util.hpp"
 
 using pisa::do_not_optimize_away;
 using pisa::get_time_usecs;
+using pisa::PerfCounters;
 
 template <typename IndexType, bool with_freqs>
-void perftest(IndexType const& index, std::string const& type)
+void perftest(IndexType const& index, std::string const& type, PerfCounters* perf)
 {
     std::string freqs_log = with_freqs ? "+freq()" : "";
     {
@@ -31,6 +33,9 @@ void perftest(IndexType const& index, std::string const& type)
             }
         }
 
+        if (perf != nullptr) {
+            perf->start();
+        }
         auto tick = get_time_usecs();
         uint64_t calls_per_list = 500000;
         size_t postings = 0;
@@ -54,6 +59,9 @@ void perftest(IndexType const& index, std::string const& type)
             freqs_log,
             uint64_t(elapsed / 1000000),
             next_ns);
+        if (perf != nullptr) {
+            spdlog::info("Per posting: {}", format_perf_sample(*perf, perf->stop(), postings));
+        }
         spdlog::info("{}\tnext{}\t{:.1f}", type, (with_freqs ? "_freq" : ""), next_ns);
     }
 
@@ -76,6 +84,9 @@ void perftest(IndexType const& index, std::string const& type)
             }
         }
 
+        if (perf != nullptr) {
+            perf->start();
+        }
         auto tick = get_time_usecs();
         size_t calls = 0;
         for (auto const& p: skip_values) {
@@ -98,41 +109,51 @@ void perftest(IndexType const& index, std::string const& type)
             freqs_log,
             skip,
             next_geq_ns);
+        if (perf != nullptr) {
+            spdlog::info("Per call: {}", format_perf_sample(*perf, perf->stop(), calls));
+        }
         spdlog::info(
             "{}\tnext_geq{}\t{}\t{:.1f}", type, (with_freqs ? "_freq" : ""), skip, next_geq_ns);
     }
 }
 
 template <typename IndexType>
-void perftest(const char* index_filename, std::string const& type)
+void perftest(const char* index_filename, std::string const& type, PerfCounters* perf)
 {
     spdlog::info("Loading index from {}", index_filename);
     IndexType index;
     mio::mmap_source m(index_filename);
     pisa::mapper::map(index, m, pisa::mapper::map_flags::warmup);
 
-    perftest<IndexType, false>(index, type);
-    perftest<IndexType, true>(index, type);
+    perftest<IndexType, false>(index, type, perf);
+    perftest<IndexType, true>(index, type, perf);
 }
 
 int main(int argc, const char** argv)
 {
     using namespace pisa;
 
-    if (argc != 3) {
-        std::cerr << "Usage: " << argv[0] << " <index type> <index filename>" << std::endl;
+    bool perf_counters = argc == 4 && std::string(argv[3]) == "--perf-counters";
+    if (argc != 3 && not perf_counters) {
+        std::cerr << "Usage: " << argv[0] << " <index type> <index filename> [--perf-counters]"
+                  << std::endl;
         return 1;
     }
 
     std::string type = argv[1];
     const char* index_filename = argv[2];
+    auto* perf = perf_counters ? &PerfCounters::this_thread() : nullptr;
+    if (perf != nullptr && not perf->available()) {
+        spdlog::warn("Hardware counters unavailable, measuring time only: {}", perf->error());
+        perf = nullptr;
+    }
 
     if (false) {
-#define LOOP_BODY(R, DATA, T)                                    \
-    }                                                            \
-    else if (type == BOOST_PP_STRINGIZE(T))                      \
-    {                                                            \
-        perftest<BOOST_PP_CAT(T, _index)>(index_filename, type); \
+#define LOOP_BODY(R, DATA, T)                                          \
+    }                                                                  \
+    else if (type == BOOST_PP_STRINGIZE(T))                            \
+    {                                                                  \
+        perftest<BOOST_PP_CAT(T, _index)>(index_filename, type, perf); \
         /**/
 
         BOOST_PP_SEQ_FOR_EACH(LOOP_BODY, _, PISA_INDEX_TYPES);
@@ -2,6 +2,7 @@
 #include "spdlog/spdlog.h"
 
 #include "mappable/mapper.hpp"
+#include "perf_counters.hpp"
 #include "sequence/partitioned_sequence.hpp"
 #include "sequence/uniform_partitioned_sequence.hpp"
 #include "sequence_collection.hpp"
@@ -10,9 +11,10 @@
 
 using pisa::do_not_optimize_away;
 using pisa::get_time_usecs;
+using pisa::PerfCounters;
 
 template <typename BaseSequence>
-void perftest(const char* index_filename)
+void perftest(const char* index_filename, PerfCounters* perf)
 {
     using collection_type = pisa::sequence_collection<BaseSequence>;
     spdlog::info("Loading collection from {}", index_filename);
@@ -22,6 +24,9 @@ void perftest(const char* index_filename)
 
     if (true) {
         spdlog::info("Scanning all the posting lists");
+        if (perf != nullptr) {
+            perf->start();
+        }
         auto tick = get_time_usecs();
         uint64_t calls_per_list = 500000;
         size_t postings = 0;
@@ -40,6 +45,9 @@ void perftest(const char* index_filename)
             postings,
             uint64_t(elapsed / 1000000),
             (elapsed / postings * 1000));
+        if (perf != nullptr) {
+            spdlog::info("Per posting: {}", format_perf_sample(*perf, perf->stop(), postings));
+        }
     }
 
     {
@@ -52,6 +60,9 @@ void perftest(const char* index_filename)
             }
         }
 
+        if (perf != nullptr) {
+            perf->start();
+        }
         auto tick = get_time_usecs();
         uint64_t calls_per_list = 500000;
         size_t postings = 0;
@@ -70,6 +81,9 @@ void perftest(const char* index_filename)
             postings,
             uint64_t(elapsed / 1000000),
             (elapsed / postings * 1000));
+        if (perf != nullptr) {
+            spdlog::info("Per posting: {}", format_perf_sample(*perf, perf->stop(), postings));
+        }
     }
 
     uint64_t calls_per_list = 20000;
@@ -96,6 +110,9 @@ void perftest(const char* index_filename)
             }
         }
 
+        if (perf != nullptr) {
+            perf->start();
+        }
         auto tick = get_time_usecs();
         size_t calls = 0;
         for (auto const& p: skip_values) {
@@ -112,6 +129,10 @@ void perftest(const char* index_filename)
             calls,
             skip,
             (elapsed / calls * 1000));
+        if (perf != nullptr) {
+            spdlog::info("Per call: {}", format_perf_sample(*perf, perf->stop(), calls));
+            perf->start();
+        }
 
         tick = get_time_usecs();
         calls = 0;
@@ -129,6 +150,9 @@ void perftest(const char* index_filename)
             calls,
             skip,
             (elapsed / calls * 1000));
+        if (perf != nullptr) {
+            spdlog::info("Per call: {}", format_perf_sample(*perf, perf->stop(), calls));
+        }
     }
 }
 int main(int argc, const char** argv)
@@ -138,22 +162,29 @@ int main(int argc, const char** argv)
     using pisa::partitioned_sequence;
     using pisa::uniform_partitioned_sequence;
 
-    if (argc != 3) {
-        std::cerr << "Usage: " << argv[0] << " <collection type> <index filename>" << std::endl;
+    bool perf_counters = argc == 4 && std::string(argv[3]) == "--perf-counters";
+    if (argc != 3 && not perf_counters) {
+        std::cerr << "Usage: " << argv[0]
+                  << " <collection type> <index filename> [--perf-counters]" << std::endl;
         return 1;
     }
 
     std::string type = argv[1];
     const char* index_filename = argv[2];
+    auto* perf = perf_counters ? &PerfCounters::this_thread() : nullptr;
+    if (perf != nullptr && not perf->available()) {
+        spdlog::warn("Hardware counters unavailable, measuring time only: {}", perf->error());
+        perf = nullptr;
+    }
 
     if (type == "ef") {
-        perftest<compact_elias_fano>(index_filename);
+        perftest<compact_elias_fano>(index_filename, perf);
     } else if (type == "is") {
-        perftest<indexed_sequence>(index_filename);
+        perftest<indexed_sequence>(index_filename, perf);
     } else if (type == "uniform") {
-        perftest<uniform_partitioned_sequence<>>(index_filename);
+        perftest<uniform_partitioned_sequence<>>(index_filename, perf);
     } else if (type == "part") {
-        perftest<partitioned_sequence<>>(index_filename);
+        perftest<partitioned_sequence<>>(index_filename, perf);
     } else {
         spdlog::error("Unknown type {}", type);
     }
@@ -3,6 +3,7 @@
 #include <algorithm>
 #include <array>
 #include <cstddef>
+#include <functional>
 #include <vector>
 
 #include "topk_queue.hpp"
@@ -70,7 +71,8 @@ struct Lazy_Accumulator {
         m_accumulators[block].accumulators[pos_in_block] += score;
     }
 
-    void aggregate(topk_queue& topk)
+    template <typename TopK>
+    void aggregate(TopK& topk)
     {
         uint64_t docid = 0U;
         for (auto const& block: m_accumulators) {
@@ -85,6 +87,31 @@ struct Lazy_Accumulator {
         m_counter = (m_counter + 1) % cycle;
     }
 
+    /// Score accumulated for `document` so far.
+    [[nodiscard]] auto score(std::ptrdiff_t const document) const -> float
+    {
+        auto const& block = m_accumulators[document / counters_in_descriptor];
+        auto const pos_in_block = document % counters_in_descriptor;
+        return block.counter(pos_in_block) == m_counter ? block.accumulators[pos_in_block] : 0.0F;
+    }
+
+    /// Largest score accumulated so far in each block.
+    [[nodiscard]] auto block_max_scores() const -> std::vector<float>
+    {
+        std::vector<float> max_scores(m_accumulators.size(), 0.0F);
+        std::transform(
+            m_accumulators.begin(), m_accumulators.end(), max_scores.begin(), [&](auto const& block) {
+                float max_score = 0.0F;
+                for (int pos = 0; pos < static_cast<int>(counters_in_descriptor); ++pos) {
+                    if (block.counter(pos) == m_counter) {
+                        max_score = std::max(max_score, block.accumulators[pos]);
+                    }
+                }
+                return max_score;
+            });
+        return max_scores;
+    }
+
     [[nodiscard]] auto size() const noexcept -> std::size_t { return m_size; }
     [[nodiscard]] auto blocks() noexcept -> std::vector<Block>& { return m_accumulators; }
     [[nodiscard]] auto counter() const noexcept -> int { return m_counter; }
@@ -95,4 +122,18 @@ struct Lazy_Accumulator {
     int m_counter{};
 };
 
+/// The `k`-th largest of `block_max_scores`, or zero if there are fewer.
+///
+/// Block maxima are scores of distinct documents, so the `k`-th score of a query is at least that.
+[[nodiscard]] inline auto kth_block_max_score(std::vector<float> block_max_scores, std::size_t k)
+    -> float
+{
+    if (k == 0 || block_max_scores.size() < k) {
+        return 0.0F;
+    }
+    auto kth = std::next(block_max_scores.begin(), k - 1);
+    std::nth_element(block_max_scores.begin(), kth, block_max_scores.end(), std::greater<>{});
+    return *kth;
+}
+
 }  // namespace pisa
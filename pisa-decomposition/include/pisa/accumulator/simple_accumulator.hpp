@@ -11,7 +11,8 @@ struct Simple_Accumulator: public std::vector<float> {
     explicit Simple_Accumulator(std::ptrdiff_t size) : std::vector<float>(size) {}
     void init() { std::fill(begin(), end(), 0.0); }
     void accumulate(uint32_t doc, float score) { operator[](doc) += score; }
-    void aggregate(topk_queue& topk)
+    template <typename TopK>
+    void aggregate(TopK& topk)
     {
         uint64_t docid = 0U;
         std::for_each(begin(), end(), [&](auto score) {
@@ -13,31 +13,6 @@ namespace detail {
     inline size_t words_for(uint64_t n) { return ceil_div(n, 64); }
 }  // namespace detail
 
-class bit_vec_64 {
-
-  public:
-    inline bool operator[](uint64_t pos) const 
-    {
-        uint64_t shift = pos % 64;
-        return ((m_bits >> shift) & 1) != 0U;
-    }
-
-    inline void set(uint64_t pos, bool b)
-    {
-        uint64_t pos_in_word = pos % 64;
-        m_bits &= ~(uint64_t(1) << pos_in_word);
-        m_bits = uint64_t(b) << pos_in_word;
-    }
-
-
-    inline void clear() {
-        m_bits = 0;
-    }
-
-  private:
-    uint64_t m_bits = 0;
-};
-
 class bit_vector_builder {
   public:
     using bits_type = std::vector<uint64_t>;
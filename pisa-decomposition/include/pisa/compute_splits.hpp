@@ -0,0 +1,195 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "fmt/format.h"
+#include "gsl/span"
+#include "spdlog/spdlog.h"
+#include "tbb/enumerable_thread_specific.h"
+#include "tbb/parallel_for.h"
+
+#include "binary_freq_collection.hpp"
+#include "configuration.hpp"
+#include "tiers.hpp"
+
+namespace pisa::decompose {
+
+/// Split point assigned to lists that should not be decomposed: no impact exceeds it,
+/// so the entire list goes to LOW.
+constexpr std::uint64_t no_split = 10'000'000;
+
+/// Policy used to pick the split point of each list.
+///
+/// - `Fraction`: the HIGH list holds (at most) the top `1 / value` of the postings,
+///   i.e., the split is the impact at position `len / value` in decreasing impact order.
+///   With more tiers, each tier is `value` times smaller than the one below it.
+/// - `Impact`: the split is the absolute impact `value` for every list.
+/// - `TopK`: the HIGH list holds at least `value` postings, so that `safe_threshold(k)` of
+///   a max-scored cursor over HIGH can prime the heap for any `k <= value`.
+enum class SplitPolicy { Fraction, Impact, TopK };
+
+[[nodiscard]] inline auto parse_split_policy(std::string const& name) -> SplitPolicy
+{
+    if (name == "fraction") {
+        return SplitPolicy::Fraction;
+    }
+    if (name == "impact") {
+        return SplitPolicy::Impact;
+    }
+    if (name == "topk") {
+        return SplitPolicy::TopK;
+    }
+    throw std::invalid_argument(fmt::format("Unknown split policy: {}", name));
+}
+
+struct SplitParams {
+    SplitPolicy policy = SplitPolicy::Fraction;
+    std::uint64_t value = 64;
+    /// Lists shorter than this are not decomposed.
+    std::size_t min_length = 256;
+    /// Number of tiers; only the `Fraction` policy supports more than two.
+    std::uint32_t tiers = 2;
+};
+
+/// Impact histogram of a single list, reused across lists processed by the same thread.
+///
+/// Quantized impacts are bounded by `2^quantization_bits`, so counting them is linear in
+/// the list length; lists with impacts beyond that range fall back to a selection algorithm.
+class ImpactHistogram {
+  public:
+    explicit ImpactHistogram(std::size_t quantization_bits)
+        : m_counts((std::size_t(1) << quantization_bits) + 1, 0)
+    {}
+
+    /// Returns the `ranks[i]`-th largest impact of `freqs` (1-based) for every `i`.
+    /// Ranks must be non-decreasing and in `[1, size]`.
+    template <typename Sequence>
+    void nth_largest(
+        Sequence const& freqs,
+        gsl::span<std::size_t const> ranks,
+        gsl::span<std::uint64_t> impacts)
+    {
+        auto max = *std::max_element(freqs.begin(), freqs.end());
+        if (max >= m_counts.size()) {
+            std::vector<std::uint32_t> values(freqs.begin(), freqs.end());
+            std::sort(values.begin(), values.end(), std::greater<>{});
+            for (std::size_t idx = 0; idx < ranks.size(); ++idx) {
+                impacts[idx] = values[ranks[idx] - 1];
+            }
+            return;
+        }
+        for (auto freq: freqs) {
+            m_counts[freq] += 1;
+        }
+        std::size_t seen = m_counts[max];
+        std::uint32_t impact = max;
+        for (std::size_t idx = 0; idx < ranks.size(); ++idx) {
+            while (seen < ranks[idx]) {
+                --impact;
+                seen += m_counts[impact];
+            }
+            impacts[idx] = impact;
+        }
+        for (auto freq: freqs) {
+            m_counts[freq] = 0;
+        }
+    }
+
+    /// Returns the `rank`-th largest impact of `freqs` (1-based), which must be in `[1, size]`.
+    template <typename Sequence>
+    [[nodiscard]] auto nth_largest(Sequence const& freqs, std::size_t rank) -> std::uint32_t
+    {
+        std::uint64_t impact = 0;
+        nth_largest(
+            freqs,
+            gsl::span<std::size_t const>(&rank, 1),
+            gsl::span<std::uint64_t>(&impact, 1));
+        return static_cast<std::uint32_t>(impact);
+    }
+
+  private:
+    std::vector<std::size_t> m_counts;
+};
+
+/// Computes the `params.tiers - 1` split points of a single list.
+template <typename Sequence>
+void compute_split(
+    Sequence const& freqs,
+    SplitParams const& params,
+    ImpactHistogram& histogram,
+    gsl::span<std::uint64_t> splits)
+{
+    std::fill(splits.begin(), splits.end(), no_split);
+    auto size = freqs.size();
+    if (size == 0 || size < params.min_length) {
+        return;
+    }
+    switch (params.policy) {
+    case SplitPolicy::Impact: splits[0] = params.value; return;
+    case SplitPolicy::Fraction: {
+        // The top tier is the smallest one: split `j` is at position `len / value^(n - 1 - j)`.
+        std::vector<std::size_t> ranks(splits.size());
+        std::size_t rank = size;
+        for (auto pos = ranks.rbegin(); pos != ranks.rend(); ++pos) {
+            rank /= params.value;
+            *pos = std::max<std::size_t>(rank, 1);
+        }
+        histogram.nth_largest(freqs, gsl::span<std::size_t const>(ranks), splits);
+        return;
+    }
+    case SplitPolicy::TopK: {
+        if (params.value == 0 || params.value > size) {
+            return;
+        }
+        auto impact = histogram.nth_largest(freqs, params.value);
+        // Postings strictly above the split go to HIGH, so everything tied
+        // with the k-th largest impact must be included.
+        splits[0] = impact > 0 ? impact - 1 : no_split;
+        return;
+    }
+    }
+}
+
+/// Computes the split points of every list of `collection` in parallel.
+[[nodiscard]] inline auto
+compute_splits(binary_freq_collection const& collection, SplitParams const& params) -> TierSplits
+{
+    if (params.policy == SplitPolicy::Fraction && params.value == 0) {
+        throw std::invalid_argument("Fraction denominator must be positive");
+    }
+    if (params.tiers < 2) {
+        throw std::invalid_argument("Decomposition requires at least two tiers");
+    }
+    if (params.tiers > 2 && params.policy != SplitPolicy::Fraction) {
+        throw std::invalid_argument("Only the fraction policy supports more than two tiers");
+    }
+    std::vector<binary_freq_collection::sequence> sequences(collection.begin(), collection.end());
+    auto points_per_term = params.tiers - 1;
+    std::vector<std::uint64_t> splits(sequences.size() * points_per_term);
+    tbb::enumerable_thread_specific<ImpactHistogram> histograms(
+        configuration::get().quantization_bits);
+    tbb::parallel_for(std::size_t(0), sequences.size(), [&](std::size_t term) {
+        compute_split(
+            sequences[term].freqs,
+            params,
+            histograms.local(),
+            gsl::span<std::uint64_t>(splits).subspan(term * points_per_term, points_per_term));
+    });
+    TierSplits tier_splits(params.tiers, std::move(splits));
+    std::size_t decomposed = 0;
+    for (std::size_t term = 0; term < tier_splits.size(); ++term) {
+        // Split points are decreasing, so the last one is the lowest.
+        if (tier_splits[term].back() != no_split) {
+            decomposed += 1;
+        }
+    }
+    spdlog::info("Decomposed lists: {} out of {}", decomposed, tier_splits.size());
+    return tier_splits;
+}
+
+}  // namespace pisa::decompose
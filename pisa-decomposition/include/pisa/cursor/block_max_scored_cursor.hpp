@@ -9,23 +9,22 @@
 
 namespace pisa {
 
-template <typename Cursor, typename Wand>
-class BlockMaxScoredCursor: public MaxScoredCursor<Cursor> {
+template <typename Cursor, typename Wand, typename TermScorerT = TermScorer>
+class BlockMaxScoredCursor: public MaxScoredCursor<Cursor, TermScorerT> {
   public:
     using base_cursor_type = Cursor;
+    using typename MaxScoredCursor<Cursor, TermScorerT>::score_type;
 
     BlockMaxScoredCursor(
         Cursor cursor,
-        TermScorer term_scorer,
+        TermScorerT term_scorer,
         float weight,
         float max_score,
         typename Wand::wand_data_enumerator wdata,
-        float paired_max_score = 0.0f,
-        float low_max_score = 0.0f,
-        size_t short_list_len = 0,
-        size_t list_id = 0,
-        bool is_dup = false)
-        : MaxScoredCursor<Cursor>(std::move(cursor), std::move(term_scorer), weight, max_score, paired_max_score, low_max_score, short_list_len, list_id, is_dup),
+        TierInfo tier = {},
+        KthScores kth_scores = {})
+        : MaxScoredCursor<Cursor, TermScorerT>(
+            std::move(cursor), std::move(term_scorer), weight, max_score, tier, kth_scores),
           m_wdata(std::move(wdata))
     {}
     BlockMaxScoredCursor(BlockMaxScoredCursor const&) = delete;
@@ -35,6 +34,11 @@ class BlockMaxScoredCursor: public MaxScoredCursor<Cursor> {
     ~BlockMaxScoredCursor() = default;
 
     [[nodiscard]] PISA_ALWAYSINLINE auto block_max_score() -> float { return m_wdata.score(); }
+    /// Block max score multiplied by the query weight.
+    [[nodiscard]] PISA_ALWAYSINLINE auto weighted_block_max_score() -> score_type
+    {
+        return score_bound_cast<score_type>(m_wdata.score() * this->query_weight());
+    }
     [[nodiscard]] PISA_ALWAYSINLINE auto block_max_docid() -> std::uint32_t
     {
         return m_wdata.docid();
@@ -46,59 +50,63 @@ class BlockMaxScoredCursor: public MaxScoredCursor<Cursor> {
     typename Wand::wand_data_enumerator m_wdata;
 };
 
+/// Returns block-max-scored cursors over the lists of `query`, whose term groups refer to the
+/// tiers of an index decomposed in `mode`.
 template <typename Index, typename WandType, typename Scorer>
-[[nodiscard]] auto
-make_block_max_scored_cursors(Index const& index, WandType const& wdata, Scorer const& scorer, Query query)
+[[nodiscard]] auto make_block_max_scored_cursors(
+    Index const& index,
+    WandType const& wdata,
+    Scorer const& scorer,
+    Query const& query,
+    DecompositionMode mode = DecompositionMode::Split)
 {
-    auto terms = query.terms;
-    auto query_term_freqs = query_freqs(terms);
-
-    std::unordered_map<uint32_t, uint64_t> idx_to_uniqid;
-    std::unordered_map<uint32_t, float> idx_to_maxscore;
-    std::unordered_map<uint32_t, uint32_t> paired_list;
-    std::unordered_map<uint32_t, bool> is_duplicate;
-    std::unordered_map<uint32_t, float> low_max_score;
-    
-    // Naive way of building a map of term_id -> unique_term
-    // This allows us to keep track of high/low pairs via an id
-    for (const auto term_pair : query.paired_terms) {
-        size_t uniqid = std::get<3>(term_pair);
-        uint32_t idx_one = std::get<0>(term_pair);
-        uint32_t idx_two = std::get<1>(term_pair);
-        paired_list[idx_one] = idx_two;
-        paired_list[idx_two] = idx_one;
+    auto query_term_freqs = query_freqs(query.terms);
+    auto tiers = query_tiers(wdata, query, query_term_freqs, mode);
 
-        idx_to_uniqid[idx_one] = uniqid;
-        idx_to_uniqid[idx_two] = uniqid;
-
-        float query_weight = std::get<2>(term_pair);
-        auto max_weight_one = query_weight * wdata.max_term_weight(idx_one);
-        auto max_weight_two = query_weight * wdata.max_term_weight(idx_two);
-        idx_to_maxscore[idx_one] = max_weight_one;
-        idx_to_maxscore[idx_two] = max_weight_two;
-
-        if (idx_one == idx_two) {
-            is_duplicate[idx_one] = true;
-            low_max_score[idx_one] = 0.0f; // No priming
-        } else { 
-            // The low_max_score is the one corresponding to the longer list
-            if (index[idx_one].size() < index[idx_two].size()) {
-                low_max_score[idx_to_uniqid[idx_one]] = max_weight_two; 
-            } else {
-                low_max_score[idx_to_uniqid[idx_one]] = max_weight_one;
-            }
-        }
+    using term_scorer_type = decltype(weighted_term_scorer(scorer, 0, 1));
+    std::vector<BlockMaxScoredCursor<typename Index::document_enumerator, WandType, term_scorer_type>>
+        cursors;
+    cursors.reserve(query_term_freqs.size());
+    for (std::size_t position = 0; position < query_term_freqs.size(); ++position) {
+        auto [term, weight] = query_term_freqs[position];
+        cursors.emplace_back(
+            index[term],
+            weighted_term_scorer(scorer, term, weight),
+            weight,
+            weight * wdata.max_term_weight(term),
+            wdata.getenum(term),
+            tiers[position],
+            wdata.kth_scores(term));
     }
+    return cursors;
+}
+
+/// Same as above, but reads the tiers of each list from `tier_data` rather than the query.
+template <typename Index, typename WandType, typename Scorer>
+[[nodiscard]] auto make_block_max_scored_cursors(
+    Index const& index,
+    WandType const& wdata,
+    TierData const& tier_data,
+    Scorer const& scorer,
+    Query const& query)
+{
+    auto query_term_freqs = query_freqs(query.terms);
 
-    std::vector<BlockMaxScoredCursor<typename Index::document_enumerator, WandType>> cursors;
+    using term_scorer_type = decltype(weighted_term_scorer(scorer, 0, 1));
+    std::vector<BlockMaxScoredCursor<typename Index::document_enumerator, WandType, term_scorer_type>>
+        cursors;
     cursors.reserve(query_term_freqs.size());
-    std::transform(
-        query_term_freqs.begin(), query_term_freqs.end(), std::back_inserter(cursors), [&](auto&& term) {
-            return BlockMaxScoredCursor<typename Index::document_enumerator, WandType>(
-                std::move(index[term.first]),
-                [scorer = scorer.term_scorer(term.first), weight = term.second](uint32_t doc, uint32_t freq) { return weight * scorer(doc, freq); },
-                term.second, idx_to_maxscore[term.first], wdata.getenum(term.first), idx_to_maxscore[paired_list[term.first]], low_max_score[idx_to_uniqid[term.first]], std::min(index[term.first].size(), index[paired_list[term.first]].size()), idx_to_uniqid[term.first], is_duplicate[term.first]);
-        });
+    for (std::size_t position = 0; position < query_term_freqs.size(); ++position) {
+        auto [term, weight] = query_term_freqs[position];
+        cursors.emplace_back(
+            index[term],
+            weighted_term_scorer(scorer, term, weight),
+            weight,
+            weight * wdata.max_term_weight(term),
+            wdata.getenum(term),
+            tier_info(tier_data, wdata, query_term_freqs, position),
+            wdata.kth_scores(term));
+    }
     return cursors;
 }
 
@@ -1,7 +1,10 @@
 #pragma once
 
+#include <stdexcept>
 #include <vector>
 
+#include "fmt/format.h"
+
 #include "query/queries.hpp"
 #include "scorer/index_scorer.hpp"
 #include "wand_data.hpp"
@@ -12,6 +15,7 @@ template <typename Cursor, typename Wand>
 class BlockMaxScoredPairedCursor {
   public:
     using base_cursor_type = Cursor;
+    using score_type = float;
 
     BlockMaxScoredPairedCursor(
         Cursor cursor_one,
@@ -23,7 +27,8 @@ class BlockMaxScoredPairedCursor {
         typename Wand::wand_data_enumerator wdata_one,
         typename Wand::wand_data_enumerator wdata_two,
         size_t short_list,
-        bool same)
+        bool same,
+        KthScores kth_scores = {})
         : m_base_cursors{std::move(cursor_one), std::move(cursor_two)},
           m_term_scorer(std::move(term_scorer)),
           m_query_weight(query_weight),
@@ -31,7 +36,8 @@ class BlockMaxScoredPairedCursor {
           m_wdata{wdata_one, wdata_two},
           m_high_list_len(short_list),
           m_low_max_score(std::min(max_score_one, max_score_two)),
-          m_same(same)
+          m_same(same),
+          m_kth_scores(kth_scores)
     {
         if (same) {
             m_high_list_len = 0; // Ensure no thresholds are used
@@ -119,6 +125,10 @@ class BlockMaxScoredPairedCursor {
     {
         return m_wdata[m_current_list].score();
     }
+    [[nodiscard]] PISA_ALWAYSINLINE auto weighted_block_max_score() -> float
+    {
+        return block_max_score() * query_weight();
+    }
     [[nodiscard]] PISA_ALWAYSINLINE auto block_max_docid() -> std::uint32_t
     {
         return m_wdata[m_current_list].docid();
@@ -133,13 +143,16 @@ class BlockMaxScoredPairedCursor {
         m_wdata[m_other_list].reset();
     }
 
-    [[nodiscard]] PISA_ALWAYSINLINE auto safe_threshold(size_t k) const noexcept -> float {
-       
+    /// A score that at least `k` documents of the query exceed, to prime the top-k threshold.
+    [[nodiscard]] PISA_ALWAYSINLINE auto safe_threshold(size_t k) const noexcept -> float
+    {
+        // The k-th scores are those of the first list, whose postings `score` leaves unweighted
+        auto threshold = m_kth_scores.threshold(k, 1.0F);
         // We know there are k things with a higher score
         if (k <= m_high_list_len) {
-            return m_low_max_score;
-        } 
-        return 0.0f;
+            threshold = std::max(threshold, m_low_max_score);
+        }
+        return threshold;
     }
  
 
@@ -153,6 +166,7 @@ class BlockMaxScoredPairedCursor {
     size_t m_high_list_len;
     float m_low_max_score;
     bool m_same;
+    KthScores m_kth_scores;
 
   private:
     typename Wand::wand_data_enumerator m_wdata[2];
@@ -162,33 +176,34 @@ template <typename Index, typename WandType, typename Scorer>
 [[nodiscard]] auto make_block_max_scored_paired_cursors(
     Index const& index, WandType const& wdata, Scorer const& scorer, Query query)
 {
-    auto paired_terms = query.paired_terms;
-
     std::vector<BlockMaxScoredPairedCursor<typename Index::document_enumerator, WandType>> cursors;
-    cursors.reserve(paired_terms.size());
+    cursors.reserve(query.term_groups.size());
     std::transform(
-        paired_terms.begin(), paired_terms.end(), std::back_inserter(cursors), [&](auto&& term_pair) {
-            float query_weight = std::get<2>(term_pair);
-            auto max_weight_one = query_weight * wdata.max_term_weight(std::get<0>(term_pair));
-            auto max_weight_two = query_weight * wdata.max_term_weight(std::get<1>(term_pair));
-            bool same = false;
-            if (std::get<0>(term_pair) == std::get<1>(term_pair)) {
-                same = true;
+        query.term_groups.begin(),
+        query.term_groups.end(),
+        std::back_inserter(cursors),
+        [&](auto&& group) {
+            if (group.tiers.size() > 2) {
+                throw std::invalid_argument(fmt::format(
+                    "Paired cursors support at most two tiers per term but got {}",
+                    group.tiers.size()));
             }
+            // The top tier is the second list, see `non_considered_high_docid`.
+            auto high = group.tiers.front();
+            auto low = group.tiers.back();
+            float query_weight = group.weight;
             return BlockMaxScoredPairedCursor<typename Index::document_enumerator, WandType>(
-                index[std::get<0>(term_pair)],
-                index[std::get<1>(term_pair)],
-                scorer.term_scorer(std::get<0>(term_pair)),
+                index[low],
+                index[high],
+                scorer.term_scorer(low),
                 query_weight,
-                max_weight_one,
-                max_weight_two,
-                wdata.getenum(std::get<0>(term_pair)),
-                wdata.getenum(std::get<1>(term_pair)),
-                std::min(
-                    index[std::get<0>(term_pair)].size(), 
-                    index[std::get<1>(term_pair)].size()
-                ), 
-                same);
+                query_weight * wdata.max_term_weight(low),
+                query_weight * wdata.max_term_weight(high),
+                wdata.getenum(low),
+                wdata.getenum(high),
+                std::min(index[low].size(), index[high].size()),
+                low == high,
+                wdata.kth_scores(low));
         });
     return cursors;
 }
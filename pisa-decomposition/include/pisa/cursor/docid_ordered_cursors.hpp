@@ -0,0 +1,116 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "util/compiler_attribute.hpp"
+
+namespace pisa {
+
+/// Cursors ordered by increasing docid, as WAND-like algorithms need them at every pivot.
+///
+/// The docids of the cursors are kept in a contiguous array next to the cursors, so that pivot
+/// selection scans it rather than chasing a pointer per cursor. Cursors must only be moved
+/// through this class, which re-inserts the ones that moved instead of sorting them all: after
+/// scoring a document, only the few cursors on it move, and by little.
+template <typename Cursor>
+class DocidOrderedCursors {
+  public:
+    template <typename Cursors>
+    explicit DocidOrderedCursors(Cursors& cursors)
+    {
+        m_cursors.reserve(cursors.size());
+        m_docids.reserve(cursors.size());
+        for (auto& cursor: cursors) {
+            m_cursors.push_back(&cursor);
+            m_docids.push_back(cursor.docid());
+            sift_down(m_cursors.size() - 1);
+        }
+    }
+
+    [[nodiscard]] PISA_ALWAYSINLINE auto size() const noexcept -> std::size_t
+    {
+        return m_cursors.size();
+    }
+
+    /// The cursor at position `pos` in docid order.
+    [[nodiscard]] PISA_ALWAYSINLINE auto operator[](std::size_t pos) const noexcept -> Cursor&
+    {
+        return *m_cursors[pos];
+    }
+
+    /// The docid of the cursor at position `pos`, read from the contiguous array.
+    [[nodiscard]] PISA_ALWAYSINLINE auto docid(std::size_t pos) const noexcept -> std::uint32_t
+    {
+        return m_docids[pos];
+    }
+
+    /// Moves the cursor at `pos` to `docid` or the next document after it.
+    PISA_ALWAYSINLINE void next_geq(std::size_t pos, std::uint64_t docid)
+    {
+        m_cursors[pos]->next_geq(docid);
+        m_docids[pos] = m_cursors[pos]->docid();
+        sift_up(pos);
+    }
+
+    /// Moves every cursor on `docid`, which must be the smallest docid, to its next document.
+    PISA_ALWAYSINLINE void next(std::uint64_t docid)
+    {
+        std::size_t moved = 0;
+        for (; moved < size() && m_docids[moved] == docid; ++moved) {
+            m_cursors[moved]->next();
+            m_docids[moved] = m_cursors[moved]->docid();
+        }
+        sift_up_prefix(moved);
+    }
+
+    /// Moves every cursor before `docid` to `docid` or the next document after it.
+    PISA_ALWAYSINLINE void next_geq(std::uint64_t docid)
+    {
+        std::size_t moved = 0;
+        for (; moved < size() && m_docids[moved] < docid; ++moved) {
+            m_cursors[moved]->next_geq(docid);
+            m_docids[moved] = m_cursors[moved]->docid();
+        }
+        sift_up_prefix(moved);
+    }
+
+  private:
+    PISA_ALWAYSINLINE void swap(std::size_t lhs, std::size_t rhs)
+    {
+        std::swap(m_cursors[lhs], m_cursors[rhs]);
+        std::swap(m_docids[lhs], m_docids[rhs]);
+    }
+
+    /// Re-inserts the cursor at `pos`, whose docid increased, among the ones after it.
+    PISA_ALWAYSINLINE void sift_up(std::size_t pos)
+    {
+        for (; pos + 1 < size() && m_docids[pos + 1] < m_docids[pos]; ++pos) {
+            swap(pos, pos + 1);
+        }
+    }
+
+    /// Re-inserts the cursors before `end`, from last to first, so each one only passes over
+    /// cursors already in order.
+    PISA_ALWAYSINLINE void sift_up_prefix(std::size_t end)
+    {
+        for (auto pos = end; pos > 0; --pos) {
+            sift_up(pos - 1);
+        }
+    }
+
+    /// Inserts the cursor at `pos` among the ones before it.
+    void sift_down(std::size_t pos)
+    {
+        for (; pos > 0 && m_docids[pos] < m_docids[pos - 1]; --pos) {
+            swap(pos, pos - 1);
+        }
+    }
+
+    std::vector<Cursor*> m_cursors;
+    std::vector<std::uint32_t> m_docids;
+};
+
+}  // namespace pisa
@@ -1,116 +1,242 @@
 #pragma once
 
+#include <algorithm>
+#include <limits>
+#include <optional>
 #include <vector>
 
 #include "cursor/scored_cursor.hpp"
 #include "query/queries.hpp"
+#include "tier_data.hpp"
 #include "wand_data.hpp"
 
 namespace pisa {
 
-template <typename Cursor>
-class MaxScoredCursor: public ScoredCursor<Cursor> {
+/// Where a list stands among the tiers of its query term.
+///
+/// `group` identifies the term, so that algorithms can tell which lists hold disjoint parts
+/// of the same original list. The top `primed_length` postings of the term are known to score
+/// at least `primed_threshold`, which is what `safe_threshold` uses to prime the heap.
+struct TierInfo {
+    std::size_t group = 0;
+    std::size_t primed_length = 0;
+    float primed_threshold = 0.0F;
+};
+
+template <typename Cursor, typename TermScorerT = TermScorer>
+class MaxScoredCursor: public ScoredCursor<Cursor, TermScorerT> {
   public:
     using base_cursor_type = Cursor;
-
-    MaxScoredCursor(Cursor cursor, TermScorer term_scorer, float query_weight, float max_score, float paired_max_score = 0.0f, float low_max_score = 0.0f, size_t short_list_len = 0, size_t list_id = 0, bool is_dup = false)
-        : ScoredCursor<Cursor>(std::move(cursor), std::move(term_scorer), query_weight),
-          m_max_score(max_score), m_paired_max_score(paired_max_score), m_low_max_score(low_max_score), m_high_list_len(short_list_len), m_list_id(list_id), m_duplicate(is_dup)
-    {
-        // Ensure no threshold used if lists are the same
-        if (m_duplicate) {
-            m_high_list_len = 0; 
-        }
-    }
+    using typename ScoredCursor<Cursor, TermScorerT>::score_type;
+
+    MaxScoredCursor(
+        Cursor cursor,
+        TermScorerT term_scorer,
+        float query_weight,
+        float max_score,
+        TierInfo tier = {},
+        KthScores kth_scores = {})
+        : ScoredCursor<Cursor, TermScorerT>(std::move(cursor), std::move(term_scorer), query_weight),
+          m_max_score(score_bound_cast<score_type>(max_score)),
+          m_tier(tier),
+          m_kth_scores(kth_scores)
+    {}
     MaxScoredCursor(MaxScoredCursor const&) = delete;
     MaxScoredCursor(MaxScoredCursor&&) = default;
     MaxScoredCursor& operator=(MaxScoredCursor const&) = delete;
     MaxScoredCursor& operator=(MaxScoredCursor&&) = default;
     ~MaxScoredCursor() = default;
 
-    [[nodiscard]] PISA_ALWAYSINLINE auto max_score() const noexcept -> float { return m_max_score; }
-
-    [[nodiscard]] PISA_ALWAYSINLINE auto paired_max_score() const noexcept -> float { return m_paired_max_score; }
-
-    [[nodiscard]] PISA_ALWAYSINLINE auto low_max_score() const noexcept -> float { return m_low_max_score; }
+    [[nodiscard]] PISA_ALWAYSINLINE auto max_score() const noexcept -> score_type
+    {
+        return m_max_score;
+    }
 
-    [[nodiscard]] PISA_ALWAYSINLINE auto list_id() const noexcept -> size_t { return m_list_id; }
+    [[nodiscard]] PISA_ALWAYSINLINE auto group() const noexcept -> std::size_t
+    {
+        return m_tier.group;
+    }
 
-    [[nodiscard]] PISA_ALWAYSINLINE auto safe_threshold(size_t k) const noexcept -> float {
-       
+    /// A score that at least `k` documents of the query exceed, to prime the top-k threshold.
+    [[nodiscard]] PISA_ALWAYSINLINE auto safe_threshold(size_t k) const noexcept -> float
+    {
+        auto threshold = m_kth_scores.threshold(k, this->query_weight());
         // We know there are k things with a higher score
-        if (k <= m_high_list_len) {
-            return m_low_max_score;
-        } 
-        return 0.0f;
+        if (k <= m_tier.primed_length) {
+            threshold = std::max(threshold, m_tier.primed_threshold);
+        }
+        return threshold;
     }
 
   private:
-    float m_max_score;
-    float m_paired_max_score;
-    float m_low_max_score;
-    float m_query_weight = 1.0;
-    size_t m_high_list_len;
-    size_t m_list_id; // a one-time ID used to uniquely identify the same (high vs low) lists for a term (they will have the same m_list_id)
-    bool m_duplicate;
+    score_type m_max_score;
+    TierInfo m_tier;
+    KthScores m_kth_scores;
 };
 
-template <typename Index, typename WandType, typename Scorer>
-[[nodiscard]] auto
-make_max_scored_cursors(Index const& index, WandType const& wdata, Scorer const& scorer, Query query)
+/// Position of `list` in `query_term_freqs`, which must be sorted by term, if it is there.
+[[nodiscard]] inline auto query_position(term_freq_vec const& query_term_freqs, term_id_type list)
+    -> std::optional<std::size_t>
 {
-    auto terms = query.terms;
-    auto query_term_freqs = query_freqs(terms);
-
-    std::unordered_map<uint32_t, uint64_t> idx_to_uniqid;
-    std::unordered_map<uint32_t, float> idx_to_maxscore;
-    std::unordered_map<uint32_t, uint32_t> paired_list;
-    std::unordered_map<uint32_t, bool> is_duplicate;
-    std::unordered_map<uint32_t, float> low_max_score;
-   
-    // Naive way of building a map of term_id -> unique_term
-    // This allows us to keep track of high/low pairs via an id
-    for (const auto term_pair : query.paired_terms) {
-        size_t uniqid = std::get<3>(term_pair);
-        uint32_t idx_one = std::get<0>(term_pair);
-        uint32_t idx_two = std::get<1>(term_pair);
-        paired_list[idx_one] = idx_two;
-        paired_list[idx_two] = idx_one;
-
-        idx_to_uniqid[idx_one] = uniqid;
-        idx_to_uniqid[idx_two] = uniqid;
-
-        float query_weight = std::get<2>(term_pair);
-        auto max_weight_one = query_weight * wdata.max_term_weight(idx_one);
-        auto max_weight_two = query_weight * wdata.max_term_weight(idx_two);
-        idx_to_maxscore[idx_one] = max_weight_one;
-        idx_to_maxscore[idx_two] = max_weight_two;
-
-        if (idx_one == idx_two) {
-            is_duplicate[idx_one] = true;
-            low_max_score[idx_one] = 0.0f; // No priming
-        } else { 
-            // The low_max_score is the one corresponding to the longer list
-            if (index[idx_one].size() < index[idx_two].size()) {
-                low_max_score[idx_to_uniqid[idx_one]] = max_weight_two; 
+    auto pos = std::lower_bound(
+        query_term_freqs.begin(),
+        query_term_freqs.end(),
+        list,
+        [](auto const& term_freq, auto list) { return term_freq.first < list; });
+    if (pos != query_term_freqs.end() && pos->first == list) {
+        return static_cast<std::size_t>(std::distance(query_term_freqs.begin(), pos));
+    }
+    return std::nullopt;
+}
+
+/// Returns the tier information of every list of `query_term_freqs`, the sorted lists of
+/// `query`, over an index decomposed in `mode`.
+///
+/// The documents of the top `t + 1` tiers of a term in the query are all above the max score of
+/// tier `t + 1` in the query, so each list but the bottom one guarantees that many documents
+/// scoring at least that much: the postings of these tiers in split mode, and those of tier `t`
+/// in clip mode, where tiers are nested. Lists that are not part of any term group form groups
+/// of their own.
+template <typename WandType>
+[[nodiscard]] auto query_tiers(
+    WandType const& wdata,
+    Query const& query,
+    term_freq_vec const& query_term_freqs,
+    DecompositionMode mode) -> std::vector<TierInfo>
+{
+    constexpr auto no_group = std::numeric_limits<std::size_t>::max();
+    std::vector<TierInfo> tiers(query_term_freqs.size(), TierInfo{no_group, 0, 0.0F});
+    for (auto const& group: query.term_groups) {
+        std::size_t length = 0;
+        for (std::size_t tier = 0; tier < group.tiers.size(); ++tier) {
+            auto term = group.tiers[tier];
+            auto position = query_position(query_term_freqs, term);
+            if (not position) {
+                continue;
+            }
+            auto& info = tiers[*position];
+            info.group = group.id;
+            if (mode == DecompositionMode::Split) {
+                length += wdata.term_posting_count(term);
             } else {
-                low_max_score[idx_to_uniqid[idx_one]] = max_weight_one;
+                length = wdata.term_posting_count(term);
+            }
+            if (tier + 1 < group.tiers.size()) {
+                info.primed_length = length;
+                info.primed_threshold = group.weight * wdata.max_term_weight(group.tiers[tier + 1]);
             }
-           // std::cerr << idx_one << " " << idx_two << " " << index[idx_one].size() << " " << index[idx_two].size() << " " << max_weight_one << " " << max_weight_two << "\n";
         }
     }
+    auto next_group = query.term_groups.size();
+    for (auto& info: tiers) {
+        if (info.group == no_group) {
+            info.group = next_group++;
+        }
+    }
+    return tiers;
+}
+
+/// Returns the tier information of the `position`-th term of `query_term_freqs`, which must be
+/// sorted by term, from persisted tier data.
+///
+/// The group of a list is the position of the highest tier of its term present in the query,
+/// so groups are in `[0, query_term_freqs.size())` and need no lookup structure. The stored
+/// primed length is only used if the query holds the tiers it counts; otherwise it is summed
+/// over the tiers the query holds.
+template <typename WandType>
+[[nodiscard]] auto tier_info(
+    TierData const& tier_data,
+    WandType const& wdata,
+    term_freq_vec const& query_term_freqs,
+    std::size_t position) -> TierInfo
+{
+    auto [term, weight] = query_term_freqs[position];
+    TierInfo info{position, 0, 0.0F};
+    bool grouped = false;
+    bool holds_above = true;
+    std::uint64_t length = wdata.term_posting_count(term);
+    for (auto list = tier_data.top_tier(term); list != term; list = tier_data.next_tier(list)) {
+        if (auto pos = query_position(query_term_freqs, list); pos) {
+            if (not grouped) {
+                info.group = *pos;
+                grouped = true;
+            }
+            length += wdata.term_posting_count(list);
+        } else {
+            holds_above = false;
+        }
+        if (tier_data.next_tier(list) == list) {
+            break;
+        }
+    }
+    auto next = tier_data.next_tier(term);
+    if (next == term) {
+        return info;
+    }
+    if (tier_data.mode() == DecompositionMode::Split) {
+        info.primed_length = holds_above ? tier_data.primed_length(term) : length;
+        info.primed_threshold = weight * tier_data.primed_max_score(term);
+    } else if (query_position(query_term_freqs, next)) {
+        info.primed_length = tier_data.primed_length(term);
+        info.primed_threshold = weight * tier_data.primed_max_score(term);
+    }
+    return info;
+}
+
+/// Returns max-scored cursors over the lists of `query`, whose term groups refer to the tiers
+/// of an index decomposed in `mode`.
+template <typename Index, typename WandType, typename Scorer>
+[[nodiscard]] auto make_max_scored_cursors(
+    Index const& index,
+    WandType const& wdata,
+    Scorer const& scorer,
+    Query const& query,
+    DecompositionMode mode = DecompositionMode::Split)
+{
+    auto query_term_freqs = query_freqs(query.terms);
+    auto tiers = query_tiers(wdata, query, query_term_freqs, mode);
 
-    std::vector<MaxScoredCursor<typename Index::document_enumerator>> cursors;
+    using term_scorer_type = decltype(weighted_term_scorer(scorer, 0, 1));
+    std::vector<MaxScoredCursor<typename Index::document_enumerator, term_scorer_type>> cursors;
     cursors.reserve(query_term_freqs.size());
-    std::transform(
-        query_term_freqs.begin(), query_term_freqs.end(), std::back_inserter(cursors), [&](auto&& term) {
-            return MaxScoredCursor<typename Index::document_enumerator>(
-                index[term.first], 
-                [scorer = scorer.term_scorer(term.first), weight = term.second](uint32_t doc, uint32_t freq) { return weight * scorer(doc, freq); }, // weighted sums
-                term.second, idx_to_maxscore[term.first], idx_to_maxscore[paired_list[term.first]], low_max_score[idx_to_uniqid[term.first]], std::min(index[term.first].size(), index[paired_list[term.first]].size()), idx_to_uniqid[term.first], is_duplicate[term.first]);
-        });
+    for (std::size_t position = 0; position < query_term_freqs.size(); ++position) {
+        auto [term, weight] = query_term_freqs[position];
+        cursors.emplace_back(
+            index[term],
+            weighted_term_scorer(scorer, term, weight),
+            weight,
+            weight * wdata.max_term_weight(term),
+            tiers[position],
+            wdata.kth_scores(term));
+    }
+    return cursors;
+}
+
+/// Same as above, but reads the tiers of each list from `tier_data` rather than the query.
+template <typename Index, typename WandType, typename Scorer>
+[[nodiscard]] auto make_max_scored_cursors(
+    Index const& index,
+    WandType const& wdata,
+    TierData const& tier_data,
+    Scorer const& scorer,
+    Query const& query)
+{
+    auto query_term_freqs = query_freqs(query.terms);
+
+    using term_scorer_type = decltype(weighted_term_scorer(scorer, 0, 1));
+    std::vector<MaxScoredCursor<typename Index::document_enumerator, term_scorer_type>> cursors;
+    cursors.reserve(query_term_freqs.size());
+    for (std::size_t position = 0; position < query_term_freqs.size(); ++position) {
+        auto [term, weight] = query_term_freqs[position];
+        cursors.emplace_back(
+            index[term],
+            weighted_term_scorer(scorer, term, weight),
+            weight,
+            weight * wdata.max_term_weight(term),
+            tier_info(tier_data, wdata, query_term_freqs, position),
+            wdata.kth_scores(term));
+    }
     return cursors;
 }
 
 }  // namespace pisa
- 
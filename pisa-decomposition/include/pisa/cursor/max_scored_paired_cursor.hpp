@@ -1,7 +1,10 @@
 #pragma once
 
+#include <stdexcept>
 #include <vector>
 
+#include "fmt/format.h"
+
 #include "query/queries.hpp"
 #include "scorer/index_scorer.hpp"
 #include "wand_data.hpp"
@@ -12,6 +15,7 @@ template <typename Cursor>
 class MaxScoredPairedCursor {
   public:
     using base_cursor_type = Cursor;
+    using score_type = float;
 
     MaxScoredPairedCursor(
         Cursor cursor_one,
@@ -21,14 +25,16 @@ class MaxScoredPairedCursor {
         float max_score_one,
         float max_score_two,
         size_t short_list,
-        bool same = false)
+        bool same = false,
+        KthScores kth_scores = {})
         : m_base_cursors{std::move(cursor_one), std::move(cursor_two)},
           m_term_scorer(std::move(term_scorer)),
           m_query_weight(query_weight),
           m_max_scores{max_score_one, max_score_two},
           m_high_list_len(short_list),
           m_low_max_score(std::min(max_score_one, max_score_two)),
-          m_same(same)
+          m_same(same),
+          m_kth_scores(kth_scores)
     {
 
         if (same) {
@@ -113,13 +119,16 @@ class MaxScoredPairedCursor {
         return m_max_scores[m_current_list];
     }
 
-    [[nodiscard]] PISA_ALWAYSINLINE auto safe_threshold(size_t k) const noexcept -> float {
-       
+    /// A score that at least `k` documents of the query exceed, to prime the top-k threshold.
+    [[nodiscard]] PISA_ALWAYSINLINE auto safe_threshold(size_t k) const noexcept -> float
+    {
+        // The k-th scores are those of the first list, whose postings `score` leaves unweighted
+        auto threshold = m_kth_scores.threshold(k, 1.0F);
         // We know there are k things with a higher score
         if (k <= m_high_list_len) {
-            return m_low_max_score;
-        } 
-        return 0.0f;
+            threshold = std::max(threshold, m_low_max_score);
+        }
+        return threshold;
     }
  
   private:
@@ -132,37 +141,39 @@ class MaxScoredPairedCursor {
     size_t m_high_list_len;
     float m_low_max_score;
     bool m_same;
+    KthScores m_kth_scores;
 };
 
 template <typename Index, typename WandType, typename Scorer>
 [[nodiscard]] auto
 make_scored_paired_cursors(Index const& index, WandType const& wdata, Scorer const& scorer, Query query)
 {
-    auto paired_terms = query.paired_terms;
-
     std::vector<MaxScoredPairedCursor<typename Index::document_enumerator>> cursors;
-    cursors.reserve(paired_terms.size());
+    cursors.reserve(query.term_groups.size());
     std::transform(
-        paired_terms.begin(), paired_terms.end(), std::back_inserter(cursors), [&](auto&& term_pair) {
-            float query_weight = std::get<2>(term_pair);
-            auto max_weight_one = query_weight * wdata.max_term_weight(std::get<0>(term_pair));
-            auto max_weight_two = query_weight * wdata.max_term_weight(std::get<1>(term_pair));
-            bool same = false;
-            if (std::get<0>(term_pair) == std::get<1>(term_pair)) {
-                same = true;
+        query.term_groups.begin(),
+        query.term_groups.end(),
+        std::back_inserter(cursors),
+        [&](auto&& group) {
+            if (group.tiers.size() > 2) {
+                throw std::invalid_argument(fmt::format(
+                    "Paired cursors support at most two tiers per term but got {}",
+                    group.tiers.size()));
             }
+            // The top tier is the second list, see `non_considered_high_docid`.
+            auto high = group.tiers.front();
+            auto low = group.tiers.back();
+            float query_weight = group.weight;
             return MaxScoredPairedCursor<typename Index::document_enumerator>(
-                index[std::get<0>(term_pair)],
-                index[std::get<1>(term_pair)],
-                scorer.term_scorer(std::get<0>(term_pair)),
+                index[low],
+                index[high],
+                scorer.term_scorer(low),
                 query_weight,
-                max_weight_one,
-                max_weight_two,
-                std::min(
-                    index[std::get<0>(term_pair)].size(), 
-                    index[std::get<1>(term_pair)].size()
-                ), 
-                same);
+                query_weight * wdata.max_term_weight(low),
+                query_weight * wdata.max_term_weight(high),
+                std::min(index[low].size(), index[high].size()),
+                low == high,
+                wdata.kth_scores(low));
         });
     return cursors;
 }
@@ -1,19 +1,40 @@
 #pragma once
 
+#include <cmath>
+#include <type_traits>
 #include <vector>
 
 #include "query/queries.hpp"
 #include "scorer/index_scorer.hpp"
+#include "util/compiler_attribute.hpp"
 #include "wand_data.hpp"
 
 namespace pisa {
 
-template <typename Cursor>
+/// Converts a float score bound to `Score`, rounding up so that integer bounds remain bounds.
+template <typename Score>
+[[nodiscard]] PISA_ALWAYSINLINE auto score_bound_cast(float bound) -> Score
+{
+    if constexpr (std::is_integral_v<Score>) {
+        return static_cast<Score>(std::ceil(bound));
+    } else {
+        return bound;
+    }
+}
+
+/// A cursor scoring its postings with `TermScorerT`, which defaults to a type-erased `TermScorer`.
+///
+/// When the term scorer is a plain function object, algorithms over these cursors inline it.
+template <typename Cursor, typename TermScorerT = TermScorer>
 class ScoredCursor {
   public:
     using base_cursor_type = Cursor;
+    using term_scorer_type = TermScorerT;
+    /// Type of posting scores, which is integral for integer scoring.
+    using score_type =
+        std::decay_t<std::invoke_result_t<TermScorerT&, std::uint32_t, std::uint32_t>>;
 
-    ScoredCursor(Cursor cursor, TermScorer term_scorer, float query_weight)
+    ScoredCursor(Cursor cursor, TermScorerT term_scorer, float query_weight)
         : m_base_cursor(std::move(cursor)),
           m_term_scorer(std::move(term_scorer)),
           m_query_weight(query_weight)
@@ -33,29 +54,51 @@ class ScoredCursor {
         return m_base_cursor.docid();
     }
     [[nodiscard]] PISA_ALWAYSINLINE auto freq() -> std::uint32_t { return m_base_cursor.freq(); }
-    [[nodiscard]] PISA_ALWAYSINLINE auto score() -> float { return m_term_scorer(docid(), freq()); }
+    [[nodiscard]] PISA_ALWAYSINLINE auto score() -> score_type
+    {
+        return m_term_scorer(docid(), freq());
+    }
     void PISA_ALWAYSINLINE next() { m_base_cursor.next(); }
     void PISA_ALWAYSINLINE next_geq(std::uint32_t docid) { m_base_cursor.next_geq(docid); }
     [[nodiscard]] PISA_ALWAYSINLINE auto size() -> std::size_t { return m_base_cursor.size(); }
+    /// Number of postings before the current one.
+    [[nodiscard]] PISA_ALWAYSINLINE auto position() const -> std::size_t
+    {
+        return m_base_cursor.position();
+    }
     void PISA_ALWAYSINLINE reset() { m_base_cursor.reset(); }
 
   private:
     Cursor m_base_cursor;
-    TermScorer m_term_scorer;
+    TermScorerT m_term_scorer;
     float m_query_weight = 1.0;
 };
 
+/// Scorer of `term` multiplied by its `weight` in the query.
+///
+/// Scorers known at compile time overload this function to return a function object instead.
+template <typename Scorer>
+[[nodiscard]] auto weighted_term_scorer(Scorer const& scorer, term_id_type term, uint64_t weight)
+    -> TermScorer
+{
+    return [scorer = scorer.term_scorer(term), weight](uint32_t doc, uint32_t freq) {
+        return weight * scorer(doc, freq);
+    };
+}
+
 template <typename Index, typename Scorer>
 [[nodiscard]] auto make_scored_cursors(Index const& index, Scorer const& scorer, Query query)
 {
     auto terms = query.terms;
     auto query_term_freqs = query_freqs(terms);
 
-    std::vector<ScoredCursor<typename Index::document_enumerator>> cursors;
+    using term_scorer_type = decltype(scorer.term_scorer(0));
+    using cursor_type = ScoredCursor<typename Index::document_enumerator, term_scorer_type>;
+    std::vector<cursor_type> cursors;
     cursors.reserve(query_term_freqs.size());
     std::transform(
         query_term_freqs.begin(), query_term_freqs.end(), std::back_inserter(cursors), [&](auto&& term) {
-            return ScoredCursor<typename Index::document_enumerator>(
+            return cursor_type(
                 index[term.first], scorer.term_scorer(term.first), term.second);
         });
     return cursors;
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <numeric>
+#include <vector>
+
+#include "cursor/tier_upper_bound.hpp"
+
+namespace pisa {
+
+/// Pointers to `cursors` grouped by term (see `TierInfo::group`).
+///
+/// The tiers of a term are ordered by increasing length, so that the top tiers are tried first,
+/// and terms by increasing total length, so that the rarest one drives conjunctions.
+template <typename Cursors>
+[[nodiscard]] auto group_tiers(Cursors& cursors)
+    -> std::vector<std::vector<typename std::decay_t<Cursors>::value_type*>>
+{
+    using Cursor = typename std::decay_t<Cursors>::value_type;
+    std::vector<std::vector<Cursor*>> groups(TierUpperBound<>::groups(cursors));
+    for (auto& cursor: cursors) {
+        groups[cursor.group()].push_back(&cursor);
+    }
+    groups.erase(
+        std::remove_if(groups.begin(), groups.end(), [](auto const& group) { return group.empty(); }),
+        groups.end());
+
+    auto length = [](auto const& group) {
+        return std::accumulate(group.begin(), group.end(), std::size_t{0}, [](auto acc, auto* cursor) {
+            return acc + cursor->size();
+        });
+    };
+    for (auto& group: groups) {
+        std::sort(group.begin(), group.end(), [](Cursor* lhs, Cursor* rhs) {
+            return lhs->size() < rhs->size();
+        });
+    }
+    std::sort(groups.begin(), groups.end(), [&](auto const& lhs, auto const& rhs) {
+        return length(lhs) < length(rhs);
+    });
+    return groups;
+}
+
+}  // namespace pisa
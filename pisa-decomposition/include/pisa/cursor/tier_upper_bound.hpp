@@ -0,0 +1,61 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+#include "util/compiler_attribute.hpp"
+
+namespace pisa {
+
+/// Upper bound on the score of a document over a set of cursors on tier lists.
+///
+/// Tiers of a split decomposition partition the postings of a term, so a document is found
+/// in at most one tier of each term: a group of cursors contributes the largest of their max
+/// scores rather than their sum. This holds for any number of tiers, and reduces to the plain
+/// sum when every group has a single list.
+template <typename Score = float>
+class TierUpperBound {
+  public:
+    explicit TierUpperBound(std::size_t groups) : m_group_bounds(groups, Score{0}) {}
+
+    /// Number of groups needed for `cursors`, whose groups must be dense from zero.
+    template <typename Cursors>
+    [[nodiscard]] static auto groups(Cursors const& cursors) -> std::size_t
+    {
+        std::size_t groups = 0;
+        for (auto const& cursor: cursors) {
+            groups = std::max(groups, cursor.group() + 1);
+        }
+        return groups;
+    }
+
+    PISA_ALWAYSINLINE void add(std::size_t group, Score max_score)
+    {
+        auto& group_bound = m_group_bounds[group];
+        if (max_score > group_bound) {
+            m_bound += max_score - group_bound;
+            group_bound = max_score;
+        }
+    }
+
+    template <typename Cursor>
+    PISA_ALWAYSINLINE void add(Cursor const& cursor)
+    {
+        add(cursor.group(), cursor.max_score());
+    }
+
+    [[nodiscard]] PISA_ALWAYSINLINE auto value() const noexcept -> Score { return m_bound; }
+
+    void clear()
+    {
+        std::fill(m_group_bounds.begin(), m_group_bounds.end(), Score{0});
+        m_bound = Score{0};
+    }
+
+  private:
+    std::vector<Score> m_group_bounds;
+    Score m_bound{0};
+};
+
+}  // namespace pisa
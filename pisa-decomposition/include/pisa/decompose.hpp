@@ -0,0 +1,512 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <limits>
+#include <numeric>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "boost/preprocessor/cat.hpp"
+#include "boost/preprocessor/seq/for_each.hpp"
+#include "boost/preprocessor/stringize.hpp"
+#include "fmt/format.h"
+#include "gsl/span"
+#include "spdlog/spdlog.h"
+#include "tbb/parallel_for.h"
+
+#include "binary_collection.hpp"
+#include "binary_freq_collection.hpp"
+#include "global_parameters.hpp"
+#include "index_types.hpp"
+#include "memory_source.hpp"
+#include "tier_data.hpp"
+#include "tiers.hpp"
+#include "util/progress.hpp"
+#include "wand_data.hpp"
+
+namespace pisa {
+
+namespace decompose {
+
+    /// A single output list: one tier of the decomposition of a base term, 0 being the top one.
+    struct List {
+        std::uint32_t base_term;
+        std::uint32_t tier;
+    };
+
+    /// Postings of a single decomposed list.
+    struct Postings {
+        std::vector<std::uint32_t> documents;
+        std::vector<std::uint32_t> frequencies;
+    };
+
+    [[nodiscard]] inline auto read_lexicon(std::string const& filename) -> std::vector<std::string>
+    {
+        std::ifstream is(filename);
+        if (not is) {
+            throw std::runtime_error(fmt::format("Unable to open lexicon: {}", filename));
+        }
+        std::vector<std::string> lexicon;
+        std::string term;
+        while (std::getline(is, term)) {
+            lexicon.push_back(std::move(term));
+        }
+        return lexicon;
+    }
+
+    /// Reads split points: the i-th line holds the split points of the i-th term, separated
+    /// by whitespace and in decreasing order. Every line must have the same number of split
+    /// points, which determines the number of tiers.
+    [[nodiscard]] inline auto read_splits(std::string const& filename) -> TierSplits
+    {
+        std::ifstream is(filename);
+        if (not is) {
+            throw std::runtime_error(fmt::format("Unable to open splits: {}", filename));
+        }
+        std::optional<std::size_t> points_per_term;
+        std::vector<std::uint64_t> points;
+        std::string line;
+        for (std::size_t line_number = 1; std::getline(is, line); ++line_number) {
+            std::istringstream line_stream(line);
+            std::size_t count = 0;
+            std::uint64_t split;
+            while (line_stream >> split) {
+                points.push_back(split);
+                count += 1;
+            }
+            if (count == 0) {
+                continue;
+            }
+            if (not points_per_term) {
+                points_per_term = count;
+            } else if (*points_per_term != count) {
+                throw std::invalid_argument(fmt::format(
+                    "Line {} of {} has {} split points but previous lines have {}",
+                    line_number,
+                    filename,
+                    count,
+                    *points_per_term));
+            }
+        }
+        return TierSplits(static_cast<std::uint32_t>(points_per_term.value_or(1) + 1), points);
+    }
+
+    [[nodiscard]] inline auto list_name(
+        std::vector<std::string> const& lexicon, List list, std::uint32_t tiers) -> std::string
+    {
+        return fmt::format("{}{}", lexicon[list.base_term], tier_suffix(list.tier, tiers));
+    }
+
+    /// Returns all candidate output lists in the lexicographic order of their decorated names.
+    ///
+    /// Only the lexicon is ordered here: the lists of each tier are sorted on their own and
+    /// the runs are merged, so postings never need to be moved around to produce sorted output.
+    [[nodiscard]] inline auto
+    output_order(std::vector<std::string> const& lexicon, std::uint32_t tiers) -> std::vector<List>
+    {
+        std::vector<std::vector<std::string>> names(tiers, std::vector<std::string>(lexicon.size()));
+        for (std::uint32_t tier = 0; tier < tiers; ++tier) {
+            for (std::uint32_t term = 0; term < lexicon.size(); ++term) {
+                names[tier][term] = list_name(lexicon, List{term, tier}, tiers);
+            }
+        }
+        auto less = [&](List lhs, List rhs) {
+            return names[lhs.tier][lhs.base_term] < names[rhs.tier][rhs.base_term];
+        };
+        std::vector<List> order;
+        order.reserve(lexicon.size() * tiers);
+        for (std::uint32_t tier = 0; tier < tiers; ++tier) {
+            auto first = order.size();
+            for (std::uint32_t term = 0; term < lexicon.size(); ++term) {
+                order.push_back(List{term, tier});
+            }
+            auto run = std::next(order.begin(), first);
+            if (not std::is_sorted(run, order.end(), less)) {
+                std::sort(run, order.end(), less);
+            }
+            std::inplace_merge(order.begin(), run, order.end(), less);
+        }
+        return order;
+    }
+
+    /// Calls `fn(document, frequency)` for each posting of tier `tier` of `sequence`
+    /// given its split points.
+    template <typename Fn>
+    void for_each_posting(
+        binary_freq_collection::sequence const& sequence,
+        gsl::span<std::uint64_t const> splits,
+        DecompositionMode mode,
+        std::uint32_t tier,
+        Fn&& fn)
+    {
+        auto const bottom = static_cast<std::uint32_t>(splits.size());
+        // Tier `tier` covers impacts in `(lower, upper]`; the bottom tier has no lower bound
+        // and the top one no upper bound.
+        auto upper = tier == 0 ? std::numeric_limits<std::uint64_t>::max() : splits[tier - 1];
+        auto lower = tier == bottom ? std::uint64_t(0) : splits[tier];
+        auto freq = sequence.freqs.begin();
+        for (auto doc = sequence.docs.begin(); doc != sequence.docs.end(); ++doc, ++freq) {
+            std::uint64_t impact = *freq;
+            if (mode == DecompositionMode::Split) {
+                if (impact <= upper && (tier == bottom || impact > lower)) {
+                    fn(*doc, static_cast<std::uint32_t>(impact));
+                }
+            } else if (tier == bottom) {
+                fn(*doc, static_cast<std::uint32_t>(std::min(impact, upper)));
+            } else if (impact > lower) {
+                fn(*doc, static_cast<std::uint32_t>(std::min(impact, upper) - lower));
+            }
+        }
+        // In clip mode every posting contributes to the bottom tier, so unlike the standalone
+        // `clip_index` there is no need to guard against an empty LOW list with a non-empty
+        // HIGH list.
+    }
+
+    /// Decomposition of a collection: its lists, their split points, and the output order.
+    class Decomposition {
+      public:
+        Decomposition(
+            binary_freq_collection const& collection,
+            std::vector<std::string> lexicon,
+            TierSplits splits,
+            DecompositionMode mode)
+            : m_lexicon(std::move(lexicon)), m_splits(std::move(splits)), m_mode(mode)
+        {
+            for (auto const& sequence: collection) {
+                if (sequence.docs.size() != sequence.freqs.size()) {
+                    throw std::runtime_error(fmt::format(
+                        "Document and frequency lists must be equal length but are {} and {} "
+                        "(term {})",
+                        sequence.docs.size(),
+                        sequence.freqs.size(),
+                        m_sequences.size()));
+                }
+                m_sequences.push_back(sequence);
+            }
+            if (m_lexicon.size() != m_sequences.size()) {
+                throw std::invalid_argument(fmt::format(
+                    "Lexicon has {} terms but collection has {} lists",
+                    m_lexicon.size(),
+                    m_sequences.size()));
+            }
+            if (m_splits.size() < m_sequences.size()) {
+                throw std::invalid_argument(fmt::format(
+                    "Read {} splits but collection has {} lists",
+                    m_splits.size(),
+                    m_sequences.size()));
+            }
+            if (m_splits.size() > m_sequences.size()) {
+                spdlog::warn(
+                    "Read {} splits but collection has only {} lists",
+                    m_splits.size(),
+                    m_sequences.size());
+            }
+            m_order = output_order(m_lexicon, m_splits.tiers());
+        }
+
+        [[nodiscard]] auto tiers() const -> std::uint32_t { return m_splits.tiers(); }
+        [[nodiscard]] auto mode() const -> DecompositionMode { return m_mode; }
+
+        /// All candidate output lists, including empty ones, in output order.
+        [[nodiscard]] auto order() const -> std::vector<List> const& { return m_order; }
+
+        [[nodiscard]] auto name(List list) const -> std::string
+        {
+            return list_name(m_lexicon, list, tiers());
+        }
+
+        [[nodiscard]] auto postings(List list) const -> Postings
+        {
+            Postings postings;
+            for_each_posting(
+                m_sequences[list.base_term],
+                m_splits[list.base_term],
+                m_mode,
+                list.tier,
+                [&](auto doc, auto freq) {
+                    postings.documents.push_back(doc);
+                    postings.frequencies.push_back(freq);
+                });
+            return postings;
+        }
+
+        /// Returns the posting count and the frequency sum of every list in output order.
+        /// Empty lists get a zero count.
+        [[nodiscard]] auto statistics() const
+            -> std::pair<std::vector<std::uint32_t>, std::vector<std::uint64_t>>
+        {
+            std::vector<std::uint32_t> posting_counts(m_order.size());
+            std::vector<std::uint64_t> occurrence_counts(m_order.size());
+            tbb::parallel_for(std::size_t(0), m_order.size(), [&](std::size_t idx) {
+                auto list = m_order[idx];
+                for_each_posting(
+                    m_sequences[list.base_term],
+                    m_splits[list.base_term],
+                    m_mode,
+                    list.tier,
+                    [&](auto, auto freq) {
+                        posting_counts[idx] += 1;
+                        occurrence_counts[idx] += freq;
+                    });
+            });
+            return {std::move(posting_counts), std::move(occurrence_counts)};
+        }
+
+        /// Calls `fn(name, documents, frequencies)` for each non-empty output list in the
+        /// lexicographic order of `name`.
+        ///
+        /// Output lists are produced in batches of roughly `batch_postings` input postings.
+        /// Lists within a batch are decomposed in parallel and then handed to `fn` in order,
+        /// so memory usage is bounded by the batch size rather than by the collection size.
+        template <typename Fn>
+        void for_each_list(std::size_t batch_postings, Fn&& fn) const
+        {
+            std::vector<Postings> batch;
+            auto first = m_order.begin();
+            while (first != m_order.end()) {
+                auto last = first;
+                std::size_t postings = 0;
+                while (last != m_order.end() && (last == first || postings < batch_postings)) {
+                    postings += m_sequences[last->base_term].docs.size();
+                    ++last;
+                }
+                auto batch_size = static_cast<std::size_t>(std::distance(first, last));
+                batch.clear();
+                batch.resize(batch_size);
+                tbb::parallel_for(std::size_t(0), batch_size, [&](std::size_t idx) {
+                    batch[idx] = this->postings(*std::next(first, idx));
+                });
+                for (std::size_t idx = 0; idx < batch_size; ++idx) {
+                    if (not batch[idx].documents.empty()) {
+                        fn(name(*std::next(first, idx)),
+                           gsl::span<std::uint32_t const>(batch[idx].documents),
+                           gsl::span<std::uint32_t const>(batch[idx].frequencies));
+                    }
+                }
+                first = last;
+            }
+        }
+
+      private:
+        std::vector<std::string> m_lexicon;
+        TierSplits m_splits;
+        DecompositionMode m_mode;
+        std::vector<binary_freq_collection::sequence> m_sequences{};
+        std::vector<List> m_order{};
+    };
+
+    /// Decomposes the canonical collection `input_basename` and writes the canonical
+    /// `.docs`, `.freqs`, and `.terms` files of the decomposed collection to `output_basename`.
+    inline void decompose_index(
+        std::string const& input_basename,
+        std::string const& output_basename,
+        std::string const& splits_filename,
+        DecompositionMode mode,
+        std::size_t batch_postings)
+    {
+        binary_freq_collection collection(input_basename.c_str());
+        auto splits = read_splits(splits_filename);
+        spdlog::info("Read splits of {} terms into {} tiers", splits.size(), splits.tiers());
+        Decomposition decomposition(
+            collection, read_lexicon(input_basename + ".terms"), std::move(splits), mode);
+
+        std::ofstream docs_out(output_basename + ".docs", std::ios::binary);
+        std::ofstream freqs_out(output_basename + ".freqs", std::ios::binary);
+        std::ofstream terms_out(output_basename + ".terms");
+
+        auto write = [](std::ofstream& os, gsl::span<std::uint32_t const> sequence) {
+            auto length = static_cast<std::uint32_t>(sequence.size());
+            os.write(reinterpret_cast<char const*>(&length), sizeof(length));
+            os.write(
+                reinterpret_cast<char const*>(sequence.data()), length * sizeof(std::uint32_t));
+        };
+
+        auto num_docs = static_cast<std::uint32_t>(collection.num_docs());
+        write(docs_out, gsl::make_span<std::uint32_t const>(&num_docs, 1));
+
+        std::size_t list_count = 0;
+        std::size_t postings_count = 0;
+        decomposition.for_each_list(
+            batch_postings, [&](std::string const& name, auto documents, auto frequencies) {
+                write(docs_out, documents);
+                write(freqs_out, frequencies);
+                terms_out << name << '\n';
+                list_count += 1;
+                postings_count += documents.size();
+            });
+
+        spdlog::info("Number of lists: {}", list_count);
+        spdlog::info("Number of documents: {}", num_docs);
+        spdlog::info("Number of postings: {}", postings_count);
+    }
+
+    /// Compresses the non-empty lists of `decomposition` with `IndexType` and builds their WAND
+    /// data in the same pass, writing `.idx`, `.bmw`, `.tiers`, and `.terms` files to
+    /// `output_basename`.
+    ///
+    /// The decomposed collection is never materialized: lists go straight from the memory-mapped
+    /// input to the index and WAND data builders. Term statistics required by the scorer are
+    /// gathered beforehand with a counting pass over the input that allocates no postings.
+    template <typename IndexType, typename WandType>
+    void decompose_and_compress(
+        Decomposition const& decomposition,
+        binary_freq_collection const& collection,
+        binary_collection const& sizes,
+        std::string const& output_basename,
+        ScorerParams const& scorer_params,
+        BlockSize block_size,
+        bool quantize_wand,
+        std::size_t batch_postings)
+    {
+        std::vector<std::uint32_t> term_posting_counts;
+        std::vector<std::uint32_t> term_occurrence_counts;
+        {
+            auto [posting_counts, occurrence_counts] = decomposition.statistics();
+            for (std::size_t idx = 0; idx < posting_counts.size(); ++idx) {
+                if (posting_counts[idx] > 0) {
+                    term_posting_counts.push_back(posting_counts[idx]);
+                    term_occurrence_counts.push_back(
+                        static_cast<std::uint32_t>(occurrence_counts[idx]));
+                }
+            }
+        }
+        auto list_count = term_posting_counts.size();
+
+        global_parameters params;
+        typename IndexType::stream_builder index_builder(collection.num_docs(), params);
+        WandType wdata;
+        typename WandType::stream_builder wand_builder(
+            wdata,
+            sizes.begin()->begin(),
+            collection.num_docs(),
+            collection,
+            std::move(term_occurrence_counts),
+            std::move(term_posting_counts),
+            scorer_params,
+            std::move(block_size),
+            quantize_wand);
+        std::ofstream terms_out(output_basename + ".terms");
+        std::vector<std::string> names;
+        names.reserve(list_count);
+
+        std::size_t postings_count = 0;
+        {
+            pisa::progress progress("Decompose and compress", list_count);
+            decomposition.for_each_list(
+                batch_postings, [&](std::string const& name, auto documents, auto frequencies) {
+                    auto occurrences =
+                        std::accumulate(frequencies.begin(), frequencies.end(), std::uint64_t(0));
+                    index_builder.add_posting_list(
+                        documents.size(), documents.data(), frequencies.data(), occurrences);
+                    wand_builder.add_sequence(binary_freq_collection::sequence{
+                        {documents.data(), documents.data() + documents.size()},
+                        {frequencies.data(), frequencies.data() + frequencies.size()}});
+                    terms_out << name << '\n';
+                    names.push_back(name);
+                    postings_count += documents.size();
+                    progress.update(1);
+                });
+        }
+        index_builder.build(output_basename + ".idx");
+        wand_builder.build();
+        mapper::freeze(wdata, (output_basename + ".bmw").c_str());
+        {
+            TierData tier_data(names, wdata, decomposition.mode());
+            mapper::freeze(tier_data, (output_basename + ".tiers").c_str());
+        }
+
+        spdlog::info("Number of lists: {}", list_count);
+        spdlog::info("Number of documents: {}", collection.num_docs());
+        spdlog::info("Number of postings: {}", postings_count);
+    }
+
+    template <typename IndexType>
+    void decompose_and_compress(
+        Decomposition const& decomposition,
+        binary_freq_collection const& collection,
+        binary_collection const& sizes,
+        std::string const& output_basename,
+        ScorerParams const& scorer_params,
+        BlockSize block_size,
+        bool compress_wand,
+        bool quantize_wand,
+        std::size_t batch_postings)
+    {
+        if (compress_wand) {
+            decompose_and_compress<IndexType, wand_data<wand_data_compressed<>>>(
+                decomposition,
+                collection,
+                sizes,
+                output_basename,
+                scorer_params,
+                block_size,
+                quantize_wand,
+                batch_postings);
+        } else {
+            decompose_and_compress<IndexType, wand_data<wand_data_raw>>(
+                decomposition,
+                collection,
+                sizes,
+                output_basename,
+                scorer_params,
+                block_size,
+                quantize_wand,
+                batch_postings);
+        }
+    }
+
+    /// Decomposes the canonical collection `input_basename` directly into a block index
+    /// encoded with `index_encoding` and its WAND data. See `decompose_and_compress` above.
+    inline void decompose_and_compress(
+        std::string const& input_basename,
+        std::string const& output_basename,
+        std::string const& splits_filename,
+        DecompositionMode mode,
+        std::string const& index_encoding,
+        ScorerParams const& scorer_params,
+        BlockSize const& block_size,
+        bool compress_wand,
+        bool quantize_wand,
+        std::size_t batch_postings)
+    {
+        binary_freq_collection collection(input_basename.c_str());
+        binary_collection sizes((input_basename + ".sizes").c_str());
+        auto splits = read_splits(splits_filename);
+        spdlog::info("Read splits of {} terms into {} tiers", splits.size(), splits.tiers());
+        Decomposition decomposition(
+            collection, read_lexicon(input_basename + ".terms"), std::move(splits), mode);
+
+        if (false) {
+#define LOOP_BODY(R, DATA, T)                                     \
+    }                                                             \
+    else if (index_encoding == BOOST_PP_STRINGIZE(T))             \
+    {                                                             \
+        decompose_and_compress<pisa::BOOST_PP_CAT(T, _index)>(    \
+            decomposition,                                        \
+            collection,                                           \
+            sizes,                                                \
+            output_basename,                                      \
+            scorer_params,                                        \
+            block_size,                                           \
+            compress_wand,                                        \
+            quantize_wand,                                        \
+            batch_postings);                                      \
+        /**/
+            BOOST_PP_SEQ_FOR_EACH(LOOP_BODY, _, PISA_BLOCK_INDEX_TYPES);
+#undef LOOP_BODY
+        } else {
+            throw std::invalid_argument(
+                fmt::format("Unknown block index encoding: {}", index_encoding));
+        }
+    }
+
+}  // namespace decompose
+
+}  // namespace pisa
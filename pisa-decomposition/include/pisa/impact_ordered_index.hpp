@@ -0,0 +1,265 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <stdexcept>
+#include <type_traits>
+#include <variant>
+#include <vector>
+
+#include "codec/block_codecs.hpp"
+#include "mappable/mappable_vector.hpp"
+#include "mappable/mapper.hpp"
+#include "memory_source.hpp"
+#include "util/util.hpp"
+
+namespace pisa {
+
+/// Posting lists ordered by decreasing impact, for score-at-a-time processing.
+///
+/// A list is a sequence of segments of postings sharing the same impact, stored by decreasing
+/// impact. The docids of a segment are gap-encoded with `BlockCodec`, in blocks as in
+/// `block_posting_list`. Lists can be empty, so that an index of the top tiers of a decomposed
+/// collection keeps the term IDs of the collection.
+template <typename BlockCodec>
+class impact_ordered_index {
+  public:
+    /// Postings of a list sharing the same impact.
+    class segment {
+      public:
+        segment(std::uint32_t impact, std::uint32_t size, std::uint8_t const* data)
+            : m_impact(impact), m_size(size), m_data(data)
+        {}
+
+        [[nodiscard]] auto impact() const noexcept -> std::uint32_t { return m_impact; }
+        [[nodiscard]] auto size() const noexcept -> std::uint32_t { return m_size; }
+
+        /// Calls `fn` with every docid of the segment, in increasing order.
+        template <typename Fn>
+        void for_each(Fn&& fn) const
+        {
+            auto blocks = ceil_div(m_size, BlockCodec::block_size);
+            auto const* block_last_docids = m_data;
+            std::uint8_t const* ptr = m_data + 4 * blocks;
+            std::array<std::uint32_t, BlockCodec::block_size> buf{};
+            std::uint32_t base = 0;
+            for (std::size_t block = 0; block < blocks; ++block) {
+                std::uint32_t size = std::min<std::uint32_t>(
+                    BlockCodec::block_size, m_size - block * BlockCodec::block_size);
+                std::uint32_t last_docid;
+                std::memcpy(&last_docid, block_last_docids + 4 * block, 4);
+                ptr = BlockCodec::decode(ptr, buf.data(), last_docid - base - (size - 1), size);
+                std::uint32_t docid = base;
+                for (std::size_t pos = 0; pos < size; ++pos) {
+                    docid += buf[pos];
+                    fn(docid);
+                    docid += 1;
+                }
+                base = last_docid + 1;
+            }
+        }
+
+      private:
+        std::uint32_t m_impact;
+        std::uint32_t m_size;
+        std::uint8_t const* m_data;
+    };
+
+    /// Segments of a list, whose headers are decoded as they are iterated.
+    class segment_list {
+      public:
+        class iterator {
+          public:
+            using iterator_category = std::input_iterator_tag;
+            using value_type = segment;
+            using difference_type = std::ptrdiff_t;
+            using pointer = segment const*;
+            using reference = segment const&;
+
+            iterator(std::uint8_t const* ptr, std::uint32_t remaining)
+                : m_ptr(ptr), m_remaining(remaining)
+            {
+                read();
+            }
+
+            [[nodiscard]] auto operator*() const -> reference { return m_segment; }
+            [[nodiscard]] auto operator->() const -> pointer { return &m_segment; }
+
+            auto operator++() -> iterator&
+            {
+                m_remaining -= 1;
+                read();
+                return *this;
+            }
+
+            [[nodiscard]] auto operator==(iterator const& other) const -> bool
+            {
+                return m_remaining == other.m_remaining;
+            }
+            [[nodiscard]] auto operator!=(iterator const& other) const -> bool
+            {
+                return m_remaining != other.m_remaining;
+            }
+
+          private:
+            void read()
+            {
+                if (m_remaining > 0) {
+                    std::array<std::uint32_t, 3> header{};
+                    m_ptr = TightVariableByte::decode(m_ptr, header.data(), header.size());
+                    auto [impact, size, bytes] = header;
+                    m_segment = segment(impact, size, m_ptr);
+                    m_ptr += bytes;
+                }
+            }
+
+            std::uint8_t const* m_ptr;
+            std::uint32_t m_remaining;
+            segment m_segment{0, 0, nullptr};
+        };
+
+        segment_list(std::uint8_t const* data, std::uint32_t size) : m_data(data), m_size(size) {}
+
+        [[nodiscard]] auto size() const noexcept -> std::uint32_t { return m_size; }
+        [[nodiscard]] auto empty() const noexcept -> bool { return m_size == 0; }
+        [[nodiscard]] auto begin() const -> iterator { return iterator(m_data, m_size); }
+        [[nodiscard]] auto end() const -> iterator { return iterator(m_data, 0); }
+
+      private:
+        std::uint8_t const* m_data;
+        std::uint32_t m_size;
+    };
+
+    class builder {
+      public:
+        explicit builder(std::uint64_t num_docs) : m_num_docs(num_docs)
+        {
+            m_endpoints.push_back(0);
+        }
+
+        /// Adds a list from its postings in docid order, taking frequencies as impacts.
+        template <typename DocsIterator, typename FreqsIterator>
+        void add_posting_list(std::uint64_t n, DocsIterator docs_begin, FreqsIterator freqs_begin)
+        {
+            std::vector<std::pair<std::uint32_t, std::uint32_t>> postings(n);
+            for (auto& [impact, docid]: postings) {
+                docid = *docs_begin++;
+                impact = *freqs_begin++;
+            }
+            // By decreasing impact, then increasing docid
+            std::sort(postings.begin(), postings.end(), [](auto const& lhs, auto const& rhs) {
+                return lhs.first > rhs.first || (lhs.first == rhs.first && lhs.second < rhs.second);
+            });
+
+            std::vector<std::uint8_t> segments;
+            std::uint32_t num_segments = 0;
+            for (auto first = postings.begin(); first != postings.end(); ++num_segments) {
+                auto last = std::find_if(first, postings.end(), [&](auto const& posting) {
+                    return posting.first != first->first;
+                });
+                std::vector<std::uint8_t> data;
+                write_docids(data, first, last);
+                TightVariableByte::encode_single(first->first, segments);
+                TightVariableByte::encode_single(std::distance(first, last), segments);
+                TightVariableByte::encode_single(data.size(), segments);
+                segments.insert(segments.end(), data.begin(), data.end());
+                first = last;
+            }
+            TightVariableByte::encode_single(num_segments, m_lists);
+            m_lists.insert(m_lists.end(), segments.begin(), segments.end());
+            m_endpoints.push_back(m_lists.size());
+        }
+
+        void add_empty_list()
+        {
+            TightVariableByte::encode_single(0, m_lists);
+            m_endpoints.push_back(m_lists.size());
+        }
+
+        void build(impact_ordered_index& index)
+        {
+            index.m_num_docs = m_num_docs;
+            index.m_endpoints.steal(m_endpoints);
+            index.m_lists.steal(m_lists);
+        }
+
+      private:
+        template <typename Iterator>
+        static void write_docids(std::vector<std::uint8_t>& out, Iterator first, Iterator last)
+        {
+            auto n = static_cast<std::uint64_t>(std::distance(first, last));
+            auto blocks = ceil_div(n, BlockCodec::block_size);
+            out.resize(4 * blocks);
+            std::vector<std::uint32_t> buf(BlockCodec::block_size);
+            std::uint32_t base = 0;
+            for (std::size_t block = 0; block < blocks; ++block) {
+                std::uint32_t size = std::min<std::uint64_t>(
+                    BlockCodec::block_size, n - block * BlockCodec::block_size);
+                std::uint32_t last_docid = base;
+                for (std::size_t pos = 0; pos < size; ++pos, ++first) {
+                    buf[pos] = first->second - last_docid;
+                    last_docid = first->second + 1;
+                }
+                last_docid -= 1;
+                std::memcpy(&out[4 * block], &last_docid, 4);
+                BlockCodec::encode(buf.data(), last_docid - base - (size - 1), size, out);
+                base = last_docid + 1;
+            }
+        }
+
+        std::uint64_t m_num_docs;
+        std::vector<std::uint64_t> m_endpoints;
+        std::vector<std::uint8_t> m_lists;
+    };
+
+    impact_ordered_index() = default;
+    explicit impact_ordered_index(MemorySource source) : m_source(std::move(source))
+    {
+        mapper::map(*this, m_source.data(), mapper::map_flags::warmup);
+    }
+
+    [[nodiscard]] auto size() const noexcept -> std::size_t { return m_endpoints.size() - 1; }
+    [[nodiscard]] auto num_docs() const noexcept -> std::uint64_t { return m_num_docs; }
+
+    /// Segments of the `term`-th list, by decreasing impact.
+    [[nodiscard]] auto operator[](std::size_t term) const -> segment_list
+    {
+        if (term >= size()) {
+            throw std::out_of_range("Term out of range of the impact-ordered index");
+        }
+        std::uint8_t const* ptr = m_lists.data() + m_endpoints[term];
+        std::uint32_t num_segments;
+        ptr = TightVariableByte::decode(ptr, &num_segments, 1);
+        return segment_list(ptr, num_segments);
+    }
+
+    template <typename Visitor>
+    void map(Visitor& visit)
+    {
+        visit(m_num_docs, "m_num_docs")(m_endpoints, "m_endpoints")(m_lists, "m_lists");
+    }
+
+  private:
+    std::uint64_t m_num_docs{0};
+    mapper::mappable_vector<std::uint64_t> m_endpoints;
+    mapper::mappable_vector<std::uint8_t> m_lists;
+    MemorySource m_source;
+};
+
+/// Impact-ordered index with the block codec of `IndexType`, or `std::monostate` if `IndexType`
+/// is not a block index.
+template <typename IndexType, typename = void>
+struct impact_index_for {
+    using type = std::monostate;
+};
+
+template <typename IndexType>
+struct impact_index_for<IndexType, std::void_t<typename IndexType::block_codec_type>> {
+    using type = impact_ordered_index<typename IndexType::block_codec_type>;
+};
+
+}  // namespace pisa
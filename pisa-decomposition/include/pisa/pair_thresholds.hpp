@@ -0,0 +1,242 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <numeric>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "gsl/span"
+
+#include "mappable/mappable_vector.hpp"
+#include "mappable/mapper.hpp"
+#include "memory_source.hpp"
+#include "query/queries.hpp"
+#include "tier_data.hpp"
+#include "wand_data.hpp"
+
+namespace pisa {
+
+/// The base terms of `query`, each identified by its top tier list, with the lists of its tiers.
+///
+/// Tiers are read from `tier_data` if given, in which case they include the tiers that `query`
+/// does not hold, and from the term groups of `query` otherwise; lists in no group are terms of
+/// their own.
+[[nodiscard]] inline auto query_base_terms(Query const& query, TierData const* tier_data)
+    -> std::map<std::uint32_t, std::vector<std::uint32_t>>
+{
+    std::map<std::uint32_t, std::vector<std::uint32_t>> terms;
+    if (tier_data != nullptr) {
+        for (auto term: query.terms) {
+            auto base = tier_data->top_tier(term);
+            if (auto& lists = terms[base]; lists.empty()) {
+                for (auto list = base;; list = tier_data->next_tier(list)) {
+                    lists.push_back(list);
+                    if (tier_data->next_tier(list) == list) {
+                        break;
+                    }
+                }
+            }
+        }
+        return terms;
+    }
+    for (auto const& group: query.term_groups) {
+        if (not group.tiers.empty()) {
+            terms[group.tiers.front()] = group.tiers;
+        }
+    }
+    for (auto term: query.terms) {
+        auto grouped = std::any_of(terms.begin(), terms.end(), [&](auto const& base) {
+            return std::find(base.second.begin(), base.second.end(), term) != base.second.end();
+        });
+        if (not grouped) {
+            terms[term] = {term};
+        }
+    }
+    return terms;
+}
+
+/// Exact k-th scores of the conjunction of pairs of base terms, for a few ranks k.
+///
+/// The scores of a base term sum those of the tier lists it was mined with, which are stored
+/// along with the pairs. Any disjunctive query holding all these lists for both terms of a pair
+/// has at least k documents scoring as much as the k-th score of the pair, since query weights
+/// are at least one and scores are non-negative. Queries missing any of them get no threshold
+/// from the pair.
+class PairThresholds {
+  public:
+    class builder {
+      public:
+        explicit builder(std::vector<std::uint32_t> ranks)
+            : m_ranks(normalize_kth_score_ranks(std::move(ranks)))
+        {}
+
+        [[nodiscard]] auto ranks() const noexcept -> std::vector<std::uint32_t> const&
+        {
+            return m_ranks;
+        }
+
+        /// Adds the k-th scores of the pair of base terms with the tier lists `first` and
+        /// `second`, one for each of `ranks()`. A base term is identified by its first list.
+        void add(
+            std::vector<std::uint32_t> const& first,
+            std::vector<std::uint32_t> const& second,
+            std::vector<float> const& scores)
+        {
+            if (scores.size() != m_ranks.size()) {
+                throw std::invalid_argument("Expected one score per rank");
+            }
+            if (first.empty() || second.empty()) {
+                throw std::invalid_argument("Expected at least one tier per term");
+            }
+            for (auto const& tiers: {first, second}) {
+                if (auto [term, inserted] = m_terms.emplace(tiers.front(), tiers);
+                    not inserted && term->second != tiers) {
+                    throw std::invalid_argument("Conflicting tiers of a term");
+                }
+            }
+            m_pairs.push_back(key(first.front(), second.front()));
+            m_scores.insert(m_scores.end(), scores.begin(), scores.end());
+        }
+
+        void build(PairThresholds& thresholds)
+        {
+            std::vector<std::size_t> order(m_pairs.size());
+            std::iota(order.begin(), order.end(), 0);
+            std::sort(order.begin(), order.end(), [&](auto lhs, auto rhs) {
+                return m_pairs[lhs] < m_pairs[rhs];
+            });
+            std::vector<std::uint64_t> pairs;
+            std::vector<float> scores;
+            pairs.reserve(m_pairs.size());
+            scores.reserve(m_scores.size());
+            for (auto pos: order) {
+                if (not pairs.empty() && pairs.back() == m_pairs[pos]) {
+                    throw std::invalid_argument("Duplicate term pair");
+                }
+                pairs.push_back(m_pairs[pos]);
+                auto first = std::next(m_scores.begin(), pos * m_ranks.size());
+                scores.insert(scores.end(), first, std::next(first, m_ranks.size()));
+            }
+            std::vector<std::uint32_t> terms;
+            std::vector<std::uint64_t> tier_endpoints{0};
+            std::vector<std::uint32_t> tiers;
+            for (auto const& [term, lists]: m_terms) {
+                terms.push_back(term);
+                tiers.insert(tiers.end(), lists.begin(), lists.end());
+                tier_endpoints.push_back(tiers.size());
+            }
+            thresholds.m_ranks.steal(m_ranks);
+            thresholds.m_pairs.steal(pairs);
+            thresholds.m_scores.steal(scores);
+            thresholds.m_terms.steal(terms);
+            thresholds.m_tier_endpoints.steal(tier_endpoints);
+            thresholds.m_tiers.steal(tiers);
+        }
+
+      private:
+        std::vector<std::uint32_t> m_ranks;
+        std::vector<std::uint64_t> m_pairs;
+        std::vector<float> m_scores;
+        std::map<std::uint32_t, std::vector<std::uint32_t>> m_terms;
+    };
+
+    PairThresholds() = default;
+    explicit PairThresholds(MemorySource source) : m_source(std::move(source))
+    {
+        mapper::map(*this, m_source.data(), mapper::map_flags::warmup);
+    }
+
+    /// Number of pairs.
+    [[nodiscard]] auto size() const noexcept -> std::size_t { return m_pairs.size(); }
+
+    /// The k-th scores of the pair of base terms `first` and `second`, if stored.
+    [[nodiscard]] auto kth_scores(std::uint32_t first, std::uint32_t second) const
+        -> std::optional<KthScores>
+    {
+        auto pair = std::lower_bound(m_pairs.begin(), m_pairs.end(), key(first, second));
+        if (pair == m_pairs.end() || *pair != key(first, second)) {
+            return std::nullopt;
+        }
+        auto ranks = m_ranks.size();
+        auto pos = static_cast<std::size_t>(std::distance(m_pairs.begin(), pair));
+        return KthScores{
+            gsl::span<std::uint32_t const>(m_ranks.data(), ranks),
+            gsl::span<float const>(m_scores.data() + pos * ranks, ranks)};
+    }
+
+    /// The tier lists the base term `term` was mined with, if it is part of a stored pair.
+    [[nodiscard]] auto tiers(std::uint32_t term) const
+        -> std::optional<gsl::span<std::uint32_t const>>
+    {
+        auto pos = std::lower_bound(m_terms.begin(), m_terms.end(), term);
+        if (pos == m_terms.end() || *pos != term) {
+            return std::nullopt;
+        }
+        auto idx = static_cast<std::size_t>(std::distance(m_terms.begin(), pos));
+        return gsl::span<std::uint32_t const>(
+            m_tiers.data() + m_tier_endpoints[idx],
+            m_tier_endpoints[idx + 1] - m_tier_endpoints[idx]);
+    }
+
+    /// The largest threshold that the stored pairs of `query` guarantee `k` documents exceed.
+    ///
+    /// Only pairs of terms whose mined tier lists are all held by `query` are considered.
+    [[nodiscard]] auto threshold(Query const& query, std::size_t k) const -> float
+    {
+        float threshold = 0.0F;
+        if (m_pairs.size() == 0) {
+            return threshold;
+        }
+        auto holds = [&](auto list) {
+            return std::find(query.terms.begin(), query.terms.end(), list) != query.terms.end();
+        };
+        std::vector<std::uint32_t> terms;
+        for (auto term: query.terms) {
+            auto lists = tiers(term);
+            if (lists && std::all_of(lists->begin(), lists->end(), holds)) {
+                terms.push_back(term);
+            }
+        }
+        std::sort(terms.begin(), terms.end());
+        terms.erase(std::unique(terms.begin(), terms.end()), terms.end());
+        for (auto first = terms.begin(); first != terms.end(); ++first) {
+            for (auto second = std::next(first); second != terms.end(); ++second) {
+                if (auto scores = kth_scores(*first, *second); scores) {
+                    threshold = std::max(threshold, scores->threshold(k, 1.0F));
+                }
+            }
+        }
+        return threshold;
+    }
+
+    template <typename Visitor>
+    void map(Visitor& visit)
+    {
+        visit(m_ranks, "m_ranks")(m_pairs, "m_pairs")(m_scores, "m_scores")(m_terms, "m_terms")(
+            m_tier_endpoints, "m_tier_endpoints")(m_tiers, "m_tiers");
+    }
+
+  private:
+    [[nodiscard]] static auto key(std::uint32_t first, std::uint32_t second) noexcept
+        -> std::uint64_t
+    {
+        if (first > second) {
+            std::swap(first, second);
+        }
+        return (static_cast<std::uint64_t>(first) << 32U) | second;
+    }
+
+    mapper::mappable_vector<std::uint32_t> m_ranks;
+    mapper::mappable_vector<std::uint64_t> m_pairs;
+    mapper::mappable_vector<float> m_scores;
+    mapper::mappable_vector<std::uint32_t> m_terms;
+    mapper::mappable_vector<std::uint64_t> m_tier_endpoints;
+    mapper::mappable_vector<std::uint32_t> m_tiers;
+    MemorySource m_source;
+};
+
+}  // namespace pisa
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace pisa {
+
+/// Hardware events counted by `PerfCounters`.
+enum class PerfEvent : std::size_t { Cycles, Instructions, BranchMisses, LlcMisses };
+
+constexpr std::array<PerfEvent, 4> perf_events{
+    PerfEvent::Cycles, PerfEvent::Instructions, PerfEvent::BranchMisses, PerfEvent::LlcMisses};
+
+/// Name of `event` in reports, e.g., `branch_misses`.
+[[nodiscard]] auto perf_event_name(PerfEvent event) -> char const*;
+
+/// Counts of hardware events over a measured section.
+///
+/// Counts are scaled up if the kernel multiplexed the counters, so they are estimates then.
+struct PerfSample {
+    std::array<double, perf_events.size()> counts{};
+
+    [[nodiscard]] auto operator[](PerfEvent event) const noexcept -> double
+    {
+        return counts[static_cast<std::size_t>(event)];
+    }
+
+    auto operator+=(PerfSample const& other) noexcept -> PerfSample&
+    {
+        for (std::size_t event = 0; event < counts.size(); ++event) {
+            counts[event] += other.counts[event];
+        }
+        return *this;
+    }
+};
+
+/// Counts hardware events of the calling thread with `perf_event_open`, in user space only.
+///
+/// Unprivileged processes may count their own user-space events unless
+/// `/proc/sys/kernel/perf_event_paranoid` is above 2. When the counters cannot be opened, e.g.,
+/// because of this setting, a seccomp filter or a platform other than Linux, they are not
+/// `available()`, `error()` tells why, and `stop()` returns zeros. Events that the CPU does not
+/// support are skipped, see `counts()`.
+///
+/// # Examples
+/// ```
+/// auto& perf = PerfCounters::this_thread();
+/// perf.start();
+/// run_query();
+/// auto sample = perf.stop();
+/// ```
+class PerfCounters {
+  public:
+    PerfCounters();
+    PerfCounters(PerfCounters const&) = delete;
+    PerfCounters(PerfCounters&&) = delete;
+    PerfCounters& operator=(PerfCounters const&) = delete;
+    PerfCounters& operator=(PerfCounters&&) = delete;
+    ~PerfCounters();
+
+    /// Counters of the calling thread, opened on first use.
+    [[nodiscard]] static auto this_thread() -> PerfCounters&;
+
+    [[nodiscard]] auto available() const noexcept -> bool { return not m_fds.empty(); }
+    [[nodiscard]] auto error() const noexcept -> std::string const& { return m_error; }
+
+    /// Whether `event` is counted.
+    [[nodiscard]] auto counts(PerfEvent event) const noexcept -> bool;
+
+    /// Resets and starts the counters.
+    void start() noexcept;
+
+    /// Stops the counters and returns the counts since `start()`.
+    [[nodiscard]] auto stop() noexcept -> PerfSample;
+
+  private:
+    /// Descriptors of the counted events, the first one leading the group.
+    std::vector<int> m_fds;
+    std::vector<PerfEvent> m_events;
+    std::string m_error;
+};
+
+/// Formats the events of `sample` counted by `perf`, divided by `count`, e.g., per posting.
+[[nodiscard]] auto
+format_perf_sample(PerfCounters const& perf, PerfSample const& sample, double count) -> std::string;
+
+}  // namespace pisa
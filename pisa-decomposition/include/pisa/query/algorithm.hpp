@@ -1,16 +1,19 @@
 #pragma once
 
 #include "query/algorithm/and_query.hpp"
+#include "query/algorithm/anytime_range_query.hpp"
 #include "query/algorithm/block_max_maxscore_query.hpp"
 #include "query/algorithm/block_max_ranked_and_query.hpp"
 #include "query/algorithm/block_max_wand_query.hpp"
 #include "query/algorithm/maxscore_query.hpp"
 #include "query/algorithm/or_query.hpp"
+#include "query/algorithm/parallel_range_query.hpp"
 #include "query/algorithm/range_query.hpp"
 #include "query/algorithm/range_taat_query.hpp"
 #include "query/algorithm/ranked_and_query.hpp"
 #include "query/algorithm/ranked_or_query.hpp"
 #include "query/algorithm/ranked_or_taat_query.hpp"
+#include "query/algorithm/saat_query.hpp"
 #include "query/algorithm/wand_query.hpp"
 
 #include "query/algorithm/block_max_wand_pair_query.hpp"
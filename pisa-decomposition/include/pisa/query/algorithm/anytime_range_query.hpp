@@ -0,0 +1,147 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <numeric>
+#include <vector>
+
+#include "cursor/tier_upper_bound.hpp"
+#include "query/budget.hpp"
+#include "topk_queue.hpp"
+#include "util/util.hpp"
+
+namespace pisa {
+
+/// Upper bounds on the scores of the documents of each range of `range_size` docids.
+///
+/// A list bounds a range by the largest weighted block max score of its blocks overlapping the
+/// range, and lists are combined by term group, so the HIGH tiers of decomposed terms, which
+/// hold the largest block max scores, drive the bounds. The block max enumerators of `cursors`
+/// are walked once and reset.
+template <typename Cursors>
+[[nodiscard]] auto range_upper_bounds(Cursors& cursors, uint64_t max_docid, std::size_t range_size)
+    -> std::vector<float>
+{
+    auto const ranges = ceil_div(max_docid, range_size);
+    std::vector<std::vector<float>> list_bounds(cursors.size(), std::vector<float>(ranges, 0.0F));
+    for (std::size_t list = 0; list < cursors.size(); ++list) {
+        auto& cursor = cursors[list];
+        auto& bounds = list_bounds[list];
+        cursor.block_max_reset();
+        for (uint64_t first = 0; first < max_docid;) {
+            cursor.block_max_next_geq(first);
+            uint64_t last = cursor.block_max_docid();
+            if (last < first) {
+                break;  // No postings beyond the last block
+            }
+            last = std::min(last, max_docid - 1);
+            auto score = static_cast<float>(cursor.weighted_block_max_score());
+            for (auto range = first / range_size; range <= last / range_size; ++range) {
+                bounds[range] = std::max(bounds[range], score);
+            }
+            first = last + 1;
+        }
+        cursor.block_max_reset();
+    }
+
+    std::vector<float> upper_bounds(ranges, 0.0F);
+    TierUpperBound<float> upper_bound(TierUpperBound<>::groups(cursors));
+    for (std::size_t range = 0; range < ranges; ++range) {
+        upper_bound.clear();
+        for (std::size_t list = 0; list < cursors.size(); ++list) {
+            upper_bound.add(cursors[list].group(), list_bounds[list][range]);
+        }
+        upper_bounds[range] = upper_bound.value();
+    }
+    return upper_bounds;
+}
+
+/// Anytime query processing over ranges of docids.
+///
+/// The docid space is split into ranges of `range_size` documents, which are processed by
+/// decreasing upper bound, so that the most promising documents are scored first. Processing
+/// stops once no remaining range can beat the top-k threshold, or when a budget runs out.
+template <typename TopK = topk_queue>
+class anytime_range_query {
+  public:
+    explicit anytime_range_query(TopK& topk) : m_topk(topk) {}
+
+    /// Processes the ranges of `cursors`, which must be block-max cursors, calling
+    /// `process_range(cursors, end)` to score the documents from the current positions of
+    /// `cursors` up to `end`, e.g., with a pair-aware algorithm.
+    ///
+    /// The postings of a range count against `budget` once it is processed. Returns whether
+    /// results are exact, i.e., if the ranges left when the budget runs out cannot beat the
+    /// final threshold.
+    template <typename CursorRange, typename ProcessRange>
+    auto operator()(
+        CursorRange&& cursors,
+        uint64_t max_docid,
+        std::size_t range_size,
+        ProcessRange&& process_range,
+        QueryBudget budget = {}) -> bool
+    {
+        if (cursors.empty()) {
+            return true;
+        }
+        auto const bounds = range_upper_bounds(cursors, max_docid, range_size);
+        std::vector<std::size_t> ranges(bounds.size());
+        std::iota(ranges.begin(), ranges.end(), 0);
+        std::stable_sort(ranges.begin(), ranges.end(), [&](auto lhs, auto rhs) {
+            return bounds[lhs] > bounds[rhs];
+        });
+        auto live = [&](std::size_t range) {
+            return bounds[range] > static_cast<float>(m_topk.threshold());
+        };
+
+        auto const start = std::chrono::steady_clock::now();
+        std::size_t postings = 0;
+        // Cursors only move forward, so they are reset to go back to an earlier range
+        uint64_t processed_until = 0;
+        auto range = ranges.begin();
+        for (; range != ranges.end() && live(*range); ++range) {
+            auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - start);
+            if (budget.exhausted(postings, elapsed)) {
+                break;
+            }
+            uint64_t first = *range * range_size;
+            uint64_t last = std::min<uint64_t>(first + range_size, max_docid);
+            if (first < processed_until) {
+                for (auto& cursor: cursors) {
+                    cursor.reset();
+                    cursor.block_max_reset();
+                }
+            }
+            // `process_range` may reorder the cursors, so positions are summed over all of them
+            std::size_t position = 0;
+            for (auto& cursor: cursors) {
+                // Lists may already be past `first`, e.g., if their next posting is in a later
+                // range than the previous one processed
+                if (cursor.docid() < first) {
+                    cursor.next_geq(first);
+                }
+                position += cursor.position();
+            }
+            process_range(cursors, last);
+            for (auto& cursor: cursors) {
+                if (cursor.docid() < last) {
+                    cursor.next_geq(last);
+                }
+                postings += cursor.position();
+            }
+            postings -= position;
+            processed_until = last;
+        }
+        return range == ranges.end() || not live(*range);
+    }
+
+    std::vector<typename TopK::entry_type> const& topk() const { return m_topk.topk(); }
+
+  private:
+    TopK& m_topk;
+};
+
+}  // namespace pisa
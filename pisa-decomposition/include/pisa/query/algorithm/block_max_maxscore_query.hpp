@@ -1,13 +1,18 @@
 #pragma once
 
+#include "cursor/tier_upper_bound.hpp"
+#include "query/counters.hpp"
 #include "query/queries.hpp"
 #include "topk_queue.hpp"
 #include <vector>
 
 namespace pisa {
 
+template <typename TopK = topk_queue, typename Counters = NoCounters>
 struct block_max_maxscore_query {
-    explicit block_max_maxscore_query(topk_queue& topk) : m_topk(topk) {}
+    explicit block_max_maxscore_query(TopK& topk, Counters counters = {})
+        : m_topk(topk), m_counters(counters)
+    {}
 
     template <typename CursorRange>
     void operator()(CursorRange&& cursors, uint64_t max_docid)
@@ -28,7 +33,7 @@ struct block_max_maxscore_query {
             return lhs->max_score() < rhs->max_score();
         });
 
-        std::vector<float> upper_bounds(ordered_cursors.size());
+        std::vector<typename Cursor::score_type> upper_bounds(ordered_cursors.size());
         upper_bounds[0] = ordered_cursors[0]->max_score();
         for (size_t i = 1; i < ordered_cursors.size(); ++i) {
             upper_bounds[i] = upper_bounds[i - 1] + ordered_cursors[i]->max_score();
@@ -41,7 +46,8 @@ struct block_max_maxscore_query {
             })->docid();
 
         while (non_essential_lists < ordered_cursors.size() && cur_doc < max_docid) {
-            float score = 0;
+            m_counters.document();
+            typename Cursor::score_type score = 0;
             uint64_t next_doc = max_docid;
             for (size_t i = non_essential_lists; i < ordered_cursors.size(); ++i) {
                 if (ordered_cursors[i]->docid() == cur_doc) {
@@ -59,8 +65,8 @@ struct block_max_maxscore_query {
                 if (ordered_cursors[i]->block_max_docid() < cur_doc) {
                     ordered_cursors[i]->block_max_next_geq(cur_doc);
                 }
-                block_upper_bound -= ordered_cursors[i]->max_score()
-                    - ordered_cursors[i]->block_max_score() * ordered_cursors[i]->query_weight();
+                block_upper_bound -=
+                    ordered_cursors[i]->max_score() - ordered_cursors[i]->weighted_block_max_score();
                 if (!m_topk.would_enter(score + block_upper_bound)) {
                     break;
                 }
@@ -68,22 +74,26 @@ struct block_max_maxscore_query {
             if (m_topk.would_enter(score + block_upper_bound)) {
                 // try to complete evaluation with non-essential lists
                 for (size_t i = non_essential_lists - 1; i + 1 > 0; --i) {
-                    ordered_cursors[i]->next_geq(cur_doc);
+                    // Lists that were essential may already be past the current document
+                    if (ordered_cursors[i]->docid() < cur_doc) {
+                        ordered_cursors[i]->next_geq(cur_doc);
+                    }
                     if (ordered_cursors[i]->docid() == cur_doc) {
                         auto s = ordered_cursors[i]->score();
                         // score += s;
                         block_upper_bound += s;
                     }
-                    block_upper_bound -=
-                        ordered_cursors[i]->block_max_score() * ordered_cursors[i]->query_weight();
+                    block_upper_bound -= ordered_cursors[i]->weighted_block_max_score();
 
                     if (!m_topk.would_enter(score + block_upper_bound)) {
                         break;
                     }
                 }
                 score += block_upper_bound;
+            } else {
+                m_counters.block_max_skip();
             }
-            if (m_topk.insert(score, cur_doc)) {
+            if (m_counters.insert(m_topk, score, cur_doc)) {
                 // update non-essential lists
                 while (non_essential_lists < ordered_cursors.size()
                        && !m_topk.would_enter(upper_bounds[non_essential_lists])) {
@@ -94,9 +104,120 @@ struct block_max_maxscore_query {
         }
     }
 
-    std::vector<std::pair<float, uint64_t>> const& topk() const { return m_topk.topk(); }
+    /// Block-max MaxScore over the tier lists of a decomposed index.
+    ///
+    /// A document is in at most one tier of each term, so the bounds partitioning the lists into
+    /// essential and non-essential ones, as well as the block bounds of the non-essential lists,
+    /// only count the largest bound among the tiers of each term.
+    template <typename CursorRange>
+    void pair_aware_block_max_maxscore(CursorRange&& cursors, uint64_t max_docid, bool prime = false)
+    {
+        using Cursor = typename std::decay_t<CursorRange>::value_type;
+        using score_type = typename Cursor::score_type;
+        if (cursors.empty()) {
+            return;
+        }
+
+        std::vector<Cursor*> ordered_cursors;
+        ordered_cursors.reserve(cursors.size());
+        for (auto& en: cursors) {
+            ordered_cursors.push_back(&en);
+        }
+
+        if (prime) {
+            // There *has to be* at least k docs with a score > initial_threshold based on our
+            // precomputation
+            float initial_threshold = m_topk.threshold();
+            size_t top_k_value = m_topk.capacity();
+            for (auto* cursor: ordered_cursors) {
+                initial_threshold = std::max(initial_threshold, cursor->safe_threshold(top_k_value));
+            }
+            m_counters.set_threshold(m_topk, initial_threshold);
+        }
+
+        // sort enumerators by increasing maxscore
+        std::sort(ordered_cursors.begin(), ordered_cursors.end(), [](Cursor* lhs, Cursor* rhs) {
+            return lhs->max_score() < rhs->max_score();
+        });
+
+        // upper_bounds[i] bounds the score of a document over the lists up to i
+        auto groups = TierUpperBound<>::groups(cursors);
+        TierUpperBound<score_type> bound(groups);
+        std::vector<score_type> upper_bounds(ordered_cursors.size());
+        for (size_t i = 0; i < ordered_cursors.size(); ++i) {
+            bound.add(*ordered_cursors[i]);
+            upper_bounds[i] = bound.value();
+        }
+
+        size_t non_essential_lists = 0;
+        auto update_non_essential_lists = [&] {
+            while (non_essential_lists < ordered_cursors.size()
+                   && !m_topk.would_enter(upper_bounds[non_essential_lists])) {
+                non_essential_lists += 1;
+            }
+        };
+        update_non_essential_lists();
+
+        // Same as upper_bounds, but with the block max scores of the current document
+        TierUpperBound<score_type> block_bound(groups);
+        std::vector<score_type> block_upper_bounds(ordered_cursors.size());
+
+        uint64_t cur_doc =
+            std::min_element(cursors.begin(), cursors.end(), [](Cursor const& lhs, Cursor const& rhs) {
+                return lhs.docid() < rhs.docid();
+            })->docid();
+
+        while (non_essential_lists < ordered_cursors.size() && cur_doc < max_docid) {
+            m_counters.document();
+            score_type score = 0;
+            uint64_t next_doc = max_docid;
+            for (size_t i = non_essential_lists; i < ordered_cursors.size(); ++i) {
+                if (ordered_cursors[i]->docid() == cur_doc) {
+                    score += ordered_cursors[i]->score();
+                    ordered_cursors[i]->next();
+                }
+                if (ordered_cursors[i]->docid() < next_doc) {
+                    next_doc = ordered_cursors[i]->docid();
+                }
+            }
+
+            block_bound.clear();
+            for (size_t i = 0; i < non_essential_lists; ++i) {
+                if (ordered_cursors[i]->block_max_docid() < cur_doc) {
+                    ordered_cursors[i]->block_max_next_geq(cur_doc);
+                }
+                block_bound.add(
+                    ordered_cursors[i]->group(), ordered_cursors[i]->weighted_block_max_score());
+                block_upper_bounds[i] = block_bound.value();
+            }
+
+            // try to complete evaluation with non-essential lists, highest bound first
+            bool complete = true;
+            for (size_t i = non_essential_lists; i > 0; --i) {
+                if (!m_topk.would_enter(score + block_upper_bounds[i - 1])) {
+                    m_counters.block_max_skip();
+                    complete = false;
+                    break;
+                }
+                // Lists that were essential may already be past the current document
+                if (ordered_cursors[i - 1]->docid() < cur_doc) {
+                    ordered_cursors[i - 1]->next_geq(cur_doc);
+                }
+                if (ordered_cursors[i - 1]->docid() == cur_doc) {
+                    score += ordered_cursors[i - 1]->score();
+                }
+            }
+            if (complete && m_counters.insert(m_topk, score, cur_doc)) {
+                update_non_essential_lists();
+            }
+            cur_doc = next_doc;
+        }
+    }
+
+    std::vector<typename TopK::entry_type> const& topk() const { return m_topk.topk(); }
 
   private:
-    topk_queue& m_topk;
+    TopK& m_topk;
+    Counters m_counters;
 };
 }  // namespace pisa
@@ -1,13 +1,19 @@
 #pragma once
 
+#include "cursor/tier_groups.hpp"
+#include "cursor/tier_upper_bound.hpp"
+#include "query/counters.hpp"
 #include "query/queries.hpp"
 #include "topk_queue.hpp"
 #include <vector>
 
 namespace pisa {
 
+template <typename TopK = topk_queue, typename Counters = NoCounters>
 struct block_max_ranked_and_query {
-    explicit block_max_ranked_and_query(topk_queue& topk) : m_topk(topk) {}
+    explicit block_max_ranked_and_query(TopK& topk, Counters counters = {})
+        : m_topk(topk), m_counters(counters)
+    {}
 
     template <typename CursorRange>
     void operator()(CursorRange&& cursors, uint64_t max_docid)
@@ -36,8 +42,7 @@ struct block_max_ranked_and_query {
             double block_upper_bound = 0;
             for (size_t block = 0; block < ordered_cursors.size(); ++block) {
                 ordered_cursors[block]->block_max_next_geq(candidate);
-                block_upper_bound += ordered_cursors[block]->block_max_score()
-                    * ordered_cursors[block]->query_weight();
+                block_upper_bound += ordered_cursors[block]->weighted_block_max_score();
             }
             if (m_topk.would_enter(block_upper_bound)) {
                 for (; candidate_list < ordered_cursors.size(); ++candidate_list) {
@@ -50,18 +55,20 @@ struct block_max_ranked_and_query {
                     }
                 }
                 if (candidate_list == ordered_cursors.size()) {
-                    float score = 0;
+                    m_counters.document();
+                    typename Cursor::score_type score = 0;
                     for (candidate_list = 0; candidate_list < ordered_cursors.size();
                          ++candidate_list) {
                         score += ordered_cursors[candidate_list]->score();
                     }
 
-                    m_topk.insert(score, ordered_cursors[0]->docid());
+                    m_counters.insert(m_topk, score, ordered_cursors[0]->docid());
                     ordered_cursors[0]->next();
                     candidate = ordered_cursors[0]->docid();
                     candidate_list = 1;
                 }
             } else {
+                m_counters.block_max_skip();
                 candidate_list = 0;
                 std::uint32_t next_jump = max_docid;
                 for (size_t block = 0; block < ordered_cursors.size(); ++block) {
@@ -78,12 +85,93 @@ struct block_max_ranked_and_query {
         }
     }
 
-    std::vector<std::pair<float, uint64_t>> const& topk() const { return m_topk.topk(); }
+    /// Same as `ranked_and_query::pair_aware_ranked_and`, but skipping the blocks in which
+    /// the sum over terms of the largest block max score among their tiers cannot enter the top k.
+    template <typename CursorRange>
+    void pair_aware_block_max_ranked_and(CursorRange&& cursors, uint64_t max_docid)
+    {
+        using Cursor = typename std::decay_t<CursorRange>::value_type;
+        if (cursors.empty()) {
+            return;
+        }
+        auto groups = group_tiers(cursors);
+        TierUpperBound<typename Cursor::score_type> block_upper_bound(
+            TierUpperBound<>::groups(cursors));
+
+        // Moves the tiers of a term to `docid`, and returns the first document from there on
+        // containing the term; the shorter top tiers are tried first. Tiers left past `docid` by
+        // an earlier call stay where they are, as cursors only move forward.
+        auto next_geq = [&](auto const& group, uint64_t docid) {
+            uint64_t next = max_docid;
+            for (auto* cursor: group) {
+                if (cursor->docid() < docid) {
+                    cursor->next_geq(docid);
+                }
+                if (cursor->docid() == docid) {
+                    return docid;
+                }
+                next = std::min<uint64_t>(next, cursor->docid());
+            }
+            return next;
+        };
+
+        uint64_t candidate = next_geq(groups[0], 0);
+        size_t i = 1;
+        while (candidate < max_docid) {
+            // Tiers whose last block ends before the candidate have no postings left
+            block_upper_bound.clear();
+            for (auto& cursor: cursors) {
+                cursor.block_max_next_geq(candidate);
+                if (cursor.block_max_docid() >= candidate) {
+                    block_upper_bound.add(cursor.group(), cursor.weighted_block_max_score());
+                }
+            }
+            if (m_topk.would_enter(block_upper_bound.value())) {
+                for (; i < groups.size(); ++i) {
+                    if (auto docid = next_geq(groups[i], candidate); docid != candidate) {
+                        candidate = docid;
+                        i = 0;
+                        break;
+                    }
+                }
+                if (i == groups.size()) {
+                    m_counters.document();
+                    typename Cursor::score_type score = 0;
+                    for (auto& cursor: cursors) {
+                        if (cursor.docid() < candidate) {
+                            cursor.next_geq(candidate);
+                        }
+                        if (cursor.docid() == candidate) {
+                            score += cursor.score();
+                        }
+                    }
+
+                    m_counters.insert(m_topk, score, candidate);
+                    candidate = next_geq(groups[0], candidate + 1);
+                    i = 1;
+                }
+            } else {
+                m_counters.block_max_skip();
+                // Skip to the end of the first block to end
+                uint64_t next_jump = max_docid;
+                for (auto& cursor: cursors) {
+                    if (cursor.block_max_docid() >= candidate) {
+                        next_jump = std::min<uint64_t>(next_jump, cursor.block_max_docid());
+                    }
+                }
+                candidate = next_jump >= max_docid ? max_docid : next_jump + 1;
+                i = 0;
+            }
+        }
+    }
+
+    std::vector<typename TopK::entry_type> const& topk() const { return m_topk.topk(); }
 
-    topk_queue& get_topk() { return m_topk; }
+    TopK& get_topk() { return m_topk; }
 
   private:
-    topk_queue& m_topk;
+    TopK& m_topk;
+    Counters m_counters;
 };
 
 }  // namespace pisa
@@ -1,12 +1,17 @@
 #pragma once
 
+#include "cursor/docid_ordered_cursors.hpp"
+#include "query/counters.hpp"
 #include "query/queries.hpp"
 #include "topk_queue.hpp"
 #include <vector>
 namespace pisa {
 
+template <typename TopK = topk_queue, typename Counters = NoCounters>
 struct block_max_wand_pair_query {
-    explicit block_max_wand_pair_query(topk_queue& topk) : m_topk(topk) {}
+    explicit block_max_wand_pair_query(TopK& topk, Counters counters = {})
+        : m_topk(topk), m_counters(counters)
+    {}
 
     template <typename CursorRange>
     void operator()(CursorRange&& cursors, uint64_t max_docid)
@@ -16,41 +21,30 @@ struct block_max_wand_pair_query {
             return;
         }
 
-        std::vector<Cursor*> ordered_cursors;
-        ordered_cursors.reserve(cursors.size());
-        for (auto& en: cursors) {
-            ordered_cursors.push_back(&en);
-        }
-
-        auto sort_cursors = [&]() {
-            // sort enumerators by increasing docid
-            std::sort(ordered_cursors.begin(), ordered_cursors.end(), [](Cursor* lhs, Cursor* rhs) {
-                return lhs->docid() < rhs->docid();
-            });
-        };
-
-        sort_cursors();
+        // Only the cursors that move are re-inserted, instead of sorting all of them
+        DocidOrderedCursors<Cursor> ordered_cursors(cursors);
 
         while (true) {
+            m_counters.pivot();
             // find pivot
-            float upper_bound = 0.F;
+            typename Cursor::score_type upper_bound = 0;
             size_t pivot;
             bool found_pivot = false;
             uint64_t pivot_id = max_docid;
             uint32_t min_high_non_considered = std::numeric_limits<uint32_t>::max();
             for (pivot = 0; pivot < ordered_cursors.size(); ++pivot) {
-                if (ordered_cursors[pivot]->docid() >= max_docid) {
+                if (ordered_cursors.docid(pivot) >= max_docid) {
                     break;
                 }
 
-                upper_bound += ordered_cursors[pivot]->max_score();
+                upper_bound += ordered_cursors[pivot].max_score();
                 min_high_non_considered = std::min(
-                    min_high_non_considered, ordered_cursors[pivot]->non_considered_high_docid());
+                    min_high_non_considered, ordered_cursors[pivot].non_considered_high_docid());
                 if (m_topk.would_enter(upper_bound)) {
                     found_pivot = true;
-                    pivot_id = ordered_cursors[pivot]->docid();
+                    pivot_id = ordered_cursors.docid(pivot);
                     for (; pivot + 1 < ordered_cursors.size()
-                         && ordered_cursors[pivot + 1]->docid() == pivot_id;
+                         && ordered_cursors.docid(pivot + 1) == pivot_id;
                          ++pivot) {
                     }
                     break;
@@ -63,129 +57,100 @@ struct block_max_wand_pair_query {
                     break;
                 } else {
                     // We didn't find a pivot, but we might still be interested in some highs
-                    for (size_t i = 0; i < ordered_cursors.size(); ++i) {
-                        if (ordered_cursors[i]->docid() < min_high_non_considered)
-                            ordered_cursors[i]->next_geq(min_high_non_considered);
-                    }
-                    sort_cursors();
+                    ordered_cursors.next_geq(min_high_non_considered);
                     continue;
                 }
             }
 
             if (pivot_id > min_high_non_considered) {
-                for (size_t i = 0; i < pivot; ++i) {
-                    if (ordered_cursors[i]->docid() < min_high_non_considered)
-                        ordered_cursors[i]->next_geq(min_high_non_considered);
-                }
-                sort_cursors();
+                // The cursors before min_high_non_considered all come before the pivot
+                ordered_cursors.next_geq(min_high_non_considered);
                 continue;
             }
 
             double block_upper_bound = 0;
 
             for (size_t i = 0; i < pivot + 1; ++i) {
-                if (ordered_cursors[i]->block_max_docid() < pivot_id) {
-                    ordered_cursors[i]->block_max_next_geq(pivot_id);
+                auto& cursor = ordered_cursors[i];
+                if (cursor.block_max_docid() < pivot_id) {
+                    cursor.block_max_next_geq(pivot_id);
                 }
 
-                block_upper_bound +=
-                    ordered_cursors[i]->block_max_score() * ordered_cursors[i]->query_weight();
+                block_upper_bound += cursor.weighted_block_max_score();
             }
 
             if (m_topk.would_enter(block_upper_bound)) {
                 // check if pivot is a possible match
-                if (pivot_id == ordered_cursors[0]->docid()) {
-                    float score = 0;
-                    for (Cursor* en: ordered_cursors) {
-                        if (en->docid() != pivot_id) {
+                if (pivot_id == ordered_cursors.docid(0)) {
+                    m_counters.document();
+                    typename Cursor::score_type score = 0;
+                    for (size_t i = 0; i < ordered_cursors.size(); ++i) {
+                        if (ordered_cursors.docid(i) != pivot_id) {
                             break;
                         }
-                        float part_score = en->score();
+                        auto& cursor = ordered_cursors[i];
+                        auto part_score = cursor.score();
                         score += part_score;
-                        block_upper_bound -= en->block_max_score() * en->query_weight() - part_score;
+                        block_upper_bound -= cursor.weighted_block_max_score() - part_score;
                         if (!m_topk.would_enter(block_upper_bound)) {
                             break;
                         }
                     }
-                    for (Cursor* en: ordered_cursors) {
-                        if (en->docid() != pivot_id) {
-                            break;
-                        }
-                        en->next();
-                    }
-
-                    m_topk.insert(score, pivot_id);
-                    // resort by docid
-                    sort_cursors();
 
+                    m_counters.insert(m_topk, score, pivot_id);
+                    ordered_cursors.next(pivot_id);
                 } else {
                     uint64_t next_list = pivot;
-                    for (; ordered_cursors[next_list]->docid() == pivot_id; --next_list) {
-                    }
-                    ordered_cursors[next_list]->next_geq(pivot_id);
-
-                    // bubble down the advanced list
-                    for (size_t i = next_list + 1; i < ordered_cursors.size(); ++i) {
-                        if (ordered_cursors[i]->docid() <= ordered_cursors[i - 1]->docid()) {
-                            std::swap(ordered_cursors[i], ordered_cursors[i - 1]);
-                        } else {
-                            break;
-                        }
+                    for (; ordered_cursors.docid(next_list) == pivot_id; --next_list) {
                     }
+                    ordered_cursors.next_geq(next_list, pivot_id);
                 }
 
             } else {
+                m_counters.block_max_skip();
                 uint64_t next;
                 uint64_t next_list = pivot;
 
-                float max_weight = ordered_cursors[next_list]->max_score();
+                auto max_weight = ordered_cursors[next_list].max_score();
 
                 for (uint64_t i = 0; i < pivot; i++) {
-                    if (ordered_cursors[i]->max_score() > max_weight) {
+                    if (ordered_cursors[i].max_score() > max_weight) {
                         next_list = i;
-                        max_weight = ordered_cursors[i]->max_score();
+                        max_weight = ordered_cursors[i].max_score();
                     }
                 }
 
                 next = max_docid;
 
                 for (size_t i = 0; i <= pivot; ++i) {
-                    if (ordered_cursors[i]->block_max_docid() < next) {
-                        next = ordered_cursors[i]->block_max_docid();
+                    if (ordered_cursors[i].block_max_docid() < next) {
+                        next = ordered_cursors[i].block_max_docid();
                     }
                 }
 
                 next = next + 1;
-                if (pivot + 1 < ordered_cursors.size() && ordered_cursors[pivot + 1]->docid() < next) {
-                    next = ordered_cursors[pivot + 1]->docid();
+                if (pivot + 1 < ordered_cursors.size() && ordered_cursors.docid(pivot + 1) < next) {
+                    next = ordered_cursors.docid(pivot + 1);
                 }
 
                 if (next <= pivot_id) {
                     next = pivot_id + 1;
                 }
 
-                ordered_cursors[next_list]->next_geq(next);
-
-                // bubble down the advanced list
-                for (size_t i = next_list + 1; i < ordered_cursors.size(); ++i) {
-                    if (ordered_cursors[i]->docid() < ordered_cursors[i - 1]->docid()) {
-                        std::swap(ordered_cursors[i], ordered_cursors[i - 1]);
-                    } else {
-                        break;
-                    }
-                }
+                ordered_cursors.next_geq(next_list, next);
             }
         }
     }
 
-    std::vector<std::pair<float, uint64_t>> const& topk() const { return m_topk.topk(); }
+    std::vector<typename TopK::entry_type> const& topk() const { return m_topk.topk(); }
 
     void clear_topk() { m_topk.clear(); }
 
-    topk_queue const& get_topk() const { return m_topk; }
+    TopK const& get_topk() const { return m_topk; }
 
   private:
-    topk_queue& m_topk;
+    TopK& m_topk;
+    Counters m_counters;
 };
 
 }  // namespace pisa
@@ -4,14 +4,19 @@
 #include <numeric>
 #include <vector>
 
+#include "cursor/tier_upper_bound.hpp"
+#include "query/counters.hpp"
 #include "query/queries.hpp"
 #include "topk_queue.hpp"
 #include "util/compiler_attribute.hpp"
 
 namespace pisa {
 
+template <typename TopK = topk_queue, typename Counters = NoCounters>
 struct maxscore_query {
-    explicit maxscore_query(topk_queue& topk) : m_topk(topk) {}
+    explicit maxscore_query(TopK& topk, Counters counters = {})
+        : m_topk(topk), m_counters(counters)
+    {}
 
     template <typename Cursors>
     [[nodiscard]] PISA_ALWAYSINLINE auto sorted_by_bound(Cursors&& cursors)
@@ -48,11 +53,15 @@ struct maxscore_query {
 
 
     template <typename Cursors>
-    [[nodiscard]] PISA_ALWAYSINLINE auto calc_upper_bounds(Cursors&& cursors) -> std::vector<float>
+    using score_type = typename std::decay_t<Cursors>::value_type::score_type;
+
+    template <typename Cursors>
+    [[nodiscard]] PISA_ALWAYSINLINE auto calc_upper_bounds(Cursors&& cursors)
+        -> std::vector<score_type<Cursors>>
     {
-        std::vector<float> upper_bounds(cursors.size());
+        std::vector<score_type<Cursors>> upper_bounds(cursors.size());
         auto out = upper_bounds.rbegin();
-        float bound = 0.0;
+        score_type<Cursors> bound = 0;
         for (auto pos = cursors.rbegin(); pos != cursors.rend(); ++pos) {
             bound += pos->max_score();
             *out++ = bound;
@@ -82,11 +91,6 @@ struct maxscore_query {
         auto first_upper_bound = upper_bounds.end();
         auto first_lookup = cursors.end();
         auto next_docid = min_docid(cursors);
-#ifdef PROFILE
-size_t profile_docs = 0;
-size_t profile_postings = 0;
-#endif
-
 
         auto update_non_essential_lists = [&] {
             while (first_lookup != cursors.begin()
@@ -101,38 +105,25 @@ size_t profile_postings = 0;
         };
 
         if (update_non_essential_lists() == UpdateResult::ShortCircuit) {
-#ifdef PROFILE
-std::cout << profile_docs << " " << profile_postings << "\n";
-#endif
- 
             return;
         }
-        float current_score = 0;
+        score_type<Cursors> current_score = 0;
         std::uint32_t current_docid = 0;
 
         while (current_docid < max_docid) {
             auto status = DocumentStatus::Skip;
             while (status == DocumentStatus::Skip) {
                 if (PISA_UNLIKELY(next_docid >= max_docid)) {
-#ifdef PROFILE
-std::cout << profile_docs << " " << profile_postings << "\n";
-#endif
- 
                     return;
                 }
 
                 current_score = 0;
                 current_docid = std::exchange(next_docid, max_docid);
-#ifdef PROFILE
-++profile_docs;
-#endif
+                m_counters.document();
                 std::for_each(cursors.begin(), first_lookup, [&](auto& cursor) {
                     if (cursor.docid() == current_docid) {
                         current_score += cursor.score();
                         cursor.next();
-#ifdef PROFILE
-++profile_postings;
-#endif
                     }
                     if (auto docid = cursor.docid(); docid < next_docid) {
                         next_docid = docid;
@@ -147,174 +138,194 @@ std::cout << profile_docs << " " << profile_postings << "\n";
                         status = DocumentStatus::Skip;
                         break;
                     }
-                    cursor.next_geq(current_docid);
+                    // Lists that were essential may already be past the current document
+                    if (cursor.docid() < current_docid) {
+                        cursor.next_geq(current_docid);
+                    }
                     if (cursor.docid() == current_docid) {
                         current_score += cursor.score();
-#ifdef PROFILE
-++profile_postings;
-#endif
                     }
                 }
             }
-            if (m_topk.insert(current_score, current_docid)
+            if (m_counters.insert(m_topk, current_score, current_docid)
                 && update_non_essential_lists() == UpdateResult::ShortCircuit) {
-#ifdef PROFILE
-std::cout << profile_docs << " " << profile_postings << "\n";
-#endif
- 
                 return;
             }
         }
-#ifdef PROFILE
-std::cout << profile_docs << " " << profile_postings << "\n";
-#endif
- 
     }
 
-    // Run exhaustive over the high lists
-    template <typename Cursors>
-    PISA_ALWAYSINLINE void high_then_low_internal(Cursors&& high_cursors, Cursors&& low_cursors, uint64_t max_docid)
+    /// First docid of `[first, last)` not less than `docid`, by galloping from `first`.
+    template <typename Iterator>
+    [[nodiscard]] PISA_ALWAYSINLINE static auto
+    gallop(Iterator first, Iterator last, std::uint32_t docid) -> Iterator
     {
+        std::ptrdiff_t step = 1;
+        while (step < std::distance(first, last) && *std::next(first, step) < docid) {
+            std::advance(first, step);
+            step *= 2;
+        }
+        return std::lower_bound(
+            first, std::next(first, std::min(step, std::distance(first, last))), docid);
+    }
 
-        std::unordered_set<uint32_t> scored_documents;
+    /// Exhaustive OR over the HIGH lists, completing each document with lookups in the LOW
+    /// lists, sorted by decreasing max score, as long as it can make the top k.
+    ///
+    /// Returns the sorted docids of the HIGH lists, which are either scored in full or cannot
+    /// make the top k, and so are to be skipped over the LOW lists.
+    template <typename HighCursors, typename LowCursors>
+    [[nodiscard]] PISA_ALWAYSINLINE auto
+    high_phase(HighCursors&& high_cursors, LowCursors&& low_cursors, uint64_t max_docid)
+        -> std::vector<std::uint32_t>
+    {
+        std::vector<std::uint32_t> scored_documents;
+        if (high_cursors.empty()) {
+            return scored_documents;
+        }
+        auto low_bounds = calc_upper_bounds(low_cursors);
 
         uint64_t cur_doc = min_docid(high_cursors);
-
-        // Exhaustive OR over high lists
         while (cur_doc < max_docid) {
-            float score = 0;
+            m_counters.document();
+            score_type<HighCursors> score = 0;
             uint64_t next_doc = max_docid;
-            for (size_t i = 0; i < high_cursors.size(); ++i) {
-                if (high_cursors[i].docid() == cur_doc) {
-                    score += high_cursors[i].score();
-                    high_cursors[i].next();
+            for (auto& cursor: high_cursors) {
+                if (cursor.docid() == cur_doc) {
+                    score += cursor.score();
+                    cursor.next();
                 }
-                if (high_cursors[i].docid() < next_doc) {
-                    next_doc = high_cursors[i].docid();
+                if (cursor.docid() < next_doc) {
+                    next_doc = cursor.docid();
                 }
             }
 
-            // Now update scores for low lists if need be
+            bool complete = true;
             for (size_t i = 0; i < low_cursors.size(); ++i) {
-                low_cursors[i].next_geq(cur_doc);
+                if (!m_topk.would_enter(score + low_bounds[i])) {
+                    complete = false;
+                    break;
+                }
+                // Lookups for earlier documents may have moved the list past this one
+                if (low_cursors[i].docid() < cur_doc) {
+                    low_cursors[i].next_geq(cur_doc);
+                }
                 if (low_cursors[i].docid() == cur_doc) {
                     score += low_cursors[i].score();
                 }
             }
-            m_topk.insert(score, cur_doc);
-            // Keep the scored document for later
-            scored_documents.insert(cur_doc);
-
+            if (complete) {
+                m_counters.insert(m_topk, score, cur_doc);
+            }
+            scored_documents.push_back(cur_doc);
             cur_doc = next_doc;
         }
+        return scored_documents;
+    }
 
-        // Now we run a modified maxscore on the low lists
-
-        // Reset the low lists and move up to the first non-scored doc
-        for (size_t i = 0; i < low_cursors.size(); ++i) {
-            low_cursors[i].reset();
-            while (scored_documents.find(low_cursors[i].docid()) != scored_documents.end()) {
-                low_cursors[i].next();
-            }
+    /// Block-max MaxScore over the LOW lists, sorted by decreasing max score, skipping
+    /// `scored_documents`.
+    template <typename Cursors>
+    PISA_ALWAYSINLINE void low_phase(
+        Cursors&& cursors, std::vector<std::uint32_t> const& scored_documents, uint64_t max_docid)
+    {
+        if (cursors.empty()) {
+            return;
         }
- 
-        auto upper_bounds = calc_upper_bounds(low_cursors);
-        auto above_threshold = [&](auto score) { return m_topk.would_enter(score); };
-
-        auto first_upper_bound = upper_bounds.end();
-        auto first_lookup = low_cursors.end();
-        auto next_docid = min_docid(low_cursors);
+        auto upper_bounds = calc_upper_bounds(cursors);
 
+        // Lists from `essential_lists` on are non-essential
+        auto essential_lists = cursors.size();
         auto update_non_essential_lists = [&] {
-            while (first_lookup != low_cursors.begin()
-                   && !above_threshold(*std::prev(first_upper_bound))) {
-                --first_lookup;
-                --first_upper_bound;
-                if (first_lookup == low_cursors.begin()) {
-                    return UpdateResult::ShortCircuit;
-                }
+            while (essential_lists > 0 && !m_topk.would_enter(upper_bounds[essential_lists - 1])) {
+                --essential_lists;
             }
-            return UpdateResult::Continue;
+        };
+        update_non_essential_lists();
+
+        // Candidates come in increasing docid order, so the skipped documents are searched
+        // from the position of the previous candidate on.
+        auto next_scored = scored_documents.begin();
+        auto already_scored = [&](std::uint32_t docid) {
+            next_scored = gallop(next_scored, scored_documents.end(), docid);
+            return next_scored != scored_documents.end() && *next_scored == docid;
         };
 
-        if (update_non_essential_lists() == UpdateResult::ShortCircuit) {
-            return;
+        uint64_t cur_doc = max_docid;
+        for (size_t i = 0; i < essential_lists; ++i) {
+            cur_doc = std::min<uint64_t>(cur_doc, cursors[i].docid());
         }
-
-        float current_score = 0;
-        std::uint32_t current_docid = 0;
-
-        while (current_docid < max_docid) {
-            auto status = DocumentStatus::Skip;
-            while (status == DocumentStatus::Skip) {
-                if (PISA_UNLIKELY(next_docid >= max_docid)) {
-                    return;
-                }
-
-                current_score = 0;
-                current_docid = std::exchange(next_docid, max_docid);
-
-                std::for_each(low_cursors.begin(), first_lookup, [&](auto& cursor) {
-                    if (cursor.docid() == current_docid) {
-                        current_score += cursor.score();
-                        cursor.next();
+        while (essential_lists > 0 && cur_doc < max_docid) {
+            bool skip = already_scored(cur_doc);
+            score_type<Cursors> score = 0;
+            uint64_t next_doc = max_docid;
+            for (size_t i = 0; i < essential_lists; ++i) {
+                auto& cursor = cursors[i];
+                if (cursor.docid() == cur_doc) {
+                    if (!skip) {
+                        score += cursor.score();
                     }
-
-                    // Move up until we find something of potential interest (not yet scored)
-                    auto potential_next = cursor.docid();
-                    while (scored_documents.find(potential_next) != scored_documents.end()) {
-                        cursor.next();
-                        potential_next = cursor.docid();
+                    cursor.next();
+                }
+                if (cursor.docid() < next_doc) {
+                    next_doc = cursor.docid();
+                }
+            }
+            if (skip) {
+                cur_doc = next_doc;
+                continue;
+            }
+            m_counters.document();
+
+            double block_upper_bound =
+                essential_lists < cursors.size() ? upper_bounds[essential_lists] : 0;
+            for (size_t i = essential_lists; i < cursors.size(); ++i) {
+                auto& cursor = cursors[i];
+                if (cursor.block_max_docid() < cur_doc) {
+                    cursor.block_max_next_geq(cur_doc);
+                }
+                block_upper_bound -= cursor.max_score() - cursor.weighted_block_max_score();
+                if (!m_topk.would_enter(score + block_upper_bound)) {
+                    break;
+                }
+            }
+            if (m_topk.would_enter(score + block_upper_bound)) {
+                // Try to complete the evaluation with the non-essential lists
+                for (size_t i = essential_lists; i < cursors.size(); ++i) {
+                    auto& cursor = cursors[i];
+                    // Lists that were essential may already be past the current document
+                    if (cursor.docid() < cur_doc) {
+                        cursor.next_geq(cur_doc);
                     }
- 
-                    if (potential_next < next_docid) {
-                        next_docid = potential_next;
+                    if (cursor.docid() == cur_doc) {
+                        block_upper_bound += cursor.score();
                     }
-                });
-
-                status = DocumentStatus::Insert;
-                auto lookup_bound = first_upper_bound;
-                for (auto pos = first_lookup; pos != low_cursors.end(); ++pos, ++lookup_bound) {
-                    auto& cursor = *pos;
-                    if (not above_threshold(current_score + *lookup_bound)) {
-                        status = DocumentStatus::Skip;
+                    block_upper_bound -= cursor.weighted_block_max_score();
+                    if (!m_topk.would_enter(score + block_upper_bound)) {
                         break;
                     }
-                    cursor.next_geq(current_docid);
-                    if (cursor.docid() == current_docid) {
-                        current_score += cursor.score();
-                    }
                 }
+                score += block_upper_bound;
+            } else {
+                m_counters.block_max_skip();
             }
-            if (m_topk.insert(current_score, current_docid)
-                && update_non_essential_lists() == UpdateResult::ShortCircuit) {
-                return;
+            if (m_counters.insert(m_topk, score, cur_doc)) {
+                update_non_essential_lists();
             }
+            cur_doc = next_doc;
         }
     }
 
-    // Maxscore which has awareness of partner lists
+    // Maxscore which has awareness of the other tiers of each term
     template <typename Cursors>
     PISA_ALWAYSINLINE void run_sorted_aware(Cursors&& cursors, uint64_t max_docid)
     {
-        //auto upper_bounds = calc_upper_bounds(cursors);
-       
-        bit_vec_64 seen_term;
-
-        // Stolen from calc_upper_bounds
-        // Modify to only use the upper list at any step
-        std::vector<float> upper_bounds(cursors.size());
+        // Like calc_upper_bounds, but each term only counts the highest of its tier bounds
+        std::vector<score_type<Cursors>> upper_bounds(cursors.size());
+        TierUpperBound<score_type<Cursors>> bound(TierUpperBound<>::groups(cursors));
         auto out = upper_bounds.rbegin();
-        float bound = 0.0;
-        size_t idx = cursors.size() - 1;
         for (auto pos = cursors.rbegin(); pos != cursors.rend(); ++pos) {
-            bound += pos->max_score();
-            if (seen_term[pos->list_id()]) {
-               bound -= pos->low_max_score(); 
-            } else {
-                seen_term.set(pos->list_id(), true);
-            }
-            *out++ = bound;
+            bound.add(*pos);
+            *out++ = bound.value();
         }
 
         auto above_threshold = [&](auto score) { return m_topk.would_enter(score); };
@@ -339,7 +350,7 @@ std::cout << profile_docs << " " << profile_postings << "\n";
             return;
         }
 
-        float current_score = 0;
+        score_type<Cursors> current_score = 0;
         std::uint32_t current_docid = 0;
 
         while (current_docid < max_docid) {
@@ -351,6 +362,7 @@ std::cout << profile_docs << " " << profile_postings << "\n";
 
                 current_score = 0;
                 current_docid = std::exchange(next_docid, max_docid);
+                m_counters.document();
 
                 std::for_each(cursors.begin(), first_lookup, [&](auto& cursor) {
                     if (cursor.docid() == current_docid) {
@@ -370,13 +382,16 @@ std::cout << profile_docs << " " << profile_postings << "\n";
                         status = DocumentStatus::Skip;
                         break;
                     }
-                    cursor.next_geq(current_docid);
+                    // Lists that were essential may already be past the current document
+                    if (cursor.docid() < current_docid) {
+                        cursor.next_geq(current_docid);
+                    }
                     if (cursor.docid() == current_docid) {
                         current_score += cursor.score();
                     }
                 }
             }
-            if (m_topk.insert(current_score, current_docid)
+            if (m_counters.insert(m_topk, current_score, current_docid)
                 && update_non_essential_lists() == UpdateResult::ShortCircuit) {
                 return;
             }
@@ -389,15 +404,15 @@ std::cout << profile_docs << " " << profile_postings << "\n";
     {
 
         // There *has to be* at least k docs with a score > initial_threshold based on our
-        // precomputation
-        float initial_threshold = 0.0f;
+        // precomputation; a threshold already set by the caller is kept if higher
+        float initial_threshold = m_topk.threshold();
         size_t top_k_value = m_topk.capacity();
         //std::cerr << "k = " << top_k_value << "\n";
         for (size_t i = 0; i < cursors.size(); ++i) {
             initial_threshold = std::max(initial_threshold, cursors[i].safe_threshold(top_k_value));
         }
         //std::cerr << "init = " << initial_threshold << "\n";
-        m_topk.set_threshold(initial_threshold);
+        m_counters.set_threshold(m_topk, initial_threshold);
     }
 
 
@@ -431,13 +446,22 @@ std::cout << profile_docs << " " << profile_postings << "\n";
 
 
 
-    template <typename Cursors>
-    void high_then_low(Cursors&& high_cursors_, Cursors&& low_cursors_, uint64_t max_docid)
+    /// Two-phase MaxScore over the HIGH and LOW lists of a decomposed index.
+    ///
+    /// The HIGH lists are processed exhaustively first, completing their documents with lookups
+    /// in the LOW lists, which raises the threshold early. The LOW lists, which must be
+    /// `BlockMaxScoredCursor`s, are then processed from the start with block-max MaxScore,
+    /// skipping the documents of the HIGH lists.
+    template <typename HighCursors, typename LowCursors>
+    void high_then_low(HighCursors&& high_cursors_, LowCursors&& low_cursors_, uint64_t max_docid)
     {
-
         auto high_cursors = sorted_by_bound(high_cursors_);
         auto low_cursors = sorted_by_bound(low_cursors_);
-        high_then_low_internal(high_cursors, low_cursors, max_docid);
+        auto scored_documents = high_phase(high_cursors, low_cursors, max_docid);
+        for (auto& cursor: low_cursors) {
+            cursor.reset();
+        }
+        low_phase(low_cursors, scored_documents, max_docid);
         std::swap(high_cursors, high_cursors_);
         std::swap(low_cursors, low_cursors_);
     }
@@ -460,10 +484,11 @@ std::cout << profile_docs << " " << profile_postings << "\n";
 
 
 
-    std::vector<std::pair<float, uint64_t>> const& topk() const { return m_topk.topk(); }
+    std::vector<typename TopK::entry_type> const& topk() const { return m_topk.topk(); }
 
   private:
-    topk_queue& m_topk;
+    TopK& m_topk;
+    Counters m_counters;
 };
 
 }  // namespace pisa
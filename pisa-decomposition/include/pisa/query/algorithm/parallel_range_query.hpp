@@ -0,0 +1,69 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "tbb/parallel_for.h"
+
+#include "shared_topk_queue.hpp"
+#include "topk_queue.hpp"
+#include "util/util.hpp"
+
+namespace pisa {
+
+/// Intra-query parallelism over ranges of docids.
+///
+/// As in `range_query`, the docid space is split into ranges of `range_size` documents, but
+/// ranges are processed concurrently as TBB tasks, each with its own cursors and top-k queue.
+/// The tasks share a threshold (see `shared_topk_queue`), so that one task's progress prunes
+/// the others, and their queues are merged at the end.
+template <typename TopK = topk_queue>
+class parallel_range_query {
+  public:
+    explicit parallel_range_query(TopK& topk) : m_topk(topk) {}
+
+    /// Processes every range with new cursors from `make_cursors()`, moved to the start of the
+    /// range, by calling `process_range(topk, cursors, end)` with the queue of the task, e.g.,
+    /// to run MaxScore or a pair-aware algorithm up to the end of the range.
+    template <typename MakeCursors, typename ProcessRange>
+    void operator()(
+        MakeCursors&& make_cursors,
+        uint64_t max_docid,
+        std::size_t range_size,
+        ProcessRange&& process_range)
+    {
+        using score_type = typename TopK::score_type;
+        auto const ranges = ceil_div(max_docid, range_size);
+        SharedThreshold<score_type> threshold(m_topk.threshold());
+        std::vector<shared_topk_queue<TopK>> queues;
+        queues.reserve(ranges);
+        for (std::size_t range = 0; range < ranges; ++range) {
+            queues.emplace_back(m_topk.capacity(), threshold);
+        }
+
+        tbb::parallel_for(std::size_t(0), ranges, [&](std::size_t range) {
+            uint64_t first = range * range_size;
+            uint64_t last = std::min<uint64_t>(first + range_size, max_docid);
+            auto cursors = make_cursors();
+            for (auto& cursor: cursors) {
+                cursor.next_geq(first);
+            }
+            process_range(queues[range], cursors, last);
+        });
+
+        for (auto const& queue: queues) {
+            for (auto const& [score, docid]: queue.topk()) {
+                m_topk.insert(score, docid);
+            }
+        }
+    }
+
+    std::vector<typename TopK::entry_type> const& topk() const { return m_topk.topk(); }
+
+  private:
+    TopK& m_topk;
+};
+
+}  // namespace pisa
@@ -5,9 +5,9 @@
 
 namespace pisa {
 
-template <typename QueryAlg>
+template <typename QueryAlg, typename TopK = topk_queue>
 struct range_query {
-    explicit range_query(topk_queue& topk) : m_topk(topk) {}
+    explicit range_query(TopK& topk) : m_topk(topk) {}
 
     template <typename CursorRange>
     void operator()(CursorRange&& cursors, uint64_t max_docid, size_t range_size)
@@ -23,7 +23,7 @@ struct range_query {
         process_range(cursors, max_docid);
     }
 
-    std::vector<std::pair<float, uint64_t>> const& topk() const { return m_topk.topk(); }
+    std::vector<typename TopK::entry_type> const& topk() const { return m_topk.topk(); }
 
     template <typename CursorRange>
     void process_range(CursorRange&& cursors, size_t end)
@@ -33,7 +33,7 @@ struct range_query {
     }
 
   private:
-    topk_queue& m_topk;
+    TopK& m_topk;
 };
 
 }  // namespace pisa
@@ -5,9 +5,9 @@
 
 namespace pisa {
 
-template <typename QueryAlg>
+template <typename QueryAlg, typename TopK = topk_queue>
 struct range_taat_query {
-    explicit range_taat_query(topk_queue& topk) : m_topk(topk) {}
+    explicit range_taat_query(TopK& topk) : m_topk(topk) {}
 
     template <typename CursorRange, typename Acc>
     void operator()(CursorRange&& cursors, uint64_t max_docid, size_t range_size, Acc&& accumulator)
@@ -24,7 +24,7 @@ struct range_taat_query {
         process_range(cursors, max_docid, accumulator);
     }
 
-    std::vector<std::pair<float, uint64_t>> const& topk() const { return m_topk.topk(); }
+    std::vector<typename TopK::entry_type> const& topk() const { return m_topk.topk(); }
 
     template <typename CursorRange, typename Acc>
     void process_range(CursorRange&& cursors, size_t end, Acc&& accumulator)
@@ -34,7 +34,7 @@ struct range_taat_query {
     }
 
   private:
-    topk_queue& m_topk;
+    TopK& m_topk;
 };
 
 }  // namespace pisa
@@ -1,13 +1,18 @@
 #pragma once
 
+#include "cursor/tier_groups.hpp"
+#include "query/counters.hpp"
 #include "query/queries.hpp"
 #include "topk_queue.hpp"
 #include <vector>
 
 namespace pisa {
 
+template <typename TopK = topk_queue, typename Counters = NoCounters>
 struct ranked_and_query {
-    explicit ranked_and_query(topk_queue& topk) : m_topk(topk) {}
+    explicit ranked_and_query(TopK& topk, Counters counters = {})
+        : m_topk(topk), m_counters(counters)
+    {}
 
     template <typename CursorRange>
     void operator()(CursorRange&& cursors, uint64_t max_docid)
@@ -41,12 +46,13 @@ struct ranked_and_query {
             }
 
             if (i == ordered_cursors.size()) {
-                float score = 0;
+                m_counters.document();
+                typename Cursor::score_type score = 0;
                 for (i = 0; i < ordered_cursors.size(); ++i) {
                     score += ordered_cursors[i]->score();
                 }
 
-                m_topk.insert(score, ordered_cursors[0]->docid());
+                m_counters.insert(m_topk, score, ordered_cursors[0]->docid());
                 ordered_cursors[0]->next();
                 candidate = ordered_cursors[0]->docid();
                 i = 1;
@@ -54,12 +60,70 @@ struct ranked_and_query {
         }
     }
 
-    std::vector<std::pair<float, uint64_t>> const& topk() const { return m_topk.topk(); }
+    /// Conjunction over the terms of a decomposed query, rather than over its lists: a term
+    /// matches a document found in any of its tiers.
+    template <typename CursorRange>
+    void pair_aware_ranked_and(CursorRange&& cursors, uint64_t max_docid)
+    {
+        if (cursors.empty()) {
+            return;
+        }
+        auto groups = group_tiers(cursors);
+
+        // Moves the tiers of a term to `docid`, and returns the first document from there on
+        // containing the term; the shorter top tiers are tried first. Tiers left past `docid` by
+        // an earlier call stay where they are, as cursors only move forward.
+        auto next_geq = [&](auto const& group, uint64_t docid) {
+            uint64_t next = max_docid;
+            for (auto* cursor: group) {
+                if (cursor->docid() < docid) {
+                    cursor->next_geq(docid);
+                }
+                if (cursor->docid() == docid) {
+                    return docid;
+                }
+                next = std::min<uint64_t>(next, cursor->docid());
+            }
+            return next;
+        };
+
+        uint64_t candidate = next_geq(groups[0], 0);
+        size_t i = 1;
+        while (candidate < max_docid) {
+            for (; i < groups.size(); ++i) {
+                if (auto docid = next_geq(groups[i], candidate); docid != candidate) {
+                    candidate = docid;
+                    i = 0;
+                    break;
+                }
+            }
+
+            if (i == groups.size()) {
+                m_counters.document();
+                typename std::decay_t<CursorRange>::value_type::score_type score = 0;
+                for (auto& cursor: cursors) {
+                    if (cursor.docid() < candidate) {
+                        cursor.next_geq(candidate);
+                    }
+                    if (cursor.docid() == candidate) {
+                        score += cursor.score();
+                    }
+                }
+
+                m_counters.insert(m_topk, score, candidate);
+                candidate = next_geq(groups[0], candidate + 1);
+                i = 1;
+            }
+        }
+    }
+
+    std::vector<typename TopK::entry_type> const& topk() const { return m_topk.topk(); }
 
-    topk_queue& get_topk() { return m_topk; }
+    TopK& get_topk() { return m_topk; }
 
   private:
-    topk_queue& m_topk;
+    TopK& m_topk;
+    Counters m_counters;
 };
 
 }  // namespace pisa
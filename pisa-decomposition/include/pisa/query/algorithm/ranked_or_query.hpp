@@ -1,5 +1,6 @@
 #pragma once
 
+#include "query/counters.hpp"
 #include "query/queries.hpp"
 #include "topk_queue.hpp"
 #include <string>
@@ -7,8 +8,11 @@
 
 namespace pisa {
 
+template <typename TopK = topk_queue, typename Counters = NoCounters>
 struct ranked_or_query {
-    explicit ranked_or_query(topk_queue& topk) : m_topk(topk) {}
+    explicit ranked_or_query(TopK& topk, Counters counters = {})
+        : m_topk(topk), m_counters(counters)
+    {}
 
     template <typename CursorRange>
     void operator()(CursorRange&& cursors, uint64_t max_docid)
@@ -23,7 +27,8 @@ struct ranked_or_query {
             })->docid();
 
         while (cur_doc < max_docid) {
-            float score = 0;
+            m_counters.document();
+            typename Cursor::score_type score = 0;
             uint64_t next_doc = max_docid;
             for (size_t i = 0; i < cursors.size(); ++i) {
                 if (cursors[i].docid() == cur_doc) {
@@ -35,15 +40,16 @@ struct ranked_or_query {
                 }
             }
 
-            m_topk.insert(score, cur_doc);
+            m_counters.insert(m_topk, score, cur_doc);
             cur_doc = next_doc;
         }
     }
 
-    std::vector<std::pair<float, uint64_t>> const& topk() const { return m_topk.topk(); }
+    std::vector<typename TopK::entry_type> const& topk() const { return m_topk.topk(); }
 
   private:
-    topk_queue& m_topk;
+    TopK& m_topk;
+    Counters m_counters;
 };
 
 }  // namespace pisa
@@ -1,18 +1,25 @@
 #pragma once
 
+#include "query/counters.hpp"
 #include "query/queries.hpp"
 #include "topk_queue.hpp"
 #include "util/intrinsics.hpp"
 
+#include "accumulator/lazy_accumulator.hpp"
 #include "accumulator/simple_accumulator.hpp"
+#include "cursor/tier_groups.hpp"
+#include "cursor/tier_upper_bound.hpp"
 
 #include "topk_queue.hpp"
 
 namespace pisa {
 
+template <typename TopK = topk_queue, typename Counters = NoCounters>
 class ranked_or_taat_query {
   public:
-    explicit ranked_or_taat_query(topk_queue& topk) : m_topk(topk) {}
+    explicit ranked_or_taat_query(TopK& topk, Counters counters = {})
+        : m_topk(topk), m_counters(counters)
+    {}
 
     template <typename CursorRange, typename Acc>
     void operator()(CursorRange&& cursors, uint64_t max_docid, Acc&& accumulator)
@@ -32,10 +39,96 @@ class ranked_or_taat_query {
         accumulator.aggregate(m_topk);
     }
 
-    std::vector<std::pair<float, uint64_t>> const& topk() const { return m_topk.topk(); }
+    /// TAAT over the tier lists of a decomposed index.
+    ///
+    /// The top tier of every term is accumulated in full. The k-th largest block max score of
+    /// the accumulator then bounds the k-th score from below, and the other tiers are processed
+    /// by decreasing max score, skipping the postings of blocks that cannot reach it even with
+    /// the remaining tiers, and stopping once no block can.
+    template <typename CursorRange, int counter_bit_size, typename Descriptor>
+    void pair_aware_taat(
+        CursorRange&& cursors,
+        uint64_t max_docid,
+        Lazy_Accumulator<counter_bit_size, Descriptor>& accumulator)
+    {
+        using Cursor = typename std::decay_t<CursorRange>::value_type;
+        constexpr auto block_size = Lazy_Accumulator<counter_bit_size, Descriptor>::counters_in_descriptor;
+        if (cursors.empty()) {
+            return;
+        }
+        accumulator.init();
+
+        auto accumulate = [&](Cursor& cursor) {
+            while (cursor.docid() < max_docid) {
+                accumulator.accumulate(cursor.docid(), cursor.score());
+                cursor.next();
+            }
+        };
+
+        std::vector<Cursor*> lower_tiers;
+        for (auto& group: group_tiers(cursors)) {
+            auto top = std::max_element(group.begin(), group.end(), [](Cursor* lhs, Cursor* rhs) {
+                return lhs->max_score() < rhs->max_score();
+            });
+            accumulate(**top);
+            group.erase(top);
+            lower_tiers.insert(lower_tiers.end(), group.begin(), group.end());
+        }
+        std::sort(lower_tiers.begin(), lower_tiers.end(), [](Cursor* lhs, Cursor* rhs) {
+            return lhs->max_score() > rhs->max_score();
+        });
+
+        // remaining_bounds[i] bounds what the tiers from i on add to the score of a document
+        TierUpperBound<typename Cursor::score_type> bound(TierUpperBound<>::groups(cursors));
+        std::vector<float> remaining_bounds(lower_tiers.size());
+        for (size_t i = lower_tiers.size(); i > 0; --i) {
+            bound.add(*lower_tiers[i - 1]);
+            remaining_bounds[i - 1] = bound.value();
+        }
+
+        auto block_max_scores = accumulator.block_max_scores();
+        float threshold = kth_block_max_score(block_max_scores, m_topk.capacity());
+        float max_block_score = *std::max_element(block_max_scores.begin(), block_max_scores.end());
+
+        for (size_t i = 0; i < lower_tiers.size(); ++i) {
+            auto& cursor = *lower_tiers[i];
+            auto remaining = remaining_bounds[i];
+            if (max_block_score + remaining <= threshold) {
+                break;
+            }
+            if (remaining > threshold) {
+                // Documents yet to be scored may still enter the top k
+                while (cursor.docid() < max_docid) {
+                    auto docid = cursor.docid();
+                    accumulator.accumulate(docid, cursor.score());
+                    auto& block_max = block_max_scores[docid / block_size];
+                    block_max = std::max(block_max, accumulator.score(docid));
+                    max_block_score = std::max(max_block_score, block_max);
+                    cursor.next();
+                }
+            } else {
+                while (cursor.docid() < max_docid) {
+                    auto docid = cursor.docid();
+                    auto& block_max = block_max_scores[docid / block_size];
+                    if (block_max + remaining > threshold) {
+                        accumulator.accumulate(docid, cursor.score());
+                        block_max = std::max(block_max, accumulator.score(docid));
+                        max_block_score = std::max(max_block_score, block_max);
+                    } else {
+                        m_counters.block_max_skip();
+                    }
+                    cursor.next();
+                }
+            }
+        }
+        accumulator.aggregate(m_topk);
+    }
+
+    std::vector<typename TopK::entry_type> const& topk() const { return m_topk.topk(); }
 
   private:
-    topk_queue& m_topk;
+    TopK& m_topk;
+    Counters m_counters;
 };
 
 };  // namespace pisa
@@ -0,0 +1,191 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <limits>
+#include <vector>
+
+#include "accumulator/lazy_accumulator.hpp"
+#include "cursor/tier_upper_bound.hpp"
+#include "query/budget.hpp"
+#include "query/counters.hpp"
+#include "query/queries.hpp"
+#include "topk_queue.hpp"
+
+namespace pisa {
+
+/// The terms of `query` that have no list in `impact_index`, to be processed in docid order.
+template <typename ImpactIndex>
+[[nodiscard]] auto docid_ordered_query(ImpactIndex const& impact_index, Query query) -> Query
+{
+    query.terms.erase(
+        std::remove_if(
+            query.terms.begin(),
+            query.terms.end(),
+            [&](auto term) { return term < impact_index.size() && !impact_index[term].empty(); }),
+        query.terms.end());
+    query.is_high.clear();
+    return query;
+}
+
+/// Score-at-a-time processing of an `impact_ordered_index` (Lin and Trotman, ICTIR '15).
+///
+/// The segments of all query terms are processed in decreasing order of weighted impact, so
+/// that the documents most likely to make the top k are scored first, until a budget runs out.
+template <typename TopK = topk_queue, typename Counters = NoCounters>
+class saat_query {
+  public:
+    explicit saat_query(TopK& topk, Counters counters = {})
+        : m_topk(topk), m_counters(counters)
+    {}
+
+    /// Returns whether all segments were processed within `budget`, i.e., if results are exact.
+    template <typename ImpactIndex, int counter_bit_size, typename Descriptor>
+    auto operator()(
+        ImpactIndex const& impact_index,
+        Query const& query,
+        Lazy_Accumulator<counter_bit_size, Descriptor>& accumulator,
+        QueryBudget budget = {}) -> bool
+    {
+        accumulator.init();
+        bool exhaustive = accumulate_segments(impact_index, query, accumulator, budget) == 0.0F;
+        accumulator.aggregate(m_topk);
+        return exhaustive;
+    }
+
+    /// Processes the lists of `query` held by `impact_index` score-at-a-time, and then the other
+    /// lists, given as `cursors`, in docid order.
+    ///
+    /// Once the impact-ordered lists are accumulated, the `k`-th largest block max score of the
+    /// accumulator bounds the `k`-th score from below, and the docid-ordered pass jumps over the
+    /// blocks that cannot reach it even with the max scores of all `cursors`. Results are exact
+    /// if the score-at-a-time phase completes within `budget`, which is what this returns;
+    /// otherwise, the max scores of the unprocessed segments are added to the bound, but the
+    /// scores of the documents missing them are partial.
+    template <typename ImpactIndex, typename CursorRange, int counter_bit_size, typename Descriptor>
+    auto rank_safe(
+        ImpactIndex const& impact_index,
+        Query const& query,
+        CursorRange&& cursors,
+        uint64_t max_docid,
+        Lazy_Accumulator<counter_bit_size, Descriptor>& accumulator,
+        QueryBudget budget = {}) -> bool
+    {
+        constexpr auto block_size =
+            Lazy_Accumulator<counter_bit_size, Descriptor>::counters_in_descriptor;
+        accumulator.init();
+        float unprocessed = accumulate_segments(impact_index, query, accumulator, budget);
+
+        TierUpperBound<float> low_bound(TierUpperBound<>::groups(cursors));
+        for (auto const& cursor: cursors) {
+            low_bound.add(cursor.group(), cursor.max_score());
+        }
+        auto bound = low_bound.value() + unprocessed;
+        auto block_max_scores = accumulator.block_max_scores();
+        float threshold = kth_block_max_score(block_max_scores, m_topk.capacity());
+
+        auto next_docid = [&] {
+            uint64_t docid = max_docid;
+            for (auto const& cursor: cursors) {
+                docid = std::min<uint64_t>(docid, cursor.docid());
+            }
+            return docid;
+        };
+        auto block = std::numeric_limits<std::size_t>::max();
+        uint64_t docid = next_docid();
+        while (docid < max_docid) {
+            if (docid / block_size != block) {
+                block = docid / block_size;
+                // Jump over the blocks that cannot make the top k
+                while (block < block_max_scores.size()
+                       && block_max_scores[block] + bound <= threshold) {
+                    m_counters.block_max_skip();
+                    ++block;
+                }
+                if (block * block_size > docid) {
+                    for (auto& cursor: cursors) {
+                        // Only the lists at `docid` lag behind the skipped blocks
+                        if (cursor.docid() < block * block_size) {
+                            cursor.next_geq(block * block_size);
+                        }
+                    }
+                    docid = next_docid();
+                    continue;
+                }
+            }
+            m_counters.document();
+            float score = 0.0F;
+            for (auto& cursor: cursors) {
+                if (cursor.docid() == docid) {
+                    score += cursor.score();
+                    cursor.next();
+                }
+            }
+            accumulator.accumulate(docid, score);
+            docid = next_docid();
+        }
+        accumulator.aggregate(m_topk);
+        return unprocessed == 0.0F;
+    }
+
+    std::vector<typename TopK::entry_type> const& topk() const { return m_topk.topk(); }
+
+  private:
+    /// Accumulates segments by decreasing weighted impact until `budget` runs out, and returns
+    /// the largest score the unprocessed segments can add to a document.
+    template <typename ImpactIndex, typename Acc>
+    auto accumulate_segments(
+        ImpactIndex const& impact_index, Query const& query, Acc& accumulator, QueryBudget budget)
+        -> float
+    {
+        using segment_type = typename ImpactIndex::segment;
+        struct weighted_segment {
+            float score;
+            std::size_t list;
+            segment_type segment;
+        };
+
+        auto const query_term_freqs = query_freqs(query.terms);
+        std::vector<weighted_segment> segments;
+        for (std::size_t list = 0; list < query_term_freqs.size(); ++list) {
+            auto [term, weight] = query_term_freqs[list];
+            if (term >= impact_index.size()) {
+                continue;
+            }
+            for (auto const& segment: impact_index[term]) {
+                segments.push_back({static_cast<float>(weight * segment.impact()), list, segment});
+            }
+        }
+        std::stable_sort(segments.begin(), segments.end(), [](auto const& lhs, auto const& rhs) {
+            return lhs.score > rhs.score;
+        });
+
+        auto const start = std::chrono::steady_clock::now();
+        std::size_t postings = 0;
+        auto segment = segments.begin();
+        for (; segment != segments.end(); ++segment) {
+            auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - start);
+            if (budget.exhausted(postings, elapsed)) {
+                break;
+            }
+            auto score = segment->score;
+            segment->segment.for_each([&](auto docid) { accumulator.accumulate(docid, score); });
+            postings += segment->segment.size();
+            m_counters.posting(segment->segment.size());
+        }
+
+        // The first unprocessed segment of a list has its highest remaining impact
+        TierUpperBound<float> unprocessed(query_term_freqs.size());
+        for (; segment != segments.end(); ++segment) {
+            unprocessed.add(segment->list, segment->score);
+        }
+        return unprocessed.value();
+    }
+
+    TopK& m_topk;
+    Counters m_counters;
+};
+
+}  // namespace pisa
@@ -2,13 +2,18 @@
 
 #include <vector>
 
+#include "cursor/docid_ordered_cursors.hpp"
+#include "query/counters.hpp"
 #include "query/queries.hpp"
 #include "topk_queue.hpp"
 
 namespace pisa {
 
+template <typename TopK = topk_queue, typename Counters = NoCounters>
 struct wand_pair_query {
-    explicit wand_pair_query(topk_queue& topk) : m_topk(topk) {}
+    explicit wand_pair_query(TopK& topk, Counters counters = {})
+        : m_topk(topk), m_counters(counters)
+    {}
 
     template <typename CursorRange>
     void operator()(CursorRange&& cursors, uint64_t max_docid)
@@ -18,33 +23,23 @@ struct wand_pair_query {
             return;
         }
 
-        std::vector<Cursor*> ordered_cursors;
-        ordered_cursors.reserve(cursors.size());
-        for (auto& en: cursors) {
-            ordered_cursors.push_back(&en);
-        }
-
-        auto sort_enums = [&]() {
-            // sort enumerators by increasing docid
-            std::sort(ordered_cursors.begin(), ordered_cursors.end(), [](Cursor* lhs, Cursor* rhs) {
-                return lhs->docid() < rhs->docid();
-            });
-        };
+        // Only the cursors that move are re-inserted, instead of sorting all of them
+        DocidOrderedCursors<Cursor> ordered_cursors(cursors);
 
-        sort_enums();
         while (true) {
+            m_counters.pivot();
             // find pivot
-            float upper_bound = 0;
+            typename Cursor::score_type upper_bound = 0;
             size_t pivot;
             bool found_pivot = false;
             uint32_t min_high_non_considered = std::numeric_limits<uint32_t>::max();
             for (pivot = 0; pivot < ordered_cursors.size(); ++pivot) {
-                if (ordered_cursors[pivot]->docid() >= max_docid) {
+                if (ordered_cursors.docid(pivot) >= max_docid) {
                     break;
                 }
-                upper_bound += ordered_cursors[pivot]->max_score();
+                upper_bound += ordered_cursors[pivot].max_score();
                 min_high_non_considered = std::min(
-                    min_high_non_considered, ordered_cursors[pivot]->non_considered_high_docid());
+                    min_high_non_considered, ordered_cursors[pivot].non_considered_high_docid());
                 if (m_topk.would_enter(upper_bound)) {
                     found_pivot = true;
                     break;
@@ -57,66 +52,47 @@ struct wand_pair_query {
                     break;
                 } else{
                     // We didn't find a pivot, but we might still be interested in some highs
-                    for (size_t i = 0; i < ordered_cursors.size(); ++i) {
-                        if (ordered_cursors[i]->docid() < min_high_non_considered)
-                            ordered_cursors[i]->next_geq(min_high_non_considered);
-                    }
-                    sort_enums();
+                    ordered_cursors.next_geq(min_high_non_considered);
                     continue;
                 }
             }
 
             // check if pivot is a possible match
-            uint64_t pivot_id = ordered_cursors[pivot]->docid();
+            uint64_t pivot_id = ordered_cursors.docid(pivot);
 
             if (pivot_id > min_high_non_considered) {
-                // printf(
-                //     "pivot_id %lu min_high_non_considered %u\n", pivot_id,
-                //     min_high_non_considered);
-                // fflush(stdout);
-                for (size_t i = 0; i < pivot; ++i) {
-                    if (ordered_cursors[i]->docid() < min_high_non_considered)
-                        ordered_cursors[i]->next_geq(min_high_non_considered);
-                }
-                sort_enums();
+                // The cursors before min_high_non_considered all come before the pivot
+                ordered_cursors.next_geq(min_high_non_considered);
                 continue;
             }
 
-            if (pivot_id == ordered_cursors[0]->docid()) {
-                float score = 0;
-                for (Cursor* en: ordered_cursors) {
-                    if (en->docid() != pivot_id) {
+            if (pivot_id == ordered_cursors.docid(0)) {
+                m_counters.document();
+                typename Cursor::score_type score = 0;
+                for (size_t i = 0; i < ordered_cursors.size(); ++i) {
+                    if (ordered_cursors.docid(i) != pivot_id) {
                         break;
                     }
-                    score += en->score();
-                    en->next();
+                    score += ordered_cursors[i].score();
                 }
 
-                m_topk.insert(score, pivot_id);
-                // resort by docid
-                sort_enums();
+                m_counters.insert(m_topk, score, pivot_id);
+                ordered_cursors.next(pivot_id);
             } else {
                 // no match, move farthest list up to the pivot
                 uint64_t next_list = pivot;
-                for (; ordered_cursors[next_list]->docid() == pivot_id; --next_list) {
-                }
-                ordered_cursors[next_list]->next_geq(pivot_id);
-                // // bubble down the advanced list
-                for (size_t i = next_list + 1; i < ordered_cursors.size(); ++i) {
-                    if (ordered_cursors[i]->docid() < ordered_cursors[i - 1]->docid()) {
-                        std::swap(ordered_cursors[i], ordered_cursors[i - 1]);
-                    } else {
-                        break;
-                    }
+                for (; ordered_cursors.docid(next_list) == pivot_id; --next_list) {
                 }
+                ordered_cursors.next_geq(next_list, pivot_id);
             }
         }
     }
 
-    std::vector<std::pair<float, uint64_t>> const& topk() const { return m_topk.topk(); }
+    std::vector<typename TopK::entry_type> const& topk() const { return m_topk.topk(); }
 
   private:
-    topk_queue& m_topk;
+    TopK& m_topk;
+    Counters m_counters;
 };
 
 }  // namespace pisa
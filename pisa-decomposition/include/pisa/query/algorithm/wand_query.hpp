@@ -2,13 +2,19 @@
 
 #include <vector>
 
+#include "cursor/docid_ordered_cursors.hpp"
+#include "cursor/tier_upper_bound.hpp"
+#include "query/counters.hpp"
 #include "query/queries.hpp"
 #include "topk_queue.hpp"
 
 namespace pisa {
 
+template <typename TopK = topk_queue, typename Counters = NoCounters>
 struct wand_query {
-    explicit wand_query(topk_queue& topk) : m_topk(topk) {}
+    explicit wand_query(TopK& topk, Counters counters = {})
+        : m_topk(topk), m_counters(counters)
+    {}
 
     template <typename CursorRange>
     void operator()(CursorRange&& cursors, uint64_t max_docid, bool prime = false)
@@ -27,14 +33,14 @@ struct wand_query {
         if (prime) {
             // There *has to be* at least k docs with a score > initial_threshold based on our
             // precomputation
-            float initial_threshold = 0.0f;
+            float initial_threshold = m_topk.threshold();
             size_t top_k_value = m_topk.capacity();
             //std::cerr << "k = " << top_k_value << "\n";
             for (size_t i = 0; i < ordered_cursors.size(); ++i) {
                 initial_threshold = std::max(initial_threshold, ordered_cursors[i]->safe_threshold(top_k_value));
             }
             //std::cerr << "init = " << initial_threshold << "\n";
-            m_topk.set_threshold(initial_threshold);
+            m_counters.set_threshold(m_topk, initial_threshold);
         }
 
         auto sort_enums = [&]() {
@@ -46,8 +52,9 @@ struct wand_query {
 
         sort_enums();
         while (true) {
+            m_counters.pivot();
             // find pivot
-            float upper_bound = 0;
+            typename Cursor::score_type upper_bound = 0;
             size_t pivot;
             bool found_pivot = false;
             for (pivot = 0; pivot < ordered_cursors.size(); ++pivot) {
@@ -69,7 +76,8 @@ struct wand_query {
             // check if pivot is a possible match
             uint64_t pivot_id = ordered_cursors[pivot]->docid();
             if (pivot_id == ordered_cursors[0]->docid()) {
-                float score = 0;
+                m_counters.document();
+                typename Cursor::score_type score = 0;
                 for (Cursor* en: ordered_cursors) {
                     if (en->docid() != pivot_id) {
                         break;
@@ -78,7 +86,7 @@ struct wand_query {
                     en->next();
                 }
 
-                m_topk.insert(score, pivot_id);
+                m_counters.insert(m_topk, score, pivot_id);
                 // resort by docid
                 sort_enums();
             } else {
@@ -107,68 +115,40 @@ struct wand_query {
             return;
         }
 
-
-        std::vector<Cursor*> ordered_cursors;
-        ordered_cursors.reserve(cursors.size());
-        size_t max_id = 0;
-        for (auto& en: cursors) {
-            ordered_cursors.push_back(&en);
-            max_id = std::max(max_id, en.list_id());
-        }
-        max_id += 1;
-
         if (prime) {
             // There *has to be* at least k docs with a score > initial_threshold based on our
             // precomputation
-            float initial_threshold = 0.0f;
+            float initial_threshold = m_topk.threshold();
             size_t top_k_value = m_topk.capacity();
-            //std::cerr << "k = " << top_k_value << "\n";
-            for (size_t i = 0; i < ordered_cursors.size(); ++i) {
-                initial_threshold = std::max(initial_threshold, ordered_cursors[i]->safe_threshold(top_k_value));
+            for (auto const& cursor: cursors) {
+                initial_threshold = std::max(initial_threshold, cursor.safe_threshold(top_k_value));
             }
-            //std::cerr << "init = " << initial_threshold << "\n";
-            m_topk.set_threshold(initial_threshold);
+            m_counters.set_threshold(m_topk, initial_threshold);
         }
 
-        auto sort_enums = [&]() {
-            // sort enumerators by increasing docid
-            std::sort(ordered_cursors.begin(), ordered_cursors.end(), [](Cursor* lhs, Cursor* rhs) {
-                return lhs->docid() < rhs->docid();
-            });
-        };
+        // Only the cursors that move are re-inserted, instead of sorting all of them
+        DocidOrderedCursors<Cursor> ordered_cursors(cursors);
 
-        sort_enums();
-
-        bit_vec_64 seen_term;
+        TierUpperBound<typename Cursor::score_type> upper_bound(TierUpperBound<>::groups(cursors));
 
         while (true) {
+            m_counters.pivot();
             // find pivot
-            float upper_bound = 0;
             size_t pivot;
             bool found_pivot = false;
 
-            seen_term.clear();
+            upper_bound.clear();
 
-            // Pivoting is aware of paired lists; removes redundant contributions on the fly
+            // Pivoting is aware of the tiers of each term; a term only contributes the
+            // highest bound among its tiers seen so far
             for (pivot = 0; pivot < ordered_cursors.size(); ++pivot) {
-                if (ordered_cursors[pivot]->docid() >= max_docid) {
+                if (ordered_cursors.docid(pivot) >= max_docid) {
                     break;
                 }
 
-                // We have seen this term already, so we have used its bound in the UB sum
-                // If the list we already saw was the "HIGH" list, then we don't want to add anything new
-                // If the list we already saw was the "LOW" list, we want to remove that UB and instate the "HIGH" one
-                // Both of these conditions == "remove the LOW UB"
-                // So, let's add the current bound first
-                upper_bound += ordered_cursors[pivot]->max_score();
-                
-                if (seen_term[ordered_cursors[pivot]->list_id()]) {
-                    upper_bound -= ordered_cursors[pivot]->low_max_score();
-                } else {
-                    seen_term.set(ordered_cursors[pivot]->list_id(), true);
-                }
+                upper_bound.add(ordered_cursors[pivot]);
 
-                if (m_topk.would_enter(upper_bound)) {
+                if (m_topk.would_enter(upper_bound.value())) {
                     found_pivot = true;
                     break;
                 }
@@ -180,44 +160,34 @@ struct wand_query {
             }
 
             // check if pivot is a possible match
-            uint64_t pivot_id = ordered_cursors[pivot]->docid();
-            if (pivot_id == ordered_cursors[0]->docid()) {
-                float score = 0;
-                for (Cursor* en: ordered_cursors) {
-                    if (en->docid() != pivot_id) {
+            uint64_t pivot_id = ordered_cursors.docid(pivot);
+            if (pivot_id == ordered_cursors.docid(0)) {
+                m_counters.document();
+                typename Cursor::score_type score = 0;
+                for (size_t i = 0; i < ordered_cursors.size(); ++i) {
+                    if (ordered_cursors.docid(i) != pivot_id) {
                         break;
                     }
-                    score += en->score();
-                    en->next();
+                    score += ordered_cursors[i].score();
                 }
 
-                m_topk.insert(score, pivot_id);
-                // resort by docid
-                sort_enums();
+                m_counters.insert(m_topk, score, pivot_id);
+                ordered_cursors.next(pivot_id);
             } else {
-
                 // no match, move farthest list up to the pivot
                 uint64_t next_list = pivot;
-                for (; ordered_cursors[next_list]->docid() == pivot_id; --next_list) {
-                }
-                ordered_cursors[next_list]->next_geq(pivot_id);
-                // bubble down the advanced list
-                for (size_t i = next_list + 1; i < ordered_cursors.size(); ++i) {
-                    if (ordered_cursors[i]->docid() < ordered_cursors[i - 1]->docid()) {
-                        std::swap(ordered_cursors[i], ordered_cursors[i - 1]);
-                    } else {
-                        break;
-                    }
+                for (; ordered_cursors.docid(next_list) == pivot_id; --next_list) {
                 }
+                ordered_cursors.next_geq(next_list, pivot_id);
             }
         }
     }
 
-
-    std::vector<std::pair<float, uint64_t>> const& topk() const { return m_topk.topk(); }
+    std::vector<typename TopK::entry_type> const& topk() const { return m_topk.topk(); }
 
   private:
-    topk_queue& m_topk;
+    TopK& m_topk;
+    Counters m_counters;
 };
 
 }  // namespace pisa
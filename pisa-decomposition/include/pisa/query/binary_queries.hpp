@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "mappable/mappable_vector.hpp"
+#include "memory_source.hpp"
+#include "query/queries.hpp"
+
+namespace pisa {
+
+/// A query log compiled into flat arrays, which can be memory-mapped and read back without
+/// any parsing.
+///
+/// Every query keeps its id, its list ids, which of them are top tiers, and its term groups,
+/// exactly as produced by `parse_query_terms` or `parse_query_ids`. The file is written in
+/// native byte order.
+class BinaryQueries {
+  public:
+    /// Stored first in the file so that compiled queries can be told apart from text ones.
+    static constexpr std::uint64_t magic = 0x3159525141534950;  // "PISAQRY1"
+
+    BinaryQueries() = default;
+    explicit BinaryQueries(MemorySource source);
+    explicit BinaryQueries(std::vector<Query> const& queries);
+
+    /// Whether `filename` holds compiled queries rather than text.
+    [[nodiscard]] static auto is_binary(std::string const& filename) -> bool;
+
+    [[nodiscard]] auto size() const -> std::size_t { return m_flags.size(); }
+    [[nodiscard]] auto operator[](std::size_t query) const -> Query;
+    [[nodiscard]] auto queries() const -> std::vector<Query>;
+
+    template <typename Visitor>
+    void map(Visitor& visit)
+    {
+        visit(m_magic, "m_magic")(m_flags, "m_flags")(m_id_offsets, "m_id_offsets")(
+            m_ids, "m_ids")(m_term_offsets, "m_term_offsets")(m_terms, "m_terms")(
+            m_is_high, "m_is_high")(m_group_offsets, "m_group_offsets")(
+            m_group_weights, "m_group_weights")(m_tier_offsets, "m_tier_offsets")(
+            m_tiers, "m_tiers");
+    }
+
+  private:
+    enum Flags : std::uint8_t { HasId = 1, HasTiers = 2 };
+
+    std::uint64_t m_magic = magic;
+    mapper::mappable_vector<std::uint8_t> m_flags;
+    mapper::mappable_vector<std::uint64_t> m_id_offsets;
+    mapper::mappable_vector<char> m_ids;
+    mapper::mappable_vector<std::uint64_t> m_term_offsets;
+    mapper::mappable_vector<term_id_type> m_terms;
+    mapper::mappable_vector<std::uint8_t> m_is_high;
+    mapper::mappable_vector<std::uint64_t> m_group_offsets;
+    mapper::mappable_vector<std::uint64_t> m_group_weights;
+    mapper::mappable_vector<std::uint64_t> m_tier_offsets;
+    mapper::mappable_vector<term_id_type> m_tiers;
+    MemorySource m_source;
+};
+
+}  // namespace pisa
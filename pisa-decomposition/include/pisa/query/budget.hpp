@@ -0,0 +1,25 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <limits>
+
+namespace pisa {
+
+/// Work allowed to an anytime query algorithm, unlimited by default.
+///
+/// Budgets are checked between units of work, such as impact segments or docid ranges, so the
+/// last unit processed can overshoot them.
+struct QueryBudget {
+    std::size_t postings = std::numeric_limits<std::size_t>::max();
+    std::chrono::microseconds time = std::chrono::microseconds::max();
+
+    /// Whether processing `processed` postings in `elapsed` time exhausts the budget.
+    [[nodiscard]] auto exhausted(std::size_t processed, std::chrono::microseconds elapsed) const
+        noexcept -> bool
+    {
+        return processed >= postings || elapsed >= time;
+    }
+};
+
+}  // namespace pisa
@@ -0,0 +1,243 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "query/cursor_trace.hpp"
+#include "topk_queue.hpp"
+#include "util/compiler_attribute.hpp"
+
+namespace pisa {
+
+/// Work done by a query algorithm on one query, as counted by `WorkCounters`.
+struct QueryWork {
+    /// Candidate documents whose score was computed, fully or until it could not make the top k.
+    std::size_t documents = 0;
+    /// Postings scored.
+    std::size_t postings = 0;
+    /// Calls to `next_geq` on the cursors.
+    std::size_t next_geqs = 0;
+    /// Posting blocks the cursors moved into, of `posting_block_size` postings.
+    std::size_t blocks = 0;
+    /// Candidates or blocks skipped because their block max scores could not make the top k.
+    std::size_t block_max_skips = 0;
+    /// Pivot selections of WAND-like algorithms.
+    std::size_t pivots = 0;
+    /// Documents inserted in the top k.
+    std::size_t inserts = 0;
+    /// The top-k threshold every time it changes, with the number of documents evaluated then.
+    std::vector<std::pair<std::size_t, float>> thresholds;
+    /// Whether counted cursors record the calls they receive in `cursor_traces`.
+    bool trace_cursors = false;
+    std::vector<CursorTrace> cursor_traces;
+
+    /// Postings per block of the block codecs, which all use the same size.
+    static constexpr std::size_t posting_block_size = 128;
+
+    /// Clears the work, but keeps tracing cursors if it does.
+    void clear()
+    {
+        bool trace = trace_cursors;
+        *this = QueryWork{};
+        trace_cursors = trace;
+    }
+};
+
+/// Counting policy of query algorithms, which compiles to nothing.
+///
+/// Algorithms take a counting policy as a template parameter, defaulting to this one, and report
+/// their work to it; cursors report theirs once wrapped by `counted_cursors`.
+struct NoCounters {
+    static constexpr bool enabled = false;
+
+    PISA_ALWAYSINLINE void document() const noexcept {}
+    PISA_ALWAYSINLINE void posting(std::size_t = 1) const noexcept {}
+    PISA_ALWAYSINLINE void next_geq() const noexcept {}
+    PISA_ALWAYSINLINE void block() const noexcept {}
+    PISA_ALWAYSINLINE void block_max_skip() const noexcept {}
+    PISA_ALWAYSINLINE void pivot() const noexcept {}
+
+    /// Opens the trace of a cursor on the list of a term, if known, returning its id.
+    [[nodiscard]] auto open_trace(std::optional<std::uint32_t>) const noexcept -> std::size_t
+    {
+        return 0;
+    }
+    /// Records a call received by the cursor of trace `id`.
+    PISA_ALWAYSINLINE void trace(std::size_t, CursorOp, std::uint64_t) const noexcept {}
+
+    /// Inserts a document in `topk`.
+    template <typename TopK, typename Score, typename DocId>
+    PISA_ALWAYSINLINE auto insert(TopK& topk, Score score, DocId docid) const -> bool
+    {
+        return topk.insert(score, docid);
+    }
+
+    /// Sets the threshold of `topk`, e.g., when priming it.
+    template <typename TopK>
+    PISA_ALWAYSINLINE void set_threshold(TopK& topk, Threshold threshold) const
+    {
+        topk.set_threshold(threshold);
+    }
+};
+
+/// Counting policy recording the work of query algorithms in a `QueryWork`.
+class WorkCounters {
+  public:
+    static constexpr bool enabled = true;
+
+    explicit WorkCounters(QueryWork& work) : m_work(&work) {}
+
+    PISA_ALWAYSINLINE void document() noexcept { m_work->documents += 1; }
+    PISA_ALWAYSINLINE void posting(std::size_t count = 1) noexcept { m_work->postings += count; }
+    PISA_ALWAYSINLINE void next_geq() noexcept { m_work->next_geqs += 1; }
+    PISA_ALWAYSINLINE void block() noexcept { m_work->blocks += 1; }
+    PISA_ALWAYSINLINE void block_max_skip() noexcept { m_work->block_max_skips += 1; }
+    PISA_ALWAYSINLINE void pivot() noexcept { m_work->pivots += 1; }
+
+    [[nodiscard]] auto open_trace(std::optional<std::uint32_t> term) -> std::size_t
+    {
+        if (not m_work->trace_cursors || not term) {
+            return no_trace;
+        }
+        m_work->cursor_traces.push_back(CursorTrace{*term, {}});
+        return m_work->cursor_traces.size() - 1;
+    }
+
+    PISA_ALWAYSINLINE void trace(std::size_t id, CursorOp op, std::uint64_t docid)
+    {
+        if (id != no_trace) {
+            m_work->cursor_traces[id].calls.push_back({op, static_cast<std::uint32_t>(docid)});
+        }
+    }
+
+    template <typename TopK, typename Score, typename DocId>
+    PISA_ALWAYSINLINE auto insert(TopK& topk, Score score, DocId docid) -> bool
+    {
+        if (not topk.insert(score, docid)) {
+            return false;
+        }
+        m_work->inserts += 1;
+        record_threshold(topk.threshold());
+        return true;
+    }
+
+    template <typename TopK>
+    PISA_ALWAYSINLINE void set_threshold(TopK& topk, Threshold threshold)
+    {
+        topk.set_threshold(threshold);
+        record_threshold(topk.threshold());
+    }
+
+  private:
+    static constexpr std::size_t no_trace = std::numeric_limits<std::size_t>::max();
+
+    void record_threshold(float threshold)
+    {
+        auto& thresholds = m_work->thresholds;
+        if (thresholds.empty() || thresholds.back().second != threshold) {
+            thresholds.emplace_back(m_work->documents, threshold);
+        }
+    }
+
+    QueryWork* m_work;
+};
+
+/// A cursor reporting the postings it scores, its `next_geq` calls and the posting blocks it
+/// moves into to a counting policy, as well as the calls it receives if the policy traces them
+/// and the cursor is over the list of a known `term`.
+///
+/// Blocks are counted from `position()`, by cursors that have it.
+template <typename Cursor, typename Counters>
+class CountedCursor : public Cursor {
+  public:
+    CountedCursor(Cursor cursor, Counters counters, std::optional<std::uint32_t> term)
+        : Cursor(std::move(cursor)), m_counters(counters), m_trace(m_counters.open_trace(term))
+    {}
+
+    [[nodiscard]] PISA_ALWAYSINLINE auto score()
+    {
+        m_counters.posting();
+        return Cursor::score();
+    }
+
+    PISA_ALWAYSINLINE void next()
+    {
+        m_counters.trace(m_trace, CursorOp::Next, 0);
+        auto block = this->block();
+        Cursor::next();
+        count_block(block);
+    }
+
+    PISA_ALWAYSINLINE void next_geq(std::uint64_t docid)
+    {
+        m_counters.next_geq();
+        m_counters.trace(m_trace, CursorOp::NextGeq, docid);
+        auto block = this->block();
+        Cursor::next_geq(docid);
+        count_block(block);
+    }
+
+    template <typename C = Cursor, typename = decltype(std::declval<C&>().block_max_next_geq(0))>
+    PISA_ALWAYSINLINE void block_max_next_geq(std::uint32_t docid)
+    {
+        m_counters.trace(m_trace, CursorOp::BlockMaxNextGeq, docid);
+        Cursor::block_max_next_geq(docid);
+    }
+
+  private:
+    template <typename C, typename = void>
+    struct has_position : std::false_type {};
+    template <typename C>
+    struct has_position<C, std::void_t<decltype(std::declval<C const&>().position())>>
+        : std::true_type {};
+    [[nodiscard]] PISA_ALWAYSINLINE auto block() const -> std::size_t
+    {
+        if constexpr (has_position<Cursor>::value) {
+            return Cursor::position() / QueryWork::posting_block_size;
+        } else {
+            return 0;
+        }
+    }
+
+    PISA_ALWAYSINLINE void count_block(std::size_t previous)
+    {
+        if (block() != previous) {
+            m_counters.block();
+        }
+    }
+
+    Counters m_counters;
+    std::size_t m_trace;
+};
+
+/// Wraps `cursors` so that they report their work to `counters`, unless it counts nothing.
+///
+/// `terms` are the terms of the lists of the cursors, in order, e.g., `query_lists(query)` for
+/// cursors over single lists; cursors are only traced if they are given.
+template <typename Cursors, typename Counters>
+[[nodiscard]] auto
+counted_cursors(Cursors cursors, Counters counters, std::vector<std::uint32_t> const& terms = {})
+{
+    if constexpr (not Counters::enabled) {
+        return cursors;
+    } else {
+        using Cursor = typename Cursors::value_type;
+        std::vector<CountedCursor<Cursor, Counters>> counted;
+        counted.reserve(cursors.size());
+        for (std::size_t pos = 0; pos < cursors.size(); ++pos) {
+            std::optional<std::uint32_t> term;
+            if (pos < terms.size()) {
+                term = terms[pos];
+            }
+            counted.emplace_back(std::move(cursors[pos]), counters, term);
+        }
+        return counted;
+    }
+}
+
+}  // namespace pisa
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace pisa {
+
+/// Cursor methods recorded in a `CursorTrace`.
+enum class CursorOp : std::uint8_t { Next, NextGeq, BlockMaxNextGeq };
+
+/// A call received by a cursor; `docid` is the argument of `next_geq` calls.
+struct CursorCall {
+    CursorOp op;
+    std::uint32_t docid;
+};
+
+/// Calls received by the cursor of the list of `term` during one query, in order.
+struct CursorTrace {
+    std::uint32_t term = 0;
+    std::vector<CursorCall> calls;
+};
+
+/// A trace of a known list, as read back by `read_cursor_traces`.
+struct ListTrace {
+    std::uint32_t term;
+    /// Class of the list in a decomposed index: `high`, `low`, or `-` if the query tells none.
+    std::string list_class;
+    std::vector<CursorCall> calls;
+};
+
+/// Writes the calls received by the list of `term` during query `qid` as a line of
+///
+///     <query type> TAB <qid> TAB <term> TAB <list class> TAB <calls>
+///
+/// where calls are separated by spaces: `n<count>` for `count` consecutive `next()`,
+/// `g<docid>` for `next_geq(docid)` and `b<docid>` for `block_max_next_geq(docid)`.
+void write_cursor_trace(
+    std::ostream& os,
+    std::string const& query_type,
+    std::string const& qid,
+    std::uint32_t term,
+    std::string const& list_class,
+    std::vector<CursorCall> const& calls);
+
+/// Reads the lines written by `write_cursor_trace`.
+[[nodiscard]] auto read_cursor_traces(std::istream& is) -> std::vector<ListTrace>;
+
+}  // namespace pisa
@@ -17,30 +17,47 @@ using term_freq_pair = std::pair<term_id_type, uint64_t>;
 using high_low_pair = std::pair<term_id_type, term_id_type>;
 using term_freq_vec = std::vector<term_freq_pair>;
 
-using high_low_tuple = std::tuple<term_id_type, term_id_type, uint64_t, uint64_t>;
-using term_pair_freq_vec = std::vector<high_low_tuple>;
+/// Lists of a single query term in a decomposed index, ordered from the top tier down.
+///
+/// `weight` is the number of times the term occurs in the query, and `id` is unique
+/// within the query, so that cursors can tell which lists belong to the same term.
+struct TermGroup {
+    std::vector<term_id_type> tiers;
+    uint64_t weight;
+    uint64_t id;
+};
 
 struct Query {
     std::optional<std::string> id;
     std::vector<term_id_type> terms;
     std::vector<float> term_weights;
     std::vector<bool> is_high;
-    std::vector<high_low_tuple> paired_terms;
+    std::vector<TermGroup> term_groups;
 };
 
 [[nodiscard]] auto split_query_at_colon(std::string const& query_string)
     -> std::pair<std::optional<std::string>, std::string_view>;
 
+/// Parses a query of decorated tier lists, grouping the tiers of each term; throws
+/// `std::invalid_argument` on a list of the index without a tier suffix.
 [[nodiscard]] auto parse_query_terms(std::string const& query_string, TermProcessor term_processor)
     -> Query;
 
+/// Parses a query of undecorated terms, expanding each of them to all its tier lists.
+[[nodiscard]] auto
+parse_undecorated_query(std::string const& query_string, TierTermProcessor const& term_processor)
+    -> Query;
+
 [[nodiscard]] auto parse_query_ids(std::string const& query_string) -> Query;
 
+/// Returns a function parsing a query line into `queries`: undecorated terms if
+/// `tier_lexicon_file` is given, decorated list names if `terms_file` is given, and ids otherwise.
 [[nodiscard]] std::function<void(const std::string)> resolve_query_parser(
     std::vector<Query>& queries,
     std::optional<std::string> const& terms_file,
     std::optional<std::string> const& stopwords_filename,
-    std::optional<std::string> const& stemmer_type);
+    std::optional<std::string> const& stemmer_type,
+    std::optional<std::string> const& tier_lexicon_file = std::nullopt);
 
 bool read_query(term_id_vec& ret, std::istream& is = std::cin);
 
@@ -48,8 +65,14 @@ void remove_duplicate_terms(term_id_vec& terms);
 
 term_freq_vec query_freqs(term_id_vec terms);
 
+/// The distinct lists of `query` in increasing order, which is the order of the cursors over
+/// single lists made for it.
+[[nodiscard]] auto query_lists(Query const& query) -> term_id_vec;
+
+/// The terms of a query flagged as top tier lists in `Query::is_high`.
 [[nodiscard]] auto get_high_query(Query) -> Query;
 
+/// The other terms of a query; terms without a flag are low.
 [[nodiscard]] auto get_low_query(Query) -> Query;
 
 }  // namespace pisa
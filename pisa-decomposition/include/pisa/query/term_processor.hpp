@@ -7,6 +7,7 @@
 #include "io.hpp"
 #include "memory_source.hpp"
 #include "payload_vector.hpp"
+#include "tier_lexicon.hpp"
 
 namespace pisa {
 
@@ -61,4 +62,41 @@ class TermProcessor {
     }
 };
 
+/// Resolves undecorated query terms to all their tier lists with a `TierLexicon`.
+///
+/// Term ids, including those of stopwords, are positions of base terms in the lexicon.
+class TierTermProcessor {
+  private:
+    std::shared_ptr<TierLexicon> m_lexicon;
+    std::unordered_set<term_id_type> m_stopwords;
+    Stemmer_t m_stem;
+
+  public:
+    TierTermProcessor(
+        std::string const& tier_lexicon_file,
+        std::optional<std::string> const& stopwords_filename,
+        std::optional<std::string> const& stemmer_type)
+        : m_lexicon(std::make_shared<TierLexicon>(MemorySource::mapped_file(tier_lexicon_file))),
+          m_stem(term_processor_builder(stemmer_type)())
+    {
+        if (stopwords_filename) {
+            std::ifstream is(*stopwords_filename);
+            io::for_each_line(is, [&](auto&& word) {
+                if (auto term = (*this)(std::move(word)); term.has_value()) {
+                    m_stopwords.insert(*term);
+                }
+            });
+        }
+    }
+
+    std::optional<term_id_type> operator()(std::string token) const
+    {
+        return m_lexicon->find(m_stem(std::move(token)));
+    }
+
+    bool is_stopword(term_id_type term) const { return m_stopwords.find(term) != m_stopwords.end(); }
+
+    [[nodiscard]] auto lexicon() const -> TierLexicon const& { return *m_lexicon; }
+};
+
 }  // namespace pisa
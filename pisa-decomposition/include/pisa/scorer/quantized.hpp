@@ -6,6 +6,8 @@
 #include <utility>
 
 #include "index_scorer.hpp"
+#include "util/compiler_attribute.hpp"
+
 namespace pisa {
 
 template <typename Wand>
@@ -18,4 +20,59 @@ struct quantized: public index_scorer<Wand> {
     }
 };
 
+/// Term scorer of `quantized` with the query weight folded in.
+///
+/// Scores are integer products, and this plain function object is inlined into the query
+/// algorithms where a `TermScorer` costs an indirect call per posting.
+struct QuantizedTermScorer {
+    std::uint32_t weight = 1;
+
+    [[nodiscard]] PISA_ALWAYSINLINE auto operator()(uint32_t /* doc */, uint32_t freq) const -> float
+    {
+        return static_cast<float>(weight * freq);
+    }
+};
+
+/// Same as `quantized`, but known at compile time, so that cursors hold `QuantizedTermScorer`s.
+struct static_quantized {
+    [[nodiscard]] auto term_scorer(uint64_t /* term_id */) const -> QuantizedTermScorer
+    {
+        return {};
+    }
+};
+
+[[nodiscard]] inline auto
+weighted_term_scorer(static_quantized const& /* scorer */, uint32_t /* term */, uint64_t weight)
+    -> QuantizedTermScorer
+{
+    return {static_cast<std::uint32_t>(weight)};
+}
+
+/// Same as `QuantizedTermScorer`, but yields integer scores, to be accumulated without
+/// conversions and collected in an `int_topk_queue`.
+struct IntegerQuantizedTermScorer {
+    std::uint32_t weight = 1;
+
+    [[nodiscard]] PISA_ALWAYSINLINE auto operator()(uint32_t /* doc */, uint32_t freq) const
+        -> std::uint32_t
+    {
+        return weight * freq;
+    }
+};
+
+/// Same as `static_quantized`, but with integer scores.
+struct integer_quantized {
+    [[nodiscard]] auto term_scorer(uint64_t /* term_id */) const -> IntegerQuantizedTermScorer
+    {
+        return {};
+    }
+};
+
+[[nodiscard]] inline auto
+weighted_term_scorer(integer_quantized const& /* scorer */, uint32_t /* term */, uint64_t weight)
+    -> IntegerQuantizedTermScorer
+{
+    return {static_cast<std::uint32_t>(weight)};
+}
+
 }  // namespace pisa
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+#include "topk_queue.hpp"
+#include "util/compiler_attribute.hpp"
+
+namespace pisa {
+
+/// A top-k threshold shared by concurrent tasks of a query, which only increases.
+template <typename Score>
+class SharedThreshold {
+  public:
+    explicit SharedThreshold(Score threshold = 0) : m_threshold(threshold) {}
+
+    [[nodiscard]] PISA_ALWAYSINLINE auto load() const noexcept -> Score
+    {
+        return m_threshold.load(std::memory_order_relaxed);
+    }
+
+    /// Raises the threshold to `threshold` unless it is already higher.
+    void raise(Score threshold) noexcept
+    {
+        auto current = load();
+        while (threshold > current
+               && not m_threshold.compare_exchange_weak(
+                   current, threshold, std::memory_order_relaxed)) {
+        }
+    }
+
+  private:
+    std::atomic<Score> m_threshold;
+};
+
+/// Top-k queue of one task of a parallel query, which also prunes with a shared threshold.
+///
+/// Once its queue is full, a task publishes its threshold, which k documents of the query
+/// exceed, so that every task skips the documents that cannot make the top k of the query.
+/// Thresholds set on the queue, e.g., when priming, are published as well.
+template <typename TopK = topk_queue>
+class shared_topk_queue {
+  public:
+    using score_type = typename TopK::score_type;
+    using docid_type = typename TopK::docid_type;
+    using entry_type = typename TopK::entry_type;
+
+    shared_topk_queue(std::size_t k, SharedThreshold<score_type>& shared)
+        : m_topk(k), m_shared(shared)
+    {}
+
+    [[nodiscard]] PISA_ALWAYSINLINE auto would_enter(score_type score) const -> bool
+    {
+        return m_topk.would_enter(score) && score > m_shared.load();
+    }
+
+    bool insert(score_type score) { return insert(score, 0); }
+
+    bool insert(score_type score, docid_type docid)
+    {
+        if (not would_enter(score)) {
+            return false;
+        }
+        m_topk.insert(score, docid);
+        if (m_topk.size() == m_topk.capacity()) {
+            m_shared.raise(m_topk.threshold());
+        }
+        return true;
+    }
+
+    void set_threshold(Threshold t) noexcept
+    {
+        m_topk.set_threshold(t);
+        m_shared.raise(m_topk.threshold());
+    }
+
+    [[nodiscard]] auto threshold() const noexcept -> score_type
+    {
+        return std::max(m_topk.threshold(), m_shared.load());
+    }
+
+    void finalize() { m_topk.finalize(); }
+    void clear() noexcept { m_topk.clear(); }
+    [[nodiscard]] auto topk() const noexcept -> std::vector<entry_type> const&
+    {
+        return m_topk.topk();
+    }
+    [[nodiscard]] auto capacity() const noexcept -> std::size_t { return m_topk.capacity(); }
+    [[nodiscard]] auto size() const noexcept -> std::size_t { return m_topk.size(); }
+
+  private:
+    TopK m_topk;
+    SharedThreshold<score_type>& m_shared;
+};
+
+}  // namespace pisa
@@ -0,0 +1,291 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <numeric>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "spdlog/spdlog.h"
+#include "tbb/parallel_for.h"
+
+#include "compute_splits.hpp"
+#include "cursor/tier_upper_bound.hpp"
+#include "decompose.hpp"
+
+namespace pisa::decompose {
+
+/// Number of postings of a list for each impact value.
+using ImpactCounts = std::vector<std::uint64_t>;
+
+/// A candidate decomposition of a single list, described by the shape of the lists it yields.
+///
+/// A list that is not decomposed is represented by an empty HIGH list and a LOW list
+/// equal to the original one.
+struct SplitCandidate {
+    std::uint64_t split = no_split;
+    std::uint64_t high_length = 0;
+    std::uint64_t low_length = 0;
+    float high_max_score = 0;
+    float low_max_score = 0;
+    /// Postings stored on top of those of the original list.
+    std::uint64_t extra_postings = 0;
+};
+
+/// Enumerates candidate splits of a list with the given impact counts: no split at all,
+/// and the impacts found at positions `len / 2^j` in decreasing impact order.
+[[nodiscard]] inline auto split_candidates(
+    ImpactCounts const& counts, DecompositionMode mode, std::size_t min_length)
+    -> std::vector<SplitCandidate>
+{
+    auto length = std::accumulate(counts.begin(), counts.end(), std::uint64_t(0));
+    auto max_impact = static_cast<std::uint64_t>(counts.size()) - 1;
+    std::vector<SplitCandidate> candidates;
+    candidates.push_back(SplitCandidate{no_split, 0, length, 0, static_cast<float>(max_impact), 0});
+    if (length == 0 || length < min_length) {
+        return candidates;
+    }
+
+    // `above[i]` is the number of postings with impact strictly greater than `i`.
+    std::vector<std::uint64_t> above(counts.size(), 0);
+    for (auto impact = max_impact; impact > 0; --impact) {
+        above[impact - 1] = above[impact] + counts[impact];
+    }
+    std::uint64_t previous_split = no_split;
+    for (std::uint64_t rank = length / 2; rank > 0; rank /= 2) {
+        // Smallest impact `split` such that fewer than `rank` postings are above it.
+        auto split = static_cast<std::uint64_t>(std::distance(
+            above.begin(),
+            std::find_if(above.begin(), above.end(), [&](auto count) { return count < rank; })));
+        if (split == previous_split || above[split] == 0) {
+            continue;
+        }
+        previous_split = split;
+        SplitCandidate candidate;
+        candidate.split = split;
+        candidate.high_length = above[split];
+        if (mode == DecompositionMode::Split) {
+            std::uint64_t low_max = split;
+            while (low_max > 0 && counts[low_max] == 0) {
+                --low_max;
+            }
+            candidate.low_length = length - candidate.high_length;
+            candidate.high_max_score = static_cast<float>(max_impact);
+            candidate.low_max_score = static_cast<float>(low_max);
+        } else {
+            candidate.low_length = length;
+            candidate.high_max_score = static_cast<float>(max_impact - split);
+            candidate.low_max_score = static_cast<float>(split);
+            candidate.extra_postings = candidate.high_length;
+        }
+        candidates.push_back(candidate);
+    }
+    return candidates;
+}
+
+/// A training query: its final top-k threshold on the original index and its weighted terms,
+/// given as indices into the list of modeled terms.
+struct ModeledQuery {
+    float threshold = 0;
+    std::vector<std::pair<std::uint32_t, float>> terms;
+};
+
+/// Models the cost of processing queries over a decomposed index as the number of postings
+/// in the essential lists of the algorithm run on it, given the final top-k threshold of each
+/// query.
+///
+/// Split indexes are modeled for `pair_aware_maxscore`: lists are sorted by length, and the
+/// longest ones are non-essential while the bound of their terms, the largest of the HIGH and
+/// LOW max scores of each term as in `TierUpperBound`, does not exceed the threshold. Clipped
+/// indexes, where a document may be in both lists of a term, are modeled for `maxscore`, with
+/// every list adding its max score. This is the number of postings that the work counters of
+/// `maxscore_query` count (see `QueryWork`), minus the lookups in non-essential lists; it
+/// assumes impact scores (the `quantized` scorer).
+class SplitCostModel {
+  public:
+    SplitCostModel(
+        std::vector<std::vector<SplitCandidate>> candidates,
+        std::vector<ModeledQuery> queries,
+        DecompositionMode mode)
+        : m_candidates(std::move(candidates)),
+          m_queries(std::move(queries)),
+          m_mode(mode),
+          m_choices(m_candidates.size(), 0),
+          m_term_queries(m_candidates.size())
+    {
+        for (std::size_t query = 0; query < m_queries.size(); ++query) {
+            for (auto [term, weight]: m_queries[query].terms) {
+                m_term_queries[term].push_back(query);
+            }
+        }
+    }
+
+    [[nodiscard]] auto choices() const -> std::vector<std::size_t> const& { return m_choices; }
+
+    [[nodiscard]] auto candidate(std::uint32_t term) const -> SplitCandidate const&
+    {
+        return m_candidates[term][m_choices[term]];
+    }
+
+    [[nodiscard]] auto total_cost() const -> std::uint64_t
+    {
+        std::uint64_t cost = 0;
+        for (std::size_t query = 0; query < m_queries.size(); ++query) {
+            cost += query_cost(query, no_term, 0);
+        }
+        return cost;
+    }
+
+    [[nodiscard]] auto extra_postings() const -> std::uint64_t
+    {
+        std::uint64_t postings = 0;
+        for (std::uint32_t term = 0; term < m_candidates.size(); ++term) {
+            postings += candidate(term).extra_postings;
+        }
+        return postings;
+    }
+
+    /// Greedily picks the split of each term to minimize the modeled cost, without exceeding
+    /// `budget` extra postings in total.
+    ///
+    /// Each pass finds the best move of every term given the current choices of the others,
+    /// then applies moves by decreasing cost reduction per extra posting while they still
+    /// improve the cost and fit in the budget. Stops after `passes` or when nothing changes.
+    void optimize(std::uint64_t budget, std::size_t passes)
+    {
+        struct Move {
+            std::uint32_t term;
+            std::size_t choice;
+            std::int64_t gain;
+            std::int64_t space;
+        };
+        auto used = static_cast<std::int64_t>(extra_postings());
+        for (std::size_t pass = 0; pass < passes; ++pass) {
+            std::vector<Move> moves(m_candidates.size(), Move{0, 0, 0, 0});
+            tbb::parallel_for(std::uint32_t(0), std::uint32_t(m_candidates.size()), [&](auto term) {
+                moves[term] = Move{term, m_choices[term], 0, 0};
+                for (std::size_t choice = 0; choice < m_candidates[term].size(); ++choice) {
+                    if (auto gain = this->gain(term, choice); gain > moves[term].gain) {
+                        moves[term] = Move{term, choice, gain, space(term, choice)};
+                    }
+                }
+            });
+            moves.erase(
+                std::remove_if(
+                    moves.begin(), moves.end(), [](auto const& move) { return move.gain <= 0; }),
+                moves.end());
+            auto efficiency = [](Move const& move) {
+                return static_cast<double>(move.gain) / std::max<std::int64_t>(move.space, 1);
+            };
+            std::sort(moves.begin(), moves.end(), [&](auto const& lhs, auto const& rhs) {
+                return efficiency(lhs) > efficiency(rhs);
+            });
+            std::size_t applied = 0;
+            for (auto const& move: moves) {
+                auto space = this->space(move.term, move.choice);
+                if (used + space > static_cast<std::int64_t>(budget)) {
+                    continue;
+                }
+                // Earlier moves in this pass may have changed the gain.
+                if (gain(move.term, move.choice) <= 0) {
+                    continue;
+                }
+                m_choices[move.term] = move.choice;
+                used += space;
+                applied += 1;
+            }
+            spdlog::info(
+                "Pass {}: {} moves applied, cost: {}, extra postings: {}",
+                pass + 1,
+                applied,
+                total_cost(),
+                used);
+            if (applied == 0) {
+                break;
+            }
+        }
+    }
+
+  private:
+    static constexpr std::uint32_t no_term = std::numeric_limits<std::uint32_t>::max();
+
+    /// Cost of `query` if `term` used candidate `choice` instead of its current one.
+    [[nodiscard]] auto
+    query_cost(std::size_t query, std::uint32_t term, std::size_t choice) const -> std::uint64_t
+    {
+        struct List {
+            float max_score;
+            std::uint64_t length;
+            std::size_t group;
+        };
+        auto const& modeled = m_queries[query];
+        std::vector<List> lists;
+        for (std::size_t group = 0; group < modeled.terms.size(); ++group) {
+            auto [query_term, weight] = modeled.terms[group];
+            auto const& candidate = m_candidates[query_term]
+                                                [query_term == term ? choice
+                                                                    : m_choices[query_term]];
+            if (candidate.high_length > 0) {
+                lists.push_back({weight * candidate.high_max_score, candidate.high_length, group});
+            }
+            if (candidate.low_length > 0) {
+                lists.push_back({weight * candidate.low_max_score, candidate.low_length, group});
+            }
+        }
+        std::uint64_t cost = 0;
+        if (m_mode == DecompositionMode::Split) {
+            std::sort(lists.begin(), lists.end(), [](auto const& lhs, auto const& rhs) {
+                return lhs.length < rhs.length;
+            });
+            TierUpperBound<float> bound(modeled.terms.size());
+            auto essential = lists.rbegin();
+            for (; essential != lists.rend(); ++essential) {
+                bound.add(essential->group, essential->max_score);
+                if (bound.value() > modeled.threshold) {
+                    break;
+                }
+            }
+            for (; essential != lists.rend(); ++essential) {
+                cost += essential->length;
+            }
+            return cost;
+        }
+        std::sort(lists.begin(), lists.end(), [](auto const& lhs, auto const& rhs) {
+            return lhs.max_score < rhs.max_score;
+        });
+        float bound = 0;
+        for (auto const& list: lists) {
+            bound += list.max_score;
+            if (bound > modeled.threshold) {
+                cost += list.length;
+            }
+        }
+        return cost;
+    }
+
+    [[nodiscard]] auto gain(std::uint32_t term, std::size_t choice) const -> std::int64_t
+    {
+        std::int64_t gain = 0;
+        for (auto query: m_term_queries[term]) {
+            gain += static_cast<std::int64_t>(query_cost(query, term, m_choices[term]))
+                - static_cast<std::int64_t>(query_cost(query, term, choice));
+        }
+        return gain;
+    }
+
+    [[nodiscard]] auto space(std::uint32_t term, std::size_t choice) const -> std::int64_t
+    {
+        return static_cast<std::int64_t>(m_candidates[term][choice].extra_postings)
+            - static_cast<std::int64_t>(candidate(term).extra_postings);
+    }
+
+    std::vector<std::vector<SplitCandidate>> m_candidates;
+    std::vector<ModeledQuery> m_queries;
+    DecompositionMode m_mode;
+    std::vector<std::size_t> m_choices;
+    std::vector<std::vector<std::size_t>> m_term_queries;
+};
+
+}  // namespace pisa::decompose
@@ -0,0 +1,173 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "fmt/format.h"
+#include "spdlog/spdlog.h"
+
+#include "mappable/mappable_vector.hpp"
+#include "mappable/mapper.hpp"
+#include "memory_source.hpp"
+#include "tiers.hpp"
+
+namespace pisa {
+
+/// How a posting list is decomposed into impact tiers, given decreasing split points
+/// `s_0 > s_1 > ... > s_{n-2}` for `n` tiers (a single split point yields HIGH and LOW).
+///
+/// - `Split` partitions the postings: tier `t` holds the impacts in `(s_t, s_{t-1}]`,
+///   so the top tier gets everything above `s_0` and the bottom tier the rest.
+/// - `Clip` slices every impact: tier `t` holds the part of the impact that lies in
+///   `(s_t, s_{t-1}]`, so the bottom tier covers the entire original list and the impacts
+///   of a posting across all tiers sum up to the original one.
+enum class DecompositionMode { Split, Clip };
+
+[[nodiscard]] inline auto parse_decomposition_mode(std::string const& name) -> DecompositionMode
+{
+    if (name == "split") {
+        return DecompositionMode::Split;
+    }
+    if (name == "clip") {
+        return DecompositionMode::Clip;
+    }
+    throw std::invalid_argument(fmt::format("Unknown decomposition mode: {}", name));
+}
+
+/// Whether the query algorithm `name` can run on an index decomposed in `mode`.
+///
+/// The pair-aware and paired algorithms bound a term by the largest max score of its tiers,
+/// and the `*_prime` ones start from thresholds that count the postings of its tiers as
+/// distinct documents: both assume that the tiers partition the postings, as in split mode.
+[[nodiscard]] inline auto supports_decomposition(std::string_view name, DecompositionMode mode)
+    -> bool
+{
+    constexpr std::string_view prime_suffix = "_prime";
+    bool primed = name.size() > prime_suffix.size()
+        && name.substr(name.size() - prime_suffix.size()) == prime_suffix;
+    return mode == DecompositionMode::Split
+        || not(primed || name.find("pair") != std::string_view::npos);
+}
+
+/// Per-list metadata of a decomposed index, linking the tier lists of each term.
+///
+/// Everything a cursor needs to know about the other tiers of its term is stored in flat
+/// arrays indexed by list, so that building the cursors of a query requires no lookup
+/// structure. Lists of an index that is not decomposed form single-tier terms.
+class TierData {
+  public:
+    TierData() = default;
+    explicit TierData(MemorySource source) : m_source(std::move(source))
+    {
+        mapper::map(*this, m_source.data(), mapper::map_flags::warmup);
+    }
+
+    /// Links the lists named in `lexicon` (see `decompose::parse_tier_names`) of an index
+    /// decomposed in `mode`, with lengths and max scores taken from `wdata`.
+    template <typename WandType>
+    TierData(std::vector<std::string> const& lexicon, WandType const& wdata, DecompositionMode mode)
+        : m_mode(mode)
+    {
+        std::vector<std::uint32_t> top_tier(lexicon.size());
+        std::vector<std::uint32_t> next_tier(lexicon.size());
+        std::vector<std::uint64_t> primed_length(lexicon.size(), 0);
+        std::vector<float> primed_max_score(lexicon.size(), 0.0F);
+
+        std::unordered_map<std::string_view, std::vector<std::pair<std::uint32_t, std::uint32_t>>>
+            terms;
+        auto names = decompose::parse_tier_names(lexicon);
+        for (std::uint32_t list = 0; list < lexicon.size(); ++list) {
+            top_tier[list] = list;
+            next_tier[list] = list;
+            if (auto const& name = names[list]; name) {
+                terms[name->base].emplace_back(name->tier, list);
+            }
+        }
+        std::size_t decomposed = 0;
+        for (auto& [base, tiers]: terms) {
+            std::sort(tiers.begin(), tiers.end());
+            std::uint64_t length = 0;
+            for (std::size_t tier = 0; tier < tiers.size(); ++tier) {
+                auto list = tiers[tier].second;
+                top_tier[list] = tiers.front().second;
+                // Clipped tiers are nested: the documents of a tier are in all tiers below it.
+                if (mode == DecompositionMode::Split) {
+                    length += wdata.term_posting_count(list);
+                } else {
+                    length = wdata.term_posting_count(list);
+                }
+                if (tier + 1 < tiers.size()) {
+                    auto next = tiers[tier + 1].second;
+                    next_tier[list] = next;
+                    primed_length[list] = length;
+                    primed_max_score[list] = wdata.max_term_weight(next);
+                }
+            }
+            if (tiers.size() > 1) {
+                decomposed += 1;
+            }
+        }
+        spdlog::info("Linked tiers of {} decomposed terms", decomposed);
+
+        m_top_tier.steal(top_tier);
+        m_next_tier.steal(next_tier);
+        m_primed_length.steal(primed_length);
+        m_primed_max_score.steal(primed_max_score);
+    }
+
+    [[nodiscard]] auto size() const -> std::size_t { return m_top_tier.size(); }
+
+    [[nodiscard]] auto mode() const -> DecompositionMode { return m_mode; }
+
+    /// The top tier list of the term of `list`, which is `list` itself for the top tier.
+    [[nodiscard]] auto top_tier(std::uint64_t list) const -> std::uint32_t
+    {
+        return m_top_tier[list];
+    }
+
+    /// The list right below `list` among the tiers of its term, or `list` for the bottom tier.
+    [[nodiscard]] auto next_tier(std::uint64_t list) const -> std::uint32_t
+    {
+        return m_next_tier[list];
+    }
+
+    /// Number of documents in `list` and the tiers above it, all of which score more than
+    /// `primed_max_score(list)` over `list` and the tiers below it; zero for the bottom tier.
+    ///
+    /// These are the postings of all these tiers in split mode, and those of `list` in clip
+    /// mode, where each of its documents has a full slice of its impact in the tier below.
+    [[nodiscard]] auto primed_length(std::uint64_t list) const -> std::uint64_t
+    {
+        return m_primed_length[list];
+    }
+
+    /// Max score of the list right below `list` (before query weighting).
+    [[nodiscard]] auto primed_max_score(std::uint64_t list) const -> float
+    {
+        return m_primed_max_score[list];
+    }
+
+    template <typename Visitor>
+    void map(Visitor& visit)
+    {
+        visit(m_top_tier, "m_top_tier")(m_next_tier, "m_next_tier")(
+            m_primed_length, "m_primed_length")(m_primed_max_score, "m_primed_max_score")(
+            m_mode, "m_mode");
+    }
+
+  private:
+    mapper::mappable_vector<std::uint32_t> m_top_tier;
+    mapper::mappable_vector<std::uint32_t> m_next_tier;
+    mapper::mappable_vector<std::uint64_t> m_primed_length;
+    mapper::mappable_vector<float> m_primed_max_score;
+    DecompositionMode m_mode = DecompositionMode::Split;
+    MemorySource m_source;
+};
+
+}  // namespace pisa
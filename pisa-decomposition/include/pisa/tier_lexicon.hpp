@@ -0,0 +1,121 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <map>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "gsl/span"
+#include "spdlog/spdlog.h"
+
+#include "mappable/mappable_vector.hpp"
+#include "mappable/mapper.hpp"
+#include "memory_source.hpp"
+#include "payload_vector.hpp"
+#include "tiers.hpp"
+
+namespace pisa {
+
+/// Lexicon of a decomposed index mapping each base term to all of its tier lists at once.
+///
+/// A single lookup of an undecorated term yields the ids of its lists, from the top tier down,
+/// instead of one lookup per decorated name. Lists whose names have no tier suffix are terms
+/// of their own.
+class TierLexicon {
+  public:
+    TierLexicon() = default;
+    explicit TierLexicon(MemorySource source) : m_source(std::move(source))
+    {
+        mapper::map(*this, m_source.data(), mapper::map_flags::warmup);
+    }
+
+    /// Groups the lists named in `lexicon`, the i-th name being that of list i.
+    explicit TierLexicon(std::vector<std::string> const& lexicon)
+    {
+        std::map<std::string_view, std::vector<std::pair<std::uint32_t, std::uint32_t>>> terms;
+        auto names = decompose::parse_tier_names(lexicon);
+        for (std::uint32_t list = 0; list < lexicon.size(); ++list) {
+            if (auto const& name = names[list]; name) {
+                terms[name->base].emplace_back(name->tier, list);
+            } else {
+                terms[lexicon[list]].emplace_back(0, list);
+            }
+        }
+
+        std::vector<detail::size_type> term_offsets{0};
+        std::vector<std::byte> term_chars;
+        std::vector<std::uint64_t> list_offsets{0};
+        std::vector<std::uint32_t> lists;
+        std::vector<std::uint32_t> tiers;
+        for (auto& [base, term_lists]: terms) {
+            std::sort(term_lists.begin(), term_lists.end());
+            std::transform(base.begin(), base.end(), std::back_inserter(term_chars), [](auto ch) {
+                return static_cast<std::byte>(ch);
+            });
+            term_offsets.push_back(term_chars.size());
+            for (auto [tier, list]: term_lists) {
+                tiers.push_back(tier);
+                lists.push_back(list);
+            }
+            list_offsets.push_back(lists.size());
+        }
+        spdlog::info("Grouped {} lists into {} terms", lexicon.size(), terms.size());
+
+        m_term_offsets.steal(term_offsets);
+        m_list_offsets.steal(list_offsets);
+        m_lists.steal(lists);
+        m_tiers.steal(tiers);
+        m_term_chars.steal(term_chars);
+    }
+
+    /// Number of base terms.
+    [[nodiscard]] auto size() const -> std::size_t { return m_list_offsets.size() - 1; }
+
+    /// Position of `term` among the base terms, if present.
+    [[nodiscard]] auto find(std::string_view term) const -> std::optional<std::uint32_t>
+    {
+        auto terms = Payload_Vector<>(
+            gsl::make_span(m_term_offsets.data(), m_term_offsets.size()),
+            gsl::make_span(m_term_chars.data(), m_term_chars.size()));
+        if (auto pos = pisa::binary_search(terms.begin(), terms.end(), term); pos) {
+            return static_cast<std::uint32_t>(*pos);
+        }
+        return std::nullopt;
+    }
+
+    /// Lists of the `term`-th base term, from the top tier down.
+    [[nodiscard]] auto lists(std::uint32_t term) const -> gsl::span<std::uint32_t const>
+    {
+        return gsl::make_span(m_lists.data(), m_lists.size())
+            .subspan(m_list_offsets[term], m_list_offsets[term + 1] - m_list_offsets[term]);
+    }
+
+    /// Tiers of the lists of the `term`-th base term (see `decompose::parse_tier_name`).
+    [[nodiscard]] auto tiers(std::uint32_t term) const -> gsl::span<std::uint32_t const>
+    {
+        return gsl::make_span(m_tiers.data(), m_tiers.size())
+            .subspan(m_list_offsets[term], m_list_offsets[term + 1] - m_list_offsets[term]);
+    }
+
+    template <typename Visitor>
+    void map(Visitor& visit)
+    {
+        visit(m_term_offsets, "m_term_offsets")(m_list_offsets, "m_list_offsets")(
+            m_lists, "m_lists")(m_tiers, "m_tiers")(m_term_chars, "m_term_chars");
+    }
+
+  private:
+    mapper::mappable_vector<detail::size_type> m_term_offsets;
+    mapper::mappable_vector<std::uint64_t> m_list_offsets;
+    mapper::mappable_vector<std::uint32_t> m_lists;
+    mapper::mappable_vector<std::uint32_t> m_tiers;
+    mapper::mappable_vector<std::byte> m_term_chars;
+    MemorySource m_source;
+};
+
+}  // namespace pisa
@@ -0,0 +1,135 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "fmt/format.h"
+#include "gsl/span"
+
+namespace pisa::decompose {
+
+/// Names of the lists a term is decomposed into.
+///
+/// A two-tier decomposition keeps the original `_HIGH` and `_LOW` suffixes; with more tiers,
+/// list `t` (counting from the top tier) gets the suffix `_T<t>`.
+constexpr std::string_view high_suffix = "_HIGH";
+constexpr std::string_view low_suffix = "_LOW";
+constexpr std::string_view tier_prefix = "_T";
+
+/// Tier of a `_LOW` list, which is the bottom one whatever the number of tiers.
+constexpr std::uint32_t bottom_tier = std::numeric_limits<std::uint32_t>::max();
+
+[[nodiscard]] inline auto tier_suffix(std::uint32_t tier, std::uint32_t tiers) -> std::string
+{
+    if (tiers == 2) {
+        return std::string(tier == 0 ? high_suffix : low_suffix);
+    }
+    return fmt::format("{}{}", tier_prefix, tier);
+}
+
+/// A decorated list name split into its base term and its tier.
+struct TierName {
+    std::string_view base;
+    std::uint32_t tier;
+};
+
+/// Parses `<base>_HIGH`, `<base>_LOW`, or `<base>_T<t>`; `_LOW` yields `bottom_tier`.
+[[nodiscard]] inline auto parse_tier_name(std::string_view name) -> std::optional<TierName>
+{
+    auto ends_with = [&](std::string_view suffix) {
+        return name.size() > suffix.size() && name.substr(name.size() - suffix.size()) == suffix;
+    };
+    if (ends_with(high_suffix)) {
+        return TierName{name.substr(0, name.size() - high_suffix.size()), 0};
+    }
+    if (ends_with(low_suffix)) {
+        return TierName{name.substr(0, name.size() - low_suffix.size()), bottom_tier};
+    }
+    auto pos = name.rfind(tier_prefix);
+    if (pos == std::string_view::npos || pos == 0 || pos + tier_prefix.size() == name.size()) {
+        return std::nullopt;
+    }
+    std::uint32_t tier = 0;
+    for (auto digit: name.substr(pos + tier_prefix.size())) {
+        if (digit < '0' || digit > '9') {
+            return std::nullopt;
+        }
+        tier = tier * 10 + static_cast<std::uint32_t>(digit - '0');
+    }
+    return TierName{name.substr(0, pos), tier};
+}
+
+/// Parses the names of all lists of `lexicon`, the i-th name being that of list i.
+///
+/// Every list of a decomposed index carries a tier suffix, so a single undecorated name means
+/// the index is not decomposed: then no name is a tier, not even one like `covid_T19` that
+/// happens to end like one.
+[[nodiscard]] inline auto parse_tier_names(std::vector<std::string> const& lexicon)
+    -> std::vector<std::optional<TierName>>
+{
+    std::vector<std::optional<TierName>> names;
+    names.reserve(lexicon.size());
+    for (auto const& name: lexicon) {
+        names.push_back(parse_tier_name(name));
+        if (not names.back()) {
+            return std::vector<std::optional<TierName>>(lexicon.size());
+        }
+    }
+    return names;
+}
+
+/// Split points of every term of a collection decomposed into `tiers()` tiers: each term
+/// has `tiers() - 1` split points in decreasing order.
+class TierSplits {
+  public:
+    TierSplits(std::uint32_t tiers, std::vector<std::uint64_t> points)
+        : m_tiers(tiers), m_points(std::move(points))
+    {
+        if (m_tiers < 2) {
+            throw std::invalid_argument("Decomposition requires at least two tiers");
+        }
+        if (m_points.size() % (m_tiers - 1) != 0) {
+            throw std::invalid_argument(fmt::format(
+                "Number of split points ({}) is not a multiple of {}",
+                m_points.size(),
+                m_tiers - 1));
+        }
+        for (std::size_t term = 0; term < size(); ++term) {
+            auto points = (*this)[term];
+            if (not std::is_sorted(points.begin(), points.end(), std::greater<>{})) {
+                throw std::invalid_argument(
+                    fmt::format("Split points of term {} are not decreasing", term));
+            }
+        }
+    }
+
+    /// Splits of a two-tier decomposition, one per term.
+    explicit TierSplits(std::vector<std::uint64_t> points) : TierSplits(2, std::move(points))
+    {}
+
+    [[nodiscard]] auto tiers() const -> std::uint32_t { return m_tiers; }
+
+    /// Number of terms.
+    [[nodiscard]] auto size() const -> std::size_t { return m_points.size() / (m_tiers - 1); }
+
+    [[nodiscard]] auto operator[](std::size_t term) const -> gsl::span<std::uint64_t const>
+    {
+        return gsl::span<std::uint64_t const>(m_points).subspan(
+            term * (m_tiers - 1), m_tiers - 1);
+    }
+
+    [[nodiscard]] auto points() const -> std::vector<std::uint64_t> const& { return m_points; }
+
+  private:
+    std::uint32_t m_tiers;
+    std::vector<std::uint64_t> m_points;
+};
+
+}  // namespace pisa::decompose
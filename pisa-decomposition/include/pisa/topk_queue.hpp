@@ -3,19 +3,28 @@
 #include "util/likely.hpp"
 #include "util/util.hpp"
 #include <algorithm>
+#include <cstdint>
 
 namespace pisa {
 
 using Threshold = float;
-struct topk_queue {
-    using entry_type = std::pair<float, uint64_t>;
 
-    explicit topk_queue(uint64_t k) : m_threshold(0), m_k(k) { m_q.reserve(m_k + 1); }
-    topk_queue(topk_queue const&) = default;
-    topk_queue(topk_queue&&) noexcept = default;
-    topk_queue& operator=(topk_queue const&) = default;
-    topk_queue& operator=(topk_queue&&) noexcept = default;
-    ~topk_queue() = default;
+/// Min-heap of the `k` highest scoring documents.
+///
+/// With quantized scores, `Score` and `DocId` can both be 32-bit integers (see `int_topk_queue`),
+/// which halves the size of an entry and makes score comparisons exact.
+template <typename Score = float, typename DocId = uint64_t>
+struct basic_topk_queue {
+    using score_type = Score;
+    using docid_type = DocId;
+    using entry_type = std::pair<Score, DocId>;
+
+    explicit basic_topk_queue(uint64_t k) : m_threshold(0), m_k(k) { m_q.reserve(m_k + 1); }
+    basic_topk_queue(basic_topk_queue const&) = default;
+    basic_topk_queue(basic_topk_queue&&) noexcept = default;
+    basic_topk_queue& operator=(basic_topk_queue const&) = default;
+    basic_topk_queue& operator=(basic_topk_queue&&) noexcept = default;
+    ~basic_topk_queue() = default;
 
     [[nodiscard]] constexpr static auto
     min_heap_order(entry_type const& lhs, entry_type const& rhs) noexcept -> bool
@@ -23,9 +32,9 @@ struct topk_queue {
         return lhs.first > rhs.first;
     }
 
-    bool insert(float score) { return insert(score, 0); }
+    bool insert(Score score) { return insert(score, 0); }
 
-    bool insert(float score, uint64_t docid)
+    bool insert(Score score, DocId docid)
     {
         if (PISA_UNLIKELY(not would_enter(score))) {
             return false;
@@ -44,7 +53,7 @@ struct topk_queue {
         return true;
     }
 
-    bool would_enter(float score) const { return score > m_threshold; }
+    bool would_enter(Score score) const { return score > m_threshold; }
 
     void finalize()
     {
@@ -53,16 +62,17 @@ struct topk_queue {
                           m_q.begin(),
                           m_q.end(),
                           0,
-                          [](std::pair<float, uint64_t> l, float r) { return l.first > r; })
+                          [](entry_type const& l, Score r) { return l.first > r; })
             - m_q.begin();
         m_q.resize(size);
     }
 
     [[nodiscard]] std::vector<entry_type> const& topk() const noexcept { return m_q; }
 
-    void set_threshold(Threshold t) noexcept { m_threshold = t; }
+    /// Sets the score that documents must exceed; integer queues round `t` down.
+    void set_threshold(Threshold t) noexcept { m_threshold = static_cast<Score>(t); }
 
-    Threshold threshold() const noexcept { return m_threshold; }
+    Score threshold() const noexcept { return m_threshold; }
 
     void clear() noexcept
     {
@@ -75,9 +85,12 @@ struct topk_queue {
     [[nodiscard]] size_t size() const noexcept { return m_q.size(); }
 
   private:
-    float m_threshold;
+    Score m_threshold;
     uint64_t m_k;
     std::vector<entry_type> m_q;
 };
 
+using topk_queue = basic_topk_queue<>;
+using int_topk_queue = basic_topk_queue<std::uint32_t, std::uint32_t>;
+
 }  // namespace pisa
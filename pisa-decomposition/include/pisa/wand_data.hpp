@@ -1,10 +1,14 @@
 #pragma once
 
 #include <algorithm>
+#include <cmath>
+#include <functional>
 #include <numeric>
 #include <unordered_set>
+#include <vector>
 
 #include "boost/variant.hpp"
+#include "gsl/span"
 #include "spdlog/spdlog.h"
 
 #include "binary_collection.hpp"
@@ -17,6 +21,7 @@
 #include "wand_data_compressed.hpp"
 #include "wand_data_range.hpp"
 #include "wand_data_raw.hpp"
+#include "wand_utils.hpp"
 
 #include "linear_quantizer.hpp"
 #include "scorer/scorer.hpp"
@@ -24,6 +29,70 @@
 class enumerator;
 namespace pisa {
 
+/// The k-th largest scores of a list for a few ranks k, in increasing order of k.
+///
+/// A list holds distinct documents, so a query with this term has at least k documents scoring
+/// as much as its k-th score, which primes the top-k threshold safely.
+struct KthScores {
+    gsl::span<std::uint32_t const> ranks;
+    gsl::span<float const> scores;
+
+    /// Lower bound on the `k`-th largest score: that of the smallest stored rank not below `k`.
+    [[nodiscard]] auto at_least(std::size_t k) const noexcept -> float
+    {
+        auto rank = std::lower_bound(ranks.begin(), ranks.end(), k);
+        return rank == ranks.end() ? 0.0F : scores[std::distance(ranks.begin(), rank)];
+    }
+
+    /// A score that `k` documents exceed once scores are multiplied by the query `weight`.
+    [[nodiscard]] auto threshold(std::size_t k, float weight) const noexcept -> float
+    {
+        auto score = weight * at_least(k);
+        return score > 0.0F ? std::nextafter(score, 0.0F) : 0.0F;
+    }
+};
+
+/// The `ranks[i]`-th largest score of `seq` for every `i`, zero for ranks beyond its length.
+/// `ranks` must be sorted and unique.
+template <typename TermScorerT>
+[[nodiscard]] auto compute_kth_scores(
+    binary_freq_collection::sequence const& seq,
+    TermScorerT const& term_scorer,
+    std::vector<std::uint32_t> const& ranks) -> std::vector<float>
+{
+    std::vector<float> kth_scores(ranks.size(), 0.0F);
+    if (ranks.empty()) {
+        return kth_scores;
+    }
+    std::vector<float> scores;
+    scores.reserve(seq.docs.size());
+    auto freq = seq.freqs.begin();
+    for (auto doc: seq.docs) {
+        scores.push_back(term_scorer(doc, *freq++));
+    }
+    auto top = std::min<std::size_t>(ranks.back(), scores.size());
+    if (top == 0) {
+        return kth_scores;
+    }
+    auto last = std::next(scores.begin(), top);
+    std::nth_element(scores.begin(), std::prev(last), scores.end(), std::greater<>{});
+    std::sort(scores.begin(), last, std::greater<>{});
+    for (std::size_t pos = 0; pos < ranks.size() && ranks[pos] <= top; ++pos) {
+        kth_scores[pos] = scores[ranks[pos] - 1];
+    }
+    return kth_scores;
+}
+
+/// Sorts `ranks`, dropping duplicates and zeros.
+[[nodiscard]] inline auto normalize_kth_score_ranks(std::vector<std::uint32_t> ranks)
+    -> std::vector<std::uint32_t>
+{
+    std::sort(ranks.begin(), ranks.end());
+    ranks.erase(std::unique(ranks.begin(), ranks.end()), ranks.end());
+    ranks.erase(std::remove(ranks.begin(), ranks.end(), 0U), ranks.end());
+    return ranks;
+}
+
 template <typename block_wand_type = wand_data_raw>
 class wand_data {
   public:
@@ -43,79 +112,53 @@ class wand_data {
         const ScorerParams& scorer_params,
         BlockSize block_size,
         bool is_quantized,
-        std::unordered_set<size_t> const& terms_to_drop)
-        : m_num_docs(num_docs)
+        std::unordered_set<size_t> const& terms_to_drop,
+        std::vector<std::uint32_t> kth_score_ranks = default_kth_score_ranks)
     {
-        std::vector<uint32_t> doc_lens(num_docs);
-        std::vector<float> max_term_weight;
         std::vector<uint32_t> term_occurrence_counts;
         std::vector<uint32_t> term_posting_counts;
-        global_parameters params;
-        spdlog::info("Reading sizes...");
-
-        for (size_t i = 0; i < num_docs; ++i) {
-            uint32_t len = *len_it++;
-            doc_lens[i] = len;
-            m_collection_len += len;
-        }
-
-        m_avg_len = float(m_collection_len / double(num_docs));
-
-        typename block_wand_type::builder builder(coll, params);
-
         {
             pisa::progress progress("Storing terms statistics", coll.size());
             size_t term_id = 0;
             for (auto const& seq: coll) {
-                if (terms_to_drop.find(term_id) != terms_to_drop.end()) {
-                    progress.update(1);
-                    term_id += 1;
-                    continue;
+                if (terms_to_drop.find(term_id) == terms_to_drop.end()) {
+                    term_occurrence_counts.push_back(
+                        std::accumulate(seq.freqs.begin(), seq.freqs.end(), 0));
+                    term_posting_counts.push_back(seq.docs.size());
                 }
-
-                size_t term_occurrence_count = std::accumulate(seq.freqs.begin(), seq.freqs.end(), 0);
-                term_occurrence_counts.push_back(term_occurrence_count);
-                term_posting_counts.push_back(seq.docs.size());
                 term_id += 1;
                 progress.update(1);
             }
         }
-        m_doc_lens.steal(doc_lens);
-        m_term_occurrence_counts.steal(term_occurrence_counts);
-        m_term_posting_counts.steal(term_posting_counts);
 
-        auto scorer = scorer::from_params(scorer_params, *this);
+        spdlog::info("Reading sizes...");
+        stream_builder builder(
+            *this,
+            len_it,
+            num_docs,
+            coll,
+            std::move(term_occurrence_counts),
+            std::move(term_posting_counts),
+            scorer_params,
+            std::move(block_size),
+            is_quantized,
+            std::move(kth_score_ranks));
         {
             pisa::progress progress("Storing score upper bounds", coll.size());
             size_t term_id = 0;
-            size_t new_term_id = 0;
             for (auto const& seq: coll) {
-                if (terms_to_drop.find(term_id) != terms_to_drop.end()) {
-                    progress.update(1);
-                    term_id += 1;
-                    continue;
+                if (terms_to_drop.find(term_id) == terms_to_drop.end()) {
+                    builder.add_sequence(seq);
                 }
-                auto v = builder.add_sequence(
-                    seq, coll, doc_lens, m_avg_len, scorer->term_scorer(new_term_id), block_size);
-                max_term_weight.push_back(v);
-                m_index_max_term_weight = std::max(m_index_max_term_weight, v);
                 term_id += 1;
-                new_term_id += 1;
                 progress.update(1);
             }
-            if (is_quantized) {
-                LinearQuantizer quantizer(
-                    m_index_max_term_weight, configuration::get().quantization_bits);
-                for (auto&& w: max_term_weight) {
-                    w = quantizer(w);
-                }
-                builder.quantize_block_max_term_weights(m_index_max_term_weight);
-            }
         }
-        builder.build(m_block_wand);
-        m_max_term_weight.steal(max_term_weight);
+        builder.build();
     }
 
+    class stream_builder;
+
     float norm_len(uint64_t doc_id) const { return m_doc_lens[doc_id] / m_avg_len; }
 
     size_t doc_len(uint64_t doc_id) const { return m_doc_lens[doc_id]; }
@@ -131,12 +174,26 @@ class wand_data {
 
     size_t num_docs() const { return m_num_docs; }
 
+    size_t num_terms() const { return m_max_term_weight.size(); }
+
     float avg_len() const { return m_avg_len; }
 
     uint64_t collection_len() const { return m_collection_len; }
 
     float max_term_weight(uint64_t list) const { return m_max_term_weight[list]; }
 
+    /// k-th largest scores of `list`, with no ranks if the data has none.
+    [[nodiscard]] auto kth_scores(uint64_t list) const -> KthScores
+    {
+        auto ranks = m_kth_score_ranks.size();
+        if (ranks == 0) {
+            return {};
+        }
+        return {
+            gsl::span<std::uint32_t const>(m_kth_score_ranks.data(), ranks),
+            gsl::span<float const>(m_kth_scores.data() + list * ranks, ranks)};
+    }
+
     wand_data_enumerator getenum(size_t i) const
     {
         return m_block_wand.get_enum(i, index_max_term_weight());
@@ -153,7 +210,8 @@ class wand_data {
             m_term_posting_counts, "m_term_posting_counts")(m_avg_len, "m_avg_len")(
             m_collection_len, "m_collection_len")(m_num_docs, "m_num_docs")(
             m_max_term_weight, "m_max_term_weight")(
-            m_index_max_term_weight, "m_index_max_term_weight");
+            m_index_max_term_weight, "m_index_max_term_weight")(
+            m_kth_score_ranks, "m_kth_score_ranks")(m_kth_scores, "m_kth_scores");
     }
 
   private:
@@ -166,9 +224,98 @@ class wand_data {
     mapper::mappable_vector<uint32_t> m_term_occurrence_counts;
     mapper::mappable_vector<uint32_t> m_term_posting_counts;
     mapper::mappable_vector<float> m_max_term_weight;
+    mapper::mappable_vector<std::uint32_t> m_kth_score_ranks;
+    mapper::mappable_vector<float> m_kth_scores;
     MemorySource m_source;
 };
 
+/// Builds WAND data into `wdata` one posting list at a time, for lists that are read from a
+/// `binary_freq_collection` or produced on the fly, e.g., during index decomposition.
+///
+/// Term statistics must be known up front, since scorers may depend on them.
+/// `coll` is only used for its global properties, such as the number of documents.
+template <typename block_wand_type>
+class wand_data<block_wand_type>::stream_builder {
+  public:
+    template <typename LengthsIterator>
+    stream_builder(
+        wand_data& wdata,
+        LengthsIterator len_it,
+        uint64_t num_docs,
+        binary_freq_collection const& coll,
+        std::vector<uint32_t> term_occurrence_counts,
+        std::vector<uint32_t> term_posting_counts,
+        const ScorerParams& scorer_params,
+        BlockSize block_size,
+        bool is_quantized,
+        std::vector<std::uint32_t> kth_score_ranks = default_kth_score_ranks)
+        : m_wdata(wdata),
+          m_coll(coll),
+          m_block_size(std::move(block_size)),
+          m_is_quantized(is_quantized),
+          m_builder(coll, m_params),
+          m_kth_score_ranks(normalize_kth_score_ranks(std::move(kth_score_ranks)))
+    {
+        m_wdata.m_num_docs = num_docs;
+        m_doc_lens.resize(num_docs);
+        for (auto& len: m_doc_lens) {
+            len = *len_it++;
+            m_wdata.m_collection_len += len;
+        }
+        m_wdata.m_avg_len = float(m_wdata.m_collection_len / double(m_wdata.m_num_docs));
+        m_wdata.m_doc_lens.steal(m_doc_lens);
+        m_wdata.m_term_occurrence_counts.steal(term_occurrence_counts);
+        m_wdata.m_term_posting_counts.steal(term_posting_counts);
+        m_scorer = scorer::from_params(scorer_params, m_wdata);
+    }
+
+    /// Adds the next posting list and returns its maximum score.
+    float add_sequence(binary_freq_collection::sequence const& seq)
+    {
+        auto term_scorer = m_scorer->term_scorer(m_max_term_weight.size());
+        auto v = m_builder.add_sequence(
+            seq, m_coll, m_doc_lens, m_wdata.m_avg_len, term_scorer, m_block_size);
+        m_max_term_weight.push_back(v);
+        m_wdata.m_index_max_term_weight = std::max(m_wdata.m_index_max_term_weight, v);
+        auto kth_scores = compute_kth_scores(seq, term_scorer, m_kth_score_ranks);
+        m_kth_scores.insert(m_kth_scores.end(), kth_scores.begin(), kth_scores.end());
+        return v;
+    }
+
+    /// Finishes the WAND data, after the last list.
+    void build()
+    {
+        if (m_is_quantized) {
+            LinearQuantizer quantizer(
+                m_wdata.m_index_max_term_weight, configuration::get().quantization_bits);
+            for (auto&& w: m_max_term_weight) {
+                w = quantizer(w);
+            }
+            for (auto&& score: m_kth_scores) {
+                score = quantizer(score);
+            }
+            m_builder.quantize_block_max_term_weights(m_wdata.m_index_max_term_weight);
+        }
+        m_builder.build(m_wdata.m_block_wand);
+        m_wdata.m_max_term_weight.steal(m_max_term_weight);
+        m_wdata.m_kth_score_ranks.steal(m_kth_score_ranks);
+        m_wdata.m_kth_scores.steal(m_kth_scores);
+    }
+
+  private:
+    wand_data& m_wdata;
+    binary_freq_collection const& m_coll;
+    BlockSize m_block_size;
+    bool m_is_quantized;
+    global_parameters m_params{};
+    typename block_wand_type::builder m_builder;
+    std::vector<uint32_t> m_doc_lens{};
+    std::vector<float> m_max_term_weight{};
+    std::vector<std::uint32_t> m_kth_score_ranks{};
+    std::vector<float> m_kth_scores{};
+    std::unique_ptr<index_scorer<wand_data<block_wand_type>>> m_scorer{};
+};
+
 inline void create_wand_data(
     std::string const& output,
     std::string const& input_basename,
@@ -177,7 +324,8 @@ inline void create_wand_data(
     bool range,
     bool compress,
     bool quantize,
-    std::unordered_set<size_t> const& dropped_term_ids)
+    std::unordered_set<size_t> const& dropped_term_ids,
+    std::vector<std::uint32_t> const& kth_score_ranks = default_kth_score_ranks)
 {
     spdlog::info("Dropping {} terms", dropped_term_ids.size());
     binary_collection sizes_coll((input_basename + ".sizes").c_str());
@@ -191,7 +339,8 @@ inline void create_wand_data(
             scorer_params,
             block_size,
             quantize,
-            dropped_term_ids);
+            dropped_term_ids,
+            kth_score_ranks);
         mapper::freeze(wdata, output.c_str());
     } else if (range) {
         wand_data<wand_data_range<128, 1024>> wdata(
@@ -201,7 +350,8 @@ inline void create_wand_data(
             scorer_params,
             block_size,
             quantize,
-            dropped_term_ids);
+            dropped_term_ids,
+            kth_score_ranks);
         mapper::freeze(wdata, output.c_str());
     } else {
         wand_data<wand_data_raw> wdata(
@@ -211,7 +361,8 @@ inline void create_wand_data(
             scorer_params,
             block_size,
             quantize,
-            dropped_term_ids);
+            dropped_term_ids,
+            kth_score_ranks);
         mapper::freeze(wdata, output.c_str());
     }
 }
@@ -20,6 +20,9 @@ struct VariableBlock {
 
 using BlockSize = boost::variant<FixedBlock, VariableBlock>;
 
+/// Ranks for which `create_wand_data` stores the k-th largest score of every list by default.
+inline std::vector<std::uint32_t> const default_kth_score_ranks{10, 100, 1000};
+
 template <typename Scorer>
 std::pair<std::vector<uint32_t>, std::vector<float>> static_block_partition(
     binary_freq_collection::sequence const& seq, Scorer scorer, const uint64_t block_size)
@@ -0,0 +1,174 @@
+#include "perf_counters.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+
+#include <fmt/format.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace pisa {
+
+auto perf_event_name(PerfEvent event) -> char const*
+{
+    switch (event) {
+    case PerfEvent::Cycles: return "cycles";
+    case PerfEvent::Instructions: return "instructions";
+    case PerfEvent::BranchMisses: return "branch_misses";
+    case PerfEvent::LlcMisses: return "llc_misses";
+    }
+    return "unknown";
+}
+
+#ifdef __linux__
+
+namespace {
+
+    [[nodiscard]] auto event_config(PerfEvent event) -> std::uint64_t
+    {
+        switch (event) {
+        case PerfEvent::Cycles: return PERF_COUNT_HW_CPU_CYCLES;
+        case PerfEvent::Instructions: return PERF_COUNT_HW_INSTRUCTIONS;
+        case PerfEvent::BranchMisses: return PERF_COUNT_HW_BRANCH_MISSES;
+        // Generic cache misses are last-level cache misses on common CPUs.
+        case PerfEvent::LlcMisses: return PERF_COUNT_HW_CACHE_MISSES;
+        }
+        return PERF_COUNT_HW_CPU_CYCLES;
+    }
+
+    /// Opens a user-space counter of `event` for the calling thread, in the group of `leader`
+    /// or leading a new, disabled group if it is -1.
+    [[nodiscard]] auto open_event(PerfEvent event, int leader) -> int
+    {
+        perf_event_attr attr{};
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = event_config(event);
+        attr.disabled = leader == -1 ? 1 : 0;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format =
+            PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, leader, 0));
+    }
+
+    [[nodiscard]] auto paranoid_level() -> std::string
+    {
+        std::ifstream in("/proc/sys/kernel/perf_event_paranoid");
+        std::string level;
+        if (not(in >> level)) {
+            return "unknown";
+        }
+        return level;
+    }
+
+}  // namespace
+
+PerfCounters::PerfCounters()
+{
+    for (auto event: perf_events) {
+        int fd = open_event(event, m_fds.empty() ? -1 : m_fds.front());
+        if (fd != -1) {
+            m_fds.push_back(fd);
+            m_events.push_back(event);
+        } else if (m_fds.empty()) {
+            // Without cycles, nothing else is worth counting.
+            int error = errno;
+            m_error = fmt::format("perf_event_open failed: {}", std::strerror(error));
+            if (error == EACCES || error == EPERM) {
+                m_error += fmt::format(
+                    " (perf_event_paranoid is {}, counting requires at most 2)",
+                    paranoid_level());
+            }
+            return;
+        }
+    }
+}
+
+PerfCounters::~PerfCounters()
+{
+    for (auto fd: m_fds) {
+        close(fd);
+    }
+}
+
+void PerfCounters::start() noexcept
+{
+    if (available()) {
+        ioctl(m_fds.front(), PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(m_fds.front(), PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    }
+}
+
+auto PerfCounters::stop() noexcept -> PerfSample
+{
+    PerfSample sample;
+    if (not available()) {
+        return sample;
+    }
+    ioctl(m_fds.front(), PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+
+    // Layout of a group read: nr, time_enabled, time_running, then the nr values.
+    std::array<std::uint64_t, 3 + perf_events.size()> buffer{};
+    auto bytes = (3 + m_fds.size()) * sizeof(std::uint64_t);
+    if (read(m_fds.front(), buffer.data(), bytes) != static_cast<ssize_t>(bytes)) {
+        return sample;
+    }
+    auto const enabled = buffer[1];
+    auto const running = buffer[2];
+    double scale = running > 0 && running < enabled ? double(enabled) / running : 1.0;
+    for (std::size_t idx = 0; idx < m_events.size(); ++idx) {
+        sample.counts[static_cast<std::size_t>(m_events[idx])] = buffer[3 + idx] * scale;
+    }
+    return sample;
+}
+
+#else
+
+PerfCounters::PerfCounters() : m_error("hardware counters require Linux") {}
+
+PerfCounters::~PerfCounters() = default;
+
+void PerfCounters::start() noexcept {}
+
+auto PerfCounters::stop() noexcept -> PerfSample
+{
+    return {};
+}
+
+#endif
+
+auto PerfCounters::this_thread() -> PerfCounters&
+{
+    thread_local PerfCounters counters;
+    return counters;
+}
+
+auto PerfCounters::counts(PerfEvent event) const noexcept -> bool
+{
+    return std::find(m_events.begin(), m_events.end(), event) != m_events.end();
+}
+
+auto format_perf_sample(PerfCounters const& perf, PerfSample const& sample, double count)
+    -> std::string
+{
+    std::string formatted;
+    for (auto event: perf_events) {
+        if (perf.counts(event)) {
+            if (not formatted.empty()) {
+                formatted += ", ";
+            }
+            formatted += fmt::format("{:.3f} {}", sample[event] / count, perf_event_name(event));
+        }
+    }
+    return formatted;
+}
+
+}  // namespace pisa
@@ -0,0 +1,113 @@
+#include "query/binary_queries.hpp"
+
+#include <array>
+#include <fstream>
+#include <stdexcept>
+
+#include <fmt/format.h>
+
+#include "mappable/mapper.hpp"
+
+namespace pisa {
+
+BinaryQueries::BinaryQueries(MemorySource source) : m_source(std::move(source))
+{
+    if (m_source.size() < 2 * sizeof(std::uint64_t)) {
+        throw std::invalid_argument("Compiled query file is too short");
+    }
+    mapper::map(*this, m_source.data(), mapper::map_flags::warmup);
+    if (m_magic != magic) {
+        throw std::invalid_argument("Not a compiled query file");
+    }
+}
+
+BinaryQueries::BinaryQueries(std::vector<Query> const& queries)
+{
+    std::vector<std::uint8_t> flags;
+    std::vector<std::uint64_t> id_offsets{0};
+    std::vector<char> ids;
+    std::vector<std::uint64_t> term_offsets{0};
+    std::vector<term_id_type> terms;
+    std::vector<std::uint8_t> is_high;
+    std::vector<std::uint64_t> group_offsets{0};
+    std::vector<std::uint64_t> group_weights;
+    std::vector<std::uint64_t> tier_offsets{0};
+    std::vector<term_id_type> tiers;
+
+    for (auto const& query: queries) {
+        bool has_tiers = query.is_high.size() == query.terms.size() && not query.terms.empty();
+        flags.push_back((query.id ? HasId : 0) | (has_tiers ? HasTiers : 0));
+        if (query.id) {
+            ids.insert(ids.end(), query.id->begin(), query.id->end());
+        }
+        id_offsets.push_back(ids.size());
+
+        terms.insert(terms.end(), query.terms.begin(), query.terms.end());
+        for (std::size_t term = 0; term < query.terms.size(); ++term) {
+            is_high.push_back(has_tiers && query.is_high[term] ? 1 : 0);
+        }
+        term_offsets.push_back(terms.size());
+
+        // Group ids are positions in the group list, so they need not be stored.
+        for (auto const& group: query.term_groups) {
+            group_weights.push_back(group.weight);
+            tiers.insert(tiers.end(), group.tiers.begin(), group.tiers.end());
+            tier_offsets.push_back(tiers.size());
+        }
+        group_offsets.push_back(group_weights.size());
+    }
+
+    m_flags.steal(flags);
+    m_id_offsets.steal(id_offsets);
+    m_ids.steal(ids);
+    m_term_offsets.steal(term_offsets);
+    m_terms.steal(terms);
+    m_is_high.steal(is_high);
+    m_group_offsets.steal(group_offsets);
+    m_group_weights.steal(group_weights);
+    m_tier_offsets.steal(tier_offsets);
+    m_tiers.steal(tiers);
+}
+
+auto BinaryQueries::is_binary(std::string const& filename) -> bool
+{
+    // The mapper writes its flags before the first member
+    std::array<std::uint64_t, 2> header{};
+    std::ifstream is(filename, std::ios::binary);
+    is.read(reinterpret_cast<char*>(header.data()), sizeof(header));
+    return is.gcount() == sizeof(header) && header[1] == magic;
+}
+
+auto BinaryQueries::operator[](std::size_t query) const -> Query
+{
+    Query parsed;
+    if ((m_flags[query] & HasId) != 0) {
+        parsed.id = std::string(
+            m_ids.begin() + m_id_offsets[query], m_ids.begin() + m_id_offsets[query + 1]);
+    }
+    auto first_term = m_term_offsets[query];
+    auto last_term = m_term_offsets[query + 1];
+    parsed.terms.assign(m_terms.begin() + first_term, m_terms.begin() + last_term);
+    if ((m_flags[query] & HasTiers) != 0) {
+        parsed.is_high.assign(m_is_high.begin() + first_term, m_is_high.begin() + last_term);
+    }
+    for (auto group = m_group_offsets[query]; group < m_group_offsets[query + 1]; ++group) {
+        parsed.term_groups.push_back(TermGroup{
+            {m_tiers.begin() + m_tier_offsets[group], m_tiers.begin() + m_tier_offsets[group + 1]},
+            m_group_weights[group],
+            group - m_group_offsets[query]});
+    }
+    return parsed;
+}
+
+auto BinaryQueries::queries() const -> std::vector<Query>
+{
+    std::vector<Query> queries;
+    queries.reserve(size());
+    for (std::size_t query = 0; query < size(); ++query) {
+        queries.push_back((*this)[query]);
+    }
+    return queries;
+}
+
+}  // namespace pisa
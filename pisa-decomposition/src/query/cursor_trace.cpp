@@ -0,0 +1,75 @@
+#include "query/cursor_trace.hpp"
+
+#include <sstream>
+#include <stdexcept>
+
+#include <fmt/format.h>
+
+namespace pisa {
+
+void write_cursor_trace(
+    std::ostream& os,
+    std::string const& query_type,
+    std::string const& qid,
+    std::uint32_t term,
+    std::string const& list_class,
+    std::vector<CursorCall> const& calls)
+{
+    os << query_type << '\t' << qid << '\t' << term << '\t' << list_class << '\t';
+    std::size_t nexts = 0;
+    char const* separator = "";
+    auto flush_nexts = [&] {
+        if (nexts > 0) {
+            os << separator << 'n' << nexts;
+            separator = " ";
+            nexts = 0;
+        }
+    };
+    for (auto const& call: calls) {
+        if (call.op == CursorOp::Next) {
+            nexts += 1;
+            continue;
+        }
+        flush_nexts();
+        os << separator << (call.op == CursorOp::NextGeq ? 'g' : 'b') << call.docid;
+        separator = " ";
+    }
+    flush_nexts();
+    os << '\n';
+}
+
+auto read_cursor_traces(std::istream& is) -> std::vector<ListTrace>
+{
+    std::vector<ListTrace> traces;
+    std::string line;
+    std::size_t line_number = 0;
+    while (std::getline(is, line)) {
+        line_number += 1;
+        std::istringstream fields(line);
+        std::string query_type;
+        std::string qid;
+        ListTrace trace;
+        if (not std::getline(fields, query_type, '\t') || not std::getline(fields, qid, '\t')
+            || not(fields >> trace.term >> trace.list_class)) {
+            throw std::invalid_argument(
+                fmt::format("Invalid cursor trace at line {}", line_number));
+        }
+        std::string token;
+        while (fields >> token) {
+            auto value = std::stoull(token.substr(1));
+            auto docid = static_cast<std::uint32_t>(value);
+            switch (token[0]) {
+            case 'n': trace.calls.insert(trace.calls.end(), value, {CursorOp::Next, 0}); break;
+            case 'g': trace.calls.push_back({CursorOp::NextGeq, docid}); break;
+            case 'b': trace.calls.push_back({CursorOp::BlockMaxNextGeq, docid}); break;
+            default:
+                throw std::invalid_argument(
+                    fmt::format("Invalid cursor call {} at line {}", token, line_number));
+            }
+        }
+        traces.push_back(std::move(trace));
+    }
+    return traces;
+}
+
+}  // namespace pisa
@@ -1,10 +1,15 @@
 #include "query/queries.hpp"
 
 #include <boost/algorithm/string.hpp>
+#include <fmt/format.h>
 #include <range/v3/view/enumerate.hpp>
 #include <spdlog/spdlog.h>
 #include <iterator>
+#include <limits>
+#include <map>
+#include <stdexcept>
 #include "index_types.hpp"
+#include "tiers.hpp"
 #include "tokenizer.hpp"
 #include "topk_queue.hpp"
 #include "util/util.hpp"
@@ -27,19 +32,6 @@ auto split_query_at_colon(std::string const& query_string)
     return {std::move(id), raw_query};
 }
 
-bool ends_with(std::string const& value, std::string const& ending)
-{
-    if (ending.size() > value.size())
-        return false;
-    return std::equal(ending.rbegin(), ending.rend(), value.rbegin());
-}
-
-std::string extract_term(std::string const& value, std::string const& ending)
-{
-    auto term_len = value.size() - ending.size();
-    return value.substr(0, term_len);
-}
-
 auto parse_query_terms(std::string const& query_string, TermProcessor term_processor) -> Query
 {
     auto [id, raw_query] = split_query_at_colon(query_string);
@@ -54,38 +46,27 @@ auto parse_query_terms(std::string const& query_string, TermProcessor term_proce
     //TermTokenizer tokenizer(raw_query);
     */
     std::vector<term_id_type> parsed_query;
-    std::unordered_map<std::string, std::vector<term_id_type>> pair_collector;
-
     std::vector<bool> high_terms;
-    for (auto term_iter = tokenizer.begin(); term_iter != tokenizer.end(); ++term_iter) {
-        auto raw_term = *term_iter;
-        // Check if HIGH or LOW
-        bool ends_with_high = false;
-        ends_with_high = ends_with(raw_term, "_HIGH");
-        bool ends_with_low = false;
-        ends_with_low = ends_with(raw_term, "_LOW");
-
-        if (!ends_with_high && !ends_with_low) {
-            std::cerr << "ERROR: Term [" << raw_term << "] is neither HIGH nor LOW. Exiting...\n";
-            exit(EXIT_FAILURE);
-        }
-
-        high_terms.push_back(ends_with_high);
+    // Base term -> (tier, list) of every occurrence of its lists in the query
+    std::map<std::string_view, std::vector<std::pair<uint32_t, term_id_type>>> tier_collector;
 
-        //std::cerr << "TERM: |" << raw_term << "|\n";
+    for (auto const& raw_term: tokenizer) {
+        if (raw_term.empty()) {
+            continue;
+        }
+        // Only names of lists of the index are parsed, so that the suffix of a term that is
+        // not in the index is never taken for a tier.
         auto term = term_processor(raw_term);
-        //std::cerr << "Processed: |" << *term << "|\n";
         if (term) {
+            auto tier_name = decompose::parse_tier_name(raw_term);
+            if (!tier_name) {
+                throw std::invalid_argument(fmt::format(
+                    "Term `{}` is not a decomposed list (_HIGH, _LOW, or _T<tier>)", raw_term));
+            }
             if (!term_processor.is_stopword(*term)) {
                 parsed_query.push_back(*term);
-                if (ends_with_high) {
-                    auto term_prefix = extract_term(raw_term, "_HIGH");
-                    pair_collector[term_prefix].push_back(*term);
-                }
-                if (ends_with_low) {
-                    auto term_prefix = extract_term(raw_term, "_LOW");
-                    pair_collector[term_prefix].push_back(*term);
-                }
+                high_terms.push_back(tier_name->tier == 0);
+                tier_collector[tier_name->base].emplace_back(tier_name->tier, *term);
             } else {
                 spdlog::warn("Term `{}` is a stopword and will be ignored", raw_term);
             }
@@ -94,51 +75,62 @@ auto parse_query_terms(std::string const& query_string, TermProcessor term_proce
         }
     }
 
-    std::vector<high_low_tuple> parsed_pairs;
-    size_t collected_pairs = 0;
-    for (auto term: pair_collector) {
-        auto term_vec = term.second;
-       // std::cerr << term_vec.size() << " " << term.first << "\n";
-        if (term_vec.size() % 2 != 0) {
-            std::cerr << "WARN: Term needs to have HIGH and LOW...\n";
-            std::cerr << "I am duplicating the non-empty list...\n";
-            parsed_pairs.push_back({term_vec[0], term_vec[0], term_vec.size(), collected_pairs++});
-            continue;
-        }
-        
-        // Sanity check the terms and get a frequency
-        std::unordered_map<uint32_t, size_t> term_counts;
-        for (size_t i = 0; i < term_vec.size(); ++i) {
-            term_counts[term_vec[i]] += 1;
+    std::vector<TermGroup> term_groups;
+    for (auto& [base, lists]: tier_collector) {
+        std::sort(lists.begin(), lists.end());
+        TermGroup group{{}, std::numeric_limits<uint64_t>::max(), term_groups.size()};
+        for (auto first = lists.begin(); first != lists.end();) {
+            auto last = std::find_if(first, lists.end(), [&](auto const& list) {
+                return list.second != first->second;
+            });
+            group.tiers.push_back(first->second);
+            group.weight = std::min<uint64_t>(group.weight, std::distance(first, last));
+            first = last;
         }
+        term_groups.push_back(std::move(group));
+    }
 
-        // Case: We have just one list (eg, there is no corresponding paired list)
-        if (term_counts.size() == 1) {
-            parsed_pairs.push_back({term_vec[0], term_vec[0], term_vec.size(), collected_pairs++});
-        } else if (term_counts.size() == 2) {
+    return {
+        std::move(id), std::move(parsed_query), {}, std::move(high_terms), std::move(term_groups)};
+}
 
-            // We need to find both term identifiers;
-            uint32_t term_id_one = term_vec[0];
-            uint32_t term_id_two = term_vec[0];
+auto parse_undecorated_query(std::string const& query_string, TierTermProcessor const& term_processor)
+    -> Query
+{
+    auto [id, raw_query] = split_query_at_colon(query_string);
 
-            // Guaranteed we have two, so don't check bounds
-            size_t i = 0;
-            while (term_id_one == term_id_two) {
-                term_id_two = term_vec[++i];
-            }
-            //std::cerr << "Found a pair: " << term_id_one << " " << term_id_two << " \n";
+    std::vector<std::string> tokenizer;
+    boost::split(tokenizer, raw_query, boost::is_any_of(" "), boost::token_compress_on);
 
-            parsed_pairs.push_back({term_id_one, term_id_two, term_vec.size()/2, collected_pairs++});
- 
+    // Base term -> number of occurrences in the query
+    std::map<term_id_type, uint64_t> occurrences;
+    for (auto const& raw_term: tokenizer) {
+        if (raw_term.empty()) {
+            continue;
+        }
+        auto term = term_processor(raw_term);
+        if (not term) {
+            spdlog::warn("Term `{}` not found and will be ignored", raw_term);
+        } else if (term_processor.is_stopword(*term)) {
+            spdlog::warn("Term `{}` is a stopword and will be ignored", raw_term);
         } else {
-            std::cerr << "ERROR: UNREACHABLE?\n";
-            exit(EXIT_FAILURE);
+            occurrences[*term] += 1;
         }
-
     }
 
-    return {
-        std::move(id), std::move(parsed_query), {}, std::move(high_terms), std::move(parsed_pairs)};
+    Query query{std::move(id), {}, {}, {}, {}};
+    auto const& lexicon = term_processor.lexicon();
+    for (auto [term, count]: occurrences) {
+        auto lists = lexicon.lists(term);
+        auto tiers = lexicon.tiers(term);
+        for (std::size_t list = 0; list < lists.size(); ++list) {
+            query.terms.insert(query.terms.end(), count, lists[list]);
+            query.is_high.insert(query.is_high.end(), count, tiers[list] == 0);
+        }
+        query.term_groups.push_back(TermGroup{
+            {lists.begin(), lists.end()}, count, static_cast<uint64_t>(query.term_groups.size())});
+    }
+    return query;
 }
 
 auto parse_query_ids(std::string const& query_string) -> Query
@@ -155,9 +147,9 @@ auto parse_query_ids(std::string const& query_string) -> Query
     try {
         auto to_int = [](const std::string& val) { return std::stoi(val); };
         std::transform(term_ids.begin(), term_ids.end(), std::back_inserter(parsed_query), to_int);
-    } catch (std::invalid_argument& err) {
-        spdlog::error("Could not parse term identifiers of query `{}`", raw_query);
-        exit(1);
+    } catch (std::invalid_argument const& err) {
+        throw std::invalid_argument(
+            fmt::format("Could not parse term identifiers of query `{}`", raw_query));
     }
     return {std::move(id), std::move(parsed_query), {}, {}, {}};
 }
@@ -166,8 +158,16 @@ std::function<void(const std::string)> resolve_query_parser(
     std::vector<Query>& queries,
     std::optional<std::string> const& terms_file,
     std::optional<std::string> const& stopwords_filename,
-    std::optional<std::string> const& stemmer_type)
+    std::optional<std::string> const& stemmer_type,
+    std::optional<std::string> const& tier_lexicon_file)
 {
+    if (tier_lexicon_file) {
+        auto term_processor =
+            TierTermProcessor(*tier_lexicon_file, stopwords_filename, stemmer_type);
+        return [&queries, term_processor = std::move(term_processor)](std::string const& query_line) {
+            queries.push_back(parse_undecorated_query(query_line, term_processor));
+        };
+    }
     if (terms_file) {
         auto term_processor = TermProcessor(terms_file, stopwords_filename, stemmer_type);
         return [&queries, term_processor = std::move(term_processor)](std::string const& query_line) {
@@ -211,12 +211,19 @@ term_freq_vec query_freqs(term_id_vec terms)
     return query_term_freqs;
 }
 
+auto query_lists(Query const& query) -> term_id_vec
+{
+    auto terms = query.terms;
+    remove_duplicate_terms(terms);
+    return terms;
+}
+
 [[nodiscard]] auto get_high_query(Query q) -> Query
 {
     Query high_query;
     high_query.id = q.id;
     for (size_t i = 0; i < q.terms.size(); ++i) {
-        if (q.is_high[i]) {
+        if (i < q.is_high.size() && q.is_high[i]) {
             high_query.terms.push_back(q.terms[i]);
         }
     }
@@ -228,7 +235,7 @@ term_freq_vec query_freqs(term_id_vec terms)
     Query low_query;
     low_query.id = q.id;
     for (size_t i = 0; i < q.terms.size(); ++i) {
-        if (!q.is_high[i]) {
+        if (i >= q.is_high.size() || !q.is_high[i]) {
             low_query.terms.push_back(q.terms[i]);
         }
     }
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "fmt/format.h"
+
+/// Split point of every term of the collections written by `write_decomposable_collection`:
+/// postings with a frequency above it go to the HIGH tier.
+constexpr std::uint32_t test_split_point = 3;
+
+/// Writes a random collection of `num_terms` terms over `num_docs` documents to `basename`, as
+/// `.docs`, `.freqs`, `.sizes` and `.terms` files, and a `.splits` file decomposing every term
+/// into two tiers at `test_split_point`.
+///
+/// Terms are named `t00`, `t01`, ..., and get sparser with their number; frequencies are in
+/// `[1, 8]`, so most terms have both a HIGH and a LOW tier.
+inline void write_decomposable_collection(
+    std::string const& basename, std::uint32_t num_docs, std::uint32_t num_terms, unsigned seed)
+{
+    std::mt19937 rng(seed);
+    std::ofstream docs(basename + ".docs", std::ios::binary);
+    std::ofstream freqs(basename + ".freqs", std::ios::binary);
+    std::ofstream sizes(basename + ".sizes", std::ios::binary);
+    std::ofstream terms(basename + ".terms");
+    std::ofstream splits(basename + ".splits");
+    auto write = [](std::ofstream& os, std::vector<std::uint32_t> const& sequence) {
+        auto length = static_cast<std::uint32_t>(sequence.size());
+        os.write(reinterpret_cast<char const*>(&length), sizeof(length));
+        os.write(
+            reinterpret_cast<char const*>(sequence.data()), length * sizeof(std::uint32_t));
+    };
+
+    write(docs, {num_docs});
+    std::vector<std::uint32_t> lengths(num_docs);
+    for (auto& length: lengths) {
+        length = 10 + rng() % 200;
+    }
+    write(sizes, lengths);
+    for (std::uint32_t term = 0; term < num_terms; ++term) {
+        std::bernoulli_distribution contains(1.0 / (2 + term % 5));
+        std::vector<std::uint32_t> term_docs;
+        std::vector<std::uint32_t> term_freqs;
+        for (std::uint32_t doc = 0; doc < num_docs; ++doc) {
+            if (contains(rng) || (term_docs.empty() && doc + 1 == num_docs)) {
+                term_docs.push_back(doc);
+                term_freqs.push_back(1 + rng() % 8);
+            }
+        }
+        write(docs, term_docs);
+        write(freqs, term_freqs);
+        terms << fmt::format("t{:02}\n", term);
+        splits << test_split_point << '\n';
+    }
+}
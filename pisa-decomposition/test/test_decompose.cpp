@@ -0,0 +1,270 @@
+#define CATCH_CONFIG_MAIN
+#include <catch2/catch.hpp>
+
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "binary_collection.hpp"
+#include "binary_freq_collection.hpp"
+#include "block_freq_index.hpp"
+#include "codec/block_codecs.hpp"
+#include "decompose.hpp"
+#include "memory_source.hpp"
+#include "temporary_directory.hpp"
+#include "tier_data.hpp"
+#include "wand_data.hpp"
+#include "wand_data_raw.hpp"
+
+#include "decomposed_collection.hpp"
+
+using namespace pisa;
+
+using Postings = std::map<std::uint32_t, std::uint32_t>;
+
+auto read_postings(binary_freq_collection::sequence const& sequence) -> Postings
+{
+    Postings postings;
+    auto freq = sequence.freqs.begin();
+    for (auto doc: sequence.docs) {
+        postings[doc] = *freq++;
+    }
+    return postings;
+}
+
+TEST_CASE("Decomposed collections split or clip the postings of every term", "[decompose]")
+{
+    auto mode = GENERATE(DecompositionMode::Split, DecompositionMode::Clip);
+    Temporary_Directory tmpdir;
+    auto input = (tmpdir.path() / "input").string();
+    auto output = (tmpdir.path() / "output").string();
+    write_decomposable_collection(input, 500, 12, 7);
+    decompose::decompose_index(input, output, input + ".splits", mode, 1000);
+
+    binary_freq_collection collection(input.c_str());
+    binary_freq_collection decomposed(output.c_str());
+    auto lexicon = decompose::read_lexicon(input + ".terms");
+    auto names = decompose::read_lexicon(output + ".terms");
+    REQUIRE(decomposed.num_docs() == collection.num_docs());
+    REQUIRE(std::is_sorted(names.begin(), names.end()));
+
+    std::map<std::string, std::map<std::uint32_t, Postings>> tiers;
+    std::size_t list = 0;
+    for (auto const& sequence: decomposed) {
+        REQUIRE(list < names.size());
+        auto name = decompose::parse_tier_name(names[list]);
+        REQUIRE(name);
+        REQUIRE_FALSE(sequence.docs.size() == 0);
+        tiers[std::string(name->base)][name->tier] = read_postings(sequence);
+        list += 1;
+    }
+    REQUIRE(list == names.size());
+
+    std::size_t term = 0;
+    for (auto const& sequence: collection) {
+        CAPTURE(lexicon[term]);
+        auto postings = read_postings(sequence);
+        auto& high = tiers[lexicon[term]][0];
+        auto& low = tiers[lexicon[term]][decompose::bottom_tier];
+        if (mode == DecompositionMode::Split) {
+            Postings merged = low;
+            for (auto [doc, freq]: high) {
+                REQUIRE(freq > test_split_point);
+                REQUIRE(merged.emplace(doc, freq).second);
+            }
+            for (auto [doc, freq]: low) {
+                REQUIRE(freq <= test_split_point);
+            }
+            REQUIRE(merged == postings);
+        } else {
+            Postings expected_high;
+            Postings expected_low;
+            for (auto [doc, freq]: postings) {
+                expected_low[doc] = std::min(freq, test_split_point);
+                if (freq > test_split_point) {
+                    expected_high[doc] = freq - test_split_point;
+                }
+            }
+            REQUIRE(high == expected_high);
+            REQUIRE(low == expected_low);
+        }
+        term += 1;
+    }
+}
+
+TEST_CASE(
+    "Decompose and compress writes the index, wand data and tiers of the decomposed collection",
+    "[decompose]")
+{
+    using index_type = block_freq_index<interpolative_block>;
+    using wand_type = wand_data<wand_data_raw>;
+
+    auto mode = GENERATE(DecompositionMode::Split, DecompositionMode::Clip);
+    Temporary_Directory tmpdir;
+    auto input = (tmpdir.path() / "input").string();
+    auto expected_basename = (tmpdir.path() / "expected").string();
+    auto output = (tmpdir.path() / "output").string();
+    write_decomposable_collection(input, 500, 12, 11);
+    decompose::decompose_index(input, expected_basename, input + ".splits", mode, 1000);
+
+    binary_freq_collection collection(input.c_str());
+    binary_collection sizes((input + ".sizes").c_str());
+    decompose::Decomposition decomposition(
+        collection,
+        decompose::read_lexicon(input + ".terms"),
+        decompose::read_splits(input + ".splits"),
+        mode);
+    decompose::decompose_and_compress<index_type, wand_type>(
+        decomposition,
+        collection,
+        sizes,
+        output,
+        ScorerParams("bm25"),
+        FixedBlock(16),
+        false,
+        1000);
+
+    auto names = decompose::read_lexicon(output + ".terms");
+    REQUIRE(names == decompose::read_lexicon(expected_basename + ".terms"));
+
+    binary_freq_collection expected(expected_basename.c_str());
+    index_type index(MemorySource::mapped_file(output + ".idx"));
+    REQUIRE(index.size() == names.size());
+    REQUIRE(index.num_docs() == expected.num_docs());
+    std::size_t list = 0;
+    for (auto const& sequence: expected) {
+        auto cursor = index[list];
+        REQUIRE(cursor.size() == sequence.docs.size());
+        auto freq = sequence.freqs.begin();
+        for (auto doc: sequence.docs) {
+            REQUIRE(cursor.docid() == doc);
+            REQUIRE(cursor.freq() == *freq++);
+            cursor.next();
+        }
+        list += 1;
+    }
+
+    wand_type wdata(MemorySource::mapped_file(output + ".bmw"));
+    wand_type expected_wdata(
+        sizes.begin()->begin(),
+        expected.num_docs(),
+        expected,
+        ScorerParams("bm25"),
+        FixedBlock(16),
+        false,
+        {});
+    REQUIRE(wdata.num_terms() == names.size());
+    for (list = 0; list < names.size(); ++list) {
+        REQUIRE(wdata.term_posting_count(list) == expected_wdata.term_posting_count(list));
+        REQUIRE(wdata.max_term_weight(list) == Approx(expected_wdata.max_term_weight(list)));
+        auto kth_scores = wdata.kth_scores(list);
+        auto expected_kth_scores = expected_wdata.kth_scores(list);
+        REQUIRE(kth_scores.ranks.size() == expected_kth_scores.ranks.size());
+        for (std::size_t rank = 0; rank < kth_scores.ranks.size(); ++rank) {
+            REQUIRE(kth_scores.ranks[rank] == expected_kth_scores.ranks[rank]);
+            REQUIRE(kth_scores.scores[rank] == Approx(expected_kth_scores.scores[rank]));
+        }
+    }
+
+    TierData tier_data(MemorySource::mapped_file(output + ".tiers"));
+    TierData expected_tier_data(names, expected_wdata, mode);
+    REQUIRE(tier_data.mode() == mode);
+    REQUIRE(tier_data.size() == names.size());
+    for (list = 0; list < names.size(); ++list) {
+        CAPTURE(names[list]);
+        REQUIRE(tier_data.top_tier(list) == expected_tier_data.top_tier(list));
+        REQUIRE(tier_data.next_tier(list) == expected_tier_data.next_tier(list));
+        REQUIRE(tier_data.primed_length(list) == expected_tier_data.primed_length(list));
+        REQUIRE(
+            tier_data.primed_max_score(list) == Approx(expected_tier_data.primed_max_score(list)));
+    }
+}
+
+TEST_CASE("Tier data links the tiers of every term and records the mode", "[decompose]")
+{
+    auto mode = GENERATE(DecompositionMode::Split, DecompositionMode::Clip);
+    Temporary_Directory tmpdir;
+    auto input = (tmpdir.path() / "input").string();
+    auto output = (tmpdir.path() / "output").string();
+    write_decomposable_collection(input, 500, 12, 13);
+    {
+        std::ofstream splits(input + ".splits");
+        for (int term = 0; term < 12; ++term) {
+            splits << "5 2\n";
+        }
+    }
+    decompose::decompose_index(input, output, input + ".splits", mode, 1000);
+
+    binary_freq_collection decomposed(output.c_str());
+    binary_collection sizes((input + ".sizes").c_str());
+    wand_data<wand_data_raw> wdata(
+        sizes.begin()->begin(),
+        decomposed.num_docs(),
+        decomposed,
+        ScorerParams("bm25"),
+        FixedBlock(16),
+        false,
+        {});
+    auto names = decompose::read_lexicon(output + ".terms");
+    {
+        TierData tier_data(names, wdata, mode);
+        mapper::freeze(tier_data, (output + ".tiers").c_str());
+    }
+    TierData tier_data(MemorySource::mapped_file(output + ".tiers"));
+    REQUIRE(tier_data.mode() == mode);
+    REQUIRE(tier_data.size() == names.size());
+
+    std::map<std::string, std::map<std::uint32_t, std::uint32_t>> terms;
+    for (std::uint32_t list = 0; list < names.size(); ++list) {
+        auto name = decompose::parse_tier_name(names[list]);
+        REQUIRE(name);
+        terms[std::string(name->base)][name->tier] = list;
+    }
+    for (auto const& [base, tiers]: terms) {
+        CAPTURE(base);
+        auto top = tiers.begin()->second;
+        std::uint64_t length = 0;
+        for (auto tier = tiers.begin(); tier != tiers.end(); ++tier) {
+            auto list = tier->second;
+            REQUIRE(tier_data.top_tier(list) == top);
+            auto next = std::next(tier);
+            if (next == tiers.end()) {
+                REQUIRE(tier_data.next_tier(list) == list);
+                REQUIRE(tier_data.primed_length(list) == 0);
+                continue;
+            }
+            // Split tiers add up, clipped tiers are nested.
+            if (mode == DecompositionMode::Split) {
+                length += wdata.term_posting_count(list);
+            } else {
+                length = wdata.term_posting_count(list);
+            }
+            REQUIRE(tier_data.next_tier(list) == next->second);
+            REQUIRE(tier_data.primed_length(list) == length);
+            REQUIRE(
+                tier_data.primed_max_score(list) == Approx(wdata.max_term_weight(next->second)));
+        }
+    }
+}
+
+TEST_CASE("Tier suffixes are only parsed in decomposed lexicons", "[decompose]")
+{
+    std::vector<std::string> decomposed{"covid_T19_T0", "covid_T19_T2", "flu_T1"};
+    auto names = decompose::parse_tier_names(decomposed);
+    REQUIRE(names.size() == 3);
+    REQUIRE(names[0]->base == "covid_T19");
+    REQUIRE(names[0]->tier == 0);
+    REQUIRE(names[1]->base == "covid_T19");
+    REQUIRE(names[1]->tier == 2);
+    REQUIRE(names[2]->base == "flu");
+    REQUIRE(names[2]->tier == 1);
+
+    // A single undecorated list means that no list is a tier.
+    std::vector<std::string> undecomposed{"covid_T19", "covid_T2", "flu"};
+    names = decompose::parse_tier_names(undecomposed);
+    REQUIRE(names.size() == 3);
+    REQUIRE(std::none_of(
+        names.begin(), names.end(), [](auto const& name) { return name.has_value(); }));
+}
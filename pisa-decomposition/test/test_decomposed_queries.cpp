@@ -0,0 +1,753 @@
+#define CATCH_CONFIG_MAIN
+#include <catch2/catch.hpp>
+
+#include <algorithm>
+#include <functional>
+#include <map>
+#include <memory>
+#include <optional>
+#include <random>
+#include <set>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "accumulator/lazy_accumulator.hpp"
+#include "binary_collection.hpp"
+#include "binary_freq_collection.hpp"
+#include "block_freq_index.hpp"
+#include "codec/block_codecs.hpp"
+#include "cursor/block_max_scored_cursor.hpp"
+#include "cursor/max_scored_cursor.hpp"
+#include "cursor/scored_cursor.hpp"
+#include "decompose.hpp"
+#include "impact_ordered_index.hpp"
+#include "memory_source.hpp"
+#include "pair_thresholds.hpp"
+#include "query/algorithm.hpp"
+#include "scorer/scorer.hpp"
+#include "temporary_directory.hpp"
+#include "tier_data.hpp"
+#include "wand_data.hpp"
+#include "wand_data_raw.hpp"
+
+#include "decomposed_collection.hpp"
+
+using namespace pisa;
+
+using index_type = block_freq_index<interpolative_block>;
+using wand_type = wand_data<wand_data_raw>;
+using result_type = std::vector<std::pair<float, std::uint64_t>>;
+
+constexpr std::size_t test_k = 10;
+
+/// A collection split into HIGH and LOW tiers, with its index, wand data, tier data, and the
+/// pair thresholds of `queries`.
+struct SplitIndex {
+    explicit SplitIndex(std::size_t num_queries)
+    {
+        auto input = (tmpdir.path() / "input").string();
+        auto output = (tmpdir.path() / "output").string();
+        write_decomposable_collection(input, 2000, 30, 23);
+        decompose::decompose_index(
+            input, output, input + ".splits", DecompositionMode::Split, 100000);
+
+        binary_freq_collection collection(output.c_str());
+        binary_collection sizes((input + ".sizes").c_str());
+        {
+            index_type::builder builder(collection.num_docs(), global_parameters{});
+            for (auto const& sequence: collection) {
+                std::uint64_t occurrences = 0;
+                for (auto freq: sequence.freqs) {
+                    occurrences += freq;
+                }
+                builder.add_posting_list(
+                    sequence.docs.size(),
+                    sequence.docs.begin(),
+                    sequence.freqs.begin(),
+                    occurrences);
+            }
+            builder.build(index);
+        }
+        wdata.emplace(
+            sizes.begin()->begin(),
+            collection.num_docs(),
+            collection,
+            ScorerParams("bm25"),
+            FixedBlock(16),
+            false,
+            std::unordered_set<std::size_t>{},
+            std::vector<std::uint32_t>{test_k});
+        quantized_wdata.emplace(
+            sizes.begin()->begin(),
+            collection.num_docs(),
+            collection,
+            ScorerParams("quantized"),
+            FixedBlock(16),
+            false,
+            std::unordered_set<std::size_t>{});
+        lexicon = decompose::read_lexicon(output + ".terms");
+        tier_data.emplace(lexicon, *wdata, DecompositionMode::Split);
+        scorer = scorer::from_params(ScorerParams("bm25"), *wdata);
+        make_queries(num_queries);
+        make_pair_thresholds();
+    }
+
+    /// Queries of two to four base terms, holding all their tiers, or all but one tier of one
+    /// of them.
+    void make_queries(std::size_t num_queries)
+    {
+        std::map<std::string_view, std::vector<std::pair<std::uint32_t, std::uint32_t>>> terms;
+        for (std::uint32_t list = 0; list < lexicon.size(); ++list) {
+            auto name = decompose::parse_tier_name(lexicon[list]);
+            REQUIRE(name);
+            terms[name->base].emplace_back(name->tier, list);
+        }
+        std::vector<std::vector<std::uint32_t>> bases;
+        for (auto& [base, tiers]: terms) {
+            std::sort(tiers.begin(), tiers.end());
+            auto& lists = bases.emplace_back();
+            for (auto [tier, list]: tiers) {
+                lists.push_back(list);
+            }
+        }
+
+        std::mt19937 rng(29);
+        while (queries.size() < num_queries) {
+            std::shuffle(bases.begin(), bases.end(), rng);
+            auto num_terms = 2 + rng() % 3;
+            bool drop = queries.size() % 3 == 2;
+            Query query;
+            for (std::size_t term = 0; term < num_terms; ++term) {
+                auto tiers = bases[term];
+                if (drop && tiers.size() > 1) {
+                    tiers.erase(std::next(tiers.begin(), rng() % tiers.size()));
+                    drop = false;
+                }
+                query.terms.insert(query.terms.end(), tiers.begin(), tiers.end());
+                query.term_groups.push_back(TermGroup{tiers, 1, term});
+            }
+            queries.push_back(std::move(query));
+        }
+    }
+
+    /// Mines the thresholds of every pair of base terms of the queries.
+    void make_pair_thresholds()
+    {
+        std::map<std::uint32_t, std::vector<std::uint32_t>> tiers;
+        std::set<std::pair<std::uint32_t, std::uint32_t>> pairs;
+        for (auto const& query: queries) {
+            auto terms = query_base_terms(query, &*tier_data);
+            for (auto first = terms.begin(); first != terms.end(); ++first) {
+                for (auto second = std::next(first); second != terms.end(); ++second) {
+                    pairs.emplace(first->first, second->first);
+                }
+            }
+            tiers.insert(terms.begin(), terms.end());
+        }
+        PairThresholds::builder builder({test_k});
+        for (auto [first, second]: pairs) {
+            Query query;
+            for (auto base: {first, second}) {
+                auto const& lists = tiers[base];
+                query.terms.insert(query.terms.end(), lists.begin(), lists.end());
+                query.term_groups.push_back(TermGroup{lists, 1, query.term_groups.size()});
+            }
+            topk_queue topk(test_k);
+            ranked_and_query ranked_and_q(topk);
+            ranked_and_q.pair_aware_ranked_and(
+                make_max_scored_cursors(index, *wdata, *scorer, query), index.num_docs());
+            topk.finalize();
+            float score = topk.topk().size() < test_k ? 0.0F : topk.topk().back().first;
+            builder.add(tiers[first], tiers[second], {score});
+        }
+        builder.build(pair_thresholds);
+        REQUIRE(pair_thresholds.size() == pairs.size());
+    }
+
+    Temporary_Directory tmpdir;
+    index_type index;
+    std::optional<wand_type> wdata;
+    /// Bounds of the frequencies themselves, which the `quantized` scorers return.
+    std::optional<wand_type> quantized_wdata;
+    std::vector<std::string> lexicon;
+    std::optional<TierData> tier_data;
+    std::unique_ptr<index_scorer<wand_type>> scorer;
+    std::vector<Query> queries;
+    PairThresholds pair_thresholds;
+};
+
+/// Runs `algorithm` on a top-k queue primed with the pair threshold of `query` if `primed`.
+template <typename TopK = topk_queue, typename Algorithm>
+auto run(SplitIndex const& data, Query const& query, bool primed, Algorithm&& algorithm)
+    -> result_type
+{
+    TopK topk(test_k);
+    if (primed) {
+        topk.set_threshold(data.pair_thresholds.threshold(query, test_k));
+    }
+    algorithm(topk);
+    topk.finalize();
+    result_type results;
+    for (auto [score, docid]: topk.topk()) {
+        results.emplace_back(score, docid);
+    }
+    return results;
+}
+
+/// Checks that `results` have the scores of `expected`, whichever documents tie.
+void require_same_scores(result_type const& results, result_type const& expected)
+{
+    REQUIRE(results.size() == expected.size());
+    for (std::size_t rank = 0; rank < results.size(); ++rank) {
+        REQUIRE(results[rank].first == Approx(expected[rank].first));
+    }
+}
+
+TEST_CASE("Pair-aware and primed algorithms return the top-k of ranked OR", "[decompose][query]")
+{
+    SplitIndex data(60);
+    auto const& index = data.index;
+    auto const& wdata = *data.wdata;
+    auto const& tier_data = *data.tier_data;
+    auto const& scorer = *data.scorer;
+    auto num_docs = index.num_docs();
+
+    std::map<std::string, std::function<result_type(Query const&)>> algorithms;
+    algorithms["wand_prime"] = [&](Query const& query) {
+        return run(data, query, true, [&](auto& topk) {
+            wand_query wand_q(topk);
+            wand_q(make_max_scored_cursors(index, wdata, scorer, query), num_docs, true);
+        });
+    };
+    algorithms["maxscore_prime"] = [&](Query const& query) {
+        return run(data, query, true, [&](auto& topk) {
+            maxscore_query maxscore_q(topk);
+            maxscore_q(make_max_scored_cursors(index, wdata, scorer, query), num_docs, true);
+        });
+    };
+    algorithms["block_max_wand_prime"] = [&](Query const& query) {
+        return run(data, query, true, [&](auto& topk) {
+            block_max_wand_query block_max_wand_q(topk);
+            block_max_wand_q(
+                make_block_max_scored_cursors(index, wdata, scorer, query), num_docs, true);
+        });
+    };
+    // Pair-aware algorithms run on cursors tiered by the term groups of the query, and by tier
+    // data, with and without a primed threshold.
+    for (bool primed: {false, true}) {
+        auto suffix = primed ? std::string("_prime") : std::string();
+        algorithms["pair_aware_wand" + suffix] = [&, primed](Query const& query) {
+            return run(data, query, primed, [&](auto& topk) {
+                wand_query wand_q(topk);
+                wand_q.pair_aware_wand(
+                    make_max_scored_cursors(index, wdata, scorer, query), num_docs, primed);
+            });
+        };
+        algorithms["pair_aware_wand_tiers" + suffix] = [&, primed](Query const& query) {
+            return run(data, query, primed, [&](auto& topk) {
+                wand_query wand_q(topk);
+                wand_q.pair_aware_wand(
+                    make_max_scored_cursors(index, wdata, tier_data, scorer, query),
+                    num_docs,
+                    primed);
+            });
+        };
+        algorithms["pair_aware_maxscore" + suffix] = [&, primed](Query const& query) {
+            return run(data, query, primed, [&](auto& topk) {
+                maxscore_query maxscore_q(topk);
+                maxscore_q.pair_aware_maxscore(
+                    make_max_scored_cursors(index, wdata, scorer, query), num_docs, primed);
+            });
+        };
+        algorithms["pair_aware_maxscore_tiers" + suffix] = [&, primed](Query const& query) {
+            return run(data, query, primed, [&](auto& topk) {
+                maxscore_query maxscore_q(topk);
+                maxscore_q.pair_aware_maxscore(
+                    make_max_scored_cursors(index, wdata, tier_data, scorer, query),
+                    num_docs,
+                    primed);
+            });
+        };
+        algorithms["pair_aware_block_max_wand" + suffix] = [&, primed](Query const& query) {
+            return run(data, query, primed, [&](auto& topk) {
+                block_max_wand_query block_max_wand_q(topk);
+                block_max_wand_q.pair_aware_bmw(
+                    make_block_max_scored_cursors(index, wdata, scorer, query), num_docs, primed);
+            });
+        };
+        algorithms["pair_aware_block_max_wand_tiers" + suffix] = [&, primed](Query const& query) {
+            return run(data, query, primed, [&](auto& topk) {
+                block_max_wand_query block_max_wand_q(topk);
+                block_max_wand_q.pair_aware_bmw(
+                    make_block_max_scored_cursors(index, wdata, tier_data, scorer, query),
+                    num_docs,
+                    primed);
+            });
+        };
+        algorithms["pair_aware_block_max_maxscore" + suffix] = [&, primed](Query const& query) {
+            return run(data, query, primed, [&](auto& topk) {
+                block_max_maxscore_query block_max_maxscore_q(topk);
+                block_max_maxscore_q.pair_aware_block_max_maxscore(
+                    make_block_max_scored_cursors(index, wdata, scorer, query), num_docs, primed);
+            });
+        };
+        algorithms["pair_aware_block_max_maxscore_tiers" + suffix] =
+            [&, primed](Query const& query) {
+                return run(data, query, primed, [&](auto& topk) {
+                    block_max_maxscore_query block_max_maxscore_q(topk);
+                    block_max_maxscore_q.pair_aware_block_max_maxscore(
+                        make_block_max_scored_cursors(index, wdata, tier_data, scorer, query),
+                        num_docs,
+                        primed);
+                });
+            };
+    }
+
+    for (auto const& query: data.queries) {
+        CAPTURE(query.terms);
+        auto expected = run(data, query, false, [&](auto& topk) {
+            ranked_or_query ranked_or_q(topk);
+            ranked_or_q(make_scored_cursors(index, scorer, query), num_docs);
+        });
+        REQUIRE(expected.size() == test_k);
+        for (auto const& [name, algorithm]: algorithms) {
+            CAPTURE(name);
+            require_same_scores(algorithm(query), expected);
+        }
+    }
+}
+
+TEST_CASE("Integer scores of a quantized index match its float scores", "[decompose][query]")
+{
+    SplitIndex data(60);
+    auto const& index = data.index;
+    auto const& wdata = *data.quantized_wdata;
+    auto float_scorer = scorer::from_params(ScorerParams("quantized"), wdata);
+    integer_quantized scorer;
+    auto num_docs = index.num_docs();
+
+    std::map<std::string, std::function<result_type(Query const&)>> algorithms;
+    algorithms["ranked_or"] = [&](Query const& query) {
+        return run<int_topk_queue>(data, query, false, [&](auto& topk) {
+            ranked_or_query ranked_or_q(topk);
+            ranked_or_q(make_scored_cursors(index, scorer, query), num_docs);
+        });
+    };
+    algorithms["wand"] = [&](Query const& query) {
+        return run<int_topk_queue>(data, query, false, [&](auto& topk) {
+            wand_query wand_q(topk);
+            wand_q(make_max_scored_cursors(index, wdata, scorer, query), num_docs);
+        });
+    };
+    algorithms["maxscore"] = [&](Query const& query) {
+        return run<int_topk_queue>(data, query, false, [&](auto& topk) {
+            maxscore_query maxscore_q(topk);
+            maxscore_q(make_max_scored_cursors(index, wdata, scorer, query), num_docs);
+        });
+    };
+    algorithms["block_max_wand"] = [&](Query const& query) {
+        return run<int_topk_queue>(data, query, false, [&](auto& topk) {
+            block_max_wand_query block_max_wand_q(topk);
+            block_max_wand_q(make_block_max_scored_cursors(index, wdata, scorer, query), num_docs);
+        });
+    };
+    algorithms["block_max_maxscore"] = [&](Query const& query) {
+        return run<int_topk_queue>(data, query, false, [&](auto& topk) {
+            block_max_maxscore_query block_max_maxscore_q(topk);
+            block_max_maxscore_q(
+                make_block_max_scored_cursors(index, wdata, scorer, query), num_docs);
+        });
+    };
+    algorithms["pair_aware_wand"] = [&](Query const& query) {
+        return run<int_topk_queue>(data, query, false, [&](auto& topk) {
+            wand_query wand_q(topk);
+            wand_q.pair_aware_wand(make_max_scored_cursors(index, wdata, scorer, query), num_docs);
+        });
+    };
+    algorithms["pair_aware_maxscore"] = [&](Query const& query) {
+        return run<int_topk_queue>(data, query, false, [&](auto& topk) {
+            maxscore_query maxscore_q(topk);
+            maxscore_q.pair_aware_maxscore(
+                make_max_scored_cursors(index, wdata, scorer, query), num_docs);
+        });
+    };
+    algorithms["pair_aware_block_max_maxscore"] = [&](Query const& query) {
+        return run<int_topk_queue>(data, query, false, [&](auto& topk) {
+            block_max_maxscore_query block_max_maxscore_q(topk);
+            block_max_maxscore_q.pair_aware_block_max_maxscore(
+                make_block_max_scored_cursors(index, wdata, scorer, query), num_docs);
+        });
+    };
+
+    for (auto const& query: data.queries) {
+        CAPTURE(query.terms);
+        auto expected = run(data, query, false, [&](auto& topk) {
+            ranked_or_query ranked_or_q(topk);
+            ranked_or_q(make_scored_cursors(index, *float_scorer, query), num_docs);
+        });
+        REQUIRE(expected.size() == test_k);
+        for (auto const& [name, algorithm]: algorithms) {
+            CAPTURE(name);
+            require_same_scores(algorithm(query), expected);
+        }
+    }
+}
+
+/// The top-k of the conjunction of the base terms of `query`, from the scores of ranked OR
+/// over all documents, keeping those found in some tier of every term.
+auto conjunctive_top_k(SplitIndex const& data, Query const& query) -> result_type
+{
+    auto const& index = data.index;
+    topk_queue topk(index.num_docs());
+    ranked_or_query ranked_or_q(topk);
+    ranked_or_q(make_scored_cursors(index, *data.scorer, query), index.num_docs());
+    topk.finalize();
+
+    std::vector<std::set<std::uint64_t>> term_documents;
+    for (auto const& group: query.term_groups) {
+        auto& documents = term_documents.emplace_back();
+        for (auto list: group.tiers) {
+            for (auto cursor = index[list]; cursor.docid() < index.num_docs(); cursor.next()) {
+                documents.insert(cursor.docid());
+            }
+        }
+    }
+    result_type results;
+    for (auto [score, docid]: topk.topk()) {
+        auto in_all_terms = std::all_of(
+            term_documents.begin(), term_documents.end(), [docid = docid](auto const& documents) {
+                return documents.count(docid) > 0;
+            });
+        if (in_all_terms && results.size() < test_k) {
+            results.emplace_back(score, docid);
+        }
+    }
+    return results;
+}
+
+TEST_CASE("Pair-aware conjunctions return the top-k of the base terms", "[decompose][query]")
+{
+    SplitIndex data(60);
+    auto const& index = data.index;
+    auto const& wdata = *data.wdata;
+    auto const& tier_data = *data.tier_data;
+    auto const& scorer = *data.scorer;
+    auto num_docs = index.num_docs();
+
+    std::map<std::string, std::function<result_type(Query const&)>> algorithms;
+    algorithms["pair_aware_ranked_and"] = [&](Query const& query) {
+        return run(data, query, false, [&](auto& topk) {
+            ranked_and_query ranked_and_q(topk);
+            ranked_and_q.pair_aware_ranked_and(
+                make_max_scored_cursors(index, wdata, scorer, query), num_docs);
+        });
+    };
+    algorithms["pair_aware_ranked_and_tiers"] = [&](Query const& query) {
+        return run(data, query, false, [&](auto& topk) {
+            ranked_and_query ranked_and_q(topk);
+            ranked_and_q.pair_aware_ranked_and(
+                make_max_scored_cursors(index, wdata, tier_data, scorer, query), num_docs);
+        });
+    };
+    algorithms["pair_aware_block_max_ranked_and"] = [&](Query const& query) {
+        return run(data, query, false, [&](auto& topk) {
+            block_max_ranked_and_query block_max_ranked_and_q(topk);
+            block_max_ranked_and_q.pair_aware_block_max_ranked_and(
+                make_block_max_scored_cursors(index, wdata, scorer, query), num_docs);
+        });
+    };
+    algorithms["pair_aware_block_max_ranked_and_tiers"] = [&](Query const& query) {
+        return run(data, query, false, [&](auto& topk) {
+            block_max_ranked_and_query block_max_ranked_and_q(topk);
+            block_max_ranked_and_q.pair_aware_block_max_ranked_and(
+                make_block_max_scored_cursors(index, wdata, tier_data, scorer, query), num_docs);
+        });
+    };
+
+    std::size_t matching_queries = 0;
+    for (auto const& query: data.queries) {
+        CAPTURE(query.terms);
+        auto expected = conjunctive_top_k(data, query);
+        matching_queries += expected.empty() ? 0 : 1;
+        for (auto const& [name, algorithm]: algorithms) {
+            CAPTURE(name);
+            require_same_scores(algorithm(query), expected);
+        }
+    }
+    REQUIRE(matching_queries > 0);
+}
+
+TEST_CASE("Pair-aware TAAT returns the top-k of ranked OR", "[decompose][query]")
+{
+    SplitIndex data(60);
+    auto const& index = data.index;
+    auto const& wdata = *data.wdata;
+    auto const& tier_data = *data.tier_data;
+    auto const& scorer = *data.scorer;
+    auto num_docs = index.num_docs();
+    // Shared by all queries, as in the query tools, so that it is reset between them.
+    Lazy_Accumulator<4> accumulator(num_docs);
+
+    for (auto const& query: data.queries) {
+        CAPTURE(query.terms);
+        auto expected = run(data, query, false, [&](auto& topk) {
+            ranked_or_query ranked_or_q(topk);
+            ranked_or_q(make_scored_cursors(index, scorer, query), num_docs);
+        });
+        require_same_scores(
+            run(data,
+                query,
+                false,
+                [&](auto& topk) {
+                    ranked_or_taat_query ranked_or_taat_q(topk);
+                    ranked_or_taat_q.pair_aware_taat(
+                        make_max_scored_cursors(index, wdata, scorer, query),
+                        num_docs,
+                        accumulator);
+                }),
+            expected);
+        require_same_scores(
+            run(data,
+                query,
+                false,
+                [&](auto& topk) {
+                    ranked_or_taat_query ranked_or_taat_q(topk);
+                    ranked_or_taat_q.pair_aware_taat(
+                        make_max_scored_cursors(index, wdata, tier_data, scorer, query),
+                        num_docs,
+                        accumulator);
+                }),
+            expected);
+    }
+}
+
+TEST_CASE("Rank-safe SAAT returns the top-k of ranked OR", "[decompose][query]")
+{
+    SplitIndex data(60);
+    auto const& index = data.index;
+    auto const& wdata = *data.quantized_wdata;
+    auto const& tier_data = *data.tier_data;
+    auto scorer = scorer::from_params(ScorerParams("quantized"), wdata);
+    auto num_docs = index.num_docs();
+
+    // The top tiers in impact order, as written by `create_impact_index` with tier data
+    impact_ordered_index<index_type::block_codec_type> impact_index;
+    {
+        impact_ordered_index<index_type::block_codec_type>::builder builder(num_docs);
+        std::vector<std::uint32_t> docs;
+        std::vector<std::uint32_t> freqs;
+        for (std::uint32_t term = 0; term < index.size(); ++term) {
+            if (tier_data.top_tier(term) == term && tier_data.next_tier(term) != term) {
+                docs.clear();
+                freqs.clear();
+                for (auto list = index[term]; list.docid() < num_docs; list.next()) {
+                    docs.push_back(list.docid());
+                    freqs.push_back(list.freq());
+                }
+                builder.add_posting_list(docs.size(), docs.begin(), freqs.begin());
+            } else {
+                builder.add_empty_list();
+            }
+        }
+        builder.build(impact_index);
+    }
+    Lazy_Accumulator<4> accumulator(num_docs);
+
+    for (auto const& query: data.queries) {
+        CAPTURE(query.terms);
+        auto expected = run(data, query, false, [&](auto& topk) {
+            ranked_or_query ranked_or_q(topk);
+            ranked_or_q(make_scored_cursors(index, *scorer, query), num_docs);
+        });
+        auto docid_query = docid_ordered_query(impact_index, query);
+        REQUIRE(docid_query.terms.size() < query.terms.size());
+        require_same_scores(
+            run(data,
+                query,
+                false,
+                [&](auto& topk) {
+                    saat_query saat_q(topk);
+                    REQUIRE(saat_q.rank_safe(
+                        impact_index,
+                        query,
+                        make_max_scored_cursors(index, wdata, tier_data, *scorer, docid_query),
+                        num_docs,
+                        accumulator));
+                }),
+            expected);
+    }
+}
+
+TEST_CASE("MaxScore over HIGH then LOW lists returns the top-k of ranked OR", "[decompose][query]")
+{
+    SplitIndex data(60);
+    auto const& index = data.index;
+    auto const& wdata = *data.wdata;
+    auto const& scorer = *data.scorer;
+    auto num_docs = index.num_docs();
+
+    for (auto query: data.queries) {
+        CAPTURE(query.terms);
+        for (auto term: query.terms) {
+            query.is_high.push_back(decompose::parse_tier_name(data.lexicon[term])->tier == 0);
+        }
+        auto expected = run(data, query, false, [&](auto& topk) {
+            ranked_or_query ranked_or_q(topk);
+            ranked_or_q(make_scored_cursors(index, scorer, query), num_docs);
+        });
+        require_same_scores(
+            run(data,
+                query,
+                false,
+                [&](auto& topk) {
+                    maxscore_query maxscore_q(topk);
+                    maxscore_q.high_then_low(
+                        make_block_max_scored_cursors(index, wdata, scorer, get_high_query(query)),
+                        make_block_max_scored_cursors(index, wdata, scorer, get_low_query(query)),
+                        num_docs);
+                }),
+            expected);
+    }
+}
+
+TEST_CASE("Unbudgeted anytime ranges return the top-k of ranked OR", "[decompose][query]")
+{
+    SplitIndex data(60);
+    auto const& index = data.index;
+    auto const& wdata = *data.wdata;
+    auto const& tier_data = *data.tier_data;
+    auto const& scorer = *data.scorer;
+    auto num_docs = index.num_docs();
+    std::size_t range_size = 128;
+
+    // Runs `process_range` over the ranges of `cursors`, requiring exact results.
+    auto anytime = [&](Query const& query, auto make_cursors, auto process_range) {
+        return run(data, query, false, [&](auto& topk) {
+            anytime_range_query anytime_q(topk);
+            REQUIRE(anytime_q(make_cursors(query), num_docs, range_size, process_range(topk)));
+        });
+    };
+    auto cursors = [&](Query const& query) {
+        return make_block_max_scored_cursors(index, wdata, scorer, query);
+    };
+    auto tiered_cursors = [&](Query const& query) {
+        return make_block_max_scored_cursors(index, wdata, tier_data, scorer, query);
+    };
+
+    std::map<std::string, std::function<result_type(Query const&)>> algorithms;
+    algorithms["anytime_block_max_wand"] = [&](Query const& query) {
+        return anytime(query, cursors, [](auto& topk) {
+            return [&topk](auto& cursors, uint64_t end) {
+                block_max_wand_query block_max_wand_q(topk);
+                block_max_wand_q(cursors, end);
+            };
+        });
+    };
+    algorithms["anytime_pair_aware_block_max_wand"] = [&](Query const& query) {
+        return anytime(query, tiered_cursors, [](auto& topk) {
+            return [&topk](auto& cursors, uint64_t end) {
+                block_max_wand_query block_max_wand_q(topk);
+                block_max_wand_q.pair_aware_bmw(cursors, end);
+            };
+        });
+    };
+    algorithms["anytime_pair_aware_maxscore"] = [&](Query const& query) {
+        return anytime(query, tiered_cursors, [](auto& topk) {
+            return [&topk](auto& cursors, uint64_t end) {
+                maxscore_query maxscore_q(topk);
+                maxscore_q.pair_aware_maxscore(cursors, end);
+            };
+        });
+    };
+    algorithms["anytime_pair_aware_block_max_maxscore"] = [&](Query const& query) {
+        return anytime(query, tiered_cursors, [](auto& topk) {
+            return [&topk](auto& cursors, uint64_t end) {
+                block_max_maxscore_query block_max_maxscore_q(topk);
+                block_max_maxscore_q.pair_aware_block_max_maxscore(cursors, end);
+            };
+        });
+    };
+
+    for (auto const& query: data.queries) {
+        CAPTURE(query.terms);
+        auto expected = run(data, query, false, [&](auto& topk) {
+            ranked_or_query ranked_or_q(topk);
+            ranked_or_q(make_scored_cursors(index, scorer, query), num_docs);
+        });
+        for (auto const& [name, algorithm]: algorithms) {
+            CAPTURE(name);
+            require_same_scores(algorithm(query), expected);
+        }
+    }
+}
+
+TEST_CASE("Parallel ranges return the top-k of ranked OR", "[decompose][query]")
+{
+    SplitIndex data(60);
+    auto const& index = data.index;
+    auto const& wdata = *data.wdata;
+    auto const& tier_data = *data.tier_data;
+    auto const& scorer = *data.scorer;
+    auto num_docs = index.num_docs();
+    std::size_t range_size = 128;
+
+    auto parallel = [&](Query const& query, auto make_cursors, auto process_range) {
+        return run(data, query, false, [&](auto& topk) {
+            parallel_range_query parallel_q(topk);
+            parallel_q([&] { return make_cursors(query); }, num_docs, range_size, process_range);
+        });
+    };
+    auto cursors = [&](Query const& query) {
+        return make_max_scored_cursors(index, wdata, scorer, query);
+    };
+    auto tiered_cursors = [&](Query const& query) {
+        return make_max_scored_cursors(index, wdata, tier_data, scorer, query);
+    };
+    auto block_max_cursors = [&](Query const& query) {
+        return make_block_max_scored_cursors(index, wdata, scorer, query);
+    };
+    auto tiered_block_max_cursors = [&](Query const& query) {
+        return make_block_max_scored_cursors(index, wdata, tier_data, scorer, query);
+    };
+
+    std::map<std::string, std::function<result_type(Query const&)>> algorithms;
+    algorithms["parallel_maxscore"] = [&](Query const& query) {
+        return parallel(query, cursors, [](auto& range_topk, auto& cursors, uint64_t end) {
+            maxscore_query maxscore_q(range_topk);
+            maxscore_q(cursors, end);
+        });
+    };
+    algorithms["parallel_pair_aware_maxscore"] = [&](Query const& query) {
+        return parallel(query, tiered_cursors, [](auto& range_topk, auto& cursors, uint64_t end) {
+            maxscore_query maxscore_q(range_topk);
+            maxscore_q.pair_aware_maxscore(cursors, end);
+        });
+    };
+    algorithms["parallel_block_max_wand"] = [&](Query const& query) {
+        return parallel(
+            query, block_max_cursors, [](auto& range_topk, auto& cursors, uint64_t end) {
+                block_max_wand_query block_max_wand_q(range_topk);
+                block_max_wand_q(cursors, end);
+            });
+    };
+    algorithms["parallel_pair_aware_block_max_wand"] = [&](Query const& query) {
+        return parallel(
+            query, tiered_block_max_cursors, [](auto& range_topk, auto& cursors, uint64_t end) {
+                block_max_wand_query block_max_wand_q(range_topk);
+                block_max_wand_q.pair_aware_bmw(cursors, end);
+            });
+    };
+
+    for (auto const& query: data.queries) {
+        CAPTURE(query.terms);
+        auto expected = run(data, query, false, [&](auto& topk) {
+            ranked_or_query ranked_or_q(topk);
+            ranked_or_q(make_scored_cursors(index, scorer, query), num_docs);
+        });
+        for (auto const& [name, algorithm]: algorithms) {
+            CAPTURE(name);
+            require_same_scores(algorithm(query), expected);
+        }
+    }
+}
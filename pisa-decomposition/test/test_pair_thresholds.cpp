@@ -0,0 +1,116 @@
+#define CATCH_CONFIG_MAIN
+#include <catch2/catch.hpp>
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "mappable/mapper.hpp"
+#include "memory_source.hpp"
+#include "pair_thresholds.hpp"
+#include "temporary_directory.hpp"
+#include "tier_data.hpp"
+
+using namespace pisa;
+
+/// Wand data of a few lists, with only what tier data is built from.
+struct TestWandData {
+    std::vector<std::uint64_t> posting_counts;
+    std::vector<float> max_term_weights;
+
+    [[nodiscard]] auto term_posting_count(std::uint64_t list) const -> std::uint64_t
+    {
+        return posting_counts[list];
+    }
+    [[nodiscard]] auto max_term_weight(std::uint64_t list) const -> float
+    {
+        return max_term_weights[list];
+    }
+};
+
+auto make_query(std::vector<std::uint32_t> terms) -> Query
+{
+    Query query;
+    query.terms = std::move(terms);
+    return query;
+}
+
+TEST_CASE("Pair thresholds round-trip with the tiers of their terms", "[pair_thresholds]")
+{
+    Temporary_Directory tmpdir;
+    auto filename = (tmpdir.path() / "pairs").string();
+    {
+        PairThresholds::builder builder({100, 0, 10});
+        REQUIRE(builder.ranks() == std::vector<std::uint32_t>{10, 100});
+        builder.add({3, 4}, {0, 1}, {5.0F, 2.0F});
+        builder.add({0, 1}, {7}, {4.0F, 3.0F});
+        PairThresholds thresholds;
+        builder.build(thresholds);
+        mapper::freeze(thresholds, filename.c_str());
+    }
+    PairThresholds thresholds(MemorySource::mapped_file(filename));
+    REQUIRE(thresholds.size() == 2);
+
+    auto scores = thresholds.kth_scores(0, 3);
+    REQUIRE(scores);
+    REQUIRE(scores->ranks.size() == 2);
+    REQUIRE(scores->scores[0] == 5.0F);
+    REQUIRE(scores->scores[1] == 2.0F);
+    REQUIRE(thresholds.kth_scores(3, 0)->scores[0] == 5.0F);
+    REQUIRE_FALSE(thresholds.kth_scores(3, 7));
+
+    REQUIRE(std::vector<std::uint32_t>(thresholds.tiers(0)->begin(), thresholds.tiers(0)->end())
+            == std::vector<std::uint32_t>{0, 1});
+    REQUIRE(thresholds.tiers(7)->size() == 1);
+    REQUIRE_FALSE(thresholds.tiers(1));
+
+    SECTION("Queries holding every tier of both terms get the best pair threshold")
+    {
+        auto threshold = thresholds.threshold(make_query({0, 1, 3, 4, 7}), 10);
+        REQUIRE(threshold < 5.0F);
+        REQUIRE(threshold == Approx(5.0F));
+        REQUIRE(thresholds.threshold(make_query({0, 1, 3, 4}), 100) == Approx(2.0F));
+        REQUIRE(thresholds.threshold(make_query({7, 1, 0}), 100) == Approx(3.0F));
+        REQUIRE(thresholds.threshold(make_query({0, 1, 3, 4}), 1000) == 0.0F);
+    }
+    SECTION("Queries missing a tier of a term get no threshold from its pairs")
+    {
+        REQUIRE(thresholds.threshold(make_query({0, 3, 4}), 10) == 0.0F);
+        REQUIRE(thresholds.threshold(make_query({1, 3, 4}), 10) == 0.0F);
+        REQUIRE(thresholds.threshold(make_query({0, 1, 3, 7}), 10) == Approx(4.0F));
+    }
+}
+
+TEST_CASE("Pair thresholds reject inconsistent pairs", "[pair_thresholds]")
+{
+    PairThresholds::builder builder({10});
+    REQUIRE_THROWS_AS(builder.add({0}, {1}, {1.0F, 2.0F}), std::invalid_argument);
+    REQUIRE_THROWS_AS(builder.add({}, {1}, {1.0F}), std::invalid_argument);
+    builder.add({0, 1}, {2}, {1.0F});
+    REQUIRE_THROWS_AS(builder.add({0}, {3}, {1.0F}), std::invalid_argument);
+    builder.add({2}, {0, 1}, {1.0F});
+    PairThresholds thresholds;
+    REQUIRE_THROWS_AS(builder.build(thresholds), std::invalid_argument);
+}
+
+TEST_CASE("Base terms of a query", "[pair_thresholds]")
+{
+    using terms_type = std::map<std::uint32_t, std::vector<std::uint32_t>>;
+    // Lists 0 and 1 are the tiers of `a`, 2 the only tier of `b`, 3 and 4 the tiers of `c`.
+    std::vector<std::string> lexicon{"a_HIGH", "a_LOW", "b_LOW", "c_HIGH", "c_LOW"};
+    TestWandData wdata{{5, 50, 20, 3, 30}, {8.0F, 4.0F, 5.0F, 9.0F, 2.0F}};
+    TierData tier_data(lexicon, wdata, DecompositionMode::Split);
+
+    SECTION("From tier data, with the tiers the query does not hold")
+    {
+        auto terms = query_base_terms(make_query({1, 2, 3, 4}), &tier_data);
+        REQUIRE(terms == terms_type{{0, {0, 1}}, {2, {2}}, {3, {3, 4}}});
+    }
+    SECTION("From the term groups of the query")
+    {
+        auto query = make_query({1, 2, 3, 4});
+        query.term_groups.push_back(TermGroup{{3, 4}, 1, 0});
+        auto terms = query_base_terms(query, nullptr);
+        REQUIRE(terms == terms_type{{1, {1}}, {2, {2}}, {3, {3, 4}}});
+    }
+}
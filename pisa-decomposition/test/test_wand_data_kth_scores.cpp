@@ -0,0 +1,108 @@
+#define CATCH_CONFIG_MAIN
+#include <catch2/catch.hpp>
+
+#include <algorithm>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "binary_collection.hpp"
+#include "binary_freq_collection.hpp"
+#include "mappable/mapper.hpp"
+#include "memory_source.hpp"
+#include "scorer/scorer.hpp"
+#include "temporary_directory.hpp"
+#include "wand_data.hpp"
+#include "wand_data_compressed.hpp"
+#include "wand_data_raw.hpp"
+
+#include "decomposed_collection.hpp"
+
+using namespace pisa;
+
+TEMPLATE_TEST_CASE(
+    "Wand data stores the k-th scores of every list",
+    "[wand_data]",
+    wand_data<wand_data_raw>,
+    wand_data<wand_data_compressed<>>)
+{
+    Temporary_Directory tmpdir;
+    auto basename = (tmpdir.path() / "collection").string();
+    auto filename = (tmpdir.path() / "collection.wand").string();
+    write_decomposable_collection(basename, 300, 10, 17);
+    binary_freq_collection collection(basename.c_str());
+    binary_collection sizes((basename + ".sizes").c_str());
+
+    // Ranks are sorted and deduplicated, and zero is dropped.
+    std::vector<std::uint32_t> ranks{100, 0, 1, 10, 10};
+    std::vector<std::uint32_t> const expected_ranks{1, 10, 100};
+    TestType built(
+        sizes.begin()->begin(),
+        collection.num_docs(),
+        collection,
+        ScorerParams("bm25"),
+        FixedBlock(16),
+        false,
+        {},
+        ranks);
+    mapper::freeze(built, filename.c_str());
+    TestType wdata(MemorySource::mapped_file(filename));
+
+    auto scorer = scorer::from_params(ScorerParams("bm25"), wdata);
+    REQUIRE(wdata.num_terms() == collection.size());
+    std::size_t term = 0;
+    for (auto const& sequence: collection) {
+        CAPTURE(term);
+        auto term_scorer = scorer->term_scorer(term);
+        std::vector<float> scores;
+        auto freq = sequence.freqs.begin();
+        for (auto doc: sequence.docs) {
+            scores.push_back(term_scorer(doc, *freq++));
+        }
+        std::sort(scores.begin(), scores.end(), std::greater<>{});
+
+        auto kth_scores = wdata.kth_scores(term);
+        REQUIRE(std::vector<std::uint32_t>(kth_scores.ranks.begin(), kth_scores.ranks.end())
+                == expected_ranks);
+        for (std::size_t pos = 0; pos < expected_ranks.size(); ++pos) {
+            auto rank = expected_ranks[pos];
+            float expected = rank <= scores.size() ? scores[rank - 1] : 0.0F;
+            REQUIRE(kth_scores.scores[pos] == Approx(expected));
+        }
+        // Thresholds stay below the k-th score, so that k documents exceed them.
+        REQUIRE(kth_scores.at_least(5) == kth_scores.scores[1]);
+        REQUIRE(kth_scores.at_least(1000) == 0.0F);
+        if (scores.size() >= 10) {
+            REQUIRE(kth_scores.threshold(10, 2.0F) < 2.0F * scores[9]);
+            REQUIRE(kth_scores.threshold(10, 2.0F) == Approx(2.0F * scores[9]));
+        }
+
+        REQUIRE(wdata.max_term_weight(term) == Approx(built.max_term_weight(term)));
+        REQUIRE(wdata.term_posting_count(term) == sequence.docs.size());
+        auto blocks = wdata.getenum(term);
+        auto built_blocks = built.getenum(term);
+        for (auto doc: sequence.docs) {
+            blocks.next_geq(doc);
+            built_blocks.next_geq(doc);
+            REQUIRE(blocks.docid() == built_blocks.docid());
+            REQUIRE(blocks.score() == Approx(built_blocks.score()));
+        }
+        term += 1;
+    }
+}
+
+TEST_CASE("Wand data without k-th score ranks has no k-th scores", "[wand_data]")
+{
+    Temporary_Directory tmpdir;
+    auto basename = (tmpdir.path() / "collection").string();
+    auto filename = (tmpdir.path() / "collection.wand").string();
+    write_decomposable_collection(basename, 100, 4, 19);
+    create_wand_data(
+        filename, basename, FixedBlock(16), ScorerParams("bm25"), false, false, false, {}, {});
+    wand_data<wand_data_raw> wdata(MemorySource::mapped_file(filename));
+    REQUIRE(wdata.num_terms() == 4);
+    for (std::size_t term = 0; term < wdata.num_terms(); ++term) {
+        REQUIRE(wdata.kth_scores(term).ranks.empty());
+        REQUIRE(wdata.kth_scores(term).threshold(10, 1.0F) == 0.0F);
+    }
+}
@@ -12,9 +12,12 @@
 #include <spdlog/spdlog.h>
 
 #include "io.hpp"
+#include "memory_source.hpp"
+#include "query/binary_queries.hpp"
 #include "query/queries.hpp"
 #include "scorer/scorer.hpp"
 #include "sharding.hpp"
+#include "tier_data.hpp"
 #include "type_safe.hpp"
 #include "wand_utils.hpp"
 
@@ -95,6 +98,11 @@ namespace arg {
                    "--stopwords", m_stop_words, "List of blacklisted stop words to filter out")
                 ->needs(m_terms_option);
             app->add_option("--stemmer", m_stemmer, "Stemmer type")->needs(m_terms_option);
+            app->add_flag(
+                   "--undecorated",
+                   m_undecorated,
+                   "Queries are undecorated terms and --terms is a tier lexicon")
+                ->needs(m_terms_option);
 
             if constexpr (Mode == QueryMode::Ranked) {
                 app->add_option("-k", m_k, "The number of top results to return")->required();
@@ -109,10 +117,19 @@ namespace arg {
             return std::nullopt;
         }
 
+        /// Reads the queries, either as text or compiled with `compile_queries`.
         [[nodiscard]] auto queries() const -> std::vector<::pisa::Query>
         {
+            if (m_query_file && BinaryQueries::is_binary(*m_query_file)) {
+                if (m_term_lexicon) {
+                    spdlog::warn("Queries are compiled: ignoring --terms");
+                }
+                return BinaryQueries(MemorySource::mapped_file(*m_query_file)).queries();
+            }
             std::vector<::pisa::Query> q;
-            auto parse_query = resolve_query_parser(q, m_term_lexicon, m_stop_words, m_stemmer);
+            auto parse_query = m_undecorated
+                ? resolve_query_parser(q, std::nullopt, m_stop_words, m_stemmer, m_term_lexicon)
+                : resolve_query_parser(q, m_term_lexicon, m_stop_words, m_stemmer);
             if (m_query_file) {
                 std::ifstream is(*m_query_file);
                 io::for_each_line(is, parse_query);
@@ -134,6 +151,7 @@ namespace arg {
         std::optional<std::string> m_stop_words{std::nullopt};
         std::optional<std::string> m_stemmer{std::nullopt};
         std::optional<std::string> m_term_lexicon{std::nullopt};
+        bool m_undecorated = false;
         CLI::Option* m_terms_option{};
     };
 
@@ -230,6 +248,33 @@ namespace arg {
         CLI::Option* m_option;
     };
 
+    struct Tiers {
+        explicit Tiers(CLI::App* app)
+        {
+            auto tier_data = app->add_option(
+                "--tier-data", m_tier_data_path, "Tier data of a decomposed index (optional)");
+            app->add_option(
+                   "--decomposition",
+                   m_decomposition,
+                   "Decomposition mode of the index without tier data: split or clip",
+                   true)
+                ->check(CLI::IsMember({"split", "clip"}))
+                ->excludes(tier_data);
+        }
+
+        [[nodiscard]] auto tier_data_path() const { return m_tier_data_path; }
+
+        /// Decomposition mode of the index, which tier data records instead when given.
+        [[nodiscard]] auto decomposition() const -> DecompositionMode
+        {
+            return parse_decomposition_mode(m_decomposition);
+        }
+
+      private:
+        std::optional<std::string> m_tier_data_path;
+        std::string m_decomposition = "split";
+    };
+
     struct Verbose {
         explicit Verbose(CLI::App* app)
         {
@@ -310,6 +355,97 @@ namespace arg {
         std::optional<std::uint32_t> m_term_count{};
     };
 
+    struct Decompose {
+        explicit Decompose(CLI::App* app)
+        {
+            app->add_option("-c,--collection", m_input_basename, "Collection basename")->required();
+            app->add_option("-o,--output", m_output_basename, "Output collection basename")
+                ->required();
+            app->add_option(
+                   "--splits",
+                   m_splits,
+                   "File with a line per term of its tiers - 1 split points, in decreasing order")
+                ->required();
+            app->add_option("--mode", m_mode, "Decomposition mode: split or clip", true);
+            app->add_option(
+                "--batch-postings",
+                m_batch_postings,
+                "Number of input postings to decompose at a time",
+                true);
+        }
+
+        [[nodiscard]] auto input_basename() const -> std::string { return m_input_basename; }
+        [[nodiscard]] auto output_basename() const -> std::string { return m_output_basename; }
+        [[nodiscard]] auto splits() const -> std::string { return m_splits; }
+        [[nodiscard]] auto mode() const -> std::string { return m_mode; }
+        [[nodiscard]] auto batch_postings() const -> std::size_t { return m_batch_postings; }
+
+      private:
+        std::string m_input_basename{};
+        std::string m_output_basename{};
+        std::string m_splits{};
+        std::string m_mode = "split";
+        std::size_t m_batch_postings = 100'000'000;
+    };
+
+    /// Block options of tools that build WAND data: fixed-length or variable blocks.
+    struct WandBlocks {
+        explicit WandBlocks(CLI::App* app)
+        {
+            auto block_group = app->add_option_group("blocks");
+            m_block_size_option = block_group->add_option(
+                "-b,--block-size", m_fixed_block_size, "Block size for fixed-length blocks");
+            m_lambda_option =
+                block_group
+                    ->add_option("-l,--lambda", m_lambda, "Lambda parameter for variable blocks")
+                    ->excludes(m_block_size_option);
+            block_group->require_option();
+        }
+
+        [[nodiscard]] auto block_size() const -> BlockSize
+        {
+            if (m_lambda) {
+                spdlog::info("Lambda {}", *m_lambda);
+                return VariableBlock(*m_lambda);
+            }
+            spdlog::info("Fixed block size: {}", *m_fixed_block_size);
+            return FixedBlock(*m_fixed_block_size);
+        }
+        [[nodiscard]] auto lambda() const -> std::optional<float> { return m_lambda; }
+
+      protected:
+        [[nodiscard]] auto block_size_option() const -> CLI::Option* { return m_block_size_option; }
+        [[nodiscard]] auto lambda_option() const -> CLI::Option* { return m_lambda_option; }
+
+      private:
+        std::optional<float> m_lambda{};
+        std::optional<uint64_t> m_fixed_block_size{};
+        CLI::Option* m_block_size_option{};
+        CLI::Option* m_lambda_option{};
+    };
+
+    /// WAND data options for tools that build WAND data along with the index.
+    struct DecomposedWandData: public WandBlocks {
+        explicit DecomposedWandData(CLI::App* app) : WandBlocks(app), m_params("")
+        {
+            app->add_flag("--compress-wand", m_compress, "Compress additional data");
+            app->add_flag("--quantize-wand", m_quantize, "Quantize WAND data scores");
+            add_scorer_options(app, *this, ScorerMode::Required);
+        }
+
+        [[nodiscard]] auto scorer_params() const { return m_params; }
+        [[nodiscard]] auto compress_wand() const -> bool { return m_compress; }
+        [[nodiscard]] auto quantize_wand() const -> bool { return m_quantize; }
+
+        template <typename T>
+        friend CLI::Option* add_scorer_options(CLI::App* app, T& args, ScorerMode scorer_mode);
+
+      private:
+        ScorerParams m_params;
+        bool m_compress = false;
+        bool m_quantize = false;
+    };
+
     struct Compress {
         explicit Compress(CLI::App* app)
         {
@@ -335,44 +471,32 @@ namespace arg {
         bool m_check = false;
     };
 
-    struct CreateWandData {
-        explicit CreateWandData(CLI::App* app) : m_params("")
+    struct CreateWandData: public WandBlocks {
+        explicit CreateWandData(CLI::App* app) : WandBlocks(app), m_params("")
         {
             app->add_option("-c,--collection", m_input_basename, "Collection basename")->required();
             app->add_option("-o,--output", m_output, "Output filename")->required();
-            auto block_group = app->add_option_group("blocks");
-            auto block_size_opt = block_group->add_option(
-                "-b,--block-size", m_fixed_block_size, "Block size for fixed-length blocks");
-            auto block_lambda_opt =
-                block_group
-                    ->add_option("-l,--lambda", m_lambda, "Lambda parameter for variable blocks")
-                    ->excludes(block_size_opt);
-            block_group->require_option();
-
             app->add_flag("--compress", m_compress, "Compress additional data");
             app->add_flag("--quantize", m_quantize, "Quantize scores");
             add_scorer_options(app, *this, ScorerMode::Required);
             app->add_flag("--range", m_range, "Create docid-range based data")
-                ->excludes(block_size_opt)
-                ->excludes(block_lambda_opt);
+                ->excludes(block_size_option())
+                ->excludes(lambda_option());
             app->add_option(
                 "--terms-to-drop",
                 m_terms_to_drop_filename,
                 "A filename containing a list of term IDs that we want to drop");
+            app->add_option(
+                   "--kth-scores",
+                   m_kth_score_ranks,
+                   "Ranks k of the k-th largest scores stored for every list to prime queries",
+                   true)
+                ->delimiter(',');
         }
 
         [[nodiscard]] auto input_basename() const -> std::string { return m_input_basename; }
         [[nodiscard]] auto output() const -> std::string { return m_output; }
         [[nodiscard]] auto scorer_params() const { return m_params; }
-        [[nodiscard]] auto block_size() const -> BlockSize
-        {
-            if (m_lambda) {
-                spdlog::info("Lambda {}", *m_lambda);
-                return VariableBlock(*m_lambda);
-            }
-            spdlog::info("Fixed block size: {}", *m_fixed_block_size);
-            return FixedBlock(*m_fixed_block_size);
-        }
         [[nodiscard]] auto dropped_term_ids() const
         {
             std::ifstream dropped_terms_file(m_terms_to_drop_filename);
@@ -383,10 +507,13 @@ namespace arg {
                 std::inserter(dropped_term_ids, dropped_term_ids.end()));
             return dropped_term_ids;
         }
-        [[nodiscard]] auto lambda() const -> std::optional<float> { return m_lambda; }
         [[nodiscard]] auto compress() const -> bool { return m_compress; }
         [[nodiscard]] auto range() const -> bool { return m_range; }
         [[nodiscard]] auto quantize() const -> bool { return m_quantize; }
+        [[nodiscard]] auto kth_score_ranks() const -> std::vector<std::uint32_t> const&
+        {
+            return m_kth_score_ranks;
+        }
 
         /// Transform paths for `shard`.
         void apply_shard(Shard_Id shard)
@@ -399,8 +526,6 @@ namespace arg {
         friend CLI::Option* add_scorer_options(CLI::App* app, T& args, ScorerMode scorer_mode);
 
       private:
-        std::optional<float> m_lambda{};
-        std::optional<uint64_t> m_fixed_block_size{};
         std::string m_input_basename;
         std::string m_output;
         ScorerParams m_params;
@@ -408,6 +533,7 @@ namespace arg {
         bool m_range = false;
         bool m_quantize = false;
         std::string m_terms_to_drop_filename;
+        std::vector<std::uint32_t> m_kth_score_ranks = default_kth_score_ranks;
     };
 
     struct ReorderDocuments {
@@ -592,6 +718,9 @@ struct Args: public T... {
 };
 
 using InvertArgs = Args<arg::Invert, arg::Threads, arg::BatchSize<100'000>>;
+using DecomposeArgs = Args<arg::Decompose, arg::Threads>;
+using DecomposeCompressArgs =
+    Args<arg::Decompose, arg::Encoding, arg::DecomposedWandData, arg::Threads>;
 using ReorderDocuments = Args<arg::ReorderDocuments, arg::Threads>;
 using CompressArgs =
     pisa::Args<arg::Compress, arg::Encoding, arg::Quantize<arg::ScorerMode::Optional>>;
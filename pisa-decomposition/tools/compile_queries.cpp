@@ -0,0 +1,35 @@
+#include <string>
+
+#include "CLI/CLI.hpp"
+#include "spdlog/sinks/stdout_color_sinks.h"
+#include "spdlog/spdlog.h"
+
+#include "app.hpp"
+#include "mappable/mapper.hpp"
+#include "query/binary_queries.hpp"
+
+using namespace pisa;
+
+int main(int argc, const char** argv)
+{
+    spdlog::drop("");
+    spdlog::set_default_logger(spdlog::stderr_color_mt(""));
+
+    std::string output_filename;
+
+    App<arg::Query<arg::QueryMode::Unranked>> app{
+        "Compiles text queries into a binary file that query tools read without parsing."};
+    app.add_option("-o,--output", output_filename, "Output filename")->required();
+    CLI11_PARSE(app, argc, argv);
+
+    try {
+        auto queries = app.queries();
+        BinaryQueries compiled(queries);
+        mapper::freeze(compiled, output_filename.c_str());
+        spdlog::info("Compiled {} queries", compiled.size());
+    } catch (std::exception const& err) {
+        spdlog::error("{}", err.what());
+        return 1;
+    }
+    return 0;
+}
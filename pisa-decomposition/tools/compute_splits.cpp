@@ -0,0 +1,62 @@
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <stdexcept>
+
+#include "CLI/CLI.hpp"
+#include "spdlog/sinks/stdout_color_sinks.h"
+#include "spdlog/spdlog.h"
+#include "tbb/global_control.h"
+
+#include "app.hpp"
+#include "binary_freq_collection.hpp"
+#include "compute_splits.hpp"
+
+int main(int argc, char** argv)
+{
+    spdlog::set_default_logger(spdlog::stderr_color_mt(""));
+
+    std::string collection_basename;
+    std::optional<std::string> output;
+    std::string policy = "fraction";
+    pisa::decompose::SplitParams params;
+
+    pisa::App<pisa::arg::Threads> app{"Computes the split points of each list of a collection."};
+    app.add_option("-c,--collection", collection_basename, "Collection basename")->required();
+    app.add_option("-o,--output", output, "Output file (default: standard output)");
+    app.add_option("--policy", policy, "Split policy: fraction, impact, or topk", true);
+    app.add_option(
+        "--value",
+        params.value,
+        "Fraction denominator, absolute impact, or number of HIGH postings, depending on policy",
+        true);
+    app.add_option(
+        "--min-length", params.min_length, "Lists shorter than this are not decomposed", true);
+    app.add_option(
+        "--tiers", params.tiers, "Number of tiers; more than two requires the fraction policy", true);
+    CLI11_PARSE(app, argc, argv);
+
+    tbb::global_control control(tbb::global_control::max_allowed_parallelism, app.threads() + 1);
+    try {
+        params.policy = pisa::decompose::parse_split_policy(policy);
+        pisa::binary_freq_collection collection(collection_basename.c_str());
+        auto splits = pisa::decompose::compute_splits(collection, params);
+
+        std::ofstream file_output;
+        if (output) {
+            file_output.open(*output);
+        }
+        std::ostream& os = output ? file_output : std::cout;
+        for (std::size_t term = 0; term < splits.size(); ++term) {
+            auto points = splits[term];
+            for (std::size_t idx = 0; idx < points.size(); ++idx) {
+                os << (idx > 0 ? " " : "") << points[idx];
+            }
+            os << '\n';
+        }
+        return 0;
+    } catch (std::exception const& err) {
+        spdlog::error("{}", err.what());
+        return 1;
+    }
+}
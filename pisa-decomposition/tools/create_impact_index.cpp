@@ -0,0 +1,99 @@
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "CLI/CLI.hpp"
+#include "spdlog/spdlog.h"
+
+#include "app.hpp"
+#include "impact_ordered_index.hpp"
+#include "index_types.hpp"
+#include "mappable/mapper.hpp"
+#include "tier_data.hpp"
+#include "util/progress.hpp"
+
+using namespace pisa;
+
+/// Writes the lists of `index` in impact order, taking frequencies as impacts, so the index
+/// should be quantized. With tier data, only the top tiers of decomposed terms are written.
+template <typename IndexType>
+void create_impact_index(
+    std::string const& index_filename,
+    std::optional<std::string> const& tier_data_filename,
+    std::string const& output_filename)
+{
+    IndexType index(MemorySource::mapped_file(index_filename));
+    std::optional<TierData> tier_data;
+    if (tier_data_filename) {
+        tier_data.emplace(MemorySource::mapped_file(*tier_data_filename));
+        if (tier_data->size() != index.size()) {
+            throw std::invalid_argument(fmt::format(
+                "Tier data has {} lists but the index has {}", tier_data->size(), index.size()));
+        }
+    }
+
+    typename impact_ordered_index<typename IndexType::block_codec_type>::builder builder(
+        index.num_docs());
+    std::size_t lists = 0;
+    std::size_t postings = 0;
+    std::vector<std::uint32_t> docs;
+    std::vector<std::uint32_t> freqs;
+    {
+        pisa::progress progress("Reordering lists", index.size());
+        for (std::size_t term = 0; term < index.size(); ++term) {
+            bool high = not tier_data
+                || (tier_data->top_tier(term) == term && tier_data->next_tier(term) != term);
+            if (high) {
+                docs.clear();
+                freqs.clear();
+                for (auto list = index[term]; list.docid() < index.num_docs(); list.next()) {
+                    docs.push_back(list.docid());
+                    freqs.push_back(list.freq());
+                }
+                builder.add_posting_list(docs.size(), docs.begin(), freqs.begin());
+                lists += 1;
+                postings += docs.size();
+            } else {
+                builder.add_empty_list();
+            }
+            progress.update(1);
+        }
+    }
+    spdlog::info("Impact-ordered {} lists with {} postings", lists, postings);
+
+    impact_ordered_index<typename IndexType::block_codec_type> impact_index;
+    builder.build(impact_index);
+    mapper::freeze(impact_index, output_filename.c_str());
+}
+
+int main(int argc, const char** argv)
+{
+    std::string output_filename;
+
+    App<arg::Index, arg::Tiers> app{
+        "Writes the lists of a block index in impact order, for score-at-a-time processing."};
+    app.add_option("-o,--output", output_filename, "Output filename")->required();
+    CLI11_PARSE(app, argc, argv);
+
+    try {
+        /**/
+        if (false) {
+#define LOOP_BODY(R, DATA, T)                                                                  \
+    }                                                                                          \
+    else if (app.index_encoding() == BOOST_PP_STRINGIZE(T))                                    \
+    {                                                                                          \
+        create_impact_index<BOOST_PP_CAT(T, _index)>(                                          \
+            app.index_filename(), app.tier_data_path(), output_filename);                      \
+        /**/
+            BOOST_PP_SEQ_FOR_EACH(LOOP_BODY, _, PISA_BLOCK_INDEX_TYPES);
+#undef LOOP_BODY
+        } else {
+            spdlog::error("Unknown block index type {}", app.index_encoding());
+            return 1;
+        }
+    } catch (std::exception const& err) {
+        spdlog::error("{}", err.what());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,189 @@
+#include <algorithm>
+#include <map>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "CLI/CLI.hpp"
+#include "spdlog/spdlog.h"
+
+#include "app.hpp"
+#include "cursor/max_scored_cursor.hpp"
+#include "index_types.hpp"
+#include "mappable/mapper.hpp"
+#include "pair_thresholds.hpp"
+#include "query/algorithm/ranked_and_query.hpp"
+#include "scorer/scorer.hpp"
+#include "tier_data.hpp"
+#include "util/progress.hpp"
+#include "wand_data_compressed.hpp"
+#include "wand_data_raw.hpp"
+
+using namespace pisa;
+
+/// Mines the pairs of base terms co-occurring in at least `min_count` queries of the log, and
+/// writes the exact k-th scores of their conjunctions, every tier included.
+template <typename IndexType, typename WandType>
+void create_pair_thresholds(
+    std::string const& index_filename,
+    std::string const& wand_data_filename,
+    std::vector<Query> const& queries,
+    std::optional<std::string> const& tier_data_filename,
+    DecompositionMode decomposition,
+    ScorerParams const& scorer_params,
+    std::vector<std::uint32_t> const& ranks,
+    std::size_t min_count,
+    std::optional<std::size_t> max_pairs,
+    std::string const& output_filename)
+{
+    IndexType index(MemorySource::mapped_file(index_filename));
+    WandType const wdata(MemorySource::mapped_file(wand_data_filename));
+    std::optional<TierData> tier_data;
+    if (tier_data_filename) {
+        tier_data.emplace(MemorySource::mapped_file(*tier_data_filename));
+        decomposition = tier_data->mode();
+    }
+    // Pair thresholds are computed and used by pair-aware algorithms.
+    if (not supports_decomposition("pair_aware_ranked_and", decomposition)) {
+        throw std::invalid_argument("Pair thresholds require a split index");
+    }
+    auto scorer = scorer::from_params(scorer_params, wdata);
+
+    using lists_type = std::vector<std::uint32_t>;
+    std::map<std::pair<std::uint32_t, std::uint32_t>, std::size_t> counts;
+    std::map<std::uint32_t, lists_type> tiers;
+    for (auto const& query: queries) {
+        auto terms = query_base_terms(query, tier_data ? &*tier_data : nullptr);
+        for (auto first = terms.begin(); first != terms.end(); ++first) {
+            for (auto second = std::next(first); second != terms.end(); ++second) {
+                counts[{first->first, second->first}] += 1;
+            }
+        }
+        tiers.insert(terms.begin(), terms.end());
+    }
+
+    std::vector<std::pair<std::pair<std::uint32_t, std::uint32_t>, std::size_t>> pairs;
+    std::copy_if(counts.begin(), counts.end(), std::back_inserter(pairs), [&](auto const& pair) {
+        return pair.second >= min_count;
+    });
+    std::stable_sort(pairs.begin(), pairs.end(), [](auto const& lhs, auto const& rhs) {
+        return lhs.second > rhs.second;
+    });
+    if (max_pairs && pairs.size() > *max_pairs) {
+        pairs.resize(*max_pairs);
+    }
+    spdlog::info("Selected {} of {} term pairs", pairs.size(), counts.size());
+
+    PairThresholds::builder builder(ranks);
+    if (builder.ranks().empty()) {
+        throw std::invalid_argument("At least one positive rank is required");
+    }
+    auto const max_rank = builder.ranks().back();
+    {
+        pisa::progress progress("Computing pair thresholds", pairs.size());
+        for (auto const& [pair, count]: pairs) {
+            auto const& [first, second] = pair;
+            Query query;
+            for (auto base: {first, second}) {
+                auto const& lists = tiers[base];
+                query.terms.insert(query.terms.end(), lists.begin(), lists.end());
+                query.term_groups.push_back(TermGroup{lists, 1, query.term_groups.size()});
+            }
+            topk_queue topk(max_rank);
+            ranked_and_query ranked_and_q(topk);
+            ranked_and_q.pair_aware_ranked_and(
+                make_max_scored_cursors(index, wdata, *scorer, query), index.num_docs());
+            topk.finalize();
+
+            std::vector<float> scores;
+            for (auto rank: builder.ranks()) {
+                scores.push_back(rank <= topk.topk().size() ? topk.topk()[rank - 1].first : 0.0F);
+            }
+            builder.add(tiers[first], tiers[second], scores);
+            progress.update(1);
+        }
+    }
+
+    PairThresholds thresholds;
+    builder.build(thresholds);
+    mapper::freeze(thresholds, output_filename.c_str());
+}
+
+using wand_raw_index = wand_data<wand_data_raw>;
+using wand_uniform_index = wand_data<wand_data_compressed<>>;
+using wand_uniform_index_quantized = wand_data<wand_data_compressed<PayloadType::Quantized>>;
+
+int main(int argc, const char** argv)
+{
+    std::string output_filename;
+    std::vector<std::uint32_t> ranks = default_kth_score_ranks;
+    std::size_t min_count = 2;
+    std::optional<std::size_t> max_pairs;
+    bool quantized = false;
+
+    App<arg::Index,
+        arg::WandData<arg::WandMode::Required>,
+        arg::Query<arg::QueryMode::Ranked>,
+        arg::Scorer,
+        arg::Tiers>
+        app{"Stores the k-th scores of the conjunctions of term pairs frequent in a query log, "
+            "to prime the top-k threshold of queries."};
+    app.add_option("-o,--output", output_filename, "Output filename")->required();
+    app.add_option(
+           "--kth-scores",
+           ranks,
+           "Ranks k of the k-th scores stored for every pair, besides -k",
+           true)
+        ->delimiter(',');
+    app.add_option(
+        "--min-count", min_count, "Minimum number of queries in which a pair occurs", true);
+    app.add_option("--max-pairs", max_pairs, "Maximum number of pairs, most frequent first");
+    app.add_flag("--quantized", quantized, "Quantized scores");
+    CLI11_PARSE(app, argc, argv);
+    ranks.push_back(app.k());
+
+    auto params = std::make_tuple(
+        app.index_filename(),
+        app.wand_data_path(),
+        app.queries(),
+        app.tier_data_path(),
+        app.decomposition(),
+        app.scorer_params(),
+        ranks,
+        min_count,
+        max_pairs,
+        output_filename);
+
+    try {
+        /**/
+        if (false) {
+#define LOOP_BODY(R, DATA, T)                                                                  \
+    }                                                                                          \
+    else if (app.index_encoding() == BOOST_PP_STRINGIZE(T))                                    \
+    {                                                                                          \
+        using index_type = BOOST_PP_CAT(T, _index);                                            \
+        if (app.is_wand_compressed()) {                                                        \
+            if (quantized) {                                                                   \
+                std::apply(                                                                    \
+                    create_pair_thresholds<index_type, wand_uniform_index_quantized>, params); \
+            } else {                                                                           \
+                std::apply(create_pair_thresholds<index_type, wand_uniform_index>, params);    \
+            }                                                                                  \
+        } else {                                                                               \
+            std::apply(create_pair_thresholds<index_type, wand_raw_index>, params);            \
+        }                                                                                      \
+        /**/
+            BOOST_PP_SEQ_FOR_EACH(LOOP_BODY, _, PISA_INDEX_TYPES);
+#undef LOOP_BODY
+        } else {
+            spdlog::error("Unknown type {}", app.index_encoding());
+            return 1;
+        }
+    } catch (std::exception const& err) {
+        spdlog::error("{}", err.what());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,63 @@
+#include <string>
+
+#include "CLI/CLI.hpp"
+#include "spdlog/spdlog.h"
+
+#include "app.hpp"
+#include "decompose.hpp"
+#include "tier_data.hpp"
+#include "wand_data.hpp"
+#include "wand_data_compressed.hpp"
+#include "wand_data_raw.hpp"
+
+using namespace pisa;
+
+template <typename WandType>
+void create_tier_data(
+    std::string const& terms_filename,
+    std::string const& wand_data_filename,
+    std::string const& output_filename,
+    DecompositionMode mode)
+{
+    WandType const wdata(MemorySource::mapped_file(wand_data_filename));
+    auto lexicon = decompose::read_lexicon(terms_filename);
+    if (lexicon.size() != wdata.num_terms()) {
+        throw std::invalid_argument(fmt::format(
+            "Lexicon has {} terms but WAND data has {} lists",
+            lexicon.size(),
+            wdata.num_terms()));
+    }
+    TierData tier_data(lexicon, wdata, mode);
+    mapper::freeze(tier_data, output_filename.c_str());
+}
+
+int main(int argc, const char** argv)
+{
+    std::string terms_filename;
+    std::string output_filename;
+    std::string mode;
+
+    App<arg::WandData<arg::WandMode::Required>> app{
+        "Links the tier lists of a decomposed index for query processing."};
+    app.add_option("--terms", terms_filename, "Lexicon of the decomposed index")->required();
+    app.add_option("-o,--output", output_filename, "Output filename")->required();
+    app.add_option("--mode", mode, "Decomposition mode of the index: split or clip")
+        ->required()
+        ->check(CLI::IsMember({"split", "clip"}));
+    CLI11_PARSE(app, argc, argv);
+
+    try {
+        auto decomposition = parse_decomposition_mode(mode);
+        if (app.is_wand_compressed()) {
+            create_tier_data<wand_data<wand_data_compressed<>>>(
+                terms_filename, app.wand_data_path(), output_filename, decomposition);
+        } else {
+            create_tier_data<wand_data<wand_data_raw>>(
+                terms_filename, app.wand_data_path(), output_filename, decomposition);
+        }
+    } catch (std::exception const& err) {
+        spdlog::error("{}", err.what());
+        return 1;
+    }
+    return 0;
+}
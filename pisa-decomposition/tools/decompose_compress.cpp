@@ -0,0 +1,35 @@
+#include <stdexcept>
+
+#include "CLI/CLI.hpp"
+#include "spdlog/spdlog.h"
+#include "tbb/global_control.h"
+
+#include "app.hpp"
+#include "decompose.hpp"
+
+int main(int argc, char** argv)
+{
+    CLI::App app{"Decomposes a collection into HIGH and LOW lists and compresses them directly "
+                 "into a block index with its WAND data."};
+    pisa::DecomposeCompressArgs args(&app);
+    CLI11_PARSE(app, argc, argv);
+    tbb::global_control control(tbb::global_control::max_allowed_parallelism, args.threads() + 1);
+    spdlog::info("Number of worker threads: {}", args.threads());
+    try {
+        pisa::decompose::decompose_and_compress(
+            args.input_basename(),
+            args.output_basename(),
+            args.splits(),
+            pisa::parse_decomposition_mode(args.mode()),
+            args.index_encoding(),
+            args.scorer_params(),
+            args.block_size(),
+            args.compress_wand(),
+            args.quantize_wand(),
+            args.batch_postings());
+        return 0;
+    } catch (std::exception const& err) {
+        spdlog::error("{}", err.what());
+        return 1;
+    }
+}
@@ -1,6 +1,10 @@
+#include <atomic>
+#include <chrono>
 #include <iostream>
 #include <optional>
 #include <thread>
+#include <type_traits>
+#include <variant>
 
 #include <CLI/CLI.hpp>
 #include <boost/algorithm/string/classification.hpp>
@@ -19,10 +23,13 @@
 #include "cursor/block_max_scored_cursor.hpp"
 #include "cursor/max_scored_cursor.hpp"
 #include "cursor/scored_cursor.hpp"
+#include "impact_ordered_index.hpp"
 #include "index_types.hpp"
 #include "io.hpp"
+#include "pair_thresholds.hpp"
 #include "query/algorithm.hpp"
 #include "scorer/scorer.hpp"
+#include "tier_data.hpp"
 #include "util/util.hpp"
 #include "wand_data_compressed.hpp"
 #include "wand_data_raw.hpp"
@@ -39,19 +46,76 @@ void evaluate_queries(
     const std::string& wand_data_filename,
     const std::vector<Query>& queries,
     const std::optional<std::string>& thresholds_filename,
+    const std::optional<std::string>& tier_data_filename,
+    DecompositionMode decomposition,
     std::string const& type,
     std::string const& query_type,
     uint64_t k,
     std::string const& documents_filename,
     ScorerParams const& scorer_params,
     std::string const& run_id,
-    std::string const& iteration)
+    std::string const& iteration,
+    std::optional<std::string> const& impact_index_filename,
+    QueryBudget budget,
+    std::optional<std::string> const& pair_thresholds_filename,
+    std::size_t range_size)
 {
     IndexType index(MemorySource::mapped_file(index_filename));
     WandType const wdata(MemorySource::mapped_file(wand_data_filename));
 
+    std::optional<TierData> tier_data;
+    if (tier_data_filename) {
+        tier_data.emplace(MemorySource::mapped_file(*tier_data_filename));
+        decomposition = tier_data->mode();
+    }
+    if (not supports_decomposition(query_type, decomposition)) {
+        spdlog::error("Query type {} does not support clipped indexes", query_type);
+        return;
+    }
+    // Score-at-a-time algorithms bound and accumulate the stored impacts.
+    if ((query_type == "saat" || query_type == "saat_safe") && scorer_params.name != "quantized") {
+        spdlog::error("Query type {} requires the quantized scorer", query_type);
+        return;
+    }
+
+    using impact_index_type = typename impact_index_for<IndexType>::type;
+    std::optional<impact_index_type> impact_index;
+    if (impact_index_filename) {
+        if constexpr (std::is_same_v<impact_index_type, std::monostate>) {
+            throw std::invalid_argument("Impact-ordered lists require a block index");
+        } else {
+            impact_index.emplace(MemorySource::mapped_file(*impact_index_filename));
+        }
+    }
+
+    std::optional<PairThresholds> pair_thresholds;
+    if (pair_thresholds_filename) {
+        pair_thresholds.emplace(MemorySource::mapped_file(*pair_thresholds_filename));
+    }
+    // The `*_prime` algorithms also start from the best pair threshold of the query.
+    auto primed = [&](Query const& query) {
+        if (pair_thresholds) {
+            return pair_thresholds->threshold(query, k);
+        }
+        return 0.0F;
+    };
+
     auto scorer = scorer::from_params(scorer_params, wdata);
+    auto tiered_cursors = [&](Query const& query) {
+        if (tier_data) {
+            return make_max_scored_cursors(index, wdata, *tier_data, *scorer, query);
+        }
+        return make_max_scored_cursors(index, wdata, *scorer, query, decomposition);
+    };
+    auto tiered_block_max_cursors = [&](Query const& query) {
+        if (tier_data) {
+            return make_block_max_scored_cursors(index, wdata, *tier_data, *scorer, query);
+        }
+        return make_block_max_scored_cursors(index, wdata, *scorer, query, decomposition);
+    };
     std::function<std::vector<std::pair<float, uint64_t>>(Query)> query_fun;
+    // Queries of anytime algorithms whose results are not provably exact
+    std::atomic<std::size_t> inexact{0};
 
     if (query_type == "wand") {
         query_fun = [&](Query query) {
@@ -64,6 +128,7 @@ void evaluate_queries(
     } else if (query_type == "wand_prime") {
         query_fun = [&](Query query) {
             topk_queue topk(k);
+            topk.set_threshold(primed(query));
             wand_query wand_q(topk);
             wand_q(make_max_scored_cursors(index, wdata, *scorer, query), index.num_docs(), true);
             topk.finalize();
@@ -74,15 +139,16 @@ void evaluate_queries(
         query_fun = [&](Query query) {
             topk_queue topk(k);
             wand_query wand_q(topk);
-            wand_q.pair_aware_wand(make_max_scored_cursors(index, wdata, *scorer, query), index.num_docs());
+            wand_q.pair_aware_wand(tiered_cursors(query), index.num_docs());
             topk.finalize();
             return topk.topk();
         };
     } else if (query_type == "pair_aware_wand_prime") {
         query_fun = [&](Query query) {
             topk_queue topk(k);
+            topk.set_threshold(primed(query));
             wand_query wand_q(topk);
-            wand_q.pair_aware_wand(make_max_scored_cursors(index, wdata, *scorer, query), index.num_docs(), true);
+            wand_q.pair_aware_wand(tiered_cursors(query), index.num_docs(), true);
             topk.finalize();
             return topk.topk();
         };
@@ -116,13 +182,14 @@ void evaluate_queries(
             topk_queue topk(k);
             block_max_wand_query block_max_wand_q(topk);
             block_max_wand_q.pair_aware_bmw(
-                make_block_max_scored_cursors(index, wdata, *scorer, query), index.num_docs());
+                tiered_block_max_cursors(query), index.num_docs());
             topk.finalize();
             return topk.topk();
         };
     } else if (query_type == "block_max_wand_prime") {
         query_fun = [&](Query query) {
             topk_queue topk(k);
+            topk.set_threshold(primed(query));
             block_max_wand_query block_max_wand_q(topk);
             block_max_wand_q(
                 make_block_max_scored_cursors(index, wdata, *scorer, query), index.num_docs(), true);
@@ -132,9 +199,10 @@ void evaluate_queries(
     } else if (query_type == "pair_aware_block_max_wand_prime") {
         query_fun = [&](Query query) {
             topk_queue topk(k);
+            topk.set_threshold(primed(query));
             block_max_wand_query block_max_wand_q(topk);
             block_max_wand_q.pair_aware_bmw(
-                make_block_max_scored_cursors(index, wdata, *scorer, query), index.num_docs(), true);
+                tiered_block_max_cursors(query), index.num_docs(), true);
             topk.finalize();
             return topk.topk();
         };
@@ -166,6 +234,25 @@ void evaluate_queries(
             topk.finalize();
             return topk.topk();
         };
+    } else if (query_type == "pair_aware_block_max_maxscore") {
+        query_fun = [&](Query query) {
+            topk_queue topk(k);
+            block_max_maxscore_query block_max_maxscore_q(topk);
+            block_max_maxscore_q.pair_aware_block_max_maxscore(
+                tiered_block_max_cursors(query), index.num_docs());
+            topk.finalize();
+            return topk.topk();
+        };
+    } else if (query_type == "pair_aware_block_max_maxscore_prime") {
+        query_fun = [&](Query query) {
+            topk_queue topk(k);
+            topk.set_threshold(primed(query));
+            block_max_maxscore_query block_max_maxscore_q(topk);
+            block_max_maxscore_q.pair_aware_block_max_maxscore(
+                tiered_block_max_cursors(query), index.num_docs(), true);
+            topk.finalize();
+            return topk.topk();
+        };
     } else if (query_type == "block_max_ranked_and") {
         query_fun = [&](Query query) {
             topk_queue topk(k);
@@ -183,6 +270,23 @@ void evaluate_queries(
             topk.finalize();
             return topk.topk();
         };
+    } else if (query_type == "pair_aware_ranked_and") {
+        query_fun = [&](Query query) {
+            topk_queue topk(k);
+            ranked_and_query ranked_and_q(topk);
+            ranked_and_q.pair_aware_ranked_and(tiered_cursors(query), index.num_docs());
+            topk.finalize();
+            return topk.topk();
+        };
+    } else if (query_type == "pair_aware_block_max_ranked_and") {
+        query_fun = [&](Query query) {
+            topk_queue topk(k);
+            block_max_ranked_and_query block_max_ranked_and_q(topk);
+            block_max_ranked_and_q.pair_aware_block_max_ranked_and(
+                tiered_block_max_cursors(query), index.num_docs());
+            topk.finalize();
+            return topk.topk();
+        };
     } else if (query_type == "ranked_or") {
         query_fun = [&](Query query) {
             topk_queue topk(k);
@@ -202,6 +306,7 @@ void evaluate_queries(
     } else if (query_type == "maxscore_prime") {
         query_fun = [&](Query query) {
             topk_queue topk(k);
+            topk.set_threshold(primed(query));
             maxscore_query maxscore_q(topk);
             maxscore_q(make_max_scored_cursors(index, wdata, *scorer, query), index.num_docs(), true);
             topk.finalize();
@@ -218,6 +323,7 @@ void evaluate_queries(
     } else if (query_type == "ls_maxscore_prime") {
         query_fun = [&](Query query) {
             topk_queue topk(k);
+            topk.set_threshold(primed(query));
             maxscore_query maxscore_q(topk);
             maxscore_q.length_sorted_maxscore(make_max_scored_cursors(index, wdata, *scorer, query), index.num_docs(), true);
             topk.finalize();
@@ -227,15 +333,16 @@ void evaluate_queries(
         query_fun = [&](Query query) {
             topk_queue topk(k);
             maxscore_query maxscore_q(topk);
-            maxscore_q.pair_aware_maxscore(make_max_scored_cursors(index, wdata, *scorer, query), index.num_docs());
+            maxscore_q.pair_aware_maxscore(tiered_cursors(query), index.num_docs());
             topk.finalize();
             return topk.topk();
         };
     } else if (query_type == "pair_aware_maxscore_prime") {
         query_fun = [&](Query query) {
             topk_queue topk(k);
+            topk.set_threshold(primed(query));
             maxscore_query maxscore_q(topk);
-            maxscore_q.pair_aware_maxscore(make_max_scored_cursors(index, wdata, *scorer, query), index.num_docs(), true);
+            maxscore_q.pair_aware_maxscore(tiered_cursors(query), index.num_docs(), true);
             topk.finalize();
             return topk.topk();
         };
@@ -247,8 +354,8 @@ void evaluate_queries(
             topk_queue topk(k);
             maxscore_query maxscore_q(topk);
             maxscore_q.high_then_low(
-                make_max_scored_cursors(index, wdata, *scorer, high_query),
-                make_max_scored_cursors(index, wdata, *scorer, low_query),
+                make_block_max_scored_cursors(index, wdata, *scorer, high_query),
+                make_block_max_scored_cursors(index, wdata, *scorer, low_query),
                 index.num_docs());
             topk.finalize();
             return topk.topk();
@@ -271,6 +378,177 @@ void evaluate_queries(
             topk.finalize();
             return topk.topk();
         };
+    } else if (query_type == "pair_aware_ranked_or_taat") {
+        query_fun = [&, accumulator = Lazy_Accumulator<4>(index.num_docs())](Query query) mutable {
+            topk_queue topk(k);
+            ranked_or_taat_query ranked_or_taat_q(topk);
+            ranked_or_taat_q.pair_aware_taat(tiered_cursors(query), index.num_docs(), accumulator);
+            topk.finalize();
+            return topk.topk();
+        };
+    } else if (query_type == "anytime_block_max_wand") {
+        query_fun = [&](Query query) {
+            topk_queue topk(k);
+            anytime_range_query anytime_q(topk);
+            block_max_wand_query block_max_wand_q(topk);
+            bool exact = anytime_q(
+                make_block_max_scored_cursors(index, wdata, *scorer, query),
+                index.num_docs(),
+                range_size,
+                [&](auto& cursors, uint64_t end) { block_max_wand_q(cursors, end); },
+                budget);
+            if (not exact) {
+                inexact += 1;
+            }
+            topk.finalize();
+            return topk.topk();
+        };
+    } else if (query_type == "anytime_pair_aware_block_max_wand") {
+        query_fun = [&](Query query) {
+            topk_queue topk(k);
+            anytime_range_query anytime_q(topk);
+            block_max_wand_query block_max_wand_q(topk);
+            bool exact = anytime_q(
+                tiered_block_max_cursors(query),
+                index.num_docs(),
+                range_size,
+                [&](auto& cursors, uint64_t end) { block_max_wand_q.pair_aware_bmw(cursors, end); },
+                budget);
+            if (not exact) {
+                inexact += 1;
+            }
+            topk.finalize();
+            return topk.topk();
+        };
+    } else if (query_type == "anytime_pair_aware_maxscore") {
+        query_fun = [&](Query query) {
+            topk_queue topk(k);
+            anytime_range_query anytime_q(topk);
+            maxscore_query maxscore_q(topk);
+            bool exact = anytime_q(
+                tiered_block_max_cursors(query),
+                index.num_docs(),
+                range_size,
+                [&](auto& cursors, uint64_t end) { maxscore_q.pair_aware_maxscore(cursors, end); },
+                budget);
+            if (not exact) {
+                inexact += 1;
+            }
+            topk.finalize();
+            return topk.topk();
+        };
+    } else if (query_type == "anytime_pair_aware_block_max_maxscore") {
+        query_fun = [&](Query query) {
+            topk_queue topk(k);
+            anytime_range_query anytime_q(topk);
+            block_max_maxscore_query block_max_maxscore_q(topk);
+            bool exact = anytime_q(
+                tiered_block_max_cursors(query),
+                index.num_docs(),
+                range_size,
+                [&](auto& cursors, uint64_t end) {
+                    block_max_maxscore_q.pair_aware_block_max_maxscore(cursors, end);
+                },
+                budget);
+            if (not exact) {
+                inexact += 1;
+            }
+            topk.finalize();
+            return topk.topk();
+        };
+    } else if (query_type == "parallel_maxscore") {
+        query_fun = [&](Query query) {
+            topk_queue topk(k);
+            parallel_range_query parallel_q(topk);
+            parallel_q(
+                [&] { return make_max_scored_cursors(index, wdata, *scorer, query); },
+                index.num_docs(),
+                range_size,
+                [&](auto& range_topk, auto& cursors, uint64_t end) {
+                    maxscore_query maxscore_q(range_topk);
+                    maxscore_q(cursors, end);
+                });
+            topk.finalize();
+            return topk.topk();
+        };
+    } else if (query_type == "parallel_pair_aware_maxscore") {
+        query_fun = [&](Query query) {
+            topk_queue topk(k);
+            parallel_range_query parallel_q(topk);
+            parallel_q(
+                [&] { return tiered_cursors(query); },
+                index.num_docs(),
+                range_size,
+                [&](auto& range_topk, auto& cursors, uint64_t end) {
+                    maxscore_query maxscore_q(range_topk);
+                    maxscore_q.pair_aware_maxscore(cursors, end);
+                });
+            topk.finalize();
+            return topk.topk();
+        };
+    } else if (query_type == "parallel_block_max_wand") {
+        query_fun = [&](Query query) {
+            topk_queue topk(k);
+            parallel_range_query parallel_q(topk);
+            parallel_q(
+                [&] { return make_block_max_scored_cursors(index, wdata, *scorer, query); },
+                index.num_docs(),
+                range_size,
+                [&](auto& range_topk, auto& cursors, uint64_t end) {
+                    block_max_wand_query block_max_wand_q(range_topk);
+                    block_max_wand_q(cursors, end);
+                });
+            topk.finalize();
+            return topk.topk();
+        };
+    } else if (query_type == "parallel_pair_aware_block_max_wand") {
+        query_fun = [&](Query query) {
+            topk_queue topk(k);
+            parallel_range_query parallel_q(topk);
+            parallel_q(
+                [&] { return tiered_block_max_cursors(query); },
+                index.num_docs(),
+                range_size,
+                [&](auto& range_topk, auto& cursors, uint64_t end) {
+                    block_max_wand_query block_max_wand_q(range_topk);
+                    block_max_wand_q.pair_aware_bmw(cursors, end);
+                });
+            topk.finalize();
+            return topk.topk();
+        };
+    } else if (query_type == "saat" && impact_index) {
+        if constexpr (not std::is_same_v<impact_index_type, std::monostate>) {
+            query_fun = [&, accumulator = Lazy_Accumulator<4>(index.num_docs())](
+                            Query query) mutable {
+                topk_queue topk(k);
+                saat_query saat_q(topk);
+                if (not saat_q(*impact_index, query, accumulator, budget)) {
+                    inexact += 1;
+                }
+                topk.finalize();
+                return topk.topk();
+            };
+        }
+    } else if (query_type == "saat_safe" && impact_index) {
+        if constexpr (not std::is_same_v<impact_index_type, std::monostate>) {
+            query_fun = [&, accumulator = Lazy_Accumulator<4>(index.num_docs())](
+                            Query query) mutable {
+                topk_queue topk(k);
+                saat_query saat_q(topk);
+                bool exact = saat_q.rank_safe(
+                    *impact_index,
+                    query,
+                    tiered_cursors(docid_ordered_query(*impact_index, query)),
+                    index.num_docs(),
+                    accumulator,
+                    budget);
+                if (not exact) {
+                    inexact += 1;
+                }
+                topk.finalize();
+                return topk.topk();
+            };
+        }
     } else {
         spdlog::error("Unsupported query type: {}", query_type);
     }
@@ -306,6 +584,9 @@ void evaluate_queries(
         std::chrono::duration_cast<std::chrono::milliseconds>(end_print - start_batch).count();
     spdlog::info("Time taken to process queries: {}ms", batch_ms);
     spdlog::info("Time taken to process queries with printing: {}ms", batch_with_print_ms);
+    if (inexact > 0) {
+        spdlog::info("Results of {} queries are not provably exact", inexact.load());
+    }
 }
 
 using wand_raw_index = wand_data<wand_data_raw>;
@@ -319,6 +600,12 @@ int main(int argc, const char** argv)
     std::string documents_file;
     std::string run_id = "R0";
     bool quantized = false;
+    std::optional<std::string> impact_index_filename;
+    QueryBudget budget;
+    std::optional<std::size_t> postings_budget;
+    std::optional<std::int64_t> time_budget;
+    std::optional<std::string> pair_thresholds_filename;
+    std::size_t range_size = 1U << 20U;
 
     App<arg::Index,
         arg::WandData<arg::WandMode::Required>,
@@ -326,13 +613,37 @@ int main(int argc, const char** argv)
         arg::Algorithm,
         arg::Scorer,
         arg::Thresholds,
+        arg::Tiers,
         arg::Threads>
         app{"Retrieves query results in TREC format."};
     app.add_option("-r,--run", run_id, "Run identifier");
     app.add_option("--documents", documents_file, "Document lexicon")->required();
     app.add_flag("--quantized", quantized, "Quantized scores");
+    app.add_option(
+        "--impact-index",
+        impact_index_filename,
+        "Impact-ordered lists for score-at-a-time algorithms (see create_impact_index)");
+    app.add_option(
+        "--postings-budget", postings_budget, "Postings processed per query by anytime algorithms");
+    app.add_option(
+        "--time-budget", time_budget, "Microseconds of processing per query by anytime algorithms");
+    app.add_option(
+        "--range-size",
+        range_size,
+        "Documents per docid range of anytime_* and parallel_* algorithms",
+        true);
+    app.add_option(
+        "--pair-thresholds",
+        pair_thresholds_filename,
+        "Pair thresholds priming the *_prime algorithms (see create_pair_thresholds)");
 
     CLI11_PARSE(app, argc, argv);
+    if (postings_budget) {
+        budget.postings = *postings_budget;
+    }
+    if (time_budget) {
+        budget.time = std::chrono::microseconds(*time_budget);
+    }
 
     tbb::global_control control(tbb::global_control::max_allowed_parallelism, app.threads() + 1);
     spdlog::info("Number of worker threads: {}", app.threads());
@@ -348,13 +659,19 @@ int main(int argc, const char** argv)
         app.wand_data_path(),
         app.queries(),
         app.thresholds_file(),
+        app.tier_data_path(),
+        app.decomposition(),
         app.index_encoding(),
         app.algorithm(),
         app.k(),
         documents_file,
         app.scorer_params(),
         run_id,
-        iteration);
+        iteration,
+        impact_index_filename,
+        budget,
+        pair_thresholds_filename,
+        range_size);
 
     /**/
     if (false) {  // NOLINT
@@ -3,7 +3,9 @@
 #include <spdlog/spdlog.h>
 
 #include "io.hpp"
+#include "mappable/mapper.hpp"
 #include "payload_vector.hpp"
+#include "tier_lexicon.hpp"
 
 using namespace pisa;
 
@@ -19,6 +21,11 @@ int main(int argc, char** argv)
     auto build = app.add_subcommand("build", "Build a lexicon");
     build->add_option("input", text_file, "Input text file")->required();
     build->add_option("output", lexicon_file, "Output file")->required();
+    auto build_tiers =
+        app.add_subcommand("build-tiers", "Build a lexicon of base terms of a decomposed index");
+    build_tiers->add_option("input", text_file, "Input text file with decorated list names")
+        ->required();
+    build_tiers->add_option("output", lexicon_file, "Output file")->required();
     auto lookup = app.add_subcommand("lookup", "Retrieve the payload at index");
     lookup->add_option("lexicon", lexicon_file, "Lexicon file path")->required();
     lookup->add_option("idx", idx, "Index of requested element")->required();
@@ -37,6 +44,14 @@ int main(int argc, char** argv)
                 .to_file(lexicon_file);
             return 0;
         }
+        if (*build_tiers) {
+            std::vector<std::string> names;
+            std::ifstream is(text_file);
+            io::for_each_line(is, [&](auto&& name) { names.push_back(std::move(name)); });
+            TierLexicon lexicon(names);
+            mapper::freeze(lexicon, lexicon_file.c_str());
+            return 0;
+        }
         mio::mmap_source m(lexicon_file.c_str());
         auto lexicon = Payload_Vector<>::from(m);
         if (*print) {
@@ -0,0 +1,177 @@
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <unordered_map>
+
+#include <CLI/CLI.hpp>
+#include <spdlog/sinks/stdout_color_sinks.h>
+#include <spdlog/spdlog.h>
+#include <tbb/global_control.h>
+#include <tbb/parallel_for.h>
+
+#include "app.hpp"
+#include "cursor/max_scored_cursor.hpp"
+#include "index_types.hpp"
+#include "memory_source.hpp"
+#include "query/algorithm/wand_query.hpp"
+#include "scorer/scorer.hpp"
+#include "split_cost_model.hpp"
+#include "wand_data_compressed.hpp"
+#include "wand_data_raw.hpp"
+
+using namespace pisa;
+using namespace pisa::decompose;
+
+struct OptimizeSplitsParams {
+    DecompositionMode mode = DecompositionMode::Clip;
+    double budget = 0.1;
+    std::size_t passes = 5;
+    std::size_t min_length = 256;
+};
+
+template <typename IndexType, typename WandType>
+void optimize_splits(
+    std::string const& index_filename,
+    std::string const& wand_data_filename,
+    std::vector<Query> const& queries,
+    std::uint64_t k,
+    OptimizeSplitsParams const& params,
+    std::ostream& os)
+{
+    IndexType index(MemorySource::mapped_file(index_filename));
+    WandType const wdata(MemorySource::mapped_file(wand_data_filename));
+    auto scorer = scorer::from_params(ScorerParams("quantized"), wdata);
+
+    spdlog::info("Computing thresholds of {} training queries", queries.size());
+    std::vector<float> thresholds(queries.size(), 0.0);
+    tbb::parallel_for(std::size_t(0), queries.size(), [&](std::size_t query) {
+        topk_queue topk(k);
+        wand_query wand_q(topk);
+        wand_q(make_max_scored_cursors(index, wdata, *scorer, queries[query]), index.num_docs());
+        topk.finalize();
+        if (topk.topk().size() == k) {
+            thresholds[query] = topk.topk().back().first;
+        }
+    });
+
+    std::unordered_map<term_id_type, std::uint32_t> modeled_ids;
+    std::vector<term_id_type> modeled_terms;
+    std::vector<ModeledQuery> modeled_queries;
+    for (std::size_t query = 0; query < queries.size(); ++query) {
+        ModeledQuery modeled{thresholds[query], {}};
+        for (auto [term, weight]: query_freqs(queries[query].terms)) {
+            auto [pos, inserted] = modeled_ids.emplace(term, modeled_terms.size());
+            if (inserted) {
+                modeled_terms.push_back(term);
+            }
+            modeled.terms.emplace_back(pos->second, static_cast<float>(weight));
+        }
+        modeled_queries.push_back(std::move(modeled));
+    }
+
+    spdlog::info("Reading impacts of {} query terms", modeled_terms.size());
+    std::vector<std::vector<SplitCandidate>> candidates(modeled_terms.size());
+    tbb::parallel_for(std::size_t(0), modeled_terms.size(), [&](std::size_t idx) {
+        auto list = index[modeled_terms[idx]];
+        ImpactCounts counts(1, 0);
+        for (std::size_t pos = 0; pos < list.size(); ++pos, list.next()) {
+            auto freq = list.freq();
+            if (freq >= counts.size()) {
+                counts.resize(freq + 1, 0);
+            }
+            counts[freq] += 1;
+        }
+        candidates[idx] = split_candidates(counts, params.mode, params.min_length);
+    });
+
+    std::uint64_t postings = 0;
+    for (std::size_t term = 0; term < index.size(); ++term) {
+        postings += index[term].size();
+    }
+    auto budget = static_cast<std::uint64_t>(params.budget * postings);
+    spdlog::info("Budget: {} extra postings ({} of {})", budget, params.budget, postings);
+
+    SplitCostModel model(std::move(candidates), std::move(modeled_queries), params.mode);
+    auto initial_cost = model.total_cost();
+    model.optimize(budget, params.passes);
+    spdlog::info("Modeled cost: {} -> {} postings", initial_cost, model.total_cost());
+    spdlog::info("Extra postings: {}", model.extra_postings());
+
+    std::vector<std::uint64_t> splits(index.size(), no_split);
+    for (std::uint32_t idx = 0; idx < modeled_terms.size(); ++idx) {
+        splits[modeled_terms[idx]] = model.candidate(idx).split;
+    }
+    for (auto split: splits) {
+        os << split << '\n';
+    }
+}
+
+using wand_raw_index = wand_data<wand_data_raw>;
+using wand_uniform_index = wand_data<wand_data_compressed<>>;
+
+int main(int argc, const char** argv)
+{
+    spdlog::drop("");
+    spdlog::set_default_logger(spdlog::stderr_color_mt(""));
+
+    std::string mode = "clip";
+    std::optional<std::string> output;
+    OptimizeSplitsParams params;
+
+    App<arg::Index,
+        arg::WandData<arg::WandMode::Required>,
+        arg::Query<arg::QueryMode::Ranked>,
+        arg::Threads>
+        app{"Chooses the split point of each term to minimize the cost of a training query log."};
+    app.add_option("--mode", mode, "Decomposition mode: split or clip", true);
+    app.add_option(
+        "--budget",
+        params.budget,
+        "Maximum number of duplicated postings, as a fraction of the index postings",
+        true);
+    app.add_option("--passes", params.passes, "Maximum number of optimization passes", true);
+    app.add_option(
+        "--min-length", params.min_length, "Lists shorter than this are not decomposed", true);
+    app.add_option("-o,--output", output, "Output file (default: standard output)");
+    CLI11_PARSE(app, argc, argv);
+
+    tbb::global_control control(tbb::global_control::max_allowed_parallelism, app.threads() + 1);
+
+    std::ofstream file_output;
+    if (output) {
+        file_output.open(*output);
+    }
+    std::ostream& os = output ? file_output : std::cout;
+
+    try {
+        params.mode = parse_decomposition_mode(mode);
+        auto run = std::make_tuple(
+            app.index_filename(),
+            app.wand_data_path(),
+            app.queries(),
+            app.k(),
+            params,
+            std::ref(os));
+        if (false) {
+#define LOOP_BODY(R, DATA, T)                                                                    \
+    }                                                                                            \
+    else if (app.index_encoding() == BOOST_PP_STRINGIZE(T))                                      \
+    {                                                                                            \
+        if (app.is_wand_compressed()) {                                                          \
+            std::apply(optimize_splits<BOOST_PP_CAT(T, _index), wand_uniform_index>, run);       \
+        } else {                                                                                 \
+            std::apply(optimize_splits<BOOST_PP_CAT(T, _index), wand_raw_index>, run);           \
+        }
+            /**/
+            BOOST_PP_SEQ_FOR_EACH(LOOP_BODY, _, PISA_INDEX_TYPES);
+#undef LOOP_BODY
+        } else {
+            spdlog::error("Unknown type {}", app.index_encoding());
+            return 1;
+        }
+    } catch (std::exception const& err) {
+        spdlog::error("{}", err.what());
+        return 1;
+    }
+    return 0;
+}
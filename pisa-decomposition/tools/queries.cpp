@@ -1,8 +1,22 @@
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <functional>
 #include <iostream>
 #include <numeric>
 #include <optional>
+#include <random>
+#include <sstream>
 #include <string>
+#include <thread>
+#include <type_traits>
+#include <variant>
+
+#ifdef __linux__
+#include <pthread.h>
+#endif
 
 #include <CLI/CLI.hpp>
 #include <boost/algorithm/string/classification.hpp>
@@ -20,11 +34,16 @@
 #include "cursor/cursor.hpp"
 #include "cursor/max_scored_cursor.hpp"
 #include "cursor/scored_cursor.hpp"
+#include "impact_ordered_index.hpp"
 #include "index_types.hpp"
 #include "mappable/mapper.hpp"
 #include "memory_source.hpp"
+#include "pair_thresholds.hpp"
+#include "perf_counters.hpp"
 #include "query/algorithm.hpp"
+#include "query/counters.hpp"
 #include "scorer/scorer.hpp"
+#include "tier_data.hpp"
 #include "timer.hpp"
 #include "topk_queue.hpp"
 #include "util/util.hpp"
@@ -37,9 +56,30 @@
 using namespace pisa;
 using ranges::views::enumerate;
 
-template <typename Fn>
+/// Formats the threshold trajectory of `work` as comma-separated `documents:threshold` pairs.
+[[nodiscard]] auto format_thresholds(QueryWork const& work) -> std::string
+{
+    if (work.thresholds.empty()) {
+        return "-";
+    }
+    std::string formatted;
+    for (auto&& [documents, threshold]: work.thresholds) {
+        if (not formatted.empty()) {
+            formatted += ',';
+        }
+        formatted += fmt::format("{}:{}", documents, threshold);
+    }
+    return formatted;
+}
+
+/// Prints the mean time of every query, followed by the work counted by a separate, untimed run
+/// of `counted_fn`, which records it in `work` and then calls `on_work(query, qid)`.
+template <typename Fn, typename CountedFn, typename OnWork>
 void extract_times(
     Fn fn,
+    CountedFn counted_fn,
+    QueryWork& work,
+    OnWork on_work,
     std::vector<Query> const& queries,
     std::vector<Threshold> const& thresholds,
     std::string const& index_type,
@@ -56,8 +96,83 @@ void extract_times(
                 .count();
         });
         auto mean = std::accumulate(times.begin(), times.end(), std::size_t{0}, std::plus<>()) / runs;
-        os << fmt::format("{}\t{}\n", query.id.value_or(std::to_string(qid)), mean);
+        work.clear();
+        do_not_optimize_away(counted_fn(query, thresholds[qid]));
+        auto id = query.id.value_or(std::to_string(qid));
+        on_work(query, id);
+        os << fmt::format(
+            "{}\t{}\t{}\t{}\t{}\t{}\t{}\t{}\t{}\t{}\n",
+            id,
+            mean,
+            work.documents,
+            work.postings,
+            work.next_geqs,
+            work.blocks,
+            work.block_max_skips,
+            work.pivots,
+            work.inserts,
+            format_thresholds(work));
+    }
+}
+
+/// Writes the cursor traces of `work` for query `qid`, whose lists are classified after the
+/// flags of `query`.
+void write_cursor_traces(
+    std::ostream& os,
+    std::string const& query_type,
+    std::string const& qid,
+    Query const& query,
+    QueryWork const& work)
+{
+    for (auto const& trace: work.cursor_traces) {
+        auto position = std::find(query.terms.begin(), query.terms.end(), trace.term);
+        auto pos = static_cast<std::size_t>(std::distance(query.terms.begin(), position));
+        std::string list_class = "-";
+        if (pos < query.is_high.size()) {
+            list_class = query.is_high[pos] ? "high" : "low";
+        }
+        write_cursor_trace(os, query_type, qid, trace.term, list_class, trace.calls);
+    }
+}
+
+/// Named statistics of a benchmark, e.g., `avg`, as reported in stats lines.
+using QueryStats = std::vector<std::pair<std::string, double>>;
+
+/// Logs and returns the mean, median and 99th percentile per query of the hardware events counted
+/// in `samples`, along with the instructions per cycle, as statistics to report.
+[[nodiscard]] auto perf_counter_stats(std::vector<PerfSample> const& samples) -> QueryStats
+{
+    QueryStats stats;
+    auto const& perf = PerfCounters::this_thread();
+    PerfSample total;
+    for (auto const& sample: samples) {
+        total += sample;
+    }
+    for (auto event: perf_events) {
+        if (not perf.counts(event)) {
+            continue;
+        }
+        std::vector<double> counts(samples.size());
+        std::transform(samples.begin(), samples.end(), counts.begin(), [event](auto const& sample) {
+            return sample[event];
+        });
+        std::sort(counts.begin(), counts.end());
+        std::string name = perf_event_name(event);
+        double avg = total[event] / samples.size();
+        double q50 = counts[counts.size() / 2];
+        double q99 = counts[99 * counts.size() / 100];
+        spdlog::info("Mean {}: {} (50% quantile: {}, 99% quantile: {})", name, avg, q50, q99);
+        stats.emplace_back(name + "_avg", avg);
+        stats.emplace_back(name + "_q50", q50);
+        stats.emplace_back(name + "_q99", q99);
     }
+    if (perf.counts(PerfEvent::Cycles) && perf.counts(PerfEvent::Instructions)
+        && total[PerfEvent::Cycles] > 0) {
+        double ipc = total[PerfEvent::Instructions] / total[PerfEvent::Cycles];
+        spdlog::info("Instructions per cycle: {}", ipc);
+        stats.emplace_back("ipc", ipc);
+    }
+    return stats;
 }
 
 template <typename Functor>
@@ -120,7 +235,7 @@ void op_perftest(
 }
 
 template <typename Functor>
-void op_perftest_parallel(
+auto op_perftest_parallel(
     Functor query_func,
     std::vector<Query> const& queries,
     std::vector<Threshold> const& thresholds,
@@ -128,19 +243,27 @@ void op_perftest_parallel(
     std::string const& query_type,
     size_t runs,
     std::uint64_t k,
-    bool safe)
+    bool safe,
+    bool perf_counters) -> QueryStats
 {
     std::vector<double> query_times;
-    std::size_t num_reruns = 0;
+    std::atomic<std::size_t> num_reruns{0};
     spdlog::info("Safe: {}", safe);
 
 
     query_times.resize(queries.size() * runs);
+    std::vector<PerfSample> samples(perf_counters ? query_times.size() : 0);
 
     auto start_batch = std::chrono::steady_clock::now();
     for (size_t run = 0; run <= runs; ++run) {
+        if (run == 1) {  // first run is not timed
+            start_batch = std::chrono::steady_clock::now();
+        }
         // Run queries in parallel
         tbb::parallel_for(size_t(0), queries.size(), [&, query_func](size_t query_idx) {
+            if (perf_counters) {
+                PerfCounters::this_thread().start();
+            }
             auto usecs = run_with_timer<std::chrono::microseconds>([&]() {
                 uint64_t result = query_func(queries[query_idx], thresholds[query_idx]);
                 if (safe && result < k) {
@@ -149,15 +272,22 @@ void op_perftest_parallel(
                 }
                 do_not_optimize_away(result);
             });
+            auto sample = perf_counters ? PerfCounters::this_thread().stop() : PerfSample{};
             if (run != 0) {
                 query_times[(run-1) * queries.size() + query_idx] = usecs.count();
+                if (perf_counters) {
+                    samples[(run - 1) * queries.size() + query_idx] = sample;
+                }
             }
         });
     }
     auto end_batch = std::chrono::steady_clock::now();
     double batch_ms =
-        std::chrono::duration_cast<std::chrono::milliseconds>(end_batch - start_batch).count();
- 
+        std::chrono::duration_cast<std::chrono::microseconds>(end_batch - start_batch).count()
+        / 1000.0;
+    double qps = query_times.size() / (batch_ms / 1000.0);
+
+    QueryStats stats;
     if (false) {
         for (auto t: query_times) {
             std::cout << (t / 1000) << std::endl;
@@ -177,13 +307,183 @@ void op_perftest_parallel(
         spdlog::info("90% quantile: {}", q90);
         spdlog::info("95% quantile: {}", q95);
         spdlog::info("99% quantile: {}", q99);
-        spdlog::info("Num. reruns: {}", num_reruns);
+        spdlog::info("Throughput: {} queries/s over {} ms", qps, batch_ms);
+        spdlog::info("Num. reruns: {}", num_reruns.load());
 
-        stats_line()("type", index_type)("query", query_type)("avg", avg)("q50", q50)("q90", q90)(
-            "q95", q95)("q99", q99);
+        stats = {
+            {"avg", avg}, {"q50", q50}, {"q90", q90}, {"q95", q95}, {"q99", q99}, {"qps", qps}};
+        if (perf_counters) {
+            auto perf_stats = perf_counter_stats(samples);
+            stats.insert(stats.end(), perf_stats.begin(), perf_stats.end());
+        }
+
+        stats_line line;
+        line("type", index_type)("query", query_type);
+        for (auto&& [key, value]: stats) {
+            line(key, value);
+        }
+    }
+    return stats;
+}
+
+/// Open-loop load: queries of the log arrive at `rate` per second, whether or not the workers
+/// keep up, with fixed or exponentially distributed (Poisson) gaps between arrivals.
+struct LoadTest {
+    double rate = 0.0;
+    bool poisson = true;
+    std::vector<std::size_t> threads;
+};
+
+/// Offsets from the start of a load test at which each of `count` queries arrives.
+[[nodiscard]] auto arrival_times(std::size_t count, LoadTest const& load)
+    -> std::vector<std::chrono::nanoseconds>
+{
+    std::vector<std::chrono::nanoseconds> arrivals(count);
+    std::mt19937_64 rng;  // Default seed, so that every test replays the same arrivals
+    std::exponential_distribution<double> gap(load.rate);
+    double seconds = 0.0;
+    for (auto& arrival: arrivals) {
+        arrival = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::duration<double>(seconds));
+        seconds += load.poisson ? gap(rng) : 1.0 / load.rate;
+    }
+    return arrivals;
+}
+
+/// Pins the calling thread to a core, so that workers do not migrate during a load test.
+void pin_thread(std::size_t thread)
+{
+#ifdef __linux__
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(thread % std::max(1U, std::thread::hardware_concurrency()), &cpus);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) != 0) {
+        spdlog::warn("Could not pin worker thread {}", thread);
+    }
+#endif
+}
+
+/// Replays `runs` times the query log at the arrival rate of `load`, for each of its numbers of
+/// worker threads. Idle workers take the next query in arrival order, so its latency is the
+/// queueing delay from its arrival until a worker starts it, plus its service time.
+template <typename Functor>
+void op_loadtest(
+    Functor query_func,
+    std::vector<Query> const& queries,
+    std::vector<Threshold> const& thresholds,
+    std::string const& index_type,
+    std::string const& query_type,
+    size_t runs,
+    std::uint64_t k,
+    bool safe,
+    LoadTest const& load,
+    bool perf_counters)
+{
+    using clock = std::chrono::steady_clock;
+    auto usecs = [](clock::duration elapsed) {
+        return std::chrono::duration_cast<std::chrono::duration<double, std::micro>>(elapsed)
+            .count();
+    };
+    auto quantile = [](std::vector<double> const& sorted, double q) {
+        return sorted[std::min(sorted.size() - 1, static_cast<std::size_t>(q * sorted.size()))];
+    };
+    auto mean = [](std::vector<double> const& times) {
+        return std::accumulate(times.begin(), times.end(), double()) / times.size();
+    };
+
+    // first run is not timed
+    for (size_t idx = 0; idx < queries.size(); ++idx) {
+        do_not_optimize_away(query_func(queries[idx], thresholds[idx]));
+    }
+
+    auto const count = queries.size() * runs;
+    auto const arrivals = arrival_times(count, load);
+    for (auto threads: load.threads) {
+        std::vector<double> queueing(count);
+        std::vector<double> service(count);
+        std::vector<double> latency(count);
+        std::vector<PerfSample> samples(perf_counters ? count : 0);
+        std::vector<clock::time_point> finished(threads);
+        std::atomic<std::size_t> next{0};
+        std::atomic<std::size_t> num_reruns{0};
+
+        auto const start = clock::now();
+        auto worker = [&, query_func](std::size_t thread) {
+            pin_thread(thread);
+            finished[thread] = start;
+            for (auto request = next++; request < count; request = next++) {
+                auto const arrived = start + arrivals[request];
+                std::this_thread::sleep_until(arrived);
+                if (perf_counters) {
+                    PerfCounters::this_thread().start();
+                }
+                auto const begin = clock::now();
+                auto const idx = request % queries.size();
+                uint64_t result = query_func(queries[idx], thresholds[idx]);
+                if (safe && result < k) {
+                    num_reruns += 1;
+                    result = query_func(queries[idx], 0);
+                }
+                do_not_optimize_away(result);
+                auto const end = clock::now();
+                if (perf_counters) {
+                    samples[request] = PerfCounters::this_thread().stop();
+                }
+                queueing[request] = usecs(begin - arrived);
+                service[request] = usecs(end - begin);
+                latency[request] = usecs(end - arrived);
+                finished[thread] = end;
+            }
+        };
+        std::vector<std::thread> workers;
+        for (std::size_t thread = 0; thread < threads; ++thread) {
+            workers.emplace_back(worker, thread);
+        }
+        for (auto& thread: workers) {
+            thread.join();
+        }
+
+        auto const elapsed = *std::max_element(finished.begin(), finished.end()) - start;
+        double qps = count / (usecs(elapsed) / 1'000'000.0);
+        for (auto* times: {&queueing, &service, &latency}) {
+            std::sort(times->begin(), times->end());
+        }
+
+        spdlog::info("---- {} {} with {} threads", index_type, query_type, threads);
+        spdlog::info("Offered load: {} queries/s", load.rate);
+        spdlog::info("Throughput: {} queries/s", qps);
+        spdlog::info("Mean latency: {}", mean(latency));
+        spdlog::info("50% quantile: {}", quantile(latency, 0.5));
+        spdlog::info("90% quantile: {}", quantile(latency, 0.9));
+        spdlog::info("99% quantile: {}", quantile(latency, 0.99));
+        spdlog::info("99.9% quantile: {}", quantile(latency, 0.999));
+        spdlog::info("Mean queueing delay: {}", mean(queueing));
+        spdlog::info("Mean service time: {}", mean(service));
+        spdlog::info("Num. reruns: {}", num_reruns.load());
+        auto perf_stats = perf_counters ? perf_counter_stats(samples) : QueryStats{};
+
+        stats_line line;
+        line("type", index_type)("query", query_type)("threads", threads)(
+            "arrival", load.poisson ? "poisson" : "fixed")("offered_qps", load.rate)("qps", qps)(
+            "avg", mean(latency))("q50", quantile(latency, 0.5))("q90", quantile(latency, 0.9))(
+            "q99", quantile(latency, 0.99))("q999", quantile(latency, 0.999))(
+            "queue_avg", mean(queueing))("queue_q50", quantile(queueing, 0.5))(
+            "queue_q99", quantile(queueing, 0.99))("service_avg", mean(service))(
+            "service_q50", quantile(service, 0.5))("service_q99", quantile(service, 0.99));
+        for (auto&& [key, value]: perf_stats) {
+            line(key, value);
+        }
     }
 }
 
+/// Runs queries of a type, e.g., `wand`, retrieving the top k, on an index loaded for a sweep.
+/// Returns the statistics of the run, or nothing if the index does not support the type.
+using SweepRunner =
+    std::function<std::optional<QueryStats>(std::string const& query_type, std::uint64_t k)>;
+
+/// Called by `perftest` in a sweep with a runner of the index it loaded, which stays loaded until
+/// the call returns.
+using SweepContinuation = std::function<void(SweepRunner const&)>;
 
 template <typename IndexType, typename WandType>
 void perftest(
@@ -191,12 +491,23 @@ void perftest(
     const std::optional<std::string>& wand_data_filename,
     const std::vector<Query>& queries,
     const std::optional<std::string>& thresholds_filename,
+    const std::optional<std::string>& tier_data_filename,
+    DecompositionMode decomposition,
     std::string const& type,
     std::string const& query_type,
     uint64_t k,
     const ScorerParams& scorer_params,
     bool extract,
-    bool safe)
+    bool safe,
+    bool integer_scores,
+    std::optional<std::string> const& impact_index_filename,
+    QueryBudget budget,
+    std::optional<std::string> const& pair_thresholds_filename,
+    std::size_t range_size,
+    std::optional<LoadTest> const& load,
+    bool perf_counters,
+    std::optional<std::string> const& trace_filename,
+    SweepContinuation const& sweep)
 {
     spdlog::info("Loading index from {}", index_filename);
     IndexType index(MemorySource::mapped_file(index_filename));
@@ -233,6 +544,43 @@ void perftest(
         }
     }
 
+    std::optional<TierData> tier_data;
+    if (tier_data_filename) {
+        tier_data.emplace(MemorySource::mapped_file(*tier_data_filename));
+        decomposition = tier_data->mode();
+    }
+
+    using impact_index_type = typename impact_index_for<IndexType>::type;
+    std::optional<impact_index_type> impact_index;
+    if (impact_index_filename) {
+        if constexpr (std::is_same_v<impact_index_type, std::monostate>) {
+            throw std::invalid_argument("Impact-ordered lists require a block index");
+        } else {
+            spdlog::info("Loading impact-ordered lists from {}", *impact_index_filename);
+            impact_index.emplace(MemorySource::mapped_file(*impact_index_filename));
+        }
+    }
+
+    std::optional<PairThresholds> pair_thresholds;
+    if (pair_thresholds_filename) {
+        spdlog::info("Loading pair thresholds from {}", *pair_thresholds_filename);
+        pair_thresholds.emplace(MemorySource::mapped_file(*pair_thresholds_filename));
+    }
+
+    std::optional<std::ofstream> traces;
+    if (trace_filename) {
+        spdlog::info("Tracing cursors to {}", *trace_filename);
+        traces.emplace(*trace_filename);
+    }
+
+    // The `*_prime` algorithms also start from the best pair threshold of the query.
+    auto primed = [&](Query const& query, Threshold t) {
+        if (pair_thresholds) {
+            return std::max(t, pair_thresholds->threshold(query, k));
+        }
+        return t;
+    };
+
     auto scorer = scorer::from_params(scorer_params, wdata);
 
     spdlog::info("Performing {} queries", type);
@@ -241,292 +589,909 @@ void perftest(
     std::vector<std::string> query_types;
     boost::algorithm::split(query_types, query_type, boost::is_any_of(":"));
 
-    for (auto&& t: query_types) {
-        spdlog::info("Query type: {}", t);
-        std::function<uint64_t(Query, Threshold)> query_fun;
-        if (t == "and") {
-            query_fun = [&](Query query, Threshold) {
-                and_query and_q;
-                return and_q(make_cursors(index, query), index.num_docs()).size();
-            };
-        } else if (t == "or") {
-            query_fun = [&](Query query, Threshold) {
-                or_query<false> or_q;
-                return or_q(make_cursors(index, query), index.num_docs());
-            };
-        } else if (t == "or_freq") {
-            query_fun = [&](Query query, Threshold) {
-                or_query<true> or_q;
-                return or_q(make_cursors(index, query), index.num_docs());
-            };
-        } else if (t == "wand" && wand_data_filename) {
-            query_fun = [&](Query query, Threshold t) {
-                topk_queue topk(k);
-                topk.set_threshold(t);
-                wand_query wand_q(topk);
-                wand_q(make_max_scored_cursors(index, wdata, *scorer, query), index.num_docs());
-                topk.finalize();
-                return topk.topk().size();
-            };
-        } else if (t == "wand_prime" && wand_data_filename) {
-            query_fun = [&](Query query, Threshold t) {
-                topk_queue topk(k);
-                topk.set_threshold(t);
-                wand_query wand_q(topk);
-                wand_q(make_max_scored_cursors(index, wdata, *scorer, query), index.num_docs(), true);
-                topk.finalize();
-                return topk.topk().size();
-            };
-        } else if (t == "pair_aware_wand" && wand_data_filename) {
-            query_fun = [&](Query query, Threshold t) {
-                topk_queue topk(k);
-                topk.set_threshold(t);
-                wand_query wand_q(topk);
-                wand_q.pair_aware_wand(make_max_scored_cursors(index, wdata, *scorer, query), index.num_docs());
-                topk.finalize();
-                return topk.topk().size();
-            };
-        } else if (t == "pair_aware_wand_prime" && wand_data_filename) {
-            query_fun = [&](Query query, Threshold t) {
-                topk_queue topk(k);
-                topk.set_threshold(t);
-                wand_query wand_q(topk);
-                wand_q.pair_aware_wand(make_max_scored_cursors(index, wdata, *scorer, query), index.num_docs(), true);
-                topk.finalize();
-                return topk.topk().size();
-            };
-        } else if (t == "wand_pair" && wand_data_filename) {
-            query_fun = [&](Query query, Threshold t) {
-                topk_queue topk(k);
-                topk.set_threshold(t);
-                wand_query wand_q(topk);
-                wand_q(make_scored_paired_cursors(index, wdata, *scorer, query), index.num_docs());
-                topk.finalize();
-                return topk.topk().size();
-            };
-        } else if (t == "wand_pair_fixed" && wand_data_filename) {
-            query_fun = [&](Query query, Threshold t) {
-                topk_queue topk(k);
-                topk.set_threshold(t);
-                wand_pair_query wand_q(topk);
-                wand_q(make_scored_paired_cursors(index, wdata, *scorer, query), index.num_docs());
-                topk.finalize();
-                return topk.topk().size();
-            };
-        } else if (t == "block_max_wand" && wand_data_filename) {
-            query_fun = [&](Query query, Threshold t) {
-                topk_queue topk(k);
-                topk.set_threshold(t);
-                block_max_wand_query block_max_wand_q(topk);
-                block_max_wand_q(
-                    make_block_max_scored_cursors(index, wdata, *scorer, query), index.num_docs());
-                topk.finalize();
-                return topk.topk().size();
-            };
-        } else if (t == "block_max_wand_prime" && wand_data_filename) {
-            query_fun = [&](Query query, Threshold t) {
-                topk_queue topk(k);
-                topk.set_threshold(t);
-                block_max_wand_query block_max_wand_q(topk);
-                block_max_wand_q(
-                    make_block_max_scored_cursors(index, wdata, *scorer, query), index.num_docs(), true);
-                topk.finalize();
-                return topk.topk().size();
-            };
-        } else if (t == "pair_aware_block_max_wand" && wand_data_filename) {
-            query_fun = [&](Query query, Threshold t) {
-                topk_queue topk(k);
-                topk.set_threshold(t);
-                block_max_wand_query block_max_wand_q(topk);
-                block_max_wand_q.pair_aware_bmw(
-                    make_block_max_scored_cursors(index, wdata, *scorer, query), index.num_docs());
-                topk.finalize();
-                return topk.topk().size();
-            };
-        } else if (t == "pair_aware_block_max_wand_prime" && wand_data_filename) {
-            query_fun = [&](Query query, Threshold t) {
-                topk_queue topk(k);
-                topk.set_threshold(t);
-                block_max_wand_query block_max_wand_q(topk);
-                block_max_wand_q.pair_aware_bmw(
-                    make_block_max_scored_cursors(index, wdata, *scorer, query), index.num_docs(), true);
-                topk.finalize();
-                return topk.topk().size();
-            };
+    // Cursors over `scorer` have its type, so that query algorithms can inline its term scorers.
+    auto run = [&](auto const& scorer) {
+        // Integer scores are collected in a queue of integer entries.
+        using topk_type = std::conditional_t<
+            std::is_same_v<std::decay_t<decltype(scorer)>, integer_quantized>,
+            int_topk_queue,
+            topk_queue>;
+        auto tiered_cursors = [&](Query const& query) {
+            if (tier_data) {
+                return make_max_scored_cursors(index, wdata, *tier_data, scorer, query);
+            }
+            return make_max_scored_cursors(index, wdata, scorer, query, decomposition);
+        };
+        auto tiered_block_max_cursors = [&](Query const& query) {
+            if (tier_data) {
+                return make_block_max_scored_cursors(index, wdata, *tier_data, scorer, query);
+            }
+            return make_block_max_scored_cursors(index, wdata, scorer, query, decomposition);
+        };
+
+        // Query functions of type `t`, whose algorithms report their work to `counters`
+        auto query_function = [&](std::string const& t, auto counters) {
+            std::function<uint64_t(Query, Threshold)> query_fun;
+            if (not supports_decomposition(t, decomposition)) {
+                spdlog::error("Query type {} does not support clipped indexes", t);
+            } else if ((t == "saat" || t == "saat_safe") && scorer_params.name != "quantized") {
+                // Score-at-a-time algorithms bound and accumulate the stored impacts.
+                spdlog::error("Query type {} requires the quantized scorer", t);
+            } else if (t == "and") {
+                query_fun = [&, counters](Query query, Threshold) {
+                    and_query and_q;
+                    auto cursors = counted_cursors(
+                        make_cursors(index, query), counters, query_lists(query));
+                    return and_q(cursors, index.num_docs()).size();
+                };
+            } else if (t == "or") {
+                query_fun = [&, counters](Query query, Threshold) {
+                    or_query<false> or_q;
+                    auto cursors = counted_cursors(
+                        make_cursors(index, query), counters, query_lists(query));
+                    return or_q(cursors, index.num_docs());
+                };
+            } else if (t == "or_freq") {
+                query_fun = [&, counters](Query query, Threshold) {
+                    or_query<true> or_q;
+                    auto cursors = counted_cursors(
+                        make_cursors(index, query), counters, query_lists(query));
+                    return or_q(cursors, index.num_docs());
+                };
+            } else if (t == "wand" && wand_data_filename) {
+                query_fun = [&, counters](Query query, Threshold t) {
+                    topk_type topk(k);
+                    topk.set_threshold(t);
+                    wand_query wand_q(topk, counters);
+                    auto cursors = counted_cursors(
+                        make_max_scored_cursors(index, wdata, scorer, query),
+                        counters,
+                        query_lists(query));
+                    wand_q(cursors, index.num_docs());
+                    topk.finalize();
+                    return topk.topk().size();
+                };
+            } else if (t == "wand_prime" && wand_data_filename) {
+                query_fun = [&, counters](Query query, Threshold t) {
+                    topk_type topk(k);
+                    topk.set_threshold(primed(query, t));
+                    wand_query wand_q(topk, counters);
+                    auto cursors = counted_cursors(
+                        make_max_scored_cursors(index, wdata, scorer, query),
+                        counters,
+                        query_lists(query));
+                    wand_q(cursors, index.num_docs(), true);
+                    topk.finalize();
+                    return topk.topk().size();
+                };
+            } else if (t == "pair_aware_wand" && wand_data_filename) {
+                query_fun = [&, counters](Query query, Threshold t) {
+                    topk_type topk(k);
+                    topk.set_threshold(t);
+                    wand_query wand_q(topk, counters);
+                    auto cursors = counted_cursors(
+                        tiered_cursors(query), counters, query_lists(query));
+                    wand_q.pair_aware_wand(cursors, index.num_docs());
+                    topk.finalize();
+                    return topk.topk().size();
+                };
+            } else if (t == "pair_aware_wand_prime" && wand_data_filename) {
+                query_fun = [&, counters](Query query, Threshold t) {
+                    topk_type topk(k);
+                    topk.set_threshold(primed(query, t));
+                    wand_query wand_q(topk, counters);
+                    auto cursors = counted_cursors(
+                        tiered_cursors(query), counters, query_lists(query));
+                    wand_q.pair_aware_wand(cursors, index.num_docs(), true);
+                    topk.finalize();
+                    return topk.topk().size();
+                };
+            } else if (t == "wand_pair" && wand_data_filename) {
+                query_fun = [&, counters](Query query, Threshold t) {
+                    topk_type topk(k);
+                    topk.set_threshold(t);
+                    wand_query wand_q(topk, counters);
+                    auto cursors = counted_cursors(
+                        make_scored_paired_cursors(index, wdata, scorer, query), counters);
+                    wand_q(cursors, index.num_docs());
+                    topk.finalize();
+                    return topk.topk().size();
+                };
+            } else if (t == "wand_pair_fixed" && wand_data_filename) {
+                query_fun = [&, counters](Query query, Threshold t) {
+                    topk_type topk(k);
+                    topk.set_threshold(t);
+                    wand_pair_query wand_q(topk, counters);
+                    auto cursors = counted_cursors(
+                        make_scored_paired_cursors(index, wdata, scorer, query), counters);
+                    wand_q(cursors, index.num_docs());
+                    topk.finalize();
+                    return topk.topk().size();
+                };
+            } else if (t == "block_max_wand" && wand_data_filename) {
+                query_fun = [&, counters](Query query, Threshold t) {
+                    topk_type topk(k);
+                    topk.set_threshold(t);
+                    block_max_wand_query block_max_wand_q(topk, counters);
+                    auto cursors = counted_cursors(
+                        make_block_max_scored_cursors(index, wdata, scorer, query),
+                        counters,
+                        query_lists(query));
+                    block_max_wand_q(cursors, index.num_docs());
+                    topk.finalize();
+                    return topk.topk().size();
+                };
+            } else if (t == "block_max_wand_prime" && wand_data_filename) {
+                query_fun = [&, counters](Query query, Threshold t) {
+                    topk_type topk(k);
+                    topk.set_threshold(primed(query, t));
+                    block_max_wand_query block_max_wand_q(topk, counters);
+                    auto cursors = counted_cursors(
+                        make_block_max_scored_cursors(index, wdata, scorer, query),
+                        counters,
+                        query_lists(query));
+                    block_max_wand_q(cursors, index.num_docs(), true);
+                    topk.finalize();
+                    return topk.topk().size();
+                };
+            } else if (t == "pair_aware_block_max_wand" && wand_data_filename) {
+                query_fun = [&, counters](Query query, Threshold t) {
+                    topk_type topk(k);
+                    topk.set_threshold(t);
+                    block_max_wand_query block_max_wand_q(topk, counters);
+                    auto cursors = counted_cursors(
+                        tiered_block_max_cursors(query), counters, query_lists(query));
+                    block_max_wand_q.pair_aware_bmw(cursors, index.num_docs());
+                    topk.finalize();
+                    return topk.topk().size();
+                };
+            } else if (t == "pair_aware_block_max_wand_prime" && wand_data_filename) {
+                query_fun = [&, counters](Query query, Threshold t) {
+                    topk_type topk(k);
+                    topk.set_threshold(primed(query, t));
+                    block_max_wand_query block_max_wand_q(topk, counters);
+                    auto cursors = counted_cursors(
+                        tiered_block_max_cursors(query), counters, query_lists(query));
+                    block_max_wand_q.pair_aware_bmw(cursors, index.num_docs(), true);
+                    topk.finalize();
+                    return topk.topk().size();
+                };
  
-        } else if (t == "block_max_wand_pair" && wand_data_filename) {
-            query_fun = [&](Query query, Threshold t) {
-                topk_queue topk(k);
-                topk.set_threshold(t);
-                block_max_wand_query block_max_wand_q(topk);
-                block_max_wand_q(
-                    make_block_max_scored_paired_cursors(index, wdata, *scorer, query),
-                    index.num_docs());
-                topk.finalize();
-                return topk.topk().size();
-            };
-        } else if (t == "block_max_wand_pair_fixed" && wand_data_filename) {
-            query_fun = [&](Query query, Threshold t) {
-                topk_queue topk(k);
-                topk.set_threshold(t);
-                block_max_wand_pair_query block_max_wand_q(topk);
-                block_max_wand_q(
-                    make_block_max_scored_paired_cursors(index, wdata, *scorer, query),
-                    index.num_docs());
-                topk.finalize();
-                return topk.topk().size();
-            };
-        } else if (t == "block_max_maxscore" && wand_data_filename) {
-            query_fun = [&](Query query, Threshold t) {
-                topk_queue topk(k);
-                topk.set_threshold(t);
-                block_max_maxscore_query block_max_maxscore_q(topk);
-                block_max_maxscore_q(
-                    make_block_max_scored_cursors(index, wdata, *scorer, query), index.num_docs());
-                topk.finalize();
-                return topk.topk().size();
-            };
-        } else if (t == "ranked_and" && wand_data_filename) {
-            query_fun = [&](Query query, Threshold t) {
-                topk_queue topk(k);
-                topk.set_threshold(t);
-                ranked_and_query ranked_and_q(topk);
-                ranked_and_q(make_scored_cursors(index, *scorer, query), index.num_docs());
-                topk.finalize();
-                return topk.topk().size();
-            };
-        } else if (t == "block_max_ranked_and" && wand_data_filename) {
-            query_fun = [&](Query query, Threshold t) {
-                topk_queue topk(k);
-                topk.set_threshold(t);
-                block_max_ranked_and_query block_max_ranked_and_q(topk);
-                block_max_ranked_and_q(
-                    make_block_max_scored_cursors(index, wdata, *scorer, query), index.num_docs());
-                topk.finalize();
-                return topk.topk().size();
-            };
-        } else if (t == "ranked_or" && wand_data_filename) {
-            query_fun = [&](Query query, Threshold t) {
-                topk_queue topk(k);
-                topk.set_threshold(t);
-                ranked_or_query ranked_or_q(topk);
-                ranked_or_q(make_scored_cursors(index, *scorer, query), index.num_docs());
-                topk.finalize();
-                return topk.topk().size();
-            };
-        } else if (t == "maxscore" && wand_data_filename) {
-            query_fun = [&](Query query, Threshold t) {
-                topk_queue topk(k);
-                topk.set_threshold(t);
-                maxscore_query maxscore_q(topk);
-                maxscore_q(make_max_scored_cursors(index, wdata, *scorer, query), index.num_docs());
-                topk.finalize();
-                return topk.topk().size();
-            };
-        } else if (t == "maxscore_prime" && wand_data_filename) {
-            query_fun = [&](Query query, Threshold t) {
-                topk_queue topk(k);
-                topk.set_threshold(t);
-                maxscore_query maxscore_q(topk);
-                maxscore_q(make_max_scored_cursors(index, wdata, *scorer, query), index.num_docs(), true);
-                topk.finalize();
-                return topk.topk().size();
-            };
-        } else if (query_type == "pair_aware_maxscore") {
-            query_fun = [&](Query query, Threshold t) {
-                topk_queue topk(k);
-                topk.set_threshold(t);
-                maxscore_query maxscore_q(topk);
-                maxscore_q.pair_aware_maxscore(make_max_scored_cursors(index, wdata, *scorer, query), index.num_docs());
-                topk.finalize();
-                return topk.topk().size();
-            };
-        } else if (query_type == "pair_aware_maxscore_prime") {
-            query_fun = [&](Query query, Threshold t) {
-                topk_queue topk(k);
-                topk.set_threshold(t);
-                maxscore_query maxscore_q(topk);
-                maxscore_q.pair_aware_maxscore(make_max_scored_cursors(index, wdata, *scorer, query), index.num_docs(), true);
-                topk.finalize();
-                return topk.topk().size();
-            };
-        } else if (t == "ls_maxscore" && wand_data_filename) {
-            query_fun = [&](Query query, Threshold t) {
-                topk_queue topk(k);
-                topk.set_threshold(t);
-                maxscore_query maxscore_q(topk);
-                maxscore_q.length_sorted_maxscore(make_max_scored_cursors(index, wdata, *scorer, query), index.num_docs());
-                topk.finalize();
-                return topk.topk().size();
-            };
-        } else if (t == "ls_maxscore_prime" && wand_data_filename) {
-            query_fun = [&](Query query, Threshold t) {
-                topk_queue topk(k);
-                topk.set_threshold(t);
-                maxscore_query maxscore_q(topk);
-                maxscore_q.length_sorted_maxscore(make_max_scored_cursors(index, wdata, *scorer, query), index.num_docs(), true);
-                topk.finalize();
-                return topk.topk().size();
-            };
+            } else if (t == "block_max_wand_pair" && wand_data_filename) {
+                query_fun = [&, counters](Query query, Threshold t) {
+                    topk_type topk(k);
+                    topk.set_threshold(t);
+                    block_max_wand_query block_max_wand_q(topk, counters);
+                    auto cursors = counted_cursors(
+                        make_block_max_scored_paired_cursors(index, wdata, scorer, query),
+                        counters);
+                    block_max_wand_q(cursors, index.num_docs());
+                    topk.finalize();
+                    return topk.topk().size();
+                };
+            } else if (t == "block_max_wand_pair_fixed" && wand_data_filename) {
+                query_fun = [&, counters](Query query, Threshold t) {
+                    topk_type topk(k);
+                    topk.set_threshold(t);
+                    block_max_wand_pair_query block_max_wand_q(topk, counters);
+                    auto cursors = counted_cursors(
+                        make_block_max_scored_paired_cursors(index, wdata, scorer, query),
+                        counters);
+                    block_max_wand_q(cursors, index.num_docs());
+                    topk.finalize();
+                    return topk.topk().size();
+                };
+            } else if (t == "block_max_maxscore" && wand_data_filename) {
+                query_fun = [&, counters](Query query, Threshold t) {
+                    topk_type topk(k);
+                    topk.set_threshold(t);
+                    block_max_maxscore_query block_max_maxscore_q(topk, counters);
+                    auto cursors = counted_cursors(
+                        make_block_max_scored_cursors(index, wdata, scorer, query),
+                        counters,
+                        query_lists(query));
+                    block_max_maxscore_q(cursors, index.num_docs());
+                    topk.finalize();
+                    return topk.topk().size();
+                };
+            } else if (t == "pair_aware_block_max_maxscore" && wand_data_filename) {
+                query_fun = [&, counters](Query query, Threshold t) {
+                    topk_type topk(k);
+                    topk.set_threshold(t);
+                    block_max_maxscore_query block_max_maxscore_q(topk, counters);
+                    auto cursors = counted_cursors(
+                        tiered_block_max_cursors(query), counters, query_lists(query));
+                    block_max_maxscore_q.pair_aware_block_max_maxscore(cursors, index.num_docs());
+                    topk.finalize();
+                    return topk.topk().size();
+                };
+            } else if (t == "pair_aware_block_max_maxscore_prime" && wand_data_filename) {
+                query_fun = [&, counters](Query query, Threshold t) {
+                    topk_type topk(k);
+                    topk.set_threshold(primed(query, t));
+                    block_max_maxscore_query block_max_maxscore_q(topk, counters);
+                    auto cursors = counted_cursors(
+                        tiered_block_max_cursors(query), counters, query_lists(query));
+                    block_max_maxscore_q.pair_aware_block_max_maxscore(
+                        cursors, index.num_docs(), true);
+                    topk.finalize();
+                    return topk.topk().size();
+                };
+            } else if (t == "ranked_and" && wand_data_filename) {
+                query_fun = [&, counters](Query query, Threshold t) {
+                    topk_type topk(k);
+                    topk.set_threshold(t);
+                    ranked_and_query ranked_and_q(topk, counters);
+                    auto cursors = counted_cursors(
+                        make_scored_cursors(index, scorer, query), counters, query_lists(query));
+                    ranked_and_q(cursors, index.num_docs());
+                    topk.finalize();
+                    return topk.topk().size();
+                };
+            } else if (t == "block_max_ranked_and" && wand_data_filename) {
+                query_fun = [&, counters](Query query, Threshold t) {
+                    topk_type topk(k);
+                    topk.set_threshold(t);
+                    block_max_ranked_and_query block_max_ranked_and_q(topk, counters);
+                    auto cursors = counted_cursors(
+                        make_block_max_scored_cursors(index, wdata, scorer, query),
+                        counters,
+                        query_lists(query));
+                    block_max_ranked_and_q(cursors, index.num_docs());
+                    topk.finalize();
+                    return topk.topk().size();
+                };
+            } else if (t == "pair_aware_ranked_and" && wand_data_filename) {
+                query_fun = [&, counters](Query query, Threshold t) {
+                    topk_type topk(k);
+                    topk.set_threshold(t);
+                    ranked_and_query ranked_and_q(topk, counters);
+                    auto cursors = counted_cursors(
+                        tiered_cursors(query), counters, query_lists(query));
+                    ranked_and_q.pair_aware_ranked_and(cursors, index.num_docs());
+                    topk.finalize();
+                    return topk.topk().size();
+                };
+            } else if (t == "pair_aware_block_max_ranked_and" && wand_data_filename) {
+                query_fun = [&, counters](Query query, Threshold t) {
+                    topk_type topk(k);
+                    topk.set_threshold(t);
+                    block_max_ranked_and_query block_max_ranked_and_q(topk, counters);
+                    auto cursors = counted_cursors(
+                        tiered_block_max_cursors(query), counters, query_lists(query));
+                    block_max_ranked_and_q.pair_aware_block_max_ranked_and(
+                        cursors, index.num_docs());
+                    topk.finalize();
+                    return topk.topk().size();
+                };
+            } else if (t == "ranked_or" && wand_data_filename) {
+                query_fun = [&, counters](Query query, Threshold t) {
+                    topk_type topk(k);
+                    topk.set_threshold(t);
+                    ranked_or_query ranked_or_q(topk, counters);
+                    auto cursors = counted_cursors(
+                        make_scored_cursors(index, scorer, query), counters, query_lists(query));
+                    ranked_or_q(cursors, index.num_docs());
+                    topk.finalize();
+                    return topk.topk().size();
+                };
+            } else if (t == "maxscore" && wand_data_filename) {
+                query_fun = [&, counters](Query query, Threshold t) {
+                    topk_type topk(k);
+                    topk.set_threshold(t);
+                    maxscore_query maxscore_q(topk, counters);
+                    auto cursors = counted_cursors(
+                        make_max_scored_cursors(index, wdata, scorer, query),
+                        counters,
+                        query_lists(query));
+                    maxscore_q(cursors, index.num_docs());
+                    topk.finalize();
+                    return topk.topk().size();
+                };
+            } else if (t == "maxscore_prime" && wand_data_filename) {
+                query_fun = [&, counters](Query query, Threshold t) {
+                    topk_type topk(k);
+                    topk.set_threshold(primed(query, t));
+                    maxscore_query maxscore_q(topk, counters);
+                    auto cursors = counted_cursors(
+                        make_max_scored_cursors(index, wdata, scorer, query),
+                        counters,
+                        query_lists(query));
+                    maxscore_q(cursors, index.num_docs(), true);
+                    topk.finalize();
+                    return topk.topk().size();
+                };
+            } else if (query_type == "pair_aware_maxscore") {
+                query_fun = [&, counters](Query query, Threshold t) {
+                    topk_type topk(k);
+                    topk.set_threshold(t);
+                    maxscore_query maxscore_q(topk, counters);
+                    auto cursors = counted_cursors(
+                        tiered_cursors(query), counters, query_lists(query));
+                    maxscore_q.pair_aware_maxscore(cursors, index.num_docs());
+                    topk.finalize();
+                    return topk.topk().size();
+                };
+            } else if (query_type == "pair_aware_maxscore_prime") {
+                query_fun = [&, counters](Query query, Threshold t) {
+                    topk_type topk(k);
+                    topk.set_threshold(primed(query, t));
+                    maxscore_query maxscore_q(topk, counters);
+                    auto cursors = counted_cursors(
+                        tiered_cursors(query), counters, query_lists(query));
+                    maxscore_q.pair_aware_maxscore(cursors, index.num_docs(), true);
+                    topk.finalize();
+                    return topk.topk().size();
+                };
+            } else if (t == "ls_maxscore" && wand_data_filename) {
+                query_fun = [&, counters](Query query, Threshold t) {
+                    topk_type topk(k);
+                    topk.set_threshold(t);
+                    maxscore_query maxscore_q(topk, counters);
+                    auto cursors = counted_cursors(
+                        make_max_scored_cursors(index, wdata, scorer, query),
+                        counters,
+                        query_lists(query));
+                    maxscore_q.length_sorted_maxscore(cursors, index.num_docs());
+                    topk.finalize();
+                    return topk.topk().size();
+                };
+            } else if (t == "ls_maxscore_prime" && wand_data_filename) {
+                query_fun = [&, counters](Query query, Threshold t) {
+                    topk_type topk(k);
+                    topk.set_threshold(primed(query, t));
+                    maxscore_query maxscore_q(topk, counters);
+                    auto cursors = counted_cursors(
+                        make_max_scored_cursors(index, wdata, scorer, query),
+                        counters,
+                        query_lists(query));
+                    maxscore_q.length_sorted_maxscore(cursors, index.num_docs(), true);
+                    topk.finalize();
+                    return topk.topk().size();
+                };
  
-        } else if (t == "maxscore_wave" && wand_data_filename) {
-            query_fun = [&](Query query, Threshold t) {
-                auto high_query = get_high_query(query);
-                auto low_query = get_low_query(query);
-                topk_queue topk(k);
-                topk.set_threshold(t);
-                maxscore_query maxscore_q(topk);
-                maxscore_q.high_then_low(
-                    make_max_scored_cursors(index, wdata, *scorer, high_query),
-                    make_max_scored_cursors(index, wdata, *scorer, low_query),
-                    index.num_docs());
-                topk.finalize();
-                return topk.topk().size();
-            };
-        } else if (t == "ranked_or_taat" && wand_data_filename) {
-            Simple_Accumulator accumulator(index.num_docs());
-            topk_queue topk(k);
-            ranked_or_taat_query ranked_or_taat_q(topk);
-            query_fun = [&, ranked_or_taat_q, accumulator](Query query, Threshold t) mutable {
-                topk.set_threshold(t);
-                ranked_or_taat_q(
-                    make_scored_cursors(index, *scorer, query), index.num_docs(), accumulator);
-                topk.finalize();
-                return topk.topk().size();
-            };
-        } else if (t == "ranked_or_taat_lazy" && wand_data_filename) {
-            Lazy_Accumulator<4> accumulator(index.num_docs());
-            topk_queue topk(k);
-            ranked_or_taat_query ranked_or_taat_q(topk);
-            query_fun = [&, ranked_or_taat_q, accumulator](Query query, Threshold t) mutable {
-                topk.set_threshold(t);
-                ranked_or_taat_q(
-                    make_scored_cursors(index, *scorer, query), index.num_docs(), accumulator);
-                topk.finalize();
-                return topk.topk().size();
-            };
-        } else {
-            spdlog::error("Unsupported query type: {}", t);
-            break;
+            } else if (t == "maxscore_wave" && wand_data_filename) {
+                query_fun = [&, counters](Query query, Threshold t) {
+                    auto high_query = get_high_query(query);
+                    auto low_query = get_low_query(query);
+                    topk_type topk(k);
+                    topk.set_threshold(t);
+                    maxscore_query maxscore_q(topk, counters);
+                    auto high_cursors = counted_cursors(
+                        make_block_max_scored_cursors(index, wdata, scorer, high_query),
+                        counters,
+                        query_lists(high_query));
+                    auto low_cursors = counted_cursors(
+                        make_block_max_scored_cursors(index, wdata, scorer, low_query),
+                        counters,
+                        query_lists(low_query));
+                    maxscore_q.high_then_low(high_cursors, low_cursors, index.num_docs());
+                    topk.finalize();
+                    return topk.topk().size();
+                };
+            } else if (t == "ranked_or_taat" && wand_data_filename) {
+                query_fun = [&, counters, accumulator = Simple_Accumulator(index.num_docs())](
+                                Query query, Threshold t) mutable {
+                    topk_type topk(k);
+                    topk.set_threshold(t);
+                    ranked_or_taat_query ranked_or_taat_q(topk, counters);
+                    auto cursors = counted_cursors(
+                        make_scored_cursors(index, scorer, query), counters, query_lists(query));
+                    ranked_or_taat_q(cursors, index.num_docs(), accumulator);
+                    topk.finalize();
+                    return topk.topk().size();
+                };
+            } else if (t == "ranked_or_taat_lazy" && wand_data_filename) {
+                query_fun = [&, counters, accumulator = Lazy_Accumulator<4>(index.num_docs())](
+                                Query query, Threshold t) mutable {
+                    topk_type topk(k);
+                    topk.set_threshold(t);
+                    ranked_or_taat_query ranked_or_taat_q(topk, counters);
+                    auto cursors = counted_cursors(
+                        make_scored_cursors(index, scorer, query), counters, query_lists(query));
+                    ranked_or_taat_q(cursors, index.num_docs(), accumulator);
+                    topk.finalize();
+                    return topk.topk().size();
+                };
+            } else if (t == "pair_aware_ranked_or_taat" && wand_data_filename) {
+                query_fun = [&, counters, accumulator = Lazy_Accumulator<4>(index.num_docs())](
+                                Query query, Threshold t) mutable {
+                    topk_type topk(k);
+                    topk.set_threshold(t);
+                    ranked_or_taat_query ranked_or_taat_q(topk, counters);
+                    auto cursors = counted_cursors(
+                        tiered_cursors(query), counters, query_lists(query));
+                    ranked_or_taat_q.pair_aware_taat(cursors, index.num_docs(), accumulator);
+                    topk.finalize();
+                    return topk.topk().size();
+                };
+            } else if (t == "anytime_block_max_wand" && wand_data_filename) {
+                query_fun = [&, counters](Query query, Threshold t) {
+                    topk_type topk(k);
+                    topk.set_threshold(t);
+                    anytime_range_query anytime_q(topk);
+                    block_max_wand_query block_max_wand_q(topk, counters);
+                    auto cursors = counted_cursors(
+                        make_block_max_scored_cursors(index, wdata, scorer, query),
+                        counters,
+                        query_lists(query));
+                    anytime_q(
+                        cursors,
+                        index.num_docs(),
+                        range_size,
+                        [&](auto& cursors, uint64_t end) { block_max_wand_q(cursors, end); },
+                        budget);
+                    topk.finalize();
+                    return topk.topk().size();
+                };
+            } else if (t == "anytime_pair_aware_block_max_wand" && wand_data_filename) {
+                query_fun = [&, counters](Query query, Threshold t) {
+                    topk_type topk(k);
+                    topk.set_threshold(t);
+                    anytime_range_query anytime_q(topk);
+                    block_max_wand_query block_max_wand_q(topk, counters);
+                    auto cursors = counted_cursors(
+                        tiered_block_max_cursors(query), counters, query_lists(query));
+                    anytime_q(
+                        cursors,
+                        index.num_docs(),
+                        range_size,
+                        [&](auto& cursors, uint64_t end) {
+                            block_max_wand_q.pair_aware_bmw(cursors, end);
+                        },
+                        budget);
+                    topk.finalize();
+                    return topk.topk().size();
+                };
+            } else if (t == "anytime_pair_aware_maxscore" && wand_data_filename) {
+                query_fun = [&, counters](Query query, Threshold t) {
+                    topk_type topk(k);
+                    topk.set_threshold(t);
+                    anytime_range_query anytime_q(topk);
+                    maxscore_query maxscore_q(topk, counters);
+                    auto cursors = counted_cursors(
+                        tiered_block_max_cursors(query), counters, query_lists(query));
+                    anytime_q(
+                        cursors,
+                        index.num_docs(),
+                        range_size,
+                        [&](auto& cursors, uint64_t end) {
+                            maxscore_q.pair_aware_maxscore(cursors, end);
+                        },
+                        budget);
+                    topk.finalize();
+                    return topk.topk().size();
+                };
+            } else if (t == "anytime_pair_aware_block_max_maxscore" && wand_data_filename) {
+                query_fun = [&, counters](Query query, Threshold t) {
+                    topk_type topk(k);
+                    topk.set_threshold(t);
+                    anytime_range_query anytime_q(topk);
+                    block_max_maxscore_query block_max_maxscore_q(topk, counters);
+                    auto cursors = counted_cursors(
+                        tiered_block_max_cursors(query), counters, query_lists(query));
+                    anytime_q(
+                        cursors,
+                        index.num_docs(),
+                        range_size,
+                        [&](auto& cursors, uint64_t end) {
+                            block_max_maxscore_q.pair_aware_block_max_maxscore(cursors, end);
+                        },
+                        budget);
+                    topk.finalize();
+                    return topk.topk().size();
+                };
+            } else if (t == "parallel_maxscore" && wand_data_filename) {
+                query_fun = [&](Query query, Threshold t) {
+                    topk_type topk(k);
+                    topk.set_threshold(t);
+                    parallel_range_query parallel_q(topk);
+                    parallel_q(
+                        [&] { return make_max_scored_cursors(index, wdata, scorer, query); },
+                        index.num_docs(),
+                        range_size,
+                        [&](auto& range_topk, auto& cursors, uint64_t end) {
+                            maxscore_query maxscore_q(range_topk);
+                            maxscore_q(cursors, end);
+                        });
+                    topk.finalize();
+                    return topk.topk().size();
+                };
+            } else if (t == "parallel_pair_aware_maxscore" && wand_data_filename) {
+                query_fun = [&](Query query, Threshold t) {
+                    topk_type topk(k);
+                    topk.set_threshold(t);
+                    parallel_range_query parallel_q(topk);
+                    parallel_q(
+                        [&] { return tiered_cursors(query); },
+                        index.num_docs(),
+                        range_size,
+                        [&](auto& range_topk, auto& cursors, uint64_t end) {
+                            maxscore_query maxscore_q(range_topk);
+                            maxscore_q.pair_aware_maxscore(cursors, end);
+                        });
+                    topk.finalize();
+                    return topk.topk().size();
+                };
+            } else if (t == "parallel_block_max_wand" && wand_data_filename) {
+                query_fun = [&](Query query, Threshold t) {
+                    topk_type topk(k);
+                    topk.set_threshold(t);
+                    parallel_range_query parallel_q(topk);
+                    parallel_q(
+                        [&] { return make_block_max_scored_cursors(index, wdata, scorer, query); },
+                        index.num_docs(),
+                        range_size,
+                        [&](auto& range_topk, auto& cursors, uint64_t end) {
+                            block_max_wand_query block_max_wand_q(range_topk);
+                            block_max_wand_q(cursors, end);
+                        });
+                    topk.finalize();
+                    return topk.topk().size();
+                };
+            } else if (t == "parallel_pair_aware_block_max_wand" && wand_data_filename) {
+                query_fun = [&](Query query, Threshold t) {
+                    topk_type topk(k);
+                    topk.set_threshold(t);
+                    parallel_range_query parallel_q(topk);
+                    parallel_q(
+                        [&] { return tiered_block_max_cursors(query); },
+                        index.num_docs(),
+                        range_size,
+                        [&](auto& range_topk, auto& cursors, uint64_t end) {
+                            block_max_wand_query block_max_wand_q(range_topk);
+                            block_max_wand_q.pair_aware_bmw(cursors, end);
+                        });
+                    topk.finalize();
+                    return topk.topk().size();
+                };
+            } else if (t == "saat" && impact_index) {
+                if constexpr (not std::is_same_v<impact_index_type, std::monostate>) {
+                    query_fun = [&, counters, accumulator = Lazy_Accumulator<4>(index.num_docs())](
+                                    Query query, Threshold t) mutable {
+                        topk_type topk(k);
+                        topk.set_threshold(t);
+                        saat_query saat_q(topk, counters);
+                        saat_q(*impact_index, query, accumulator, budget);
+                        topk.finalize();
+                        return topk.topk().size();
+                    };
+                }
+            } else if (t == "saat_safe" && impact_index && wand_data_filename) {
+                if constexpr (not std::is_same_v<impact_index_type, std::monostate>) {
+                    query_fun = [&, counters, accumulator = Lazy_Accumulator<4>(index.num_docs())](
+                                    Query query, Threshold t) mutable {
+                        topk_type topk(k);
+                        topk.set_threshold(t);
+                        saat_query saat_q(topk, counters);
+                        auto docid_query = docid_ordered_query(*impact_index, query);
+                        auto cursors = counted_cursors(
+                            tiered_cursors(docid_query), counters, query_lists(docid_query));
+                        saat_q.rank_safe(
+                            *impact_index, query, cursors, index.num_docs(), accumulator, budget);
+                        topk.finalize();
+                        return topk.topk().size();
+                    };
+                }
+            }
+            return query_fun;
+        };
+
+        if (sweep) {
+            // Query functions read `k` when called, so that each run can set its own.
+            sweep([&](std::string const& t, std::uint64_t run_k) -> std::optional<QueryStats> {
+                k = run_k;
+                auto query_fun = query_function(t, NoCounters{});
+                if (not query_fun) {
+                    return std::nullopt;
+                }
+                return op_perftest_parallel(
+                    query_fun, queries, thresholds, type, t, 2, k, safe, perf_counters);
+            });
+            return;
+        }
+
+        for (auto&& t: query_types) {
+            spdlog::info("Query type: {}", t);
+            auto query_fun = query_function(t, NoCounters{});
+            if (not query_fun) {
+                spdlog::error("Unsupported query type: {}", t);
+                break;
+            }
+            if (extract) {
+                QueryWork work;
+                work.trace_cursors = traces.has_value();
+                extract_times(
+                    query_fun,
+                    query_function(t, WorkCounters(work)),
+                    work,
+                    [&](Query const& query, std::string const& qid) {
+                        if (traces) {
+                            write_cursor_traces(*traces, t, qid, query, work);
+                        }
+                    },
+                    queries,
+                    thresholds,
+                    type,
+                    t,
+                    2,
+                    std::cout);
+            } else if (load) {
+                op_loadtest(
+                    query_fun, queries, thresholds, type, t, 2, k, safe, *load, perf_counters);
+            } else {
+                op_perftest_parallel(
+                    query_fun, queries, thresholds, type, t, 2, k, safe, perf_counters);
+            }
+        }
+    };
+    if (scorer_params.name == "quantized" && integer_scores) {
+        run(integer_quantized{});
+    } else if (scorer_params.name == "quantized") {
+        run(static_quantized{});
+    } else {
+        run(*scorer);
+    }
+}
+
+/// An index of a sweep, with its data and the queries to run on it.
+struct SweepIndex {
+    std::string name;
+    std::string encoding;
+    std::string index_filename;
+    std::optional<std::string> wand_data_filename;
+    bool wand_compressed = false;
+    bool quantized = false;
+    std::vector<Query> queries;
+    std::optional<std::string> thresholds_filename;
+    std::optional<std::string> tier_data_filename;
+    DecompositionMode decomposition = DecompositionMode::Split;
+    std::optional<std::string> impact_index_filename;
+    std::optional<std::string> pair_thresholds_filename;
+};
+
+/// Runs of every query type with every k and number of threads on every index, see `read_sweep`.
+struct Sweep {
+    std::vector<SweepIndex> indexes;
+    std::vector<std::string> query_types;
+    std::vector<std::uint64_t> ks;
+    std::vector<std::size_t> threads;
+    std::size_t repetitions = 1;
+    std::optional<std::uint64_t> seed;
+};
+
+/// Reads a sweep, made of lines
+///
+///     index <name> <options>
+///     algorithms <type>...
+///     k <k>...
+///     threads <threads>...
+///     repetitions <count>
+///     seed <seed>
+///
+/// where the options of an index are those of `queries` naming it, its data and its queries, e.g.,
+/// `-e block_simdbp -i x.idx -w x.bmw -q x.queries`. Thresholds given with `-T` are for a single k,
+/// so they require a single k. Blank lines and lines starting with `#` are skipped.
+[[nodiscard]] auto read_sweep(std::string const& filename) -> Sweep
+{
+    std::ifstream is(filename);
+    if (not is) {
+        throw std::invalid_argument(fmt::format("Cannot read sweep {}", filename));
+    }
+    Sweep sweep;
+    std::string line;
+    std::size_t line_number = 0;
+    while (std::getline(is, line)) {
+        line_number += 1;
+        auto invalid = [&](std::string const& reason) {
+            return std::invalid_argument(fmt::format("{}:{}: {}", filename, line_number, reason));
+        };
+        auto read_values = [&](std::istream& fields, auto& values) {
+            typename std::decay_t<decltype(values)>::value_type value;
+            while (fields >> value) {
+                values.push_back(value);
+            }
+            if (not fields.eof()) {
+                throw invalid("Invalid value");
+            }
+        };
+        std::istringstream fields(line);
+        std::string key;
+        if (not(fields >> key) || key[0] == '#') {
+            continue;
         }
-        if (extract) {
-            extract_times(query_fun, queries, thresholds, type, t, 2, std::cout);
+        if (key == "index") {
+            SweepIndex index;
+            if (not(fields >> index.name)) {
+                throw invalid("Missing index name");
+            }
+            std::string options;
+            std::getline(fields, options);
+            App<arg::Index,
+                arg::WandData<arg::WandMode::Optional>,
+                arg::Query<arg::QueryMode::Unranked>,
+                arg::Thresholds,
+                arg::Tiers>
+                args{"Index of a sweep"};
+            args.add_option("--impact-index", index.impact_index_filename, "Impact-ordered lists");
+            args.add_option("--pair-thresholds", index.pair_thresholds_filename, "Pair thresholds");
+            args.add_flag("--quantized", index.quantized, "Quantized scores");
+            try {
+                args.parse(options);
+            } catch (CLI::ParseError const& err) {
+                throw invalid(err.what());
+            }
+            if (not args.query_file()) {
+                throw invalid("Missing queries of index " + index.name);
+            }
+            index.encoding = args.index_encoding();
+            index.index_filename = args.index_filename();
+            index.wand_data_filename = args.wand_data_path();
+            index.wand_compressed = args.is_wand_compressed();
+            index.thresholds_filename = args.thresholds_file();
+            index.tier_data_filename = args.tier_data_path();
+            index.decomposition = args.decomposition();
+            index.queries = args.queries();
+            sweep.indexes.push_back(std::move(index));
+        } else if (key == "algorithms") {
+            read_values(fields, sweep.query_types);
+        } else if (key == "k") {
+            read_values(fields, sweep.ks);
+        } else if (key == "threads") {
+            read_values(fields, sweep.threads);
+        } else if (key == "repetitions") {
+            if (not(fields >> sweep.repetitions)) {
+                throw invalid("Invalid value");
+            }
+        } else if (key == "seed") {
+            sweep.seed.emplace();
+            if (not(fields >> *sweep.seed)) {
+                throw invalid("Invalid value");
+            }
         } else {
-            op_perftest_parallel(query_fun, queries, thresholds, type, t, 2, k, safe);
+            throw invalid("Unknown setting " + key);
+        }
+    }
+    if (sweep.indexes.empty() || sweep.query_types.empty() || sweep.ks.empty()) {
+        throw std::invalid_argument(
+            fmt::format("Sweep {} needs at least an index, an algorithm and a k", filename));
+    }
+    for (auto const& index: sweep.indexes) {
+        if (index.thresholds_filename && sweep.ks.size() > 1) {
+            throw std::invalid_argument(fmt::format(
+                "Thresholds of index {} are for a single k, but sweep {} has {}",
+                index.name,
+                filename,
+                sweep.ks.size()));
+        }
+    }
+    return sweep;
+}
+
+/// Runs every combination of `sweep` `sweep.repetitions` times in random order, with a runner per
+/// index, and writes the statistics of each run to `os`, in run order, as a JSON object.
+void run_sweep(Sweep const& sweep, std::vector<SweepRunner> const& runners, std::ostream& os)
+{
+    struct Run {
+        std::size_t index;
+        std::string query_type;
+        std::uint64_t k;
+        std::size_t threads;
+        std::size_t repetition;
+    };
+    std::vector<Run> runs;
+    for (std::size_t index = 0; index < sweep.indexes.size(); ++index) {
+        for (auto const& query_type: sweep.query_types) {
+            for (auto k: sweep.ks) {
+                for (auto threads: sweep.threads) {
+                    for (std::size_t rep = 0; rep < sweep.repetitions; ++rep) {
+                        runs.push_back({index, query_type, k, threads, rep});
+                    }
+                }
+            }
+        }
+    }
+    // Shuffled so that, e.g., caches warmed up by a run do not favor the same runs every time.
+    std::uint64_t seed = sweep.seed.value_or(std::random_device{}());
+    std::mt19937_64 rng(seed);
+    std::shuffle(runs.begin(), runs.end(), rng);
+    spdlog::info("Sweeping {} runs in random order (seed: {})", runs.size(), seed);
+
+    os << fmt::format("{{\"seed\": {}, \"runs\": [", seed);
+    char const* separator = "\n";
+    for (auto&& [order, run]: enumerate(runs)) {
+        auto const& index = sweep.indexes[run.index];
+        spdlog::info(
+            "Run {}/{}: {} on {} with k = {} and {} threads",
+            order + 1,
+            runs.size(),
+            run.query_type,
+            index.name,
+            run.k,
+            run.threads);
+        tbb::global_control control(tbb::global_control::max_allowed_parallelism, run.threads);
+        auto stats = runners[run.index](run.query_type, run.k);
+        if (not stats) {
+            spdlog::error("Unsupported query type {} on index {}", run.query_type, index.name);
+            continue;
         }
+        os << separator
+           << fmt::format(
+                  "{{\"order\": {}, \"index\": \"{}\", \"type\": \"{}\", \"query\": \"{}\", "
+                  "\"k\": {}, \"threads\": {}, \"repetition\": {}",
+                  order,
+                  index.name,
+                  index.encoding,
+                  run.query_type,
+                  run.k,
+                  run.threads,
+                  run.repetition);
+        for (auto&& [key, value]: *stats) {
+            auto number = std::isfinite(value) ? fmt::format("{}", value) : "null";
+            os << fmt::format(", \"{}\": {}", key, number);
+        }
+        os << '}' << std::flush;
+        separator = ",\n";
     }
+    os << "\n]}\n";
 }
 
 using wand_raw_index = wand_data<wand_data_raw>;
 using wand_uniform_index = wand_data<wand_data_compressed<>>;
 using wand_uniform_index_quantized = wand_data<wand_data_compressed<PayloadType::Quantized>>;
 
+/// Calls `perftest` with `params` for the types of index `encoding` and its wand data, returning
+/// false if the encoding is unknown.
+template <typename Params>
+[[nodiscard]] auto
+dispatch_perftest(std::string const& encoding, bool wand_compressed, bool quantized, Params& params)
+    -> bool
+{
+    /**/
+    if (false) {
+#define LOOP_BODY(R, DATA, T)                                                                        \
+    }                                                                                                \
+    else if (encoding == BOOST_PP_STRINGIZE(T))                                                      \
+    {                                                                                                \
+        if (wand_compressed) {                                                                       \
+            if (quantized) {                                                                         \
+                std::apply(perftest<BOOST_PP_CAT(T, _index), wand_uniform_index_quantized>, params); \
+            } else {                                                                                 \
+                std::apply(perftest<BOOST_PP_CAT(T, _index), wand_uniform_index>, params);           \
+            }                                                                                        \
+        } else {                                                                                     \
+            std::apply(perftest<BOOST_PP_CAT(T, _index), wand_raw_index>, params);                   \
+        }
+        /**/
+        BOOST_PP_SEQ_FOR_EACH(LOOP_BODY, _, PISA_INDEX_TYPES);
+#undef LOOP_BODY
+
+    } else {
+        return false;
+    }
+    return true;
+}
+
 int main(int argc, const char** argv)
 {
     bool extract = false;
     bool silent = false;
     bool safe = false;
     bool quantized = false;
+    bool integer_scores = false;
+    std::optional<std::string> impact_index_filename;
+    QueryBudget budget;
+    std::optional<std::size_t> postings_budget;
+    std::optional<std::int64_t> time_budget;
+    std::optional<std::string> pair_thresholds_filename;
+    std::size_t range_size = 1U << 20U;
+    std::optional<double> arrival_rate;
+    std::string arrival = "poisson";
+    std::vector<std::size_t> load_threads;
+    bool perf_counters = false;
+    std::optional<std::string> trace_filename;
+    std::optional<std::string> sweep_filename;
+    std::optional<std::string> sweep_results;
 
     App<arg::Index,
         arg::WandData<arg::WandMode::Optional>,
@@ -534,25 +1499,193 @@ int main(int argc, const char** argv)
         arg::Algorithm,
         arg::Scorer,
         arg::Thresholds,
+        arg::Tiers,
         arg::Threads>
         app{"Benchmarks queries on a given index."};
-    app.add_flag("--quantized", quantized, "Quantized scores");
-    app.add_flag("--extract", extract, "Extract individual query times");
+    auto* quantized_option = app.add_flag("--quantized", quantized, "Quantized scores");
+    auto* extract_option =
+        app.add_flag("--extract", extract, "Extract individual query times and work");
     app.add_flag("--silent", silent, "Suppress logging");
     app.add_flag("--safe", safe, "Rerun if not enough results with pruning.")
         ->needs(app.thresholds_option());
+    app.add_flag(
+        "--integer-scores",
+        integer_scores,
+        "Accumulate quantized scores as integers (requires the quantized scorer)");
+    app.add_option(
+        "--impact-index",
+        impact_index_filename,
+        "Impact-ordered lists for score-at-a-time algorithms (see create_impact_index)");
+    app.add_option(
+        "--postings-budget", postings_budget, "Postings processed per query by anytime algorithms");
+    app.add_option(
+        "--time-budget", time_budget, "Microseconds of processing per query by anytime algorithms");
+    app.add_option(
+        "--range-size",
+        range_size,
+        "Documents per docid range of anytime_* and parallel_* algorithms",
+        true);
+    app.add_option(
+        "--pair-thresholds",
+        pair_thresholds_filename,
+        "Pair thresholds priming the *_prime algorithms (see create_pair_thresholds)");
+    auto* arrival_rate_option = app.add_option(
+        "--arrival-rate",
+        arrival_rate,
+        "Replay queries open-loop, arriving at this rate in queries per second");
+    app.add_option("--arrival", arrival, "Gaps between arrivals: fixed or poisson", true)
+        ->check(CLI::IsMember({"fixed", "poisson"}))
+        ->needs(arrival_rate_option);
+    app.add_option(
+           "--load-threads",
+           load_threads,
+           "Numbers of pinned worker threads to replay queries with (default: --threads)")
+        ->delimiter(',')
+        ->needs(arrival_rate_option);
+    app.add_flag(
+        "--perf-counters",
+        perf_counters,
+        "Count cycles, instructions, branch misses and LLC misses of every query");
+    app.add_option(
+           "--trace-cursors",
+           trace_filename,
+           "Write the calls received by every cursor to this file (see cursor_replay)")
+        ->needs(extract_option);
+    auto* sweep_option = app.add_option(
+        "--sweep",
+        sweep_filename,
+        "Run every algorithm with every k and number of threads on every index of this file");
+    auto* sweep_results_option =
+        app.add_option("--sweep-results", sweep_results, "JSON file of the results of --sweep");
+    sweep_option->needs(sweep_results_option)
+        ->excludes(extract_option)
+        ->excludes(arrival_rate_option)
+        ->excludes(quantized_option);
+    sweep_results_option->needs(sweep_option);
+    // A sweep names its own indexes, algorithms and k values, so either all of these or a sweep
+    // are required.
+    auto* target = app.add_option_group("target", "What to run");
+    auto* single = target->add_option_group("single", "A single index, algorithm and k");
+    for (auto const* name: {"-e", "-i", "-a", "-k"}) {
+        single->add_option(app.get_option(name)->required(false));
+    }
+    single->require_option(4);
+    auto* sweep_group = target->add_option_group("sweep", "A sweep");
+    sweep_group->add_option(sweep_option);
+    sweep_group->add_option(sweep_results_option);
+    target->require_option(1);
+    target->required();
     CLI11_PARSE(app, argc, argv);
-
-    tbb::global_control control(tbb::global_control::max_allowed_parallelism, app.threads());
-    std::cerr << "Number of worker threads: " << app.threads() << "\n";
+    if (postings_budget) {
+        budget.postings = *postings_budget;
+    }
+    if (time_budget) {
+        budget.time = std::chrono::microseconds(*time_budget);
+    }
+    std::optional<LoadTest> load;
+    if (arrival_rate) {
+        if (*arrival_rate <= 0.0) {
+            spdlog::error("Arrival rate must be positive");
+            return 1;
+        }
+        if (load_threads.empty()) {
+            load_threads.push_back(app.threads());
+        }
+        load = LoadTest{*arrival_rate, arrival == "poisson", load_threads};
+    }
 
     if (silent) {
         spdlog::set_default_logger(spdlog::create<spdlog::sinks::null_sink_mt>("stderr"));
     } else {
         spdlog::set_default_logger(spdlog::stderr_color_mt("stderr"));
     }
+
+    std::optional<Sweep> sweep;
+    if (sweep_filename) {
+        try {
+            sweep = read_sweep(*sweep_filename);
+        } catch (std::exception const& err) {
+            spdlog::error("{}", err.what());
+            return 1;
+        }
+        if (sweep->threads.empty()) {
+            sweep->threads.push_back(app.threads());
+        }
+    }
+    // Runs of a sweep lower the number of threads from the most any of them uses.
+    auto threads = sweep ? *std::max_element(sweep->threads.begin(), sweep->threads.end())
+                         : app.threads();
+    tbb::global_control control(tbb::global_control::max_allowed_parallelism, threads);
+    std::cerr << "Number of worker threads: " << threads << "\n";
+
+    if (integer_scores && app.scorer_params().name != "quantized") {
+        spdlog::error("Integer scores require the quantized scorer");
+        return 1;
+    }
+    if (perf_counters && not PerfCounters::this_thread().available()) {
+        spdlog::warn(
+            "Hardware counters unavailable, measuring time only: {}",
+            PerfCounters::this_thread().error());
+        perf_counters = false;
+    }
+    if (sweep) {
+        std::ofstream results(*sweep_results);
+        if (not results) {
+            spdlog::error("Cannot write sweep results to {}", *sweep_results);
+            return 1;
+        }
+        std::vector<SweepRunner> runners;
+        // Every index stays loaded while the next ones load, until the sweep is over.
+        std::function<void(std::size_t)> load_index = [&](std::size_t idx) {
+            if (idx == sweep->indexes.size()) {
+                run_sweep(*sweep, runners, results);
+                return;
+            }
+            auto const& index = sweep->indexes[idx];
+            spdlog::info("Loading sweep index {}", index.name);
+            SweepContinuation next = [&, idx](SweepRunner const& runner) {
+                runners.push_back(runner);
+                load_index(idx + 1);
+            };
+            auto params = std::make_tuple(
+                index.index_filename,
+                index.wand_data_filename,
+                index.queries,
+                index.thresholds_filename,
+                index.tier_data_filename,
+                index.decomposition,
+                index.encoding,
+                std::string{},
+                app.k(),
+                app.scorer_params(),
+                extract,
+                safe,
+                integer_scores,
+                index.impact_index_filename,
+                budget,
+                index.pair_thresholds_filename,
+                range_size,
+                load,
+                perf_counters,
+                trace_filename,
+                next);
+            if (not dispatch_perftest(
+                    index.encoding, index.wand_compressed, index.quantized, params)) {
+                throw std::invalid_argument(fmt::format("Unknown type {}", index.encoding));
+            }
+        };
+        try {
+            load_index(0);
+        } catch (std::exception const& err) {
+            spdlog::error("{}", err.what());
+            return 1;
+        }
+        return 0;
+    }
+
     if (extract) {
-        std::cout << "qid\tusec\n";
+        std::cout << "qid\tusec\tdocuments\tpostings\tnext_geqs\tblocks\tblock_max_skips\tpivots"
+                     "\tinserts\tthresholds\n";
     }
 
     auto params = std::make_tuple(
@@ -560,32 +1693,24 @@ int main(int argc, const char** argv)
         app.wand_data_path(),
         app.queries(),
         app.thresholds_file(),
+        app.tier_data_path(),
+        app.decomposition(),
         app.index_encoding(),
         app.algorithm(),
         app.k(),
         app.scorer_params(),
         extract,
-        safe);
-    /**/
-    if (false) {
-#define LOOP_BODY(R, DATA, T)                                                                        \
-    }                                                                                                \
-    else if (app.index_encoding() == BOOST_PP_STRINGIZE(T))                                          \
-    {                                                                                                \
-        if (app.is_wand_compressed()) {                                                              \
-            if (quantized) {                                                                         \
-                std::apply(perftest<BOOST_PP_CAT(T, _index), wand_uniform_index_quantized>, params); \
-            } else {                                                                                 \
-                std::apply(perftest<BOOST_PP_CAT(T, _index), wand_uniform_index>, params);           \
-            }                                                                                        \
-        } else {                                                                                     \
-            std::apply(perftest<BOOST_PP_CAT(T, _index), wand_raw_index>, params);                   \
-        }
-        /**/
-        BOOST_PP_SEQ_FOR_EACH(LOOP_BODY, _, PISA_INDEX_TYPES);
-#undef LOOP_BODY
-
-    } else {
+        safe,
+        integer_scores,
+        impact_index_filename,
+        budget,
+        pair_thresholds_filename,
+        range_size,
+        load,
+        perf_counters,
+        trace_filename,
+        SweepContinuation{});
+    if (not dispatch_perftest(app.index_encoding(), app.is_wand_compressed(), quantized, params)) {
         spdlog::error("Unknown type {}", app.index_encoding());
     }
 }
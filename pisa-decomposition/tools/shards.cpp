@@ -131,7 +131,8 @@ int main(int argc, char** argv)
                     shard_args.range(),
                     shard_args.compress(),
                     shard_args.quantize(),
-                    shard_args.dropped_term_ids());
+                    shard_args.dropped_term_ids(),
+                    shard_args.kth_score_ranks());
             }
         }
         if (taily->parsed()) {
@@ -10,6 +10,7 @@
 #include <spdlog/spdlog.h>
 
 #include "app.hpp"
+#include "cursor/block_max_scored_cursor.hpp"
 #include "cursor/max_scored_cursor.hpp"
 #include "cursor/scored_cursor.hpp"
 #include "index_types.hpp"
@@ -18,6 +19,7 @@
 #include "memory_source.hpp"
 #include "query/algorithm.hpp"
 #include "scorer/scorer.hpp"
+#include "tier_data.hpp"
 #include "util/util.hpp"
 #include "wand_data_compressed.hpp"
 #include "wand_data_raw.hpp"
@@ -29,7 +31,10 @@ void thresholds(
     const std::string& index_filename,
     const std::string& wand_data_filename,
     const std::vector<Query>& queries,
+    const std::optional<std::string>& tier_data_filename,
+    DecompositionMode decomposition,
     std::string const& type,
+    std::string const& algorithm,
     ScorerParams const& scorer_params,
     uint64_t k,
     bool quantized)
@@ -37,12 +42,34 @@ void thresholds(
     IndexType index(MemorySource::mapped_file(index_filename));
     WandType const wdata(MemorySource::mapped_file(wand_data_filename));
 
+    std::optional<TierData> tier_data;
+    if (tier_data_filename) {
+        tier_data.emplace(MemorySource::mapped_file(*tier_data_filename));
+        decomposition = tier_data->mode();
+    }
+    if (not supports_decomposition(algorithm, decomposition)) {
+        spdlog::error("Query algorithm {} does not support clipped indexes", algorithm);
+        return;
+    }
+
     auto scorer = scorer::from_params(scorer_params, wdata);
+    auto tiered_block_max_cursors = [&](Query const& query) {
+        if (tier_data) {
+            return make_block_max_scored_cursors(index, wdata, *tier_data, *scorer, query);
+        }
+        return make_block_max_scored_cursors(index, wdata, *scorer, query, decomposition);
+    };
 
     topk_queue topk(k);
     wand_query wand_q(topk);
+    block_max_maxscore_query block_max_maxscore_q(topk);
     for (auto const& query: queries) {
-        wand_q(make_max_scored_cursors(index, wdata, *scorer, query), index.num_docs());
+        if (algorithm == "pair_aware_block_max_maxscore") {
+            block_max_maxscore_q.pair_aware_block_max_maxscore(
+                tiered_block_max_cursors(query), index.num_docs());
+        } else {
+            wand_q(make_max_scored_cursors(index, wdata, *scorer, query), index.num_docs());
+        }
         topk.finalize();
         auto results = topk.topk();
         topk.clear();
@@ -67,18 +94,33 @@ int main(int argc, const char** argv)
     std::cout.precision(std::numeric_limits<float>::max_digits10);
 
     bool quantized = false;
+    std::string algorithm = "wand";
 
-    App<arg::Index, arg::WandData<arg::WandMode::Required>, arg::Query<arg::QueryMode::Ranked>, arg::Scorer>
+    App<arg::Index,
+        arg::WandData<arg::WandMode::Required>,
+        arg::Query<arg::QueryMode::Ranked>,
+        arg::Scorer,
+        arg::Tiers>
         app{"Extracts query thresholds."};
     app.add_flag("--quantized", quantized, "Quantizes the scores");
+    app.add_option(
+        "-a,--algorithm", algorithm, "Query algorithm: wand or pair_aware_block_max_maxscore", true);
 
     CLI11_PARSE(app, argc, argv);
 
+    if (algorithm != "wand" && algorithm != "pair_aware_block_max_maxscore") {
+        spdlog::error("Unsupported query algorithm: {}", algorithm);
+        return 1;
+    }
+
     auto params = std::make_tuple(
         app.index_filename(),
         app.wand_data_path(),
         app.queries(),
+        app.tier_data_path(),
+        app.decomposition(),
         app.index_encoding(),
+        algorithm,
         app.scorer_params(),
         app.k(),
         quantized);